@@ -111,6 +111,8 @@ namespace ACSVM
    //
    Environment::Environment() :
       branchLimit  {0},
+      profile      {false},
+      profileCodes {},
       scriptLocRegC{ScriptLocRegCDefault},
 
       funcV{nullptr},
@@ -311,6 +313,15 @@ namespace ACSVM
       return pd->modules.find(name);
    }
 
+   //
+   // Environment::forEachModule
+   //
+   void Environment::forEachModule(std::function<void(Module *)> const &fn)
+   {
+      for(auto &module : pd->modules)
+         fn(&module);
+   }
+
    //
    // Environment::freeFunction
    //
@@ -352,9 +363,13 @@ namespace ACSVM
    //
    // Environment::freeThread
    //
+   // Freed threads go to the front of the list, so that the next script
+   // started reuses the one whose storage was touched most recently.
+   //
    void Environment::freeThread(Thread *thread)
    {
-      thread->link.relink(&threadFree);
+      thread->link.unlink();
+      thread->link.insert(threadFree.next);
    }
 
    //
@@ -687,6 +702,17 @@ namespace ACSVM
          scope.refStrings();
    }
 
+   //
+   // Environment::reserveThreads
+   //
+   void Environment::reserveThreads(std::size_t count)
+   {
+      std::size_t free = threadFree.size();
+
+      for(; free < count; ++free)
+         allocThread()->link.insert(&threadFree);
+   }
+
    //
    // Environment::resetStrings
    //
@@ -13,9 +13,12 @@
 #ifndef ACSVM__Environment_H__
 #define ACSVM__Environment_H__
 
+#include "Code.hpp"
 #include "List.hpp"
 #include "String.hpp"
 
+#include <functional>
+
 
 //----------------------------------------------------------------------------|
 // Types                                                                      |
@@ -63,6 +66,9 @@ namespace ACSVM
 
       Module *findModule(ModuleName const &name) const;
 
+      // Calls fn for every loaded module.
+      void forEachModule(std::function<void(Module *)> const &fn);
+
       // Used by Module when unloading.
       void freeFunction(Function *func);
 
@@ -134,6 +140,9 @@ namespace ACSVM
 
       virtual void refStrings();
 
+      // Allocates threads until at least count are available for reuse.
+      void reserveThreads(std::size_t count);
+
       virtual void resetStrings();
 
       virtual void saveState(Serial &out) const;
@@ -153,6 +162,14 @@ namespace ACSVM
       // means no limit.
       Word branchLimit;
 
+      // If true, threads count the codes they run, their delays and the
+      // time they and their CallFunc calls take, into their Script and
+      // profileCodes. Default is false.
+      bool profile;
+
+      // Number of times each internal code was run while profiling.
+      DWord profileCodes[static_cast<std::size_t>(Code::None)];
+
       // Default number of script variables. Default is 20.
       Word scriptLocRegC;
 
@@ -40,6 +40,7 @@ namespace ACSVM
       flagClient{false},
       flagNet   {false}
    {
+      resetProfile();
    }
 
    //
@@ -48,6 +49,20 @@ namespace ACSVM
    Script::~Script()
    {
    }
+
+   //
+   // Script::resetProfile
+   //
+   void Script::resetProfile()
+   {
+      profCodes     = 0;
+      profExecs     = 0;
+      profTime      = 0;
+      profFuncs     = 0;
+      profFuncTime  = 0;
+      profDelays    = 0;
+      profDelayTics = 0;
+   }
 }
 
 // EOF
@@ -59,6 +59,17 @@ namespace ACSVM
 
       bool flagClient : 1;
       bool flagNet    : 1;
+
+      // Profiling counts, kept while Environment::profile is set.
+      DWord profCodes;     // Codes run.
+      DWord profExecs;     // Thread::exec calls that ran any codes.
+      DWord profTime;      // Nanoseconds spent in those calls.
+      DWord profFuncs;     // CallFunc calls.
+      DWord profFuncTime;  // Nanoseconds spent in CallFunc calls.
+      DWord profDelays;    // Delays started.
+      DWord profDelayTics; // Tics of those delays.
+
+      void resetProfile();
    };
 }
 
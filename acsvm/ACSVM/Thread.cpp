@@ -47,6 +47,12 @@ namespace ACSVM
       delay   {0},
       result  {0}
    {
+      // Give every thread its execution storage up front. Thread::stop keeps
+      // it, so a recycled thread starts without touching the allocator.
+      callStk.reserve(CallStkSize);
+      dataStk.reserve(DataStkSize);
+      localReg.alloc(Environment::ScriptLocRegCDefault);
+      localReg.clear();
    }
 
    //
@@ -247,7 +253,8 @@ namespace ACSVM
    //
    void Thread::stop()
    {
-      // Release execution resources.
+      // Release execution resources. The underlying storage is kept for the
+      // next script to run on this thread.
       callStk.clear();
       dataStk.clear();
       localArr.clear();
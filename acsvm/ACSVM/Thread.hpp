@@ -147,6 +147,10 @@ namespace ACSVM
       static constexpr std::size_t DataStkSize = 256;
 
    private:
+      bool callFuncTimed(Word func, Word const *argV, Word argC);
+
+      template<bool Profile> void execCodes(DWord &codes);
+
       CallFrame readCallFrame(Serial &in) const;
 
       void writeCallFrame(Serial &out, CallFrame const &in) const;
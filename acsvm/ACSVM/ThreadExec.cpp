@@ -21,6 +21,8 @@
 #include "Scope.hpp"
 #include "Script.hpp"
 
+#include <chrono>
+
 
 //----------------------------------------------------------------------------|
 // Macros                                                                     |
@@ -78,11 +80,51 @@
 // NextCase
 //
 #if ACSVM_DynamicGoto
-#define NextCase() goto *cases[*codePtr++]
+#define NextCase() \
+   do \
+   { \
+      CountCode(); \
+      goto *cases[*codePtr++]; \
+   } \
+   while(0)
 #else
 #define NextCase() goto next_case
 #endif
 
+//
+// CountCode
+//
+// Counts the code about to run, when profiling.
+//
+#define CountCode() \
+   if(Profile) \
+   { \
+      ++codes; \
+      ++env->profileCodes[*codePtr]; \
+   } \
+   else \
+      ((void)0)
+
+//
+// DoCallFunc
+//
+// Calls a CallFunc, timing it when profiling.
+//
+#define DoCallFunc(func, argV, argC) \
+   (Profile ? callFuncTimed((func), (argV), (argC)) : env->callFunc(this, (func), (argV), (argC)))
+
+//
+// CountDelay
+//
+#define CountDelay() \
+   if(Profile) \
+   { \
+      ++script->profDelays; \
+      script->profDelayTics += delay; \
+   } \
+   else \
+      ((void)0)
+
 //
 // Op_*
 //
@@ -263,6 +305,22 @@ namespace ACSVM
 
 namespace ACSVM
 {
+   //
+   // Thread::callFuncTimed
+   //
+   bool Thread::callFuncTimed(Word func, Word const *argV, Word argC)
+   {
+      Script *scr   = script;
+      auto    start = std::chrono::steady_clock::now();
+      bool    res   = env->callFunc(this, func, argV, argC);
+
+      scr->profFuncTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - start).count();
+      ++scr->profFuncs;
+
+      return res;
+   }
+
    //
    // Thread::exec
    //
@@ -271,6 +329,37 @@ namespace ACSVM
       if(delay && --delay)
          return;
 
+      DWord codes = 0;
+
+      if(env->profile && script)
+      {
+         // The thread may be stopped and lose its script while running.
+         Script *scr   = script;
+         auto    start = std::chrono::steady_clock::now();
+
+         execCodes<true>(codes);
+
+         if(codes)
+         {
+            scr->profTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start).count();
+            scr->profCodes += codes;
+            ++scr->profExecs;
+         }
+      }
+      else
+         execCodes<false>(codes);
+   }
+
+   //
+   // Thread::execCodes
+   //
+   // Runs the thread until it delays, waits or stops. When Profile is true,
+   // the codes run are counted into codes and the environment's counts.
+   //
+   template<bool Profile>
+   void Thread::execCodes(DWord &codes)
+   {
       auto branches = env->branchLimit;
 
    exec_intr:
@@ -315,7 +404,7 @@ namespace ACSVM
       #if ACSVM_DynamicGoto
       NextCase();
       #else
-      next_case: switch(*codePtr++)
+      next_case: CountCode(); switch(*codePtr++)
       #endif
       {
       DeclCase(Nop):
@@ -406,7 +495,7 @@ namespace ACSVM
             Word argc = *codePtr++;
             Word func = *codePtr++;
             dataStk.drop(argc);
-            if(env->callFunc(this, func, &dataStk[0], argc))
+            if(DoCallFunc(func, &dataStk[0], argc))
                goto exec_intr;
          }
          NextCase();
@@ -417,7 +506,7 @@ namespace ACSVM
             Word        func = *codePtr++;
             Word const *argv =  codePtr;
             codePtr += argc;
-            if(env->callFunc(this, func, argv, argc))
+            if(DoCallFunc(func, argv, argc))
                goto exec_intr;
          }
          NextCase();
@@ -567,10 +656,12 @@ namespace ACSVM
       DeclCase(ScrDelay):
          dataStk.drop();
          delay = dataStk[0];
+         CountDelay();
          goto exec_intr;
 
       DeclCase(ScrDelay_Lit):
          delay = *codePtr++;
+         CountDelay();
          goto exec_intr;
 
       DeclCase(ScrHalt):
@@ -49,6 +49,7 @@
 #include "ev_specials.h"
 #include "g_game.h"
 #include "hu_stuff.h"
+#include "m_compare.h"
 #include "m_random.h"
 #include "p_info.h"
 #include "p_inter.h"
@@ -56,6 +57,7 @@
 #include "p_map3d.h"
 #include "p_maputl.h"
 #include "p_portal.h"   // ioanch 20160116
+#include "p_sightbatch.h"
 #include "p_spec.h"
 #include "p_xenemy.h"
 #include "r_data.h"
@@ -73,6 +75,62 @@
 // Local Utilities
 //
 
+//
+// ACSThingCursor
+//
+// Walks the things a function is given by tid, newest first, as repeated calls
+// to P_FindMobjFromTID would. Positive tids are read from their span, which
+// is looked up again at each step since the things visited may be given tids
+// and move it. The span isn't compacted while a cursor is live, so the
+// position in it stays good.
+//
+class ACSThingCursor
+{
+protected:
+   int32_t tid;
+   Mobj   *trigger;
+   int     index; // span entries left, or -1 before the first thing
+
+public:
+   ACSThingCursor(int32_t ptid, Mobj *ptrigger)
+      : tid(ptid), trigger(ptrigger), index(-1)
+   {
+      P_BeginTIDWalk();
+   }
+
+   ~ACSThingCursor()
+   {
+      P_EndTIDWalk();
+   }
+
+   ACSThingCursor(const ACSThingCursor &) = delete;
+   ACSThingCursor &operator = (const ACSThingCursor &) = delete;
+
+   Mobj *next()
+   {
+      // reserved tids stand for a single thing
+      if(tid <= 0)
+      {
+         Mobj *mo = index < 0 ? P_FindMobjFromTID(tid, nullptr, trigger) : nullptr;
+         index = 0;
+         return mo;
+      }
+
+      Mobj *const *things;
+      int count = P_GetTIDSpan(tid, things);
+
+      index = index < 0 ? count : emin(index, count);
+      while(index > 0)
+      {
+         Mobj *mo = things[--index];
+         if(mo) // skip things which lost the tid
+            return mo;
+      }
+
+      return nullptr;
+   }
+};
+
 //
 // ACS_ChkThingProp
 //
@@ -99,7 +157,7 @@ static bool ACS_GetThingProp(ACSThread *thread, int32_t tid, uint32_t prop)
 static bool ACS_SetThingProp(ACSThread *thread, int32_t tid, uint32_t prop, uint32_t val)
 {
    Mobj *mo = nullptr;
-   while((mo = P_FindMobjFromTID(tid, mo, thread->info.mo)))
+   for(ACSThingCursor cursor(tid, thread->info.mo); (mo = cursor.next()); )
       ACS_SetThingProp(mo, prop, val);
    return false;
 }
@@ -393,9 +451,9 @@ bool ACS_CF_CheckSight(ACS_CF_ARGS)
    Mobj   *mo1  = nullptr;
    Mobj   *mo2  = nullptr;
 
-   while((mo1 = P_FindMobjFromTID(tid1, mo1, info->mo)))
+   for(ACSThingCursor cursor1(tid1, info->mo); (mo1 = cursor1.next()); )
    {
-      while((mo2 = P_FindMobjFromTID(tid2, mo2, info->mo)))
+      for(ACSThingCursor cursor2(tid2, info->mo); (mo2 = cursor2.next()); )
       {
          if(P_CheckSight(mo1, mo2))
          {
@@ -1576,7 +1634,7 @@ bool ACS_CF_RadiusQuake(ACS_CF_ARGS)
    const char *snd          = thread->scopeMap->getString(argV[5])->str;
    Mobj       *mo           = NULL;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
    {
       QuakeThinker *qt;
 
@@ -1827,6 +1885,8 @@ static void ACS_setLineBlocking(int tag, int block)
    line_t *l;
    int linenum = -1;
 
+   P_SightBatchInvalidate();
+
    while((l = P_FindLine(tag, &linenum)) != NULL)
    {
       switch(block)
@@ -1991,7 +2051,7 @@ bool ACS_CF_SetThingMom(ACS_CF_ARGS)
    bool    add  = argV[4] ? true : false;
    Mobj   *mo   = nullptr;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
    {
       if(add)
       {
@@ -2213,7 +2273,7 @@ bool ACS_CF_SetThingSpec(ACS_CF_ARGS)
    //int spec = argV[1]; // HEXEN_TODO
    Mobj *mo   = NULL;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
    {
       //mo->special = spec; // HEXEN_TODO
       for(int i = 0; i != 5; ++i)
@@ -2238,7 +2298,7 @@ bool ACS_CF_SetThingState(ACS_CF_ARGS)
    uint32_t    count     = 0;
    Mobj       *mo        = nullptr;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
    {
       // Look for the named state for that type.
       if((state = E_GetJumpInfo(mo->info, statename)))
@@ -2404,7 +2464,7 @@ bool ACS_CF_SpawnMissile(ACS_CF_ARGS)
    fixed_t    momy    = speed * finesine[  angle >> ANGLETOFINESHIFT];
    fixed_t    momz    = vspeed << FRACBITS;
 
-   while((spot = P_FindMobjFromTID(spotid, spot, info->mo)))
+   for(ACSThingCursor cursor(spotid, info->mo); (spot = cursor.next()); )
    {
       ACS_spawnMissile(type, spot->x, spot->y, spot->z, momx, momy, momz, tid,
                        spot, angle, gravity);
@@ -2463,7 +2523,7 @@ static void ACS_spawnSpot(ACS_CF_ARGS, bool forced)
    Mobj       *spot   = nullptr;
    ACSVM::Word res    = 0;
 
-   while((spot = P_FindMobjFromTID(spotid, spot, info->mo)))
+   for(ACSThingCursor cursor(spotid, info->mo); (spot = cursor.next()); )
       res += !!ACS_spawn(type, spot->x, spot->y, spot->z, tid, angle, forced);
 
    thread->dataStk.push(res);
@@ -2503,7 +2563,7 @@ static void ACS_spawnSpotAng(ACS_CF_ARGS, bool forced)
    Mobj      *spot   = nullptr;
    uint32_t   res    = 0;
 
-   while((spot = P_FindMobjFromTID(spotid, spot, info->mo)))
+   for(ACSThingCursor cursor(spotid, info->mo); (spot = cursor.next()); )
       res += !!ACS_spawn(type, spot->x, spot->y, spot->z, tid, spot->angle, forced);
 
    thread->dataStk.push(res);
@@ -2614,7 +2674,7 @@ static uint32_t ACS_thingCount(mobjtype_t type, int32_t tid)
 
    if(tid)
    {
-      while((mo = P_FindMobjFromTID(tid, mo, NULL)))
+      for(ACSThingCursor cursor(tid, NULL); (mo = cursor.next()); )
       {
          if(type == 0 || mo->type == type)
          {
@@ -2759,7 +2819,7 @@ bool ACS_CF_ThingDamage(ACS_CF_ARGS)
    Mobj    *mo     = nullptr;
    uint32_t count  = 0;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
    {
       P_DamageMobj(mo, nullptr, nullptr, damage, mod);
       ++count;
@@ -2795,7 +2855,7 @@ bool ACS_CF_ThingMissile(ACS_CF_ARGS)
 
    type = ACS_thingtypes[type];
 
-   while((spot = P_FindMobjFromTID(spotid, spot, info->mo)))
+   for(ACSThingCursor cursor(spotid, info->mo); (spot = cursor.next()); )
    {
       ACS_spawnMissile(type, spot->x, spot->y, spot->z, momx, momy, momz, tid,
                        spot, angle, gravity);
@@ -2817,7 +2877,7 @@ bool ACS_CF_ThingSound(ACS_CF_ARGS)
    int         vol  = argV[2];
    Mobj       *mo   = NULL;
 
-   while((mo = P_FindMobjFromTID(tid, mo, info->mo)))
+   for(ACSThingCursor cursor(tid, info->mo); (mo = cursor.next()); )
       S_StartSoundNameAtVolume(mo, snd, vol, ATTN_NORMAL, CHAN_AUTO);
 
    return false;
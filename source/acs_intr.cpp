@@ -30,8 +30,10 @@
 //----------------------------------------------------------------------------
 
 #include "z_zone.h"
+#include "hal/i_timer.h"
 
 #include "acs_intr.h"
+#include "c_io.h"
 #include "c_runcmd.h"
 #include "doomstat.h"
 #include "e_hash.h"
@@ -581,6 +583,9 @@ void ACSThread::stop()
 //
 void ACS_Init(void)
 {
+   // Most maps never have more than a handful of scripts running at once, so
+   // a small pool of threads covers script starts without any allocation.
+   ACSenv.reserveThreads(ACS_NUMTHREADS);
 }
 
 //
@@ -892,6 +897,286 @@ protected:
    char buf[1];
 };
 
+//=============================================================================
+//
+// Profiling
+//
+// "acs_profile start" zeroes the counts kept by the interpreter and starts
+// keeping them, "acs_profile stop" stops, and "acs_profile dump [file]"
+// writes them out, the most expensive scripts and modules first.
+//
+
+static const char *const ACSCodeNames[] =
+{
+   #define ACSVM_CodeList(name, ...) #name,
+   #include "ACSVM/CodeList.hpp"
+};
+
+static int ACSProfileStart; // gametic when profiling started
+
+//
+// Zeroes all profiling counts.
+//
+static void ACS_resetProfile()
+{
+   ACSenv.forEachModule([](ACSVM::Module *module) {
+      for(ACSVM::Script &scr : module->scriptV)
+         scr.resetProfile();
+   });
+   memset(ACSenv.profileCodes, 0, sizeof(ACSenv.profileCodes));
+}
+
+//
+// Names a module and script for the report.
+//
+static void ACS_profileName(qstring &name, const ACSVM::Script *scr)
+{
+   const ACSVM::ModuleName &mname = scr->module->name;
+
+   name.clear();
+   if(mname.s)
+      name << mname.s->str;
+   else
+      name << "?";
+   name << ':';
+   if(scr->name.s)
+      name << '"' << scr->name.s->str << '"';
+   else
+      name << static_cast<int>(scr->name.i);
+}
+
+//
+// Writes the profile report to a file.
+//
+static bool ACS_dumpProfile(const char *filename)
+{
+   struct modtotal_t
+   {
+      const ACSVM::Module *module;
+      uint64_t time, codes, funcTime;
+   };
+
+   PODCollection<ACSVM::Script *> scripts;
+   PODCollection<modtotal_t>      modules;
+   PODCollection<int>             codes;
+   qstring name;
+   FILE   *f;
+
+   if(!(f = fopen(filename, "w")))
+      return false;
+
+   ACSenv.forEachModule([&](ACSVM::Module *module) {
+      modtotal_t total = { module, 0, 0, 0 };
+
+      for(ACSVM::Script &scr : module->scriptV)
+      {
+         if(!scr.profExecs && !scr.profDelays)
+            continue;
+         scripts.add(&scr);
+         total.time     += scr.profTime;
+         total.codes    += scr.profCodes;
+         total.funcTime += scr.profFuncTime;
+      }
+
+      if(total.codes)
+         modules.add(total);
+   });
+
+   std::sort(scripts.begin(), scripts.end(),
+             [](const ACSVM::Script *a, const ACSVM::Script *b) {
+                return a->profTime > b->profTime;
+             });
+   std::sort(modules.begin(), modules.end(),
+             [](const modtotal_t &a, const modtotal_t &b) {
+                return a.time > b.time;
+             });
+   for(int i = 0; i < int(earrlen(ACSCodeNames)); i++)
+   {
+      if(ACSenv.profileCodes[i])
+         codes.add(i);
+   }
+   std::sort(codes.begin(), codes.end(), [](int a, int b) {
+      return ACSenv.profileCodes[a] > ACSenv.profileCodes[b];
+   });
+
+   fprintf(f, "ACS profile over %d tics%s\n\n",
+           gametic - ACSProfileStart, ACSenv.profile ? " (still running)" : "");
+
+   fprintf(f, "%-32s %10s %10s %12s %8s %10s %8s %9s\n",
+           "script", "time ms", "runs", "codes", "funcs", "func ms", "delays", "avg delay");
+   for(const ACSVM::Script *scr : scripts)
+   {
+      ACS_profileName(name, scr);
+      fprintf(f, "%-32s %10.3f %10llu %12llu %8llu %10.3f %8llu %9.2f\n",
+              name.constPtr(), scr->profTime / 1.0e6,
+              static_cast<unsigned long long>(scr->profExecs),
+              static_cast<unsigned long long>(scr->profCodes),
+              static_cast<unsigned long long>(scr->profFuncs),
+              scr->profFuncTime / 1.0e6,
+              static_cast<unsigned long long>(scr->profDelays),
+              scr->profDelays ? double(scr->profDelayTics) / scr->profDelays : 0.0);
+   }
+
+   fprintf(f, "\n%-32s %10s %12s %10s\n", "module", "time ms", "codes", "func ms");
+   for(const modtotal_t &total : modules)
+   {
+      const ACSVM::ModuleName &mname = total.module->name;
+      fprintf(f, "%-32s %10.3f %12llu %10.3f\n",
+              mname.s ? mname.s->str : "?", total.time / 1.0e6,
+              static_cast<unsigned long long>(total.codes), total.funcTime / 1.0e6);
+   }
+
+   fprintf(f, "\n%-32s %12s\n", "code", "count");
+   for(int code : codes)
+   {
+      fprintf(f, "%-32s %12llu\n", ACSCodeNames[code],
+              static_cast<unsigned long long>(ACSenv.profileCodes[code]));
+   }
+
+   fclose(f);
+   return true;
+}
+
+CONSOLE_COMMAND(acs_profile, cf_notnet)
+{
+   qstring cmd;
+
+   if(Console.argc >= 1)
+      cmd = *Console.argv[0];
+
+   if(cmd == "start")
+   {
+      ACS_resetProfile();
+      ACSProfileStart = gametic;
+      ACSenv.profile  = true;
+      C_Printf("ACS profiling started\n");
+   }
+   else if(cmd == "stop")
+   {
+      ACSenv.profile = false;
+      C_Printf("ACS profiling stopped\n");
+   }
+   else if(cmd == "dump")
+   {
+      const char *filename = Console.argc >= 2 ? Console.argv[1]->constPtr() :
+                                                 "acsprofile.txt";
+
+      if(ACS_dumpProfile(filename))
+         C_Printf("ACS profile written to %s\n", filename);
+      else
+         C_Printf(FC_ERROR "Could not write %s\n", filename);
+   }
+   else
+      C_Printf("usage: acs_profile start|stop|dump [filename]\n");
+}
+
+//=============================================================================
+//
+// Thread Pool Benchmark
+//
+// acs_threadbench starts thousands of scripts which end at once, a tic's
+// worth at a time, in an environment of its own so that the level is left
+// alone. It times them run on threads from the pool against allocating and
+// freeing a thread for every one.
+//
+
+// An ACS0 module holding closed script 1, which only terminates
+static const byte ACSBenchModule[] =
+{
+   'A', 'C', 'S', 0, 12, 0, 0, 0, // header, directory offset
+   1, 0, 0, 0,                    // code: Terminate
+   1, 0, 0, 0,                    // scripts
+   1, 0, 0, 0,  8, 0, 0, 0,  0, 0, 0, 0,
+   0, 0, 0, 0                     // strings
+};
+
+class ACSBenchEnvironment : public ACSEnvironment
+{
+public:
+   virtual void loadModule(ACSVM::Module *module)
+   {
+      module->readBytecode(ACSBenchModule, sizeof(ACSBenchModule));
+   }
+
+   // Deletes the threads waiting to be reused.
+   void dropFreeThreads()
+   {
+      while(threadFree.next->obj)
+         delete threadFree.next->obj;
+   }
+};
+
+//
+// Starts count scripts and runs them to their end, returning the time taken
+//
+static unsigned int ACS_benchTic(ACSBenchEnvironment &env, ACSVM::Script *script, int count)
+{
+   ACSThreadInfo info;
+   unsigned int  start = i_haltimer.GetTicks();
+
+   for(int i = 0; i < count; i++)
+      env.map->scriptStartForced(script, {nullptr, 0, &info});
+   env.exec();
+
+   return i_haltimer.GetTicks() - start;
+}
+
+CONSOLE_COMMAND(acs_threadbench, cf_hidden)
+{
+   int count = Console.argc ? Console.argv[0]->toInt() : 10000;
+
+   if(count < 1)
+      count = 1;
+
+   ACSBenchEnvironment env;
+   ACSVM::Module *module;
+
+   try
+   {
+      module = env.getModule(env.getModuleName("ACSBENCH"));
+   }
+   catch(const ACSVM::ReadError &e)
+   {
+      C_Printf(FC_ERROR "acs_threadbench: %s\n", e.what());
+      return;
+   }
+
+   env.hub = env.global->getHubScope(0);
+   env.hub->active = true;
+   env.map = env.hub->getMapScope(0);
+   env.map->active = true;
+   env.map->addModules(&module, 1);
+
+   ACSVM::Script *script = env.map->findScript(ACSVM::Word(1));
+   unsigned int pooledms = 0, allocms = 0;
+   int tics = 0;
+
+   env.reserveThreads(count);
+
+   // alternate the two, repeating until it takes long enough to measure
+   while(pooledms + allocms < 1000 && tics < 200)
+   {
+      pooledms += ACS_benchTic(env, script, count);
+
+      // with nothing to reuse, every script gets a new thread
+      env.dropFreeThreads();
+      allocms += ACS_benchTic(env, script, count);
+
+      unsigned int start = i_haltimer.GetTicks();
+      env.dropFreeThreads();
+      allocms += i_haltimer.GetTicks() - start;
+
+      env.reserveThreads(count);
+      ++tics;
+   }
+
+   C_Printf("%d scripts per tic, %d tics\n", count, tics);
+   C_Printf("pooled threads:    %.3f ms per tic\n", double(pooledms) / tics);
+   C_Printf("allocated threads: %.3f ms per tic\n", double(allocms) / tics);
+   if(env.countActiveThread())
+      C_Printf(FC_ERROR "%d scripts did not end\n", int(env.countActiveThread()));
+}
+
 //
 // ACS_Archive
 //
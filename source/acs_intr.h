@@ -49,6 +49,9 @@ class  WadDirectory;
 
 #define ACS_NUM_THINGTYPES 256
 
+// threads kept ready for reuse from startup
+#define ACS_NUMTHREADS 64
+
 #define ACS_CF_ARGS ACSVM::Thread *thread, const ACSVM::Word *argV, ACSVM::Word argC
 
 //
@@ -36,6 +36,7 @@
 #include "c_runcmd.h"
 #include "c_net.h"
 
+#include "d_dedicated.h"
 #include "d_event.h"
 #include "d_main.h"
 #include "doomdef.h"
@@ -764,6 +765,10 @@ void C_Printf(const char *s, ...)
 
    // haleyjd: write this message to the log if one is open
    C_AppendToLog(tempstr); 
+
+   // a dedicated server has no other way to show it
+   if(dedicated)
+      D_DedicatedPrint(tempstr);
    
    C_AdjustLineBreaks(tempstr); // haleyjd
    
@@ -42,6 +42,7 @@
 #include "c_runcmd.h"
 #include "c_net.h"
 #include "d_main.h"
+#include "d_net.h"
 #include "doomdef.h"
 #include "doomstat.h"
 #include "dstrings.h"
@@ -175,7 +176,8 @@ void C_NetTicker(void)
       // check for incoming chat chars
       for(int i=0; i<MAXPLAYERS; i++)
       {
-         if(!playeringame[i]) 
+         // a dedicated server has no player, but sends commands
+         if(!playeringame[i] && !(i == 0 && dedicatedhost))
             continue;
          C_DealWithChar(players[i].cmd.chatchar,i);
       }
@@ -39,17 +39,15 @@
 #include "r_portal.h"
 #include "r_state.h"
 
-#define VALID_ISSET(set, i) ((set)[(i) >> 3] & (1 << ((i) & 7)))
-#define VALID_SET(set, i) ((set)[(i) >> 3] |= 1 << ((i) & 7))
-
 //
 // Constructor. Initializes dynamic structures
 //
 PathTraverser::PathTraverser(const PTDef &indef, void *incontext) :
-   trace(), def(indef), context(incontext), portalguard()
+   trace(), def(indef), context(incontext), query(QueryContext::Acquire()),
+   portalguard(), intercepts(query->getIntercepts())
 {
-   VALID_ALLOC(validlines, ::numlines);
-   VALID_ALLOC(validpolys, ::numPolyObjects);
+   query->newQuery();
+   intercepts.clear();
 }
 
 
@@ -59,12 +57,9 @@ PathTraverser::PathTraverser(const PTDef &indef, void *incontext) :
 //
 bool PathTraverser::traverseIntercepts() const
 {
-   size_t    count;
-   fixed_t   dist;
-   divline_t dl;
-   PODCollection<intercept_t>::iterator scan, end, in;
+   divline_t    dl;
+   intercept_t *scan, *end, *in;
 
-   count = intercepts.getLength();
    end = intercepts.end();
 
    //
@@ -80,22 +75,17 @@ bool PathTraverser::traverseIntercepts() const
 
    //
    // go through in order
-   //	
-   in = NULL; // shut up compiler warning
+   //
+   intercepts.sort();
 
-   while(count--)
+   in = nullptr;
+   for(scan = intercepts.begin(); scan < end; scan++)
    {
-      dist = D_MAXINT;
-
-      for(scan = intercepts.begin(); scan < end; scan++)
-      {
-         if(scan->frac < dist)
-         {
-            dist = scan->frac;
-            in = scan;
-         }
-      }
-
+      // Intercepts as far as D_MAXINT were never picked by the nearest-first
+      // search this replaces, which instead handed the last picked one to the
+      // traverser again, once for each of them.
+      if(scan->frac != D_MAXINT)
+         in = scan;
       if(in)
       {
          if(!def.trav(in, context, trace))
@@ -178,8 +168,6 @@ bool PathTraverser::checkLine(size_t linenum)
    int s1, s2;
    divline_t dl;
 
-   VALID_SET(validlines, linenum);
-
    if(def.flags & CAM_REQUIRELINEPORTALS && !(ld->pflags & PS_PASSABLE))
       return true;
 
@@ -258,18 +246,13 @@ bool PathTraverser::blockLinesIterator(int x, int y)
    while(plink)
    {
       polyobj_t *po = (*plink)->po;
-      int polynum = eindex(po - PolyObjects);
 
       // if polyobj hasn't been checked
-      if(!VALID_ISSET(validpolys, polynum))
+      if(query->markPolyobj(*po))
       {
-         VALID_SET(validpolys, polynum);
-
          for(int i = 0; i < po->numLines; ++i)
          {
-            int linenum = eindex(po->lines[i] - lines);
-
-            if(VALID_ISSET(validlines, linenum))
+            if(!query->markLine(*po->lines[i]))
                continue; // line has already been checked
 
             if(!checkLine(po->lines[i] - ::lines))
@@ -297,7 +280,7 @@ bool PathTraverser::blockLinesIterator(int x, int y)
       if(linenum >= numlines)
          continue;
 
-      if(VALID_ISSET(validlines, linenum))
+      if(!query->markLine(lines[linenum]))
          continue; // line has already been checked
 
       if(!checkLine(linenum))
@@ -24,9 +24,7 @@
 
 #include "m_collection.h"
 #include "p_maputl.h"
-
-#define VALID_ALLOC(set, n) ((set) = ecalloc(byte *, 1, (((n) + 7) & ~7) / 8))
-#define VALID_FREE(set) efree(set)
+#include "p_querycontext.h"
 
 //
 // PathTraverser setup
@@ -55,8 +53,7 @@ public:
    PathTraverser(const PTDef &indef, void *incontext);
    ~PathTraverser()
    {
-      VALID_FREE(validlines);
-      VALID_FREE(validpolys);
+      QueryContext::Release(query);
    }
 
    divline_t trace;
@@ -68,14 +65,14 @@ private:
 
    const PTDef def;
    void *const context;
-   byte *validlines;
-   byte *validpolys;
+   QueryContext *const query; // lines and polyobjects already checked
    struct
    {
       bool hitpblock;
       bool addedportal;
    } portalguard;
-   PODCollection<intercept_t> intercepts;
+   InterceptArena &intercepts; // kept by the query context
+
 };
 
 //
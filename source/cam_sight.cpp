@@ -76,9 +76,6 @@ public:
    fixed_t openbottom;  // bottom of linedef silhouette
    fixed_t openrange;   // height of opening
 
-   // Intercepts vector
-   PODCollection<intercept_t> intercepts;
-
    // portal traversal information
    int  fromid;        // current source group id
    int  toid;          // group id of the target
@@ -93,7 +90,6 @@ public:
    explicit CamSight(const camsightparams_t &sp)
       : cx(sp.cx), cy(sp.cy), tx(sp.tx), ty(sp.ty),
         opentop(0), openbottom(0), openrange(0),
-        intercepts(),
         fromid(sp.cgroupid), toid(sp.tgroupid), 
         portalresult(false), portalexit(false),
         params(&sp)
@@ -0,0 +1,172 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Dedicated netgame server (-dedicated).
+//
+// A dedicated server is the first node of a netgame, and starts it as usual
+// from D_ArbitrateNetStart, but it takes no part in the game as a player:
+// player 1 is left out on every node. It opens no window and sets up no
+// sound or music. It runs only the game at 35 tics a second and sleeps for
+// the rest of the time. Console commands are read from standard input and
+// console output is written to standard output.
+//
+//----------------------------------------------------------------------------
+
+#include <mutex>
+#include <thread>
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_dedicated.h"
+#include "d_net.h"
+#include "doomstat.h"
+#include "hal/i_timer.h"
+#include "i_system.h"
+#include "m_compare.h"
+
+bool dedicated;
+
+#define MAXINPUTLINES 16
+#define INPUTLINESIZE 256
+
+// Lines read from standard input by the reader thread, waiting to be run.
+// The thread only copies text in here; everything else stays on the main
+// thread.
+static char       inputlines[MAXINPUTLINES][INPUTLINESIZE];
+static int        inputhead, inputcount;
+static std::mutex inputlock;
+
+//
+// Reads standard input a line at a time, for as long as it stays open.
+//
+static void D_readInput()
+{
+   char line[INPUTLINESIZE];
+
+   while(fgets(line, sizeof(line), stdin))
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+      if(!*line)
+         continue;
+
+      while(1)
+      {
+         {
+            std::lock_guard<std::mutex> lock(inputlock);
+            if(inputcount < MAXINPUTLINES)
+            {
+               int slot = (inputhead + inputcount++) % MAXINPUTLINES;
+               strcpy(inputlines[slot], line);
+               break;
+            }
+         }
+         // the game has fallen behind; wait for it to catch up
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+   }
+}
+
+//
+// Runs the console commands read since the last call.
+//
+static void D_runInput()
+{
+   char line[INPUTLINESIZE];
+
+   while(1)
+   {
+      {
+         std::lock_guard<std::mutex> lock(inputlock);
+         if(!inputcount)
+            return;
+         strcpy(line, inputlines[inputhead]);
+         inputhead = (inputhead + 1) % MAXINPUTLINES;
+         --inputcount;
+      }
+      C_Printf("> %s\n", line);
+      C_RunTextCmd(line);
+   }
+}
+
+//
+// D_DedicatedSleepTime
+//
+// Returns how long to sleep, in milliseconds, until the next tic is due.
+//
+int D_DedicatedSleepTime()
+{
+   static int lasttic = -1;
+   static unsigned int ticstart;
+   int tic = i_haltimer.GetRealTime();
+   unsigned int now = i_haltimer.GetTicks();
+
+   // note when the current tic began, to within a sleep
+   if(tic != lasttic)
+   {
+      lasttic  = tic;
+      ticstart = now;
+   }
+
+   return eclamp(1000 / TICRATE - int(now - ticstart), 1, 1000 / TICRATE);
+}
+
+//
+// D_DedicatedPrint
+//
+// Echoes console output to standard output, without the colour codes.
+//
+void D_DedicatedPrint(const char *text)
+{
+   for(const unsigned char *c = (const unsigned char *)text; *c; c++)
+   {
+      if(*c < 128)
+         putchar(*c);
+   }
+   fflush(stdout);
+}
+
+//
+// D_DedicatedLoop
+//
+// Main loop of a dedicated server, taking the place of the one in D_DoomMain.
+//
+void D_DedicatedLoop()
+{
+   if(!netgame)
+      I_Error("D_DedicatedLoop: -dedicated needs a netgame\n");
+
+   std::thread(D_readInput).detach();
+
+   // TryRunTics waits for the next tic, sleeping, instead of returning to
+   // draw a frame
+   d_fastrefresh = false;
+
+   while(1)
+   {
+      D_runInput();
+      TryRunTics();
+      Z_FreeAlloca();
+   }
+}
+
+// EOF
+
@@ -39,6 +39,7 @@
 #include "c_io.h"
 #include "c_net.h"
 #include "c_runcmd.h"
+#include "d_dedicated.h"
 #include "d_deh.h"      // Ty 04/08/98 - Externalizations
 #include "d_dehtbl.h"
 #include "d_event.h"
@@ -56,6 +57,7 @@
 #include "f_wipe.h"
 #include "g_bind.h"
 #include "g_demolog.h"
+#include "g_demoverify.h"
 #include "g_dmflag.h"
 #include "g_game.h"
 #include "g_gfs.h"
@@ -1203,8 +1205,9 @@ static void D_LoadSysConfig(void)
 //
 static void D_SetGraphicsMode()
 {
-   // set graphics mode
-   I_InitGraphics();
+   // set graphics mode; a dedicated server has none at all
+   if(!dedicated)
+      I_InitGraphics();
 
    // set up the console to display startup messages
    gamestate = GS_CONSOLE;
@@ -1265,6 +1268,10 @@ static void D_DoomInit()
 
    FindResponseFile(); // Append response file arguments to command-line
 
+   // -demoverify plays a list of demos in other instances, then quits
+   if((p = M_CheckParm("-demoverify")) && p < myargc - 1)
+      G_DemoVerify(myargv[p + 1]);
+
    // haleyjd 08/18/07: set base path and user path
    D_SetBasePath();
    D_SetUserPath();
@@ -1415,6 +1422,8 @@ static void D_DoomInit()
    // ioanch 20160313: demo testing
    if((p = M_CheckParm("-demolog")) && p < myargc - 1)
       G_DemoLogInit(myargv[p + 1]);
+   if((p = M_CheckParm("-demohashlog")) && p < myargc - 1)
+      G_DemoHashInit(myargv[p + 1]);
 
    // haleyjd 01/17/11: allow -play also
    const char *playdemoparms[] = { "-playdemo", "-play", NULL };
@@ -1518,9 +1527,12 @@ static void D_DoomInit()
       }
    }
 
+   // -dedicated: headless netgame server; see d_dedicated.cpp
+   dedicated = !!M_CheckParm("-dedicated");
+
    //jff 1/22/98 add command line parms to disable sound and music
    {
-      bool nosound = !!M_CheckParm("-nosound");
+      bool nosound = dedicated || M_CheckParm("-nosound");
       nomusicparm  = nosound || M_CheckParm("-nomusic");
       nosfxparm    = nosound || M_CheckParm("-nosfx");
       s_randmusic  = !!M_CheckParm("-randmusic");
@@ -1528,8 +1540,8 @@ static void D_DoomInit()
    //jff end of sound/music command line parms
 
    // killough 3/2/98: allow -nodraw -noblit generally
-   nodrawers = !!M_CheckParm("-nodraw");
-   noblit    = !!M_CheckParm("-noblit");
+   nodrawers = dedicated || M_CheckParm("-nodraw");
+   noblit    = dedicated || M_CheckParm("-noblit");
 
    // haleyjd: need to do this before M_LoadDefaults
    C_InitPlayerName();
@@ -1679,8 +1691,11 @@ static void D_DoomInit()
    startupmsg("F_Init", "Init finale.");
    F_Init();
 
-   startupmsg("S_Init", "Setting up sound.");
-   S_Init(snd_SfxVolume, snd_MusicVolume);
+   if(!dedicated)
+   {
+      startupmsg("S_Init", "Setting up sound.");
+      S_Init(snd_SfxVolume, snd_MusicVolume);
+   }
 
    //
    // NETCODE_FIXME: Netgame check.
@@ -1938,6 +1953,9 @@ void D_DoomMain()
    if(autostart)
       oldgamestate = GS_NOSTATE;
 
+   if(dedicated)
+      D_DedicatedLoop();
+
    // killough 12/98: inlined D_DoomLoop
    while(1)
    {
@@ -1950,7 +1968,9 @@ void D_DoomMain()
       S_UpdateSounds(players[displayplayer].mo); // move positional sounds
 
       // Update display, next frame, with current state.
+      D_PredictLocalPlayer();
       D_Display();
+      D_UnpredictLocalPlayer();
 
       // Sound mixing for the buffer is synchronous.
       I_UpdateSound();
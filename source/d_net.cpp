@@ -33,21 +33,28 @@
 #include "d_englsh.h"
 #include "d_event.h"
 #include "d_gi.h"
+#include "d_dedicated.h"
 #include "d_main.h"
 #include "d_net.h"
+#include "d_nettrans.h"
 #include "doomstat.h"
 #include "e_player.h"
 #include "e_things.h"
 #include "f_wipe.h"
 #include "g_dmflag.h"
 #include "g_game.h"
+#include "g_rewind.h"
 #include "hal/i_timer.h"
+#include "m_argv.h"
 #include "m_random.h"
 #include "mn_engin.h"
 #include "i_net.h"
 #include "i_video.h"
 #include "p_partcl.h"
+#include "p_predict.h"
 #include "p_skin.h"
+#include "p_statehash.h"
+#include "p_tick.h"
 #include "r_draw.h"
 #include "v_misc.h"
 #include "v_video.h"
@@ -71,6 +78,7 @@ doomdata_t *netbuffer; // points inside doomcom
 static ticcmd_t localcmds[BACKUPTICS];
 
 ticcmd_t    netcmds[MAXPLAYERS][BACKUPTICS];
+static ticcmd_t nodecmds[MAXNETNODES][BACKUPTICS]; // as received, for deltas
 static int  nettics[MAXNETNODES];
 static bool nodeingame[MAXNETNODES];      // set false as nodes leave game
 static bool remoteresend[MAXNETNODES];    // set when local needs tics
@@ -81,14 +89,27 @@ static int  nodeforplayer[MAXPLAYERS];
 int        maketic;
 static int skiptics;
 int        ticdup;         
-static int maxsend;               // BACKUPTICS/(2*ticdup)-1
+int        backuptics = DEFBACKUPTICS; // tics that may be buffered ahead
+static int maxsend;               // backuptics/(2*ticdup)-1
 
 void D_ProcessEvents(); 
 void G_BuildTiccmd(ticcmd_t *cmd); 
 void D_DoAdvanceDemo();
 
-static bool       reboundpacket;
-static doomdata_t reboundstore;
+static bool (*netcmd)() = I_NetCmd; // network driver
+
+static bool reboundpacket;
+static byte reboundstore[NETMAXPACKETSIZE];
+static int  reboundlength;
+static int  packetheaderlength; // where the ticcmds start in doomcom->packet
+
+static bool predictcheck;  // -predictcheck: verify every prediction rollback
+static int  predictchecks; // rollbacks verified so far
+
+static void D_finishNetSimCheck();
+
+// Player 1 is a dedicated server, which takes part only as a node
+bool dedicatedhost;
 
 //
 // ExpandTics
@@ -114,13 +135,18 @@ static int ExpandTics(int low)
 //
 // HSendPacket
 //
-static void HSendPacket(int node, int flags)
+// Ticcmds are sent relative to base, the tic before the first one, or to an
+// empty ticcmd if it is null.
+//
+static void HSendPacket(int node, int flags, const ticcmd_t *base = nullptr)
 {
    netbuffer->checksum = (uint32_t)flags;
+   doomcom->datalength = D_WritePacket(netbuffer, base, doomcom->packet);
    
    if(!node)
    {
-      reboundstore = *netbuffer;
+      memcpy(reboundstore, doomcom->packet, doomcom->datalength);
+      reboundlength = doomcom->datalength;
       reboundpacket = true;
       return;
    }
@@ -134,7 +160,7 @@ static void HSendPacket(int node, int flags)
    doomcom->command    = CMD_SEND;
    doomcom->remotenode = node;
    
-   I_NetCmd();
+   netcmd();
 }
 
 //
@@ -145,28 +171,33 @@ static bool HGetPacket()
 {       
    if(reboundpacket)
    {
-      *netbuffer = reboundstore;
+      memcpy(doomcom->packet, reboundstore, reboundlength);
+      doomcom->datalength = reboundlength;
       doomcom->remotenode = 0;
       reboundpacket = false;
-      return true;
    }
-   
-   if(!netgame)
-      return false;
-   
-   if(demoplayback)
-      return false;
+   else
+   {
+      if(!netgame)
+         return false;
 
-   doomcom->command = CMD_GET;
-   if(!I_NetCmd())
-      return false;
-   
-   if(doomcom->remotenode == -1)
-      return false;
+      if(demoplayback)
+         return false;
+
+      doomcom->command = CMD_GET;
+      if(!netcmd())
+         return false;
+
+      if(doomcom->remotenode == -1)
+         return false;
+   }
    
    // haleyjd 08/25/11: length & checksum not handled here any more
-   
-   return true;
+
+   // the ticcmds are decoded by GetPackets, once their base is known
+   packetheaderlength = D_ReadPacketHeader(doomcom->packet, doomcom->datalength,
+                                           netbuffer);
+   return packetheaderlength > 0;
 }
 
 //
@@ -205,7 +236,7 @@ static void GetPackets()
          // sf: remove the players mobj
          // spawn teleport flash
          
-         if(gamestate == GS_LEVEL)
+         if(gamestate == GS_LEVEL && players[netconsole].mo)
          {
             Mobj *tflash;
 
@@ -235,6 +266,12 @@ static void GetPackets()
          I_Error("Killed by network driver\n");
       
       nodeforplayer[netconsole] = netnode;
+
+      // everything before the acknowledged tic has arrived, so there is no
+      // need to send it again
+      int acked = ExpandTics(netbuffer->acktic);
+      if(acked > resendto[netnode] && acked <= maketic)
+         resendto[netnode] = acked;
       
       // check for retransmit request
       if(resendcount[netnode] <= 0  && (netbuffer->checksum & NCMD_RETRANSMIT))
@@ -260,6 +297,19 @@ static void GetPackets()
          continue;
       }
       
+      // the tic before the packet has to still be buffered to decode it
+      if(nettics[netnode] - realstart >= BACKUPTICS - 1)
+         continue;
+
+      const ticcmd_t *base = nullptr;
+      if(realstart > 0)
+         base = &nodecmds[netnode][(realstart - 1) % BACKUPTICS];
+
+      if(!D_ReadPacketTics(doomcom->packet + packetheaderlength,
+                           doomcom->datalength - packetheaderlength, base,
+                           netbuffer->d.cmds, netbuffer->numtics))
+         continue;
+
       // update command store from the packet
       int start;
          
@@ -270,6 +320,7 @@ static void GetPackets()
          
       while(nettics[netnode] < realend)
       {
+         nodecmds[netnode][nettics[netnode]%BACKUPTICS] = *src;
          dest = &netcmds[netconsole][nettics[netnode]%BACKUPTICS];
          nettics[netnode]++;
          *dest = *src;
@@ -324,10 +375,21 @@ void NetUpdate()
    {
       I_StartTic();
       D_ProcessEvents();
-      if(maketic - gameticdiv >= BACKUPTICS / 2 - 1)
+      if(maketic - gameticdiv >= backuptics / 2 - 1)
          break; // can't hold any more
       
-      G_BuildTiccmd(&localcmds[maketic%BACKUPTICS]);
+      if(dedicated)
+      {
+         // no player to move, but console commands typed at the server
+         // still go out as chat characters
+         localcmds[maketic%BACKUPTICS] = ticcmd_t();
+         localcmds[maketic%BACKUPTICS].chatchar = C_dequeueChatChar();
+      }
+      else
+      {
+         G_BuildTiccmd(&localcmds[maketic%BACKUPTICS]);
+         D_NetSimScriptCmd(&localcmds[maketic%BACKUPTICS], maketic);
+      }
       ++maketic;
    }
   
@@ -339,25 +401,35 @@ void NetUpdate()
    {
       if(nodeingame[i])
       {
-         netbuffer->starttic = realstart = resendto[i];
-         netbuffer->numtics = maketic - realstart;
-         if(netbuffer->numtics > BACKUPTICS)
-            I_Error("NetUpdate: netbuffer->numtics > BACKUPTICS\n");
-         
-         resendto[i] = maketic - doomcom->extratics;
+         // Everything the node has not acknowledged is sent again, until it
+         // does. The tic before the first one is the base for the deltas,
+         // so it has to still be in the buffer as well.
+         realstart = resendto[i];
+         if(realstart > maketic)
+            realstart = maketic;
+         if(maketic - realstart > BACKUPTICS - 1)
+            realstart = maketic - (BACKUPTICS - 1);
+
+         netbuffer->starttic = realstart;
+         netbuffer->numtics  = maketic - realstart;
+         netbuffer->acktic   = nettics[i];
          
          for(int j = 0; j < netbuffer->numtics; j++)
             netbuffer->d.cmds[j] = localcmds[(realstart + j) % BACKUPTICS];
+
+         const ticcmd_t *base = nullptr;
+         if(realstart > 0)
+            base = &localcmds[(realstart - 1) % BACKUPTICS];
          
          if(remoteresend[i])
          {
             netbuffer->retransmitfrom = nettics[i];
-            HSendPacket(i, NCMD_RETRANSMIT);
+            HSendPacket(i, NCMD_RETRANSMIT, base);
          }
          else
          {
             netbuffer->retransmitfrom = 0;
-            HSendPacket(i, 0);
+            HSendPacket(i, 0, base);
          }
       }
    }
@@ -450,7 +522,8 @@ static void D_ArbitrateNetStart()
                     netbuffer->retransmitfrom, netbuffer->starttic);
             // FIXME: various insufficient variable sizes
             startskill   = (skill_t)(netbuffer->retransmitfrom & 15);
-            dm           = !!((netbuffer->retransmitfrom & 0xc0) >> 6);
+            dm           = !!((netbuffer->retransmitfrom & 0x40) >> 6);
+            dedicatedhost = (netbuffer->retransmitfrom & 0x80) > 0;
             nomonsters   = (netbuffer->retransmitfrom & 0x20) > 0;
             respawnparm  = (netbuffer->retransmitfrom & 0x10) > 0;
 
@@ -485,6 +558,8 @@ static void D_ArbitrateNetStart()
                netbuffer->retransmitfrom |= 0x20;
             if(respawnparm)
                netbuffer->retransmitfrom |= 0x10;
+            if(dedicated)
+               netbuffer->retransmitfrom |= 0x80;
             // FIXME: not large enough for Heretic!
             netbuffer->starttic = (d_startlevel.episode - 1) * 64 + d_startlevel.map;
             netbuffer->player = version;
@@ -540,8 +615,12 @@ void D_CheckNetGame()
       resendto[i] = 0;                // which tic to start sending
    }
    
-   // I_InitNetwork sets doomcom and netgame
-   I_InitNetwork();
+   // I_InitNetwork sets doomcom and netgame, unless the loopback
+   // simulator stands in for the network
+   if(D_InitNetSim())
+      netcmd = D_NetSimCmd;
+   else
+      I_InitNetwork();
 
    D_InitNetGame();
    
@@ -556,6 +635,9 @@ void D_InitNetGame()
    if(doomcom->id != DOOMCOM_ID)
       I_Error("Doomcom buffer invalid!\n");
    
+   if(doomcom->numplayers > MAXPLAYERS)
+      I_Error("D_InitNetGame: too many players (max %d)\n", MAXPLAYERS);
+
    netbuffer = &doomcom->data;
    consoleplayer = displayplayer = doomcom->consoleplayer;
    
@@ -564,7 +646,18 @@ void D_InitNetGame()
    
    // read values out of doomcom
    ticdup = doomcom->ticdup;
-   maxsend = BACKUPTICS/(2*ticdup)-1;
+
+   int p = M_CheckParm("-backuptics");
+   if(p && p < myargc - 1)
+      backuptics = atoi(myargv[p + 1]);
+   if(backuptics < MINBACKUPTICS)
+      backuptics = MINBACKUPTICS;
+   if(backuptics > BACKUPTICS / 2)
+      backuptics = BACKUPTICS / 2;
+
+   predictcheck = M_CheckParm("-predictcheck") || netsimcheck;
+
+   maxsend = backuptics/(2*ticdup)-1;
    if(maxsend<1)
       maxsend = 1;
   
@@ -572,6 +665,17 @@ void D_InitNetGame()
       playeringame[i] = true;
    for(int i = 0; i < doomcom->numnodes; i++)
       nodeingame[i] = true;
+
+   // a dedicated server sends (empty) tics like any node, but has no player
+   if(dedicated)
+   {
+      if(!netgame || consoleplayer != 0 || doomcom->numplayers < 2)
+         I_Error("D_InitNetGame: -dedicated must be player 1 of a netgame\n");
+      dedicatedhost = true;
+      displayplayer = 1;
+   }
+   if(dedicatedhost)
+      playeringame[0] = false;
   
    usermsg("player %i of %i (%i nodes)",
            consoleplayer+1, doomcom->numplayers, doomcom->numnodes);
@@ -640,6 +744,35 @@ bool opensocket;
 
 extern bool advancedemo;
 
+// most tics run per frame while seeking in a demo
+#define SEEKTICSPERFRAME (4*TICRATE)
+
+//
+// RunSeekTics
+//
+// Runs a demo forward as fast as possible while demo_seek is moving it to
+// a later tic. The clock and the network bookkeeping are caught up at the end,
+// so that nothing is owed for the time spent seeking.
+//
+static void RunSeekTics()
+{
+   I_StartTic();
+   D_ProcessEvents();
+
+   for(int i = 0; i < SEEKTICSPERFRAME && G_RewindSeeking(); i++)
+   {
+      if(advancedemo)
+         D_DoAdvanceDemo();
+      G_Ticker();
+      gametic++;
+      maketic++;
+   }
+
+   for(int i = 0; i < doomcom->numnodes; i++)
+      nettics[i] = resendto[i] = maketic;
+   gametime = i_haltimer.GetTime() / ticdup;
+}
+
 //
 // RunGameTics
 //
@@ -699,9 +832,10 @@ static bool RunGameTics()
 
       // ideally nettics[0] should be 1 - 3 tics above lowtic
       // if we are consistantly slower, speed up time
+      // (a dedicated server keeps the time for everyone)
       for(pnum = 0; pnum < MAXPLAYERS; pnum++)
       {
-         if(playeringame[pnum])
+         if(playeringame[pnum] || (pnum == 0 && dedicatedhost))
             break;
       }
 
@@ -721,6 +855,13 @@ static bool RunGameTics()
       }
    }
    
+   // demo_seek fast-forward?
+   if(G_RewindSeeking())
+   {
+      RunSeekTics();
+      return true;
+   }
+
    // singletic update ?
    // sf: moved here from d_main.c
    // as it seemed more appropriate
@@ -761,7 +902,8 @@ static bool RunGameTics()
       }
       
       // Sleep until a tic is available, so we don't hog the CPU.
-      i_haltimer.Sleep(1);
+      // A dedicated server has nothing else to do until the next tic.
+      i_haltimer.Sleep(dedicated ? D_DedicatedSleepTime() : 1);
 
       return false;
    }
@@ -843,10 +985,119 @@ void TryRunTics()
 
       // run the game tickers
       game_advanced = RunGameTics();
+
+      if(netsimcheck && gametic >= netsimcheck)
+         D_finishNetSimCheck();
    } 
    while(!d_fastrefresh && realtics <= 0 && !game_advanced);
 }
 
+//
+// Client-side prediction
+//
+// Before a frame is drawn in a netgame, the console player is moved ahead
+// through the commands built locally that the game has not run yet, so that
+// their own movement shows up without the network delay. The prediction is
+// rolled back once the frame is drawn; see p_predict.cpp.
+//
+
+bool d_predict;
+
+#define MAXPREDICTTICS 32
+
+static bool predicting;
+static uint32_t predicthash;
+
+//
+// Hashes everything the prediction must leave as it was found: every thinker,
+// the momentum of every thing, and the synced hash of sectors and the RNG.
+//
+static uint32_t D_predictHash()
+{
+   statehash_t hash;
+   uint32_t    sum;
+
+   P_StateHashGet(hash);
+   sum = hash.parts[SH_SECTORS] ^ (hash.parts[SH_RNG] * 0x9e3779b9u);
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+   {
+      Mobj *mo;
+
+      sum = sum * 31 + th->stateHash();
+      if((mo = thinker_cast<Mobj *>(th)))
+      {
+         sum = sum * 31 + (uint32_t(mo->momx) ^ (uint32_t(mo->momy) << 7) ^
+                           (uint32_t(mo->momz) << 14) ^ mo->flags ^ mo->intflags);
+      }
+   }
+
+   return sum;
+}
+
+//
+// D_PredictLocalPlayer
+//
+// Called before drawing a frame.
+//
+void D_PredictLocalPlayer()
+{
+   ticcmd_t cmds[MAXPREDICTTICS];
+   int numcmds = 0;
+
+   if(!(d_predict || netsimcheck) || !netgame || demoplayback ||
+      gamestate != GS_LEVEL || paused || menuactive || displayplayer != consoleplayer)
+      return;
+
+   // gametic is the next tic to be run; it uses the command of maketic
+   // gametic/ticdup, once every node has sent theirs
+   for(int tic = gametic; tic / ticdup < maketic && numcmds < MAXPREDICTTICS;
+       tic++)
+      cmds[numcmds++] = localcmds[(tic / ticdup) % BACKUPTICS];
+
+   if(predictcheck)
+      predicthash = D_predictHash();
+
+   predicting = P_PredictPlayer(&players[consoleplayer], cmds, numcmds);
+}
+
+//
+// D_UnpredictLocalPlayer
+//
+// Called after drawing a frame, to put the game back to the last tic run.
+//
+void D_UnpredictLocalPlayer()
+{
+   if(!predicting)
+      return;
+
+   P_UnpredictPlayer();
+   predicting = false;
+
+   if(predictcheck)
+   {
+      if(D_predictHash() != predicthash)
+         I_Error("D_UnpredictLocalPlayer: prediction changed the game at tic %d\n",
+                 gametic);
+      ++predictchecks;
+   }
+}
+
+//
+// D_finishNetSimCheck
+//
+// Ends a -netsimcheck run once it has gone on long enough. Not having had a
+// single prediction to check counts as a failure as well.
+//
+static void D_finishNetSimCheck()
+{
+   if(!predictchecks)
+      I_Error("-netsimcheck: no predictions were made in %d tics\n", gametic);
+
+   I_ExitWithMessage("-netsimcheck: %d prediction rollbacks checked in %d tics\n",
+                     predictchecks, gametic);
+}
+
 /////////////////////////////////////////////////////
 //
 // Console Commands
@@ -892,6 +1143,9 @@ CONSOLE_VARIABLE(d_fastrefresh, d_fastrefresh, 0) {}
 VARIABLE_TOGGLE(d_interpolate, NULL, onoff);
 CONSOLE_VARIABLE(d_interpolate, d_interpolate, 0) {}
 
+VARIABLE_TOGGLE(d_predict, NULL, onoff);
+CONSOLE_VARIABLE(d_predict, d_predict, 0) {}
+
 //----------------------------------------------------------------------------
 //
 // $Log: d_net.c,v $
@@ -38,12 +38,18 @@
 
 #define DOOMCOM_ID              0x12345678l
 
-// Max computers/players in a game.
-#define MAXNETNODES             8
+// Max computers in a game. Every node is a player, so netgames still hold
+// no more than MAXPLAYERS of them.
+#define MAXNETNODES             16
 
 
 // Networking and tick handling related.
-#define BACKUPTICS              12
+// Size of the ticcmd buffers; the window actually used is backuptics.
+#define BACKUPTICS              64
+
+// Default and smallest windows of tics that may be buffered ahead.
+#define DEFBACKUPTICS           12
+#define MINBACKUPTICS           4
 
 // haleyjd 10/19/07: moved here from d_net.c
 #define NCMD_EXIT               0x80000000
@@ -62,6 +68,11 @@ enum
 // killough 5/2/98: number of bytes reserved for saving options
 #define GAME_OPTION_SIZE 64
 
+// Encoded packets: a header, then either the game options or up to
+// BACKUPTICS ticcmds, each behind one or two bytes of field flags.
+#define NETHEADERSIZE    6
+#define NETMAXPACKETSIZE (NETHEADERSIZE + BACKUPTICS * (2 + sizeof(ticcmd_t)))
+
 // haleyjd 10/16/07: structures in this file must be packed
 #if defined(_MSC_VER) || defined(__GNUC__)
 #pragma pack(push, 1)
@@ -80,6 +91,8 @@ struct doomdata_t
     byte         starttic;
     byte         player;
     byte         numtics;
+    // All tics before this one have been received from the destination.
+    byte         acktic;
 
     union packetdata_u
     {
@@ -162,7 +175,10 @@ struct doomcom_t
 
     // The packet data to be sent.
     doomdata_t          data;
-    
+
+    // The data as encoded for the driver, which sends and receives it.
+    int16_t             datalength;
+    byte                packet[NETMAXPACKETSIZE];
 };
 
 // haleyjd 10/16/07
@@ -182,9 +198,16 @@ void D_QuitNetGame();
 // how many ticks to run?
 void TryRunTics();
 
+// client-side prediction of the console player, around drawing a frame
+void D_PredictLocalPlayer();
+void D_UnpredictLocalPlayer();
+
 extern bool d_fastrefresh;
 extern bool d_interpolate;
+extern bool d_predict;
 extern bool opensocket;
+extern int  backuptics;
+extern bool dedicatedhost; // player 1 is a dedicated server
 
 extern ticcmd_t netcmds[][BACKUPTICS];
 
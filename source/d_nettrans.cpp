@@ -0,0 +1,600 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Network transport: packet encoding and the loopback simulator.
+//
+// Packets carry every tic the destination has not acknowledged yet. Each
+// ticcmd is written as the fields that differ from the one before it; the
+// first is compared with the tic just before the packet, which the receiver
+// is known to have, as it acknowledged it.
+//
+// The loopback simulator stands in for the network driver when -netsim is
+// given. It runs the other nodes in-process, over a link that can lose and
+// delay packets, so that the protocol can be tried out on one machine. The
+// simulated players copy the console player's movements.
+//
+// With -netsimcheck, the console player is moved by a fixed script instead of
+// the keyboard, and every prediction rollback is checked against the state
+// hash, for the given number of tics. The game quits with an error if one
+// ever changed the game, so the run can be left to a script to repeat.
+//
+//----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "i_system.h"
+
+#include "d_event.h"
+#include "d_main.h"
+#include "d_nettrans.h"
+#include "doomstat.h"
+#include "hal/i_timer.h"
+#include "m_argv.h"
+#include "m_compare.h"
+
+//=============================================================================
+//
+// Packet encoding
+//
+
+// Changed ticcmd fields. The first byte holds the ones that change most
+// often; the second only follows when TCF_MORE is set.
+enum
+{
+   TCF_ANGLETURN   = 0x0001,
+   TCF_CONSISTENCY = 0x0002,
+   TCF_FORWARDMOVE = 0x0004,
+   TCF_SIDEMOVE    = 0x0008,
+   TCF_BUTTONS     = 0x0010,
+   TCF_LOOK        = 0x0020,
+   TCF_ACTIONS     = 0x0040,
+   TCF_MORE        = 0x0080,
+   TCF_FLY         = 0x0100,
+   TCF_CHATCHAR    = 0x0200,
+   TCF_ITEMID      = 0x0400,
+   TCF_WEAPONID    = 0x0800,
+   TCF_SLOTINDEX   = 0x1000
+};
+
+static const ticcmd_t emptycmd = {};
+
+static byte *D_writeShort(byte *p, int value)
+{
+   p[0] = byte((value >> 8) & 0xff);
+   p[1] = byte( value       & 0xff);
+   return p + 2;
+}
+
+static uint16_t D_readShort(const byte *&p)
+{
+   uint16_t value = uint16_t((p[0] << 8) | p[1]);
+   p += 2;
+   return value;
+}
+
+//
+// Number of bytes taken by the fields named in flags
+//
+static int D_ticcmdFieldsSize(int flags)
+{
+   static const int sizes[13] = { 2, 2, 1, 1, 1, 2, 1, 0, 1, 1, 2, 2, 1 };
+   int size = 0;
+
+   for(int i = 0; i < int(earrlen(sizes)); i++)
+   {
+      if(flags & (1 << i))
+         size += sizes[i];
+   }
+   return size;
+}
+
+//
+// Writes the fields of cmd that differ from prev
+//
+static byte *D_writeTiccmd(byte *p, const ticcmd_t &cmd, const ticcmd_t &prev)
+{
+   byte *start = p;
+   int flags = 0;
+
+   p += 2; // flags are filled in last
+
+   if(cmd.angleturn != prev.angleturn)
+   {
+      p = D_writeShort(p, cmd.angleturn);
+      flags |= TCF_ANGLETURN;
+   }
+   if(cmd.consistency != prev.consistency)
+   {
+      p = D_writeShort(p, cmd.consistency);
+      flags |= TCF_CONSISTENCY;
+   }
+   if(cmd.forwardmove != prev.forwardmove)
+   {
+      *p++ = byte(cmd.forwardmove);
+      flags |= TCF_FORWARDMOVE;
+   }
+   if(cmd.sidemove != prev.sidemove)
+   {
+      *p++ = byte(cmd.sidemove);
+      flags |= TCF_SIDEMOVE;
+   }
+   if(cmd.buttons != prev.buttons)
+   {
+      *p++ = cmd.buttons;
+      flags |= TCF_BUTTONS;
+   }
+   if(cmd.look != prev.look)
+   {
+      p = D_writeShort(p, cmd.look);
+      flags |= TCF_LOOK;
+   }
+   if(cmd.actions != prev.actions)
+   {
+      *p++ = cmd.actions;
+      flags |= TCF_ACTIONS;
+   }
+   if(cmd.fly != prev.fly)
+   {
+      *p++ = byte(cmd.fly);
+      flags |= TCF_FLY;
+   }
+   if(cmd.chatchar != prev.chatchar)
+   {
+      *p++ = cmd.chatchar;
+      flags |= TCF_CHATCHAR;
+   }
+   if(cmd.itemID != prev.itemID)
+   {
+      p = D_writeShort(p, cmd.itemID);
+      flags |= TCF_ITEMID;
+   }
+   if(cmd.weaponID != prev.weaponID)
+   {
+      p = D_writeShort(p, cmd.weaponID);
+      flags |= TCF_WEAPONID;
+   }
+   if(cmd.slotIndex != prev.slotIndex)
+   {
+      *p++ = cmd.slotIndex;
+      flags |= TCF_SLOTINDEX;
+   }
+
+   if(flags & ~0xff)
+   {
+      start[0] = byte(flags | TCF_MORE);
+      start[1] = byte(flags >> 8);
+   }
+   else
+   {
+      // only one byte of flags: move the fields back over the second one
+      start[0] = byte(flags);
+      memmove(start + 1, start + 2, p - start - 2);
+      --p;
+   }
+
+   return p;
+}
+
+//
+// D_WritePacket
+//
+// Encodes a packet into buf, returning its length. The ticcmds are sent
+// relative to base, which must be the tic before data->starttic.
+//
+int D_WritePacket(const doomdata_t *data, const ticcmd_t *base, byte *buf)
+{
+   byte *p = buf;
+
+   *p++ = byte((data->checksum & ~NCMD_CHECKSUM) >> 24);
+   *p++ = data->player;
+   *p++ = data->retransmitfrom;
+   *p++ = data->starttic;
+   *p++ = data->acktic;
+   *p++ = data->numtics;
+
+   if(data->checksum & NCMD_SETUP)
+   {
+      memcpy(p, data->d.data, GAME_OPTION_SIZE);
+      p += GAME_OPTION_SIZE;
+   }
+   else
+   {
+      const ticcmd_t *prev = base ? base : &emptycmd;
+
+      for(int i = 0; i < data->numtics; i++)
+      {
+         p = D_writeTiccmd(p, data->d.cmds[i], *prev);
+         prev = &data->d.cmds[i];
+      }
+   }
+
+   return int(p - buf);
+}
+
+//
+// D_ReadPacketHeader
+//
+// Decodes the header of a packet into data, and the game options too for
+// setup packets. Returns the number of bytes read, or 0 if the packet is
+// malformed.
+//
+int D_ReadPacketHeader(const byte *buf, int len, doomdata_t *data)
+{
+   if(len < NETHEADERSIZE)
+      return 0;
+
+   data->checksum       = uint32_t(buf[0]) << 24;
+   data->player         = buf[1];
+   data->retransmitfrom = buf[2];
+   data->starttic       = buf[3];
+   data->acktic         = buf[4];
+   data->numtics        = buf[5];
+
+   if(data->checksum & NCMD_SETUP)
+   {
+      if(len < NETHEADERSIZE + GAME_OPTION_SIZE)
+         return 0;
+      memcpy(data->d.data, buf + NETHEADERSIZE, GAME_OPTION_SIZE);
+      return NETHEADERSIZE + GAME_OPTION_SIZE;
+   }
+
+   if(data->numtics > BACKUPTICS)
+      return 0;
+
+   return NETHEADERSIZE;
+}
+
+//
+// D_ReadPacketTics
+//
+// Decodes the ticcmds that follow a packet header, relative to base. Returns
+// false if the packet is malformed.
+//
+bool D_ReadPacketTics(const byte *buf, int len, const ticcmd_t *base,
+                      ticcmd_t *cmds, int numtics)
+{
+   const byte *p   = buf;
+   const byte *end = buf + len;
+   const ticcmd_t *prev = base ? base : &emptycmd;
+
+   for(int i = 0; i < numtics; i++)
+   {
+      ticcmd_t &cmd = cmds[i];
+      int flags;
+
+      if(p >= end)
+         return false;
+      flags = *p++;
+      if(flags & TCF_MORE)
+      {
+         if(p >= end)
+            return false;
+         flags |= *p++ << 8;
+      }
+      if(end - p < D_ticcmdFieldsSize(flags))
+         return false;
+
+      cmd = *prev;
+      if(flags & TCF_ANGLETURN)
+         cmd.angleturn = int16_t(D_readShort(p));
+      if(flags & TCF_CONSISTENCY)
+         cmd.consistency = int16_t(D_readShort(p));
+      if(flags & TCF_FORWARDMOVE)
+         cmd.forwardmove = int8_t(*p++);
+      if(flags & TCF_SIDEMOVE)
+         cmd.sidemove = int8_t(*p++);
+      if(flags & TCF_BUTTONS)
+         cmd.buttons = *p++;
+      if(flags & TCF_LOOK)
+         cmd.look = int16_t(D_readShort(p));
+      if(flags & TCF_ACTIONS)
+         cmd.actions = *p++;
+      if(flags & TCF_FLY)
+         cmd.fly = int8_t(*p++);
+      if(flags & TCF_CHATCHAR)
+         cmd.chatchar = *p++;
+      if(flags & TCF_ITEMID)
+         cmd.itemID = D_readShort(p);
+      if(flags & TCF_WEAPONID)
+         cmd.weaponID = D_readShort(p);
+      if(flags & TCF_SLOTINDEX)
+         cmd.slotIndex = *p++;
+
+      prev = &cmd;
+   }
+
+   return true;
+}
+
+//=============================================================================
+//
+// Loopback simulator
+//
+
+#define NETSIM_MAXQUEUE 256
+
+struct simpacket_t
+{
+   int          from;    // sending node; the console is node 0
+   int          to;      // receiving node
+   unsigned int arrival; // time it is delivered, in ms
+   int          len;
+   byte         data[NETMAXPACKETSIZE];
+};
+
+struct simpeer_t
+{
+   int      nettics;          // tics received from the console
+   int      resendto;         // first tic the console has not acknowledged
+   bool     remoteresend;     // a packet from the console went missing
+   ticcmd_t cmds[BACKUPTICS]; // the console's tics, as received
+};
+
+static simpacket_t *simqueue;   // packets in flight, in order of arrival
+static int          simhead;
+static int          simcount;
+static simpacket_t  simcurrent; // packet being delivered
+
+static simpeer_t    simpeers[MAXNETNODES];
+static int          simloss;    // percentage of packets lost
+static int          simlatency; // one-way delay, in ms
+
+int netsimcheck;
+static uint32_t     simrandom = 1;
+
+//
+// Random numbers for packet loss; the game's own must not be touched.
+//
+static uint32_t D_netSimRandom()
+{
+   simrandom ^= simrandom << 13;
+   simrandom ^= simrandom >> 17;
+   simrandom ^= simrandom << 5;
+   return simrandom;
+}
+
+//
+// Works out a full tic number from its low byte, near a known one
+//
+static int D_netSimExpand(int low, int near)
+{
+   int tic = (near & ~0xff) + low;
+
+   if(tic - near > 128)
+      tic -= 256;
+   else if(near - tic > 128)
+      tic += 256;
+   return tic;
+}
+
+//
+// Puts a packet on the link, unless it gets lost
+//
+static void D_netSimSend(int from, int to, const byte *data, int len)
+{
+   if(simcount == NETSIM_MAXQUEUE || int(D_netSimRandom() % 100) < simloss)
+      return;
+
+   simpacket_t &pkt = simqueue[(simhead + simcount++) % NETSIM_MAXQUEUE];
+
+   pkt.from    = from;
+   pkt.to      = to;
+   pkt.arrival = i_haltimer.GetTicks() + simlatency;
+   pkt.len     = len;
+   memcpy(pkt.data, data, len);
+}
+
+//
+// The simulated players copy the console's commands, except for the ones
+// which act on the whole game.
+//
+static void D_netSimMirror(const ticcmd_t &in, ticcmd_t &out)
+{
+   out = in;
+   out.chatchar = 0;
+   if(out.buttons & BT_SPECIAL)
+      out.buttons = 0;
+}
+
+//
+// Sends the console the tics of a simulated node it has not acknowledged
+//
+static void D_netSimReply(int node)
+{
+   simpeer_t &peer = simpeers[node];
+   doomdata_t data;
+   ticcmd_t   base;
+   byte       buf[NETMAXPACKETSIZE];
+   int        start = emax(peer.resendto, peer.nettics - (BACKUPTICS - 1));
+
+   data.checksum       = peer.remoteresend ? NCMD_RETRANSMIT : 0;
+   data.player         = byte(node);
+   data.retransmitfrom = peer.remoteresend ? byte(peer.nettics) : 0;
+   data.starttic       = byte(start);
+   data.acktic         = byte(peer.nettics);
+   data.numtics        = byte(peer.nettics - start);
+
+   for(int i = 0; i < data.numtics; i++)
+      D_netSimMirror(peer.cmds[(start + i) % BACKUPTICS], data.d.cmds[i]);
+   if(start > 0)
+      D_netSimMirror(peer.cmds[(start - 1) % BACKUPTICS], base);
+
+   D_netSimSend(node, 0, buf, D_WritePacket(&data, start > 0 ? &base : nullptr, buf));
+}
+
+//
+// Handles a packet from the console arriving at a simulated node
+//
+static void D_netSimReceive(int node, const byte *buf, int len)
+{
+   simpeer_t &peer = simpeers[node];
+   doomdata_t data;
+   int        hdrlen;
+
+   if(!(hdrlen = D_ReadPacketHeader(buf, len, &data)) ||
+      (data.checksum & (NCMD_EXIT | NCMD_KILL)))
+      return;
+
+   // setup packets only need an answer
+   if(!(data.checksum & NCMD_SETUP))
+   {
+      int realstart = D_netSimExpand(data.starttic, peer.nettics);
+      int realend   = realstart + data.numtics;
+      int acked     = D_netSimExpand(data.acktic, peer.nettics);
+
+      if(acked > peer.resendto && acked <= peer.nettics)
+         peer.resendto = acked;
+      if(data.checksum & NCMD_RETRANSMIT)
+      {
+         int from = D_netSimExpand(data.retransmitfrom, peer.nettics);
+         if(from <= peer.nettics)
+            peer.resendto = from;
+      }
+
+      if(realstart > peer.nettics)
+         peer.remoteresend = true;
+      else if(realend > peer.nettics)
+      {
+         ticcmd_t cmds[BACKUPTICS];
+         const ticcmd_t *base = nullptr;
+
+         if(realstart > 0)
+            base = &peer.cmds[(realstart - 1) % BACKUPTICS];
+         if(D_ReadPacketTics(buf + hdrlen, len - hdrlen, base, cmds, data.numtics))
+         {
+            peer.remoteresend = false;
+            for(; peer.nettics < realend; peer.nettics++)
+               peer.cmds[peer.nettics % BACKUPTICS] = cmds[peer.nettics - realstart];
+         }
+      }
+   }
+
+   D_netSimReply(node);
+}
+
+//
+// D_InitNetSim
+//
+// Sets up a netgame with simulated nodes if -netsim was given:
+//   -netsim <nodes> [-netsimloss <percent>] [-netsimlatency <ms>]
+//           [-netsimcheck <tics>]
+// Returns false otherwise.
+//
+bool D_InitNetSim()
+{
+   int p, peers = 1;
+
+   if(!(p = M_CheckParm("-netsim")))
+      return false;
+
+   if(p < myargc - 1 && myargv[p + 1][0] != '-')
+      peers = eclamp(atoi(myargv[p + 1]), 1, MAXPLAYERS - 1);
+   if((p = M_CheckParm("-netsimloss")) && p < myargc - 1)
+      simloss = eclamp(atoi(myargv[p + 1]), 0, 100);
+   if((p = M_CheckParm("-netsimlatency")) && p < myargc - 1)
+      simlatency = emax(atoi(myargv[p + 1]), 0);
+   else if(M_CheckParm("-netsimcheck"))
+      simlatency = 100; // enough for tics to be predicted
+   if((p = M_CheckParm("-netsimcheck")))
+   {
+      netsimcheck = 60 * TICRATE;
+      if(p < myargc - 1 && myargv[p + 1][0] != '-')
+         netsimcheck = emax(atoi(myargv[p + 1]), 1);
+   }
+
+   doomcom = estructalloc(doomcom_t, 1);
+   doomcom->id            = DOOMCOM_ID;
+   doomcom->numnodes      = doomcom->numplayers = peers + 1;
+   doomcom->consoleplayer = 0;
+   doomcom->ticdup        = 1;
+   doomcom->extratics     = 0;
+
+   simqueue = ecalloc(simpacket_t *, NETSIM_MAXQUEUE, sizeof(simpacket_t));
+
+   netgame = true;
+
+   usermsg("D_InitNetSim: %d simulated nodes, %d%% loss, %d ms latency",
+           peers, simloss, simlatency);
+   return true;
+}
+
+//
+// D_NetSimScriptCmd
+//
+// For -netsimcheck, replaces the movement in a command built for the console
+// player with a fixed pattern: running back and forth while turning and
+// strafing, firing now and then and pressing use.
+//
+void D_NetSimScriptCmd(ticcmd_t *cmd, int tic)
+{
+   if(!netsimcheck)
+      return;
+
+   cmd->forwardmove = tic % 140 < 100 ? 50 : -25;
+   cmd->sidemove    = (tic / 35) & 1 ? 24 : -24;
+   cmd->angleturn   = (tic / 70) & 1 ? 320 : -320;
+   cmd->look        = 0;
+   cmd->buttons     = 0;
+
+   if(tic % 35 < 5)
+      cmd->buttons |= BT_ATTACK;
+   if(tic % 70 == 20)
+      cmd->buttons |= BT_USE;
+}
+
+//
+// D_NetSimCmd
+//
+// Takes the place of I_NetCmd for -netsim.
+//
+bool D_NetSimCmd()
+{
+   if(doomcom->command == CMD_SEND)
+   {
+      D_netSimSend(0, doomcom->remotenode, doomcom->packet, doomcom->datalength);
+      return true;
+   }
+
+   unsigned int now = i_haltimer.GetTicks();
+
+   // deliver what has arrived; simulated nodes answer right away
+   while(simcount && int(simqueue[simhead].arrival - now) <= 0)
+   {
+      simcurrent = simqueue[simhead];
+      simhead = (simhead + 1) % NETSIM_MAXQUEUE;
+      --simcount;
+
+      if(simcurrent.to)
+      {
+         D_netSimReceive(simcurrent.to, simcurrent.data, simcurrent.len);
+         continue;
+      }
+
+      memcpy(doomcom->packet, simcurrent.data, simcurrent.len);
+      doomcom->datalength = int16_t(simcurrent.len);
+      doomcom->remotenode = int16_t(simcurrent.from);
+      return true;
+   }
+
+   doomcom->remotenode = -1;
+   return true;
+}
+
+// EOF
+
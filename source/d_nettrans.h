@@ -0,0 +1,46 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Network transport: packet encoding and the loopback simulator.
+//
+//----------------------------------------------------------------------------
+
+#ifndef D_NETTRANS_H__
+#define D_NETTRANS_H__
+
+#include "d_net.h"
+
+// Packet encoding. A null base stands for an empty ticcmd.
+int  D_WritePacket(const doomdata_t *data, const ticcmd_t *base, byte *buf);
+int  D_ReadPacketHeader(const byte *buf, int len, doomdata_t *data);
+bool D_ReadPacketTics(const byte *buf, int len, const ticcmd_t *base,
+                      ticcmd_t *cmds, int numtics);
+
+// Loopback simulator (-netsim)
+extern int netsimcheck; // tics to run for -netsimcheck, or 0
+
+bool D_InitNetSim();
+bool D_NetSimCmd();
+void D_NetSimScriptCmd(ticcmd_t *cmd, int tic);
+
+#endif
+
+// EOF
+
@@ -45,6 +45,7 @@
 #include "p_info.h"
 #include "p_mobj.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
 #include "p_skin.h"
 #include "p_spec.h"
 #include "p_xenemy.h"
@@ -1496,6 +1497,9 @@ static int EV_ActivateSpecial(ev_action_t *action, ev_instance_t *instance)
    // execute the action
    int result = action->action(action, instance);
 
+   // it may have changed what blocks sight
+   P_SightBatchInvalidate();
+
    // execute the post-action routine
    return action->type->post(action, result, instance);
 }
@@ -27,8 +27,10 @@
 #include "doomstat.h"
 #include "g_demolog.h"
 #include "m_argv.h"
+#include "p_statehash.h"
 
 FILE *demoLogFile;
+static FILE *demoHashFile;
 
 static bool demoLogLevelExited;
 
@@ -107,5 +109,59 @@ bool G_DemoLogEnabled()
    return demoLogFile != nullptr;
 }
 
+//
+// Per-tic state hashes for -demoverify
+//
+
+//
+// Opens the -demohashlog file, to which a hash of the game state is written
+// after every tic of demo playback.
+//
+void G_DemoHashInit(const char *path)
+{
+   if(!(demoHashFile = fopen(path, "wt")))
+      usermsg("G_DemoHashInit: failed opening '%s'\n", path);
+}
+
+//
+// True if state hashes are being logged. Such runs are started by
+// -demoverify, several at once, so they must not write the config files.
+//
+bool G_DemoHashEnabled()
+{
+   return demoHashFile != nullptr;
+}
+
+//
+// Writes the world state hash of the tic that was just run, one column for
+// each class of state
+//
+void G_DemoHashTic()
+{
+   statehash_t hash;
+
+   if(!demoHashFile || !demoplayback || gamestate != GS_LEVEL)
+      return;
+
+   P_StateHashGet(hash);
+   fprintf(demoHashFile, "%d", gametic);
+   for(uint32_t part : hash.parts)
+      fprintf(demoHashFile, " %08x", part);
+   fputc('\n', demoHashFile);
+}
+
+//
+// Marks the end of the demo in the hash log, so that -demoverify can tell a
+// finished run from one that crashed.
+//
+void G_DemoHashEnd()
+{
+   if(demoHashFile)
+   {
+      fprintf(demoHashFile, "end %d\n", gametic);
+      fflush(demoHashFile);
+   }
+}
+
 // EOF
 
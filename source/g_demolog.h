@@ -31,6 +31,11 @@ void G_DemoLogStats();
 bool G_DemoLogEnabled();
 void G_DemoLogSetExited(bool value);
 
+void G_DemoHashInit(const char *path);
+bool G_DemoHashEnabled();
+void G_DemoHashTic();
+void G_DemoHashEnd();
+
 #endif
 
 // EOF
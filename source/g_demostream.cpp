@@ -0,0 +1,690 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Compact demo format: packed and compressed ticcmd streams.
+//
+// The tic stream is cut into chunks of up to KEYFRAMETICS tics. Each ticcmd
+// is packed as the fields that differ from the same player's ticcmd of the
+// tic before, with runs of unchanged ticcmds counted instead, and the chunk
+// is then compressed. Packing starts over in every chunk, so that any chunk
+// can be read on its own: together with the world state hash stored with
+// it, this makes it a keyframe for seeking. An index chunk listing the
+// keyframes ends the stream, before the DEMOMARKER.
+//
+// All values are little-endian. Chunks are:
+//
+//   tics:  tag, first tic, state hash, number of tics (32 bits each, apart
+//          from the tag), cmds per tic, packed size, compressed size (32
+//          bits), then the compressed data.
+//   index: tag, number of keyframes, then the tic, stream offset and state
+//          hash of each (32 bits each).
+//
+//----------------------------------------------------------------------------
+
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "d_ticcmd.h"
+#include "doomdef.h"
+#include "g_demostream.h"
+#include "m_buffer.h"
+#include "../zlib/zlib.h"
+
+#define KEYFRAMETICS (10*TICRATE)
+
+// Chunk tags
+enum
+{
+   DEMOCHUNK_TICS  = 1,
+   DEMOCHUNK_INDEX = 2,
+   DEMOCHUNK_END   = 0x80 // the DEMOMARKER
+};
+
+#define TICSHEADERSIZE  22
+#define INDEXHEADERSIZE 5
+#define INDEXENTRYSIZE  12
+
+// Changed ticcmd fields. A record with none set is followed by the number of
+// further ticcmds that are unchanged too.
+enum
+{
+   DCF_FORWARDMOVE = 0x01,
+   DCF_SIDEMOVE    = 0x02,
+   DCF_ANGLETURN   = 0x04, // zigzag varint delta
+   DCF_BUTTONS     = 0x08,
+   DCF_ACTIONS     = 0x10,
+   DCF_LOOK        = 0x20, // zigzag varint delta
+   DCF_FLY         = 0x40,
+   DCF_INVENTORY   = 0x80  // itemID and weaponID varints, slotIndex
+};
+
+// Largest packed ticcmd: flags, three bytes for each 16-bit value and one
+// for each 8-bit value.
+#define MAXPACKEDCMD 19
+
+static const ticcmd_t emptycmd = {};
+
+bool demo_compact;
+
+static void G_writeLE32(byte *p, uint32_t val)
+{
+   p[0] = byte(val);
+   p[1] = byte(val >> 8);
+   p[2] = byte(val >> 16);
+   p[3] = byte(val >> 24);
+}
+
+static uint32_t G_readLE32(const byte *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+static byte *G_writeVarint(byte *p, uint32_t val)
+{
+   while(val >= 0x80)
+   {
+      *p++ = byte(val | 0x80);
+      val >>= 7;
+   }
+   *p++ = byte(val);
+   return p;
+}
+
+static bool G_readVarint(const byte *&p, const byte *end, uint32_t &val)
+{
+   val = 0;
+   for(int shift = 0; shift < 32; shift += 7)
+   {
+      if(p >= end)
+         return false;
+      val |= uint32_t(*p & 0x7f) << shift;
+      if(!(*p++ & 0x80))
+         return true;
+   }
+   return false;
+}
+
+static uint32_t G_zigzag(int delta)
+{
+   return (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+}
+
+static int G_unzigzag(uint32_t val)
+{
+   return int(val >> 1) ^ -int(val & 1);
+}
+
+//
+// Flags of the fields of cmd that differ from base. Only the fields which
+// demos record are compared.
+//
+static int G_demoCmdFlags(const ticcmd_t &cmd, const ticcmd_t &base)
+{
+   int flags = 0;
+
+   if(cmd.forwardmove != base.forwardmove)
+      flags |= DCF_FORWARDMOVE;
+   if(cmd.sidemove != base.sidemove)
+      flags |= DCF_SIDEMOVE;
+   if(cmd.angleturn != base.angleturn)
+      flags |= DCF_ANGLETURN;
+   if(cmd.buttons != base.buttons)
+      flags |= DCF_BUTTONS;
+   if(cmd.actions != base.actions)
+      flags |= DCF_ACTIONS;
+   if(cmd.look != base.look)
+      flags |= DCF_LOOK;
+   if(cmd.fly != base.fly)
+      flags |= DCF_FLY;
+   if(cmd.itemID != base.itemID || cmd.weaponID != base.weaponID ||
+      cmd.slotIndex != base.slotIndex)
+      flags |= DCF_INVENTORY;
+
+   return flags;
+}
+
+//
+// Copies the fields which demos record
+//
+static void G_copyDemoCmd(ticcmd_t &dst, const ticcmd_t &src)
+{
+   dst.forwardmove = src.forwardmove;
+   dst.sidemove    = src.sidemove;
+   dst.angleturn   = src.angleturn;
+   dst.buttons     = src.buttons;
+   dst.actions     = src.actions;
+   dst.look        = src.look;
+   dst.fly         = src.fly;
+   dst.itemID      = src.itemID;
+   dst.weaponID    = src.weaponID;
+   dst.slotIndex   = src.slotIndex;
+}
+
+//
+// Packs count ticcmds of slots per tic into out, which must have room for
+// MAXPACKEDCMD bytes each. Returns the packed size.
+//
+static size_t G_packDemoCmds(const ticcmd_t *cmds, size_t count, int slots,
+                             byte *out)
+{
+   byte *p = out;
+
+   for(size_t i = 0; i < count; )
+   {
+      const ticcmd_t &cmd  = cmds[i];
+      const ticcmd_t &base = i >= size_t(slots) ? cmds[i - slots] : emptycmd;
+      int flags = G_demoCmdFlags(cmd, base);
+
+      *p++ = byte(flags);
+
+      if(!flags)
+      {
+         size_t run = i + 1;
+
+         while(run < count && run >= size_t(slots) &&
+               !G_demoCmdFlags(cmds[run], cmds[run - slots]))
+            ++run;
+         p = G_writeVarint(p, uint32_t(run - i - 1));
+         i = run;
+         continue;
+      }
+
+      if(flags & DCF_FORWARDMOVE)
+         *p++ = byte(cmd.forwardmove);
+      if(flags & DCF_SIDEMOVE)
+         *p++ = byte(cmd.sidemove);
+      if(flags & DCF_ANGLETURN)
+         p = G_writeVarint(p, G_zigzag(int16_t(cmd.angleturn - base.angleturn)));
+      if(flags & DCF_BUTTONS)
+         *p++ = cmd.buttons;
+      if(flags & DCF_ACTIONS)
+         *p++ = cmd.actions;
+      if(flags & DCF_LOOK)
+         p = G_writeVarint(p, G_zigzag(int16_t(cmd.look - base.look)));
+      if(flags & DCF_FLY)
+         *p++ = byte(cmd.fly);
+      if(flags & DCF_INVENTORY)
+      {
+         p = G_writeVarint(p, cmd.itemID);
+         p = G_writeVarint(p, cmd.weaponID);
+         *p++ = cmd.slotIndex;
+      }
+      ++i;
+   }
+
+   return size_t(p - out);
+}
+
+//
+// Unpacks count ticcmds of slots per tic. Returns false if the data is
+// malformed.
+//
+static bool G_unpackDemoCmds(const byte *p, size_t size, int slots,
+                             ticcmd_t *cmds, size_t count)
+{
+   const byte *end = p + size;
+
+   for(size_t i = 0; i < count; )
+   {
+      const ticcmd_t &base = i >= size_t(slots) ? cmds[i - slots] : emptycmd;
+      uint32_t val;
+      int flags;
+
+      if(p >= end)
+         return false;
+      flags = *p++;
+
+      if(!flags)
+      {
+         if(!G_readVarint(p, end, val) || val >= count - i)
+            return false;
+         for(size_t run = i + val + 1; i < run; i++)
+            cmds[i] = i >= size_t(slots) ? cmds[i - slots] : emptycmd;
+         continue;
+      }
+
+      ticcmd_t &cmd = cmds[i];
+      cmd = base;
+
+      if(flags & DCF_FORWARDMOVE)
+      {
+         if(p >= end)
+            return false;
+         cmd.forwardmove = int8_t(*p++);
+      }
+      if(flags & DCF_SIDEMOVE)
+      {
+         if(p >= end)
+            return false;
+         cmd.sidemove = int8_t(*p++);
+      }
+      if(flags & DCF_ANGLETURN)
+      {
+         if(!G_readVarint(p, end, val))
+            return false;
+         cmd.angleturn = int16_t(base.angleturn + G_unzigzag(val));
+      }
+      if(flags & DCF_BUTTONS)
+      {
+         if(p >= end)
+            return false;
+         cmd.buttons = *p++;
+      }
+      if(flags & DCF_ACTIONS)
+      {
+         if(p >= end)
+            return false;
+         cmd.actions = *p++;
+      }
+      if(flags & DCF_LOOK)
+      {
+         if(!G_readVarint(p, end, val))
+            return false;
+         cmd.look = int16_t(base.look + G_unzigzag(val));
+      }
+      if(flags & DCF_FLY)
+      {
+         if(p >= end)
+            return false;
+         cmd.fly = int8_t(*p++);
+      }
+      if(flags & DCF_INVENTORY)
+      {
+         if(!G_readVarint(p, end, val))
+            return false;
+         cmd.itemID = uint16_t(val);
+         if(!G_readVarint(p, end, val))
+            return false;
+         cmd.weaponID = uint16_t(val);
+         if(p >= end)
+            return false;
+         cmd.slotIndex = *p++;
+      }
+      ++i;
+   }
+
+   return p == end;
+}
+
+//=============================================================================
+//
+// Writing
+//
+
+//
+// CompactDemoWriter::begin
+//
+// Starts a new stream.
+//
+void CompactDemoWriter::begin()
+{
+   pending.makeEmpty();
+   keyframes.makeEmpty();
+   slots   = 0;
+   numtics = 0;
+   tic     = 0;
+   offset  = 0;
+   hash    = 0;
+}
+
+//
+// CompactDemoWriter::flushChunk
+//
+// Packs, compresses and writes out the tics gathered so far.
+//
+bool CompactDemoWriter::flushChunk(OutBuffer &ob)
+{
+   if(!numtics)
+      return true;
+
+   size_t count   = pending.getLength();
+   byte  *raw     = emalloc(byte *, count * MAXPACKEDCMD + 1);
+   size_t rawsize = G_packDemoCmds(pending.begin(), count, slots, raw);
+   uLongf compsize = compressBound(static_cast<uLong>(rawsize));
+   byte  *comp    = emalloc(byte *, compsize);
+   byte   header[TICSHEADERSIZE];
+   bool   ok;
+
+   if(compress2(comp, &compsize, raw, static_cast<uLong>(rawsize),
+                Z_BEST_COMPRESSION) != Z_OK)
+      I_Error("CompactDemoWriter: compression failed\n");
+
+   demokeyframe_t &kf = keyframes.addNew();
+   kf.tic    = tic - numtics;
+   kf.offset = offset;
+   kf.hash   = hash;
+
+   header[0] = DEMOCHUNK_TICS;
+   G_writeLE32(header +  1, uint32_t(kf.tic));
+   G_writeLE32(header +  5, hash);
+   G_writeLE32(header +  9, uint32_t(numtics));
+   header[13] = byte(slots);
+   G_writeLE32(header + 14, uint32_t(rawsize));
+   G_writeLE32(header + 18, uint32_t(compsize));
+
+   ok = ob.write(header, sizeof(header)) && ob.write(comp, compsize);
+   offset += uint32_t(sizeof(header) + compsize);
+
+   efree(comp);
+   efree(raw);
+
+   pending.makeEmpty();
+   numtics = 0;
+
+   return ok;
+}
+
+//
+// CompactDemoWriter::writeTic
+//
+// Adds the ticcmds of one tic to the stream. tichash is the folded world
+// state hash from before the tic is run.
+//
+bool CompactDemoWriter::writeTic(OutBuffer &ob, const ticcmd_t *cmds, int count,
+                                 uint32_t tichash)
+{
+   if(numtics && (count != slots || numtics >= KEYFRAMETICS))
+   {
+      if(!flushChunk(ob))
+         return false;
+   }
+
+   if(!numtics)
+   {
+      slots = count;
+      hash  = tichash;
+   }
+
+   for(int i = 0; i < count; i++)
+      pending.add(cmds[i]);
+   ++numtics;
+   ++tic;
+
+   return true;
+}
+
+//
+// CompactDemoWriter::finish
+//
+// Writes out the last chunk and the keyframe index. The caller ends the
+// stream with the DEMOMARKER.
+//
+bool CompactDemoWriter::finish(OutBuffer &ob)
+{
+   byte header[INDEXHEADERSIZE];
+
+   if(!flushChunk(ob))
+      return false;
+
+   header[0] = DEMOCHUNK_INDEX;
+   G_writeLE32(header + 1, uint32_t(keyframes.getLength()));
+   if(!ob.write(header, sizeof(header)))
+      return false;
+
+   for(const demokeyframe_t &kf : keyframes)
+   {
+      byte entry[INDEXENTRYSIZE];
+
+      G_writeLE32(entry,     uint32_t(kf.tic));
+      G_writeLE32(entry + 4, kf.offset);
+      G_writeLE32(entry + 8, kf.hash);
+      if(!ob.write(entry, sizeof(entry)))
+         return false;
+   }
+
+   keyframes.clear();
+   pending.clear();
+
+   return true;
+}
+
+//=============================================================================
+//
+// Reading
+//
+
+//
+// CompactDemoReader::open
+//
+// Walks the chunks of a stream, checking that they are whole and building
+// the keyframe table, from the index if there is one. Returns false if the
+// stream is corrupt.
+//
+bool CompactDemoReader::open(const byte *stream, size_t len)
+{
+   PODCollection<demokeyframe_t> index;
+   bool   hasindex = false;
+   size_t off      = 0;
+
+   close();
+   data   = stream;
+   length = len;
+
+   while(off < len && data[off] != DEMOCHUNK_END)
+   {
+      const byte *p = data + off;
+
+      if(*p == DEMOCHUNK_TICS)
+      {
+         if(len - off < TICSHEADERSIZE)
+            return false;
+
+         uint32_t compsize = G_readLE32(p + 18);
+         if(compsize > len - off - TICSHEADERSIZE)
+            return false;
+
+         demokeyframe_t &kf = keyframes.addNew();
+         kf.tic    = int(G_readLE32(p + 1));
+         kf.offset = uint32_t(off);
+         kf.hash   = G_readLE32(p + 5);
+
+         off += TICSHEADERSIZE + compsize;
+      }
+      else if(*p == DEMOCHUNK_INDEX)
+      {
+         if(len - off < INDEXHEADERSIZE)
+            return false;
+
+         uint32_t count = G_readLE32(p + 1);
+         if(count > (len - off - INDEXHEADERSIZE) / INDEXENTRYSIZE)
+            return false;
+
+         index.makeEmpty();
+         for(uint32_t i = 0; i < count; i++)
+         {
+            const byte *e = p + INDEXHEADERSIZE + i * INDEXENTRYSIZE;
+            demokeyframe_t &kf = index.addNew();
+            kf.tic    = int(G_readLE32(e));
+            kf.offset = G_readLE32(e + 4);
+            kf.hash   = G_readLE32(e + 8);
+         }
+         hasindex = true;
+
+         off += INDEXHEADERSIZE + count * INDEXENTRYSIZE;
+      }
+      else
+         return false;
+   }
+
+   if(off >= len) // no DEMOMARKER
+      return false;
+
+   // Trust the index only if it names the chunks that are there.
+   if(hasindex && index.getLength() == keyframes.getLength())
+   {
+      for(size_t i = 0; i < index.getLength(); i++)
+      {
+         if(index[i].offset != keyframes[i].offset || index[i].tic != keyframes[i].tic)
+         {
+            hasindex = false;
+            break;
+         }
+      }
+      if(hasindex)
+      {
+         keyframes.makeEmpty();
+         for(const demokeyframe_t &kf : index)
+            keyframes.add(kf);
+      }
+   }
+
+   return true;
+}
+
+//
+// CompactDemoReader::close
+//
+void CompactDemoReader::close()
+{
+   data      = nullptr;
+   length    = 0;
+   pos       = 0;
+   firsttic  = 0;
+   slots     = 0;
+   nextchunk = 0;
+   keyframe  = false;
+   hash      = 0;
+   keyframes.clear();
+   cmds.clear();
+}
+
+//
+// CompactDemoReader::loadChunk
+//
+// Decompresses and unpacks the tics chunk at chunkoffset.
+//
+bool CompactDemoReader::loadChunk(size_t chunkoffset)
+{
+   if(chunkoffset >= length || length - chunkoffset < TICSHEADERSIZE)
+      return false;
+
+   const byte *p = data + chunkoffset;
+   if(*p != DEMOCHUNK_TICS)
+      return false;
+
+   uint32_t numtics  = G_readLE32(p + 9);
+   int      numslots = p[13];
+   uint32_t rawsize  = G_readLE32(p + 14);
+   uint32_t compsize = G_readLE32(p + 18);
+   size_t   count    = size_t(numtics) * numslots;
+
+   if(compsize > length - chunkoffset - TICSHEADERSIZE ||
+      numtics > KEYFRAMETICS || rawsize > count * MAXPACKEDCMD + 1)
+      return false;
+
+   byte  *raw    = emalloc(byte *, rawsize + 1);
+   uLongf rawlen = rawsize;
+   bool   ok;
+
+   cmds.resize(count);
+   ok = uncompress(raw, &rawlen, p + TICSHEADERSIZE, compsize) == Z_OK &&
+        rawlen == rawsize &&
+        G_unpackDemoCmds(raw, rawsize, numslots, cmds.begin(), count);
+   efree(raw);
+
+   if(!ok)
+   {
+      cmds.makeEmpty();
+      return false;
+   }
+
+   firsttic  = int(G_readLE32(p + 1));
+   hash      = G_readLE32(p + 5);
+   slots     = numslots;
+   pos       = 0;
+   nextchunk = chunkoffset + TICSHEADERSIZE + compsize;
+
+   return true;
+}
+
+//
+// CompactDemoReader::readCmd
+//
+// Reads the next ticcmd into cmd. Fields which demos do not record are left
+// alone.
+//
+int CompactDemoReader::readCmd(ticcmd_t *cmd)
+{
+   while(pos >= cmds.getLength())
+   {
+      if(nextchunk >= length)
+         return DEMOREAD_ERROR;
+
+      switch(data[nextchunk])
+      {
+      case DEMOCHUNK_END:
+         return DEMOREAD_END;
+      case DEMOCHUNK_INDEX:
+         if(length - nextchunk < INDEXHEADERSIZE)
+            return DEMOREAD_ERROR;
+         nextchunk += INDEXHEADERSIZE +
+            size_t(G_readLE32(data + nextchunk + 1)) * INDEXENTRYSIZE;
+         cmds.makeEmpty();
+         pos = 0;
+         break;
+      case DEMOCHUNK_TICS:
+         if(!loadChunk(nextchunk))
+            return DEMOREAD_ERROR;
+         break;
+      default:
+         return DEMOREAD_ERROR;
+      }
+   }
+
+   keyframe = (pos == 0);
+   G_copyDemoCmd(*cmd, cmds[pos++]);
+
+   return DEMOREAD_OK;
+}
+
+//
+// CompactDemoReader::seekTic
+//
+// Moves the read position to the start of a tic, starting from the keyframe
+// before it.
+//
+bool CompactDemoReader::seekTic(int tic)
+{
+   const demokeyframe_t *kf = nullptr;
+
+   for(const demokeyframe_t &k : keyframes)
+   {
+      if(k.tic > tic)
+         break;
+      kf = &k;
+   }
+
+   if(!kf || !loadChunk(kf->offset))
+      return false;
+
+   size_t index = size_t(tic - firsttic) * slots;
+   if(index > cmds.getLength())
+      return false;
+
+   pos = index;
+   return true;
+}
+
+VARIABLE_TOGGLE(demo_compact, NULL, onoff);
+CONSOLE_VARIABLE(demo_compact, demo_compact, 0) {}
+
+// EOF
+
@@ -0,0 +1,123 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Compact demo format: packed and compressed ticcmd streams.
+//
+//----------------------------------------------------------------------------
+
+#ifndef G_DEMOSTREAM_H__
+#define G_DEMOSTREAM_H__
+
+#include "m_collection.h"
+
+class  OutBuffer;
+struct ticcmd_t;
+
+// Format of the tic stream of an Eternity demo, stored in the byte that
+// ends the demo signature
+enum
+{
+   DEMOFORMAT_RAW,     // ticcmd bytes, as written by G_WriteDemoTiccmd
+   DEMOFORMAT_COMPACT, // chunks of packed, compressed ticcmds
+   NUMDEMOFORMATS
+};
+
+// A point the stream can be read from, with the state of the world there
+struct demokeyframe_t
+{
+   int      tic;    // first tic of the chunk
+   uint32_t offset; // chunk offset from the start of the stream
+   uint32_t hash;   // folded state hash before the tic is run
+};
+
+//
+// Writes the tic stream of a compact demo
+//
+class CompactDemoWriter
+{
+protected:
+   PODCollection<ticcmd_t>       pending;   // cmds of the chunk being built
+   PODCollection<demokeyframe_t> keyframes; // one for each chunk written
+   int      slots;    // cmds per tic in this chunk
+   int      numtics;  // tics in this chunk
+   int      tic;      // tics written so far
+   uint32_t offset;   // bytes written so far
+   uint32_t hash;     // state hash at the start of this chunk
+
+   bool flushChunk(OutBuffer &ob);
+
+public:
+   CompactDemoWriter() : slots(0), numtics(0), tic(0), offset(0), hash(0) {}
+
+   void begin();
+   bool writeTic(OutBuffer &ob, const ticcmd_t *cmds, int count, uint32_t tichash);
+   bool finish(OutBuffer &ob);
+};
+
+// Results of CompactDemoReader::readCmd
+enum
+{
+   DEMOREAD_OK,
+   DEMOREAD_END,  // reached the end of the stream
+   DEMOREAD_ERROR // the stream is corrupt
+};
+
+//
+// Reads the tic stream of a compact demo
+//
+class CompactDemoReader
+{
+protected:
+   const byte *data;   // start of the stream
+   size_t      length; // bytes up to the end of the demo
+   PODCollection<demokeyframe_t> keyframes;
+   PODCollection<ticcmd_t>       cmds;  // the chunk being read
+   size_t      pos;       // next cmd in the chunk
+   int         firsttic;  // first tic of the chunk
+   int         slots;     // cmds per tic in the chunk
+   size_t      nextchunk; // offset of the following chunk
+   bool        keyframe;  // at the start of a chunk
+   uint32_t    hash;      // state hash stored for this chunk
+
+   bool loadChunk(size_t chunkoffset);
+
+public:
+   CompactDemoReader()
+      : data(nullptr), length(0), pos(0), firsttic(0), slots(0), nextchunk(0),
+        keyframe(false), hash(0)
+   {
+   }
+
+   bool open(const byte *stream, size_t len);
+   void close();
+   int  readCmd(ticcmd_t *cmd);
+   bool seekTic(int tic);
+
+   // Returns true, with the stored state hash, if the last cmd read began a
+   // chunk.
+   bool atKeyframe(uint32_t &h) const { h = hash; return keyframe; }
+};
+
+extern bool demo_compact;
+
+#endif
+
+// EOF
+
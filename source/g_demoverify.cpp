@@ -0,0 +1,401 @@
+//
+// The Eternity Engine
+// Copyright (C) 2017 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: Parallel demo sync verification (-demoverify)
+//
+// -demoverify takes a list file naming one demo per line, optionally followed
+// by the file holding its expected ("golden") state hashes, which defaults to
+// the demo name plus ".hashes". Every demo is played by a separate instance
+// of the engine, started with the rest of the command line plus
+// -timedemo, -nodraw, -nosound and -demohashlog, several at a time. Each
+// instance logs the world state hash after every tic; the logs are then
+// compared with the golden ones, and a JSON report is written with the
+// outcome of every demo, and its first divergent tic and classes of state. Demos without golden
+// hashes get them recorded from this run.
+//
+// The game keeps all of its state in globals, so separate processes are the
+// only way to isolate the runs from one another.
+//
+
+#include <atomic>
+#include <thread>
+
+#include "z_zone.h"
+#include "i_system.h"
+#include "hal/i_platform.h"
+#include "g_demoverify.h"
+#include "m_argv.h"
+#include "m_collection.h"
+#include "m_qstr.h"
+#include "m_utils.h"
+#include "p_statehash.h"
+
+enum
+{
+   DV_PASS,     // all hashes matched
+   DV_FAIL,     // hashes diverged
+   DV_RECORDED, // no golden hashes existed; they were made from this run
+   DV_ERROR     // the run did not finish
+};
+
+static const char *const dvStatusNames[] = { "pass", "fail", "recorded", "error" };
+
+struct demojob_t
+{
+   qstring demo;    // demo file, as given in the list
+   qstring golden;  // expected state hashes
+   qstring output;  // state hashes logged by this run
+   qstring command; // command line of the run
+   int result;      // DV_ status
+   int tics;        // tics hashed in this run
+   int divergedAt;  // first tic that differs, or -1
+   qstring diverged; // classes of state differing at that tic
+};
+
+//
+// Appends an argument to a command line, quoted for the system shell
+//
+static void G_quoteArg(qstring &cmd, const char *arg)
+{
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   cmd << " \"" << arg << '"';
+#else
+   cmd << " '";
+   for(; *arg; ++arg)
+   {
+      if(*arg == '\'')
+         cmd << "'\\''";
+      else
+         cmd << *arg;
+   }
+   cmd << '\'';
+#endif
+}
+
+//
+// Reads the list file into jobs
+//
+static void G_readDemoList(const char *listfile, Collection<demojob_t> &jobs)
+{
+   FILE *f;
+   char  line[1024];
+
+   if(!(f = fopen(listfile, "rt")))
+      I_Error("G_DemoVerify: cannot open demo list '%s'\n", listfile);
+
+   while(fgets(line, sizeof(line), f))
+   {
+      char demo[512], golden[512];
+      int  count = sscanf(line, " %511s %511s", demo, golden);
+
+      if(count < 1 || *demo == '#')
+         continue;
+
+      demojob_t &job = jobs.addNew();
+      job.demo   = demo;
+      job.golden = demo;
+      if(count >= 2)
+         job.golden = golden;
+      else
+         job.golden << ".hashes";
+      job.output = job.golden;
+      job.output << ".new";
+      job.result     = DV_ERROR;
+      job.tics       = 0;
+      job.divergedAt = -1;
+   }
+
+   fclose(f);
+}
+
+//
+// Builds the command line that plays one demo
+//
+static void G_buildCommand(demojob_t &job)
+{
+   qstring &cmd = job.command;
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   cmd = "\""; // cmd.exe strips the outermost quotes
+#endif
+   G_quoteArg(cmd, myargv[0]);
+
+   for(int i = 1; i < myargc; ++i)
+   {
+      if(!strncasecmp(myargv[i], "-demoverify", 11))
+      {
+         ++i; // skip the value too
+         continue;
+      }
+      G_quoteArg(cmd, myargv[i]);
+   }
+
+   cmd << " -nodraw -nosound -timedemo";
+   G_quoteArg(cmd, job.demo.constPtr());
+   cmd << " -demohashlog";
+   G_quoteArg(cmd, job.output.constPtr());
+
+   // keep the console output of each run apart
+   qstring logname(job.output);
+   logname << ".log";
+   cmd << " >";
+   G_quoteArg(cmd, logname.constPtr());
+   cmd << " 2>&1";
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   cmd << '"';
+#endif
+}
+
+//
+// Reads the next line from a hash log, returning false at its end
+//
+static bool G_nextHash(FILE *f, char *line, size_t size)
+{
+   if(!f || !fgets(line, static_cast<int>(size), f))
+      return false;
+   line[strcspn(line, "\r\n")] = '\0';
+   return true;
+}
+
+//
+// Names the classes of state whose hashes differ between two log lines
+//
+static void G_divergedClasses(const char *line1, const char *line2, qstring &names)
+{
+   unsigned int parts1[NUMSTATEHASHES], parts2[NUMSTATEHASHES];
+   int tic;
+
+   if(sscanf(line1, "%d %x %x %x %x", &tic, &parts1[0], &parts1[1], &parts1[2],
+             &parts1[3]) != NUMSTATEHASHES + 1 ||
+      sscanf(line2, "%d %x %x %x %x", &tic, &parts2[0], &parts2[1], &parts2[2],
+             &parts2[3]) != NUMSTATEHASHES + 1)
+      return;
+
+   for(int i = 0; i < NUMSTATEHASHES; i++)
+   {
+      if(parts1[i] != parts2[i])
+      {
+         if(names.length())
+            names << ' ';
+         names << statehashnames[i];
+      }
+   }
+}
+
+//
+// Compares the state hashes of a finished run with the golden ones
+//
+static void G_checkRun(demojob_t &job)
+{
+   FILE *out, *gold;
+   char  outline[64], goldline[64];
+   bool  ended = false;
+
+   if(!(out = fopen(job.output.constPtr(), "rt")))
+   {
+      job.result = DV_ERROR;
+      return;
+   }
+
+   gold = fopen(job.golden.constPtr(), "rt");
+
+   while(1)
+   {
+      bool haveout  = G_nextHash(out, outline, sizeof(outline));
+      bool havegold = G_nextHash(gold, goldline, sizeof(goldline));
+
+      if(!haveout && !havegold)
+         break;
+
+      if(haveout)
+      {
+         if(!strncmp(outline, "end", 3))
+            ended = true;
+         else
+            ++job.tics;
+      }
+
+      if(gold && job.divergedAt < 0 &&
+         (haveout != havegold || strcmp(outline, goldline)))
+      {
+         const char *where = haveout ? outline : goldline;
+         job.divergedAt = atoi(where + (strncmp(where, "end", 3) ? 0 : 3));
+         if(haveout && havegold)
+            G_divergedClasses(outline, goldline, job.diverged);
+      }
+   }
+
+   fclose(out);
+
+   if(!ended)
+      job.result = DV_ERROR;
+   else if(gold)
+      job.result = job.divergedAt < 0 ? DV_PASS : DV_FAIL;
+   else
+   {
+      // first run of this demo: keep its hashes as the golden ones
+      byte *data;
+      int   size;
+
+      job.result = DV_ERROR;
+      if((size = M_ReadFile(job.output.constPtr(), &data)) >= 0)
+      {
+         if(M_WriteFile(job.golden.constPtr(), data, size_t(size)))
+            job.result = DV_RECORDED;
+         efree(data);
+      }
+   }
+
+   if(gold)
+      fclose(gold);
+}
+
+//
+// Writes a string as a JSON string literal
+//
+static void G_writeJSONString(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for(; *str; ++str)
+   {
+      if(*str == '"' || *str == '\\')
+         fputc('\\', f);
+      fputc(*str, f);
+   }
+   fputc('"', f);
+}
+
+//
+// Writes the JSON report of all runs
+//
+static void G_writeReport(const char *filename, const Collection<demojob_t> &jobs,
+                          const int *counts)
+{
+   FILE *f;
+
+   if(!(f = fopen(filename, "wt")))
+   {
+      printf("G_DemoVerify: cannot write report '%s'\n", filename);
+      return;
+   }
+
+   fprintf(f, "{\n  \"demos\": [\n");
+   for(size_t i = 0; i < jobs.getLength(); ++i)
+   {
+      const demojob_t &job = jobs[i];
+
+      fprintf(f, "    { \"demo\": ");
+      G_writeJSONString(f, job.demo.constPtr());
+      fprintf(f, ", \"golden\": ");
+      G_writeJSONString(f, job.golden.constPtr());
+      fprintf(f, ", \"status\": \"%s\", \"tics\": %d",
+              dvStatusNames[job.result], job.tics);
+      if(job.divergedAt >= 0)
+      {
+         fprintf(f, ", \"firstDivergentTic\": %d, \"divergentState\": ",
+                 job.divergedAt);
+         G_writeJSONString(f, job.diverged.constPtr());
+      }
+      else
+         fprintf(f, ", \"firstDivergentTic\": null");
+      fprintf(f, " }%s\n", i + 1 < jobs.getLength() ? "," : "");
+   }
+   fprintf(f, "  ],\n");
+   fprintf(f, "  \"passed\": %d,\n  \"failed\": %d,\n  \"recorded\": %d,\n"
+              "  \"errors\": %d\n}\n",
+           counts[DV_PASS], counts[DV_FAIL], counts[DV_RECORDED], counts[DV_ERROR]);
+   fclose(f);
+}
+
+//
+// Runs all the demos in the list file and reports on them. Never returns; the
+// exit code is nonzero if any demo failed or did not finish.
+//
+void G_DemoVerify(const char *listfile)
+{
+   Collection<demojob_t> jobs;
+   std::atomic<size_t>   nextjob(0);
+   int         numworkers = static_cast<int>(std::thread::hardware_concurrency());
+   const char *report = "demoverify.json";
+   int         counts[earrlen(dvStatusNames)] = { 0 };
+   int         p;
+
+   G_readDemoList(listfile, jobs);
+   if(!jobs.getLength())
+      I_Error("G_DemoVerify: no demos listed in '%s'\n", listfile);
+
+   if((p = M_CheckParm("-demoverifyjobs")) && p < myargc - 1)
+      numworkers = atoi(myargv[p + 1]);
+   if((p = M_CheckParm("-demoverifyreport")) && p < myargc - 1)
+      report = myargv[p + 1];
+
+   if(numworkers < 1)
+      numworkers = 1;
+   if(size_t(numworkers) > jobs.getLength())
+      numworkers = static_cast<int>(jobs.getLength());
+
+   for(demojob_t &job : jobs)
+      G_buildCommand(job);
+
+   printf("G_DemoVerify: playing %d demos, %d at a time\n",
+          int(jobs.getLength()), numworkers);
+
+   // The workers only start processes; everything touching the zone heap
+   // stays on this thread.
+   std::thread *workers = new std::thread[numworkers];
+   for(int i = 0; i < numworkers; ++i)
+   {
+      workers[i] = std::thread([&jobs, &nextjob] {
+         size_t j;
+         while((j = nextjob++) < jobs.getLength())
+         {
+            remove(jobs[j].output.constPtr());
+            system(jobs[j].command.constPtr());
+         }
+      });
+   }
+   for(int i = 0; i < numworkers; ++i)
+      workers[i].join();
+   delete [] workers;
+
+   for(demojob_t &job : jobs)
+   {
+      G_checkRun(job);
+      ++counts[job.result];
+
+      printf("%-8s %s", dvStatusNames[job.result], job.demo.constPtr());
+      if(job.divergedAt >= 0)
+      {
+         printf(" (first divergent tic %d: %s)", job.divergedAt,
+                job.diverged.length() ? job.diverged.constPtr() : "ended early");
+      }
+      putchar('\n');
+   }
+
+   G_writeReport(report, jobs, counts);
+   printf("G_DemoVerify: %d passed, %d failed, %d recorded, %d errors\n",
+          counts[DV_PASS], counts[DV_FAIL], counts[DV_RECORDED], counts[DV_ERROR]);
+
+   exit(counts[DV_FAIL] || counts[DV_ERROR] ? 1 : 0);
+}
+
+// EOF
+
@@ -57,7 +57,9 @@
 #include "g_bind.h"
 #include "g_demolog.h"
 #include "g_dmflag.h"
+#include "g_demostream.h"
 #include "g_game.h"
+#include "g_rewind.h"
 #include "in_lude.h"
 #include "m_argv.h"
 #include "m_buffer.h"
@@ -77,6 +79,7 @@
 #include "p_maputl.h"
 #include "p_saveg.h"
 #include "p_setup.h"
+#include "p_statehash.h"
 #include "p_tick.h"
 #include "p_user.h"
 #include "hu_stuff.h"
@@ -106,6 +109,14 @@ static OutBuffer demofp;         // only for recording
 static byte    *demo_p;          // used for both playing and recording
 static byte    *demo_continue_p; // only for rerecording
 static size_t   demolength;
+static int      demoreadformat;  // tic stream format of the demo read
+static int      demowriteformat; // tic stream format of the demo recorded
+
+static CompactDemoReader demoreader;   // compact playback
+static CompactDemoReader continuereader; // compact rerecording
+static CompactDemoWriter demowriter;
+static ticcmd_t demoticcmds[MAXPLAYERS]; // cmds of the tic being recorded
+static int      numdemoticcmds;
 static int16_t  consistency[MAXPLAYERS][BACKUPTICS];
 static int      g_destmap;
 
@@ -141,6 +152,7 @@ int             totalkills, totalitems, totalsecret;    // for intermission
 bool            democontinue;
 bool            demorecording;
 bool            demoplayback;
+int             demotic;       // tics read from the demo being played
 bool            singledemo;           // quit after playing a demo from cmdline
 bool            precache = true;      // if true, load all graphics at start
 wbstartstruct_t wminfo;               // parms for world map / intermission
@@ -1079,6 +1091,24 @@ static void G_SetCompatibility(void)
 // system being used to send them at startup is garbage.
 //
 
+//
+// G_unsupportedDemo
+//
+// Gives up on a demo which this engine cannot play.
+//
+static void G_unsupportedDemo()
+{
+   if(singledemo)
+      I_Error("G_ReadDemoHeader: unsupported demo format\n");
+   else
+   {
+      C_Printf(FC_ERROR "Unsupported demo format\n");
+      gameaction = ga_nothing;
+      Z_ChangeTag(demobuffer, PU_CACHE);
+      D_AdvanceDemo();
+   }
+}
+
 static byte *G_ReadDemoHeader(byte *demo_p)
 {
    skill_t skill;
@@ -1114,17 +1144,11 @@ static byte *G_ReadDemoHeader(byte *demo_p)
         (demover >= 200 && demover <= 203) || // BOOM, MBF
         (demover == 255)))                    // Eternity
    {
-      if(singledemo)
-         I_Error("G_ReadDemoHeader: unsupported demo format\n");
-      else
-      {
-         C_Printf(FC_ERROR "Unsupported demo format\n");
-         gameaction = ga_nothing;
-         Z_ChangeTag(demobuffer, PU_CACHE);
-         D_AdvanceDemo();
-      }
+      G_unsupportedDemo();
       return nullptr;
    }
+
+   demoreadformat = DEMOFORMAT_RAW;
    
    int dmtype = 0;
    if(demover < 200)     // Autodetect old demos
@@ -1207,7 +1231,14 @@ static byte *G_ReadDemoHeader(byte *demo_p)
       {
          int temp;
          
-         demo_p += 6; // increment past signature
+         demo_p += 5; // increment past signature
+
+         // the byte which ends the signature gives the tic stream format
+         if((demoreadformat = *demo_p++) >= NUMDEMOFORMATS)
+         {
+            G_unsupportedDemo();
+            return nullptr;
+         }
          
          // reconstruct full version number and reset it
          temp  =        *demo_p++;         // byte one
@@ -1335,6 +1366,8 @@ static byte *G_ReadDemoHeader(byte *demo_p)
    return demo_p;
 }
 
+static void G_findDemoHashes();
+
 void G_DoPlayDemo(void)
 {
    char basename[9];
@@ -1345,6 +1378,8 @@ void G_DoPlayDemo(void)
    if(gameaction != ga_loadgame)      // killough 12/98: support -loadgame
       basetic = gametic;  // killough 9/29/98
 
+   demotic = 0;
+
    M_ExtractFileBase(defdemoname, basename);         // killough
 
    // haleyjd 11/09/09: check ns_demos namespace first, then ns_global
@@ -1378,6 +1413,14 @@ void G_DoPlayDemo(void)
    if(!(demo_p = G_ReadDemoHeader(demobuffer)))
       return;
 
+   // a corrupt stream is left closed, and ends the demo at its first tic
+   demoreader.close();
+   if(demoreadformat == DEMOFORMAT_COMPACT &&
+      !demoreader.open(demo_p, demolength - size_t(demo_p - demobuffer)))
+      C_Printf(FC_ERROR "G_DoPlayDemo: corrupt demo stream\n");
+
+   G_findDemoHashes();
+
    precache = true;
    usergame = false;
    demoplayback = true;
@@ -1400,6 +1443,107 @@ void G_DoPlayDemo(void)
 
 #define DEMOMARKER    0x80
 
+//
+// Demo State Hashes
+//
+// Eternity-format demos end with a footer after the DEMOMARKER: the world
+// state hash of every tic, folded to a byte for each class of state, then the
+// number of tics and a magic number. Engines which stop at the DEMOMARKER
+// never see it. On playback the hashes are checked as the demo goes, so that
+// a desync is reported at the tic where it happens, with the kind of state
+// that was affected. Vanilla-format recordings are left without one.
+//
+
+static const char demoHashMagic[4] = { 'E', 'E', 'S', 'H' };
+
+static PODCollection<uint32_t> demohashes; // while recording
+static bool        demohashrecord;         // recording gets a footer
+static const byte *demohashfooter;         // while playing back
+static uint32_t    demohashcount;
+static bool        demodesynced;
+
+static uint32_t G_readLE32(const byte *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+static void G_writeLE32(OutBuffer &ob, uint32_t val)
+{
+   const byte b[4] = { byte(val), byte(val >> 8), byte(val >> 16), byte(val >> 24) };
+   ob.write(b, sizeof(b));
+}
+
+//
+// Locates the state hash footer of the demo being played back, if it has one.
+//
+static void G_findDemoHashes()
+{
+   const byte *end = demobuffer + demolength;
+   uint32_t count;
+
+   demohashfooter = nullptr;
+   demohashcount  = 0;
+   demodesynced   = false;
+
+   if(demolength < 9 || memcmp(end - 4, demoHashMagic, 4))
+      return;
+
+   count = G_readLE32(end - 8);
+   if(count > (demolength - 9) / 4 || *(end - 9 - 4 * count) != DEMOMARKER)
+      return;
+
+   demohashfooter = end - 8 - 4 * count;
+   demohashcount  = count;
+}
+
+//
+// Records or checks the state hash of the tic just run.
+//
+static void G_demoHashTic()
+{
+   statehash_t hash;
+
+   if(demorecording)
+   {
+      if(demohashrecord)
+      {
+         P_StateHashGet(hash);
+         demohashes.add(P_StateHashFold(hash, 8));
+      }
+   }
+   else if(demoplayback && demohashfooter && !demodesynced &&
+           demotic > 0 && uint32_t(demotic) <= demohashcount)
+   {
+      uint32_t expected = G_readLE32(demohashfooter + 4 * (demotic - 1));
+      uint32_t actual;
+
+      P_StateHashGet(hash);
+      if((actual = P_StateHashFold(hash, 8)) != expected)
+      {
+         char diff[64];
+
+         P_StateHashDiff(actual, expected, 8, diff, sizeof(diff));
+         demodesynced = true;
+         C_Printf(FC_ERROR "Demo desync at tic %d (gametic %d): %s differ\n",
+                  demotic, gametic, diff);
+         G_DemoLog("%d\tdesync at demo tic %d: %s\n", gametic, demotic, diff);
+      }
+   }
+}
+
+//
+// Writes out the state hash footer of the demo being recorded.
+//
+static void G_writeDemoHashes()
+{
+   for(uint32_t hash : demohashes)
+      G_writeLE32(demofp, hash);
+   G_writeLE32(demofp, uint32_t(demohashes.getLength()));
+   demofp.write(demoHashMagic, sizeof(demoHashMagic));
+
+   demohashes.clear();
+}
+
 //
 // NETCODE_FIXME -- DEMO_FIXME
 //
@@ -1414,6 +1558,18 @@ void G_DoPlayDemo(void)
 // ticcmds.
 //
 
+//
+// killough 3/26/98, 10/98: Ignore savegames in demos
+//
+static void G_suppressDemoSave(ticcmd_t *cmd)
+{
+   if(demoplayback && cmd->buttons & BT_SPECIAL && cmd->buttons & BTS_SAVEGAME)
+   {
+      cmd->buttons &= ~BTS_SAVEGAME;
+      doom_printf("Game Saved (Suppressed)");
+   }
+}
+
 static byte *G_ReadTic(ticcmd_t *cmd, byte *p)
 {
    cmd->forwardmove = ((signed char)*p++);
@@ -1477,19 +1633,97 @@ static byte *G_ReadTic(ticcmd_t *cmd, byte *p)
       cmd->slotIndex = 0;
    }
 
-   // killough 3/26/98, 10/98: Ignore savegames in demos
-   if(demoplayback && cmd->buttons & BT_SPECIAL && cmd->buttons & BTS_SAVEGAME)
+   G_suppressDemoSave(cmd);
+
+   return p;
+}
+
+//
+// G_GetDemoOffset
+//
+// Returns the read position within the demo being played back. Compact
+// demos are sought by tic alone.
+//
+size_t G_GetDemoOffset()
+{
+   if(!demoplayback || demoreadformat == DEMOFORMAT_COMPACT)
+      return 0;
+   return size_t(demo_p - demobuffer);
+}
+
+//
+// G_SetDemoOffset
+//
+// Moves the read position of the demo being played back, together with the
+// count of tics read so far. Used when seeking within the demo.
+//
+void G_SetDemoOffset(size_t offset, int tic)
+{
+   if(!demoplayback || offset > demolength)
+      return;
+
+   if(demoreadformat == DEMOFORMAT_COMPACT)
    {
-      cmd->buttons &= ~BTS_SAVEGAME;
-      doom_printf("Game Saved (Suppressed)");
+      if(!demoreader.seekTic(tic))
+         return;
    }
+   else
+      demo_p = demobuffer + offset;
+   demotic = tic;
+}
 
-   return p;
+//
+// G_readCompactTiccmd
+//
+// Reads a ticcmd from a compact demo stream, checking the world state
+// against the hash stored at each keyframe. Returns false at the end of the
+// stream.
+//
+static bool G_readCompactTiccmd(CompactDemoReader &reader, ticcmd_t *cmd)
+{
+   uint32_t expected;
+
+   switch(reader.readCmd(cmd))
+   {
+   case DEMOREAD_END:
+      return false;
+   case DEMOREAD_ERROR:
+      C_Printf(FC_ERROR "G_ReadDemoTiccmd: corrupt demo stream\n");
+      return false;
+   default:
+      break;
+   }
+
+   if(demoplayback && reader.atKeyframe(expected) && !demodesynced)
+   {
+      statehash_t hash;
+      uint32_t actual;
+
+      P_StateHashGet(hash);
+      if((actual = P_StateHashFold(hash, 8)) != expected)
+      {
+         char diff[64];
+
+         P_StateHashDiff(actual, expected, 8, diff, sizeof(diff));
+         demodesynced = true;
+         C_Printf(FC_ERROR "Demo desync at keyframe tic %d (gametic %d): %s differ\n",
+                  demotic, gametic, diff);
+         G_DemoLog("%d\tdesync at demo keyframe %d: %s\n", gametic, demotic, diff);
+      }
+   }
+
+   G_suppressDemoSave(cmd);
+   return true;
 }
 
 static void G_ReadDemoTiccmd(ticcmd_t *cmd)
 {
-   if(*demo_p == DEMOMARKER)
+   if(demoreadformat == DEMOFORMAT_COMPACT)
+   {
+      if(!G_readCompactTiccmd(demoreader, cmd))
+         G_CheckDemoStatus();
+   }
+   else if(*demo_p == DEMOMARKER)
    {
       G_CheckDemoStatus();      // end of demo data stream
    }
@@ -1514,7 +1748,16 @@ static void G_ReadDemoContinueTiccmd(ticcmd_t *cmd)
    if(!demo_continue_p)
       return;
 
-   if(demo_continue_p < demobuffer + demolength && *demo_continue_p != DEMOMARKER &&
+   if(demoreadformat == DEMOFORMAT_COMPACT)
+   {
+      if(gameactions[ka_join_demo] || !G_readCompactTiccmd(continuereader, cmd))
+      {
+         continuereader.close();
+         demo_continue_p = nullptr;
+         democontinue = false;
+      }
+   }
+   else if(demo_continue_p < demobuffer + demolength && *demo_continue_p != DEMOMARKER &&
       !gameactions[ka_join_demo])
       demo_continue_p = G_ReadTic(cmd, demo_continue_p);
    else
@@ -1579,6 +1822,14 @@ static void G_WriteDemoTiccmd(ticcmd_t *cmd)
       *p++ =  cmd->slotIndex;
    }
 
+   if(demowriteformat == DEMOFORMAT_COMPACT)
+   {
+      // read it back the same way, then keep it for G_writeDemoTic
+      G_ReadTic(cmd, start);
+      demoticcmds[numdemoticcmds++] = *cmd;
+      return;
+   }
+
    if(!demofp.write(start, p - start))
       I_Error("G_WriteDemoTiccmd: error writing demo\n");
 
@@ -1586,6 +1837,23 @@ static void G_WriteDemoTiccmd(ticcmd_t *cmd)
    G_ReadDemoTiccmd(cmd); // make SURE it is exactly the same
 }
 
+//
+// G_writeDemoTic
+//
+// Adds the ticcmds of the tic just read to a compact demo. tichash is the
+// world state from before the tic.
+//
+static void G_writeDemoTic(const statehash_t &tichash)
+{
+   if(demowriteformat != DEMOFORMAT_COMPACT)
+      return;
+
+   if(!demowriter.writeTic(demofp, demoticcmds, numdemoticcmds,
+                           P_StateHashFold(tichash, 8)))
+      I_Error("G_WriteDemoTiccmd: error writing demo\n");
+   numdemoticcmds = 0;
+}
+
 static bool secretexit;
 
 // haleyjd: true if a script called exitsecret()
@@ -1955,6 +2223,10 @@ void G_ForceFinale()
 
 static char *savename;
 
+// savegame image to load from memory instead of savename
+static const byte *savememory;
+static size_t      savememorysize;
+
 //
 // killough 5/15/98: add forced loadgames, which allow user to override checks
 //
@@ -1976,6 +2248,7 @@ void G_LoadGame(const char *name, int slot, bool command)
    if(savename)
       efree(savename);
    savename = estrdup(name);
+   savememory = nullptr;
    savegameslot = slot;
    gameaction = ga_loadgame;
    forced_loadgame = false;
@@ -1983,6 +2256,20 @@ void G_LoadGame(const char *name, int slot, bool command)
    hub_changelevel = false;
 }
 
+//
+// Like G_LoadGame, but loads a savegame image held in memory, as produced
+// by P_SaveGameToMemory. The data must stay valid until the load happens.
+//
+void G_LoadGameFromMemory(const byte *data, size_t size)
+{
+   savememory = data;
+   savememorysize = size;
+   gameaction = ga_loadgame;
+   forced_loadgame = false;
+   command_loadgame = false;
+   hub_changelevel = false;
+}
+
 // killough 5/15/98:
 // Consistency Error when attempting to load savegame.
 
@@ -2096,7 +2383,15 @@ WadDirectory *d_dir;
 static void G_DoLoadGame(void)
 {
    gameaction = ga_nothing;
-   P_LoadGame(savename);
+
+   if(savememory)
+   {
+      const byte *data = savememory;
+      savememory = nullptr;
+      P_LoadGameFromMemory(data, savememorysize);
+   }
+   else
+      P_LoadGame(savename);
 }
 
 //
@@ -2141,6 +2436,7 @@ static void G_CameraTicker(void)
 void G_Ticker()
 {
    int i;
+   bool rancmds = false;
 
    // do player reborns if needed
    for(i = 0; i < MAXPLAYERS; i++)
@@ -2188,6 +2484,9 @@ void G_Ticker()
       }
    }
 
+   // report on any savegame finished writing in the background
+   P_CheckSaveWriter();
+
    if(animscreenshot)    // animated screen shots
    {
       if(gametic % 16 == 0)
@@ -2224,6 +2523,15 @@ void G_Ticker()
    {
       // get commands, check consistency, and build new consistancy check
       int buf = (gametic / ticdup) % BACKUPTICS;
+      rancmds = true;
+      statehash_t tichash;
+
+      P_StateHashGet(tichash);
+
+      // a dedicated server is not in the game, but its commands carry the
+      // console commands typed at it
+      if(dedicatedhost)
+         memcpy(&players[0].cmd, &netcmds[0][buf], sizeof(ticcmd_t));
       
       for(i=0; i<MAXPLAYERS; i++)
       {
@@ -2258,21 +2566,31 @@ void G_Ticker()
                if(gametic > BACKUPTICS && 
                   consistency[i][buf] != cmd->consistency)
                {
+                  char diff[64];
+
+                  P_StateHashDiff(uint16_t(cmd->consistency), 
+                                  uint16_t(consistency[i][buf]), 4,
+                                  diff, sizeof(diff));
                   D_QuitNetGame();
-                  C_Printf(FC_ERROR "consistency failure");
-                  C_Printf(FC_ERROR "(%i should be %i)",
-                              cmd->consistency, consistency[i][buf]);
+                  C_Printf(FC_ERROR "consistency failure at tic %d", gametic);
+                  C_Printf(FC_ERROR "(%i should be %i; %s differ)",
+                              cmd->consistency, consistency[i][buf], diff);
+                  G_DemoLog("%d\tconsistency failure: %s\n", gametic, diff);
                }
                
-               // sf: include y as well as x
-               if(players[i].mo)
-                  consistency[i][buf] = (int16_t)(players[i].mo->x + players[i].mo->y);
-               else
-                  consistency[i][buf] = 0; // killough 2/14/98
+               // The world state hash, folded to four bits for each class
+               // of state, so that a failure tells what went out of sync.
+               consistency[i][buf] = (int16_t)P_StateHashFold(tichash, 4);
             }
          }
       }
       
+      if(demorecording)
+         G_writeDemoTic(tichash);
+
+      if(demoplayback)
+         ++demotic;
+
       // check for special buttons
       for(i = 0; i < MAXPLAYERS; i++)
       {
@@ -2346,6 +2664,16 @@ void G_Ticker()
          break;
       }
    }
+
+   // record or check the state hash of this tic
+   if(rancmds)
+      G_demoHashTic();
+
+   // keep the rewind buffer going
+   G_RewindTicker();
+
+   // -demoverify: log the state this tic left behind
+   G_DemoHashTic();
 }
 
 //
@@ -3268,6 +3596,12 @@ void G_RecordDemoContinue(const char *in, const char *name)
    if(!(demo_continue_p = G_ReadDemoHeader(demo_continue_p)))
       return;
 
+   continuereader.close();
+   if(demoreadformat == DEMOFORMAT_COMPACT &&
+      !continuereader.open(demo_continue_p,
+                           demolength - size_t(demo_continue_p - demobuffer)))
+      I_Error("G_RecordDemoContinue: corrupt demo stream\n");
+
    netgame = false;
    singledemo = true;
    G_RecordDemo(name);
@@ -3604,12 +3938,20 @@ void G_BeginRecording()
 {
    int i;
 
+   demohashes.makeEmpty();
+   demohashrecord  = false;
+   demowriteformat = DEMOFORMAT_RAW;
+   numdemoticcmds  = 0;
+
    // haleyjd 02/21/10: -vanilla will record v1.9-format demos
+   // (without a state hash footer, which other ports would not expect)
    if(M_CheckParm("-vanilla") || demo_version < 200)
    {
       G_BeginRecordingOld();
       return;
    }
+
+   demohashrecord = true;
    
    byte start[256], *demo_p = start;
 
@@ -3627,7 +3969,17 @@ void G_BeginRecording()
    *demo_p++ = eedemosig[2]; //'B';
    *demo_p++ = eedemosig[3]; //'F';
    *demo_p++ = eedemosig[4]; //0xe6;
-   *demo_p++ = '\0';
+
+   // tic stream format, which was always 0
+   if(demo_compact)
+   {
+      // the chunks carry their own state hashes; a per-tic footer would be
+      // about as large as the compressed stream
+      demowriteformat = DEMOFORMAT_COMPACT;
+      demohashrecord  = false;
+      demowriter.begin();
+   }
+   *demo_p++ = byte(demowriteformat);
    
    // haleyjd: write appropriate version and subversion numbers
    // write the WHOLE version number :P
@@ -3731,13 +4083,20 @@ bool G_CheckDemoStatus()
    {
       demorecording = false;
 
+      if(demowriteformat == DEMOFORMAT_COMPACT && !demowriter.finish(demofp))
+         I_Error("G_CheckDemoStatus: error writing demo\n");
       demofp.writeUint8(DEMOMARKER);
+      if(demohashrecord)
+         G_writeDemoHashes();
       demofp.close();
 
       I_ExitWithMessage("Demo %s recorded\n", demoname);
       return false;  // killough
    }
 
+   if(demoplayback)
+      G_DemoHashEnd(); // -demoverify: demo played through
+
    if(timingdemo)
    {
       int endtime = i_haltimer.GetRealTime();
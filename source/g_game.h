@@ -38,6 +38,8 @@ int   G_GetMapForName(const char *name);
 
 bool G_Responder(const event_t *ev);
 bool G_CheckDemoStatus();
+size_t G_GetDemoOffset();
+void G_SetDemoOffset(size_t offset, int tic);
 void G_DeathMatchSpawnPlayer(int playernum);
 void G_DeQueuePlayerCorpse(const Mobj *mo);
 void G_ClearPlayerCorpseQueue();
@@ -47,6 +49,7 @@ void G_DeferedInitNewFromDir(skill_t skill, const char *levelname, WadDirectory
 void G_DeferedPlayDemo(const char *demo);
 void G_TimeDemo(const char *name, bool showmenu);
 void G_LoadGame(const char *name, int slot, bool is_command); // killough 5/15/98
+void G_LoadGameFromMemory(const byte *data, size_t size);
 void G_ForcedLoadGame();                      // killough 5/15/98: forced loadgames
 void G_SaveGame(int slot, const char *description); // Called by M_Responder.
 void G_RecordDemo(const char *name);                // Only called by startup code.
@@ -111,6 +114,7 @@ extern int mouseb_dblc2;  // causes a use action
 extern int  defaultskill;     // jff 3/24/98 default skill
 extern bool haswolflevels;    // jff 4/18/98 wolf levels present
 extern bool demorecording;    // killough 12/98
+extern int  demotic;          // tics read from the demo being played
 extern bool forced_loadgame;
 extern bool command_loadgame;
 extern char gamemapname[9];
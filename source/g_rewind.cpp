@@ -0,0 +1,324 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Rewind buffer and demo seeking.
+//
+// While a level is being played, a compressed snapshot of it is taken every
+// few seconds and kept in a small ring buffer. The "rewind" command puts the
+// level back to one of them, and during demo playback "demo_seek" uses them
+// to jump backward, then runs the game forward at full speed to reach the
+// requested tic. The buffer only covers the level in play; it is emptied at
+// every level setup.
+//
+// Snapshots cost a hitch on big levels, so they are only taken in ordinary
+// play when rewind_slots is set. Demo playback always keeps a buffer, so that
+// demos can be sought.
+//
+//----------------------------------------------------------------------------
+
+#include "z_zone.h"
+#include "i_system.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "g_rewind.h"
+#include "m_buffer.h"
+#include "p_saveg.h"
+#include "v_misc.h"
+#include "../zlib/zlib.h"
+
+#define MAXREWINDSLOTS  128
+#define DEMOREWINDSLOTS 24  // kept during demo playback when rewind_slots is 0
+
+struct rewindslot_t
+{
+   byte   *data;       // compressed snapshot
+   size_t  size;       // compressed size
+   size_t  rawsize;    // uncompressed size
+   int     leveltime;  // leveltime when it was taken
+   int     demotic;    // demo tics read by then
+   size_t  demooffset; // demo read position by then
+};
+
+int rewind_interval = 5*TICRATE;
+int rewind_slots    = 0;
+
+static rewindslot_t rewindbuffer[MAXREWINDSLOTS];
+static int rewindhead;        // next slot to be written
+static int rewindcount;       // number of valid slots
+static int rewindsize;        // slots in the ring, fixed while it holds any
+static int lastsnaptime = -1; // leveltime of the newest snapshot
+static int restoreslot  = -1; // slot to restore at the end of the tic
+static int seektarget   = -1; // demo tic being sought, if >= 0
+
+//
+// Returns the slot that is i'th from the oldest one.
+//
+static rewindslot_t &G_rewindSlot(int i)
+{
+   return rewindbuffer[(rewindhead - rewindcount + i + rewindsize) % rewindsize];
+}
+
+//
+// G_ClearRewind
+//
+// Throws away all snapshots. Called at level setup, since snapshots can only
+// be restored on the level they were taken from.
+//
+void G_ClearRewind()
+{
+   for(rewindslot_t &slot : rewindbuffer)
+   {
+      efree(slot.data);
+      slot.data = nullptr;
+   }
+
+   rewindhead    = 0;
+   rewindcount   = 0;
+   lastsnaptime  = -1;
+   restoreslot   = -1;
+}
+
+//
+// Drops the newest snapshots, keeping count of them.
+//
+static void G_truncateRewind(int count)
+{
+   while(rewindcount > count)
+   {
+      rewindslot_t &slot = G_rewindSlot(rewindcount - 1);
+
+      efree(slot.data);
+      slot.data = nullptr;
+
+      rewindhead = (rewindhead + rewindsize - 1) % rewindsize;
+      --rewindcount;
+   }
+}
+
+//
+// Takes a snapshot of the level into the next slot of the ring.
+//
+static void G_takeSnapshot()
+{
+   OutBuffer buf;
+
+   buf.createMemory(256*1024, OutBuffer::NENDIAN);
+   P_SaveSnapshot(buf);
+
+   uLong  rawsize = static_cast<uLong>(buf.getMemorySize());
+   uLongf complen = compressBound(rawsize);
+   byte  *comp    = emalloc(byte *, complen);
+
+   if(compress2(comp, &complen, buf.getMemory(), rawsize, Z_BEST_SPEED) != Z_OK)
+      I_Error("G_takeSnapshot: compression failed\n");
+
+   buf.close();
+
+   rewindslot_t &slot = rewindbuffer[rewindhead];
+
+   efree(slot.data); // overwriting the oldest one, once the ring is full
+   slot.data       = erealloc(byte *, comp, complen);
+   slot.size       = complen;
+   slot.rawsize    = rawsize;
+   slot.leveltime  = leveltime;
+   slot.demotic    = demotic;
+   slot.demooffset = G_GetDemoOffset();
+
+   rewindhead = (rewindhead + 1) % rewindsize;
+   if(rewindcount < rewindsize)
+      ++rewindcount;
+
+   lastsnaptime = leveltime;
+}
+
+//
+// Puts the level back to the i'th oldest snapshot, dropping all newer ones.
+//
+static void G_restoreSnapshot(int i)
+{
+   rewindslot_t &slot = G_rewindSlot(i);
+   uLongf rawlen = static_cast<uLongf>(slot.rawsize);
+   byte  *raw    = emalloc(byte *, rawlen);
+   InBuffer buf;
+
+   if(uncompress(raw, &rawlen, slot.data, static_cast<uLong>(slot.size)) != Z_OK ||
+      rawlen != slot.rawsize)
+   {
+      I_Error("G_restoreSnapshot: snapshot is corrupt\n");
+   }
+
+   buf.openMemory(raw, rawlen, InBuffer::NENDIAN);
+   P_LoadSnapshot(buf);
+   buf.close();
+   efree(raw);
+
+   if(demoplayback)
+      G_SetDemoOffset(slot.demooffset, slot.demotic);
+
+   lastsnaptime = slot.leveltime;
+   G_truncateRewind(i + 1);
+}
+
+//
+// G_RewindTicker
+//
+// Called at the end of every gametic. Carries out a pending restore, and takes
+// a new snapshot once enough time has passed since the last one. Restores are
+// put off until here so that the level never changes under a running tic.
+//
+void G_RewindTicker()
+{
+   int slots = rewind_slots ? rewind_slots : demoplayback ? DEMOREWINDSLOTS : 0;
+
+   if(gamestate != GS_LEVEL || netgame || demorecording)
+      return;
+
+   if(!slots)
+   {
+      // a demo that was being played has ended
+      if(rewindcount)
+         G_ClearRewind();
+      return;
+   }
+
+   if(restoreslot >= 0)
+   {
+      int i = restoreslot;
+
+      restoreslot = -1;
+      if(i < rewindcount)
+      {
+         G_restoreSnapshot(i);
+         return;
+      }
+   }
+
+   if(!rewindcount || leveltime - lastsnaptime >= rewind_interval)
+   {
+      if(!rewindcount)
+         rewindsize = slots;
+      G_takeSnapshot();
+   }
+}
+
+//
+// G_RewindSeeking
+//
+// Returns true while a demo_seek is fast-forwarding the demo. The game loop
+// runs tics as fast as it can for as long as this holds.
+//
+bool G_RewindSeeking()
+{
+   if(seektarget < 0 || (paused & 2))
+      return false;
+
+   // a pending restore still has to move the demo back first
+   if(!demoplayback || (restoreslot < 0 && demotic >= seektarget))
+   {
+      seektarget = -1;
+      return false;
+   }
+
+   return true;
+}
+
+//=============================================================================
+//
+// Console Commands
+//
+
+VARIABLE_INT(rewind_interval, NULL, TICRATE, 60*TICRATE, NULL);
+CONSOLE_VARIABLE(rewind_interval, rewind_interval, 0) {}
+
+VARIABLE_INT(rewind_slots, NULL, 0, MAXREWINDSLOTS, NULL);
+CONSOLE_VARIABLE(rewind_slots, rewind_slots, 0)
+{
+   // the ring is laid out by its size, so start over
+   G_ClearRewind();
+}
+
+CONSOLE_COMMAND(rewind, cf_notnet)
+{
+   if(gamestate != GS_LEVEL || !rewindcount)
+   {
+      C_Printf(FC_ERROR "Nothing to rewind to\n");
+      return;
+   }
+
+   if(demorecording)
+   {
+      C_Printf(FC_ERROR "Cannot rewind while recording a demo\n");
+      return;
+   }
+
+   // when the newest snapshot was only just taken, go one further back
+   if(rewindcount > 1 &&
+      leveltime - G_rewindSlot(rewindcount - 1).leveltime < TICRATE)
+      restoreslot = rewindcount - 2;
+   else
+      restoreslot = rewindcount - 1;
+}
+
+CONSOLE_COMMAND(demo_seek, cf_notnet)
+{
+   int target;
+
+   if(Console.argc < 1)
+   {
+      C_Printf("usage: demo_seek tic\n");
+      return;
+   }
+
+   if(!demoplayback)
+   {
+      C_Printf(FC_ERROR "Not playing a demo\n");
+      return;
+   }
+
+   if((target = Console.argv[0]->toInt()) < 0)
+      target = 0;
+
+   if(target < demotic)
+   {
+      int i = rewindcount - 1;
+
+      // find the newest snapshot at or before the target
+      while(i >= 0 && G_rewindSlot(i).demotic > target)
+         --i;
+
+      if(gamestate != GS_LEVEL || i < 0)
+      {
+         C_Printf(FC_ERROR "Tic %d is no longer buffered\n", target);
+         return;
+      }
+
+      // fast-forward from the snapshot once it has been restored
+      restoreslot = i;
+      seektarget  = target > G_rewindSlot(i).demotic ? target : -1;
+   }
+   else
+      seektarget = target > demotic ? target : -1;
+}
+
+// EOF
+
@@ -0,0 +1,38 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Rewind buffer and demo seeking.
+//
+//----------------------------------------------------------------------------
+
+#ifndef G_REWIND_H__
+#define G_REWIND_H__
+
+extern int rewind_interval; // tics between snapshots
+extern int rewind_slots;    // number of snapshots kept; 0 = demos only
+
+void G_ClearRewind();
+void G_RewindTicker();
+bool G_RewindSeeking();
+
+#endif
+
+// EOF
+
@@ -52,7 +52,7 @@ void BufferedFileBase::initBuffer(size_t pLen, int pEndian)
 //
 long BufferedFileBase::tell()
 {
-   return ftell(f);
+   return memory ? static_cast<long>(idx) : ftell(f);
 }
 
 //
@@ -76,6 +76,7 @@ void BufferedFileBase::close()
    }
 
    ownFile = false;
+   memory  = false;
 }
 
 //
@@ -173,13 +174,30 @@ bool OutBuffer::createFile(const char *filename, size_t pLen, int pEndian)
    return true;
 }
 
+//
+// Sets up the buffer to accumulate output in memory. The buffer starts out at
+// the length given in pLen and doubles in size whenever it fills up.
+//
+bool OutBuffer::createMemory(size_t pLen, int pEndian)
+{
+   initBuffer(pLen ? pLen : 1024, pEndian);
+
+   memory = true;
+
+   return true;
+}
+
 //
 // Call to flush the contents of the buffer to the output file. This will be
 // called automatically before the file is closed, but must be called explicitly
 // if a current file offset is needed. Returns false if an IO error occurs.
+// Does nothing in memory mode.
 //
 bool OutBuffer::flush()
 {
+   if(memory)
+      return true;
+
    if(idx)
    {
       if(fwrite(buffer, sizeof(byte), idx, f) < idx)
@@ -203,7 +221,7 @@ void OutBuffer::close()
 {
    try
    {
-     if(f)
+     if(f && !memory)
         flush();
    }
    catch(...)
@@ -213,6 +231,22 @@ void OutBuffer::close()
    BufferedFileBase::close();
 }
 
+//
+// Called when the buffer is full. Flushes it to the file, or in memory mode,
+// grows it so that writing can continue.
+//
+bool OutBuffer::makeRoom()
+{
+   if(!memory)
+      return flush();
+
+   size_t newlen = len * 2;
+   buffer = erealloc(byte *, buffer, newlen);
+   len    = newlen;
+
+   return true;
+}
+
 //
 // Buffered writing function.
 //
@@ -228,9 +262,9 @@ bool OutBuffer::write(const void *data, size_t size)
       
       if(!lWriteAmt)
       {
-         if(!flush())
+         if(!makeRoom())
             return false;
-         lWriteAmt = len;
+         lWriteAmt = len - idx;
       }
 
       if(lBytesToWrite < lWriteAmt)
@@ -308,7 +342,7 @@ bool OutBuffer::writeUint8(uint8_t num)
 {     
    if(idx == len)
    {
-      if(!flush())
+      if(!makeRoom())
          return false;
    }
 
@@ -362,11 +396,63 @@ bool InBuffer::openExisting(FILE *pf, int pEndian)
    return true;
 }
 
+//
+// Attach the input buffer to a block of memory. The data is not copied, so it
+// must outlive the buffer.
+//
+bool InBuffer::openMemory(const void *data, size_t size, int pEndian)
+{
+   if(!data)
+      return false;
+
+   readmem = static_cast<const byte *>(data);
+   len     = size;
+   idx     = 0;
+   endian  = pEndian;
+   memory  = true;
+   ownFile = false;
+
+   return true;
+}
+
+//
+// Overrides BufferedFileBase::close
+// Detaches from any memory block in addition to closing the file.
+//
+void InBuffer::close()
+{
+   readmem = nullptr;
+   BufferedFileBase::close();
+}
+
 //
 // Seeks inside the file via fseek, and then clears the internal buffer.
 //
 int InBuffer::seek(long offset, int origin)
 {
+   if(memory)
+   {
+      long base;
+
+      switch(origin)
+      {
+      case SEEK_CUR:
+         base = static_cast<long>(idx);
+         break;
+      case SEEK_END:
+         base = static_cast<long>(len);
+         break;
+      default:
+         base = 0;
+         break;
+      }
+      if(base + offset < 0 || base + offset > static_cast<long>(len))
+         return -1;
+
+      idx = static_cast<size_t>(base + offset);
+      return 0;
+   }
+
    return fseek(f, offset, origin);
 }
 
@@ -376,6 +462,20 @@ int InBuffer::seek(long offset, int origin)
 //
 size_t InBuffer::read(void *dest, size_t size)
 {
+   if(memory)
+   {
+      size_t avail = len - idx;
+      if(size > avail)
+      {
+         if(throwing)
+            throw BufferedIOException("read past end of memory buffer");
+         size = avail;
+      }
+      memcpy(dest, readmem + idx, size);
+      idx += size;
+      return size;
+   }
+
    return fread(dest, 1, size, f);
 }
 
@@ -384,6 +484,9 @@ size_t InBuffer::read(void *dest, size_t size)
 //
 int InBuffer::skip(size_t skipAmt)
 {
+   if(memory)
+      return seek(static_cast<long>(skipAmt), SEEK_CUR);
+
    return fseek(f, static_cast<long>(skipAmt), SEEK_CUR);
 }
 
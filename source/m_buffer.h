@@ -62,13 +62,14 @@ protected:
    int endian;    // endianness indicator
    bool throwing; // throws exceptions on IO errors
    bool ownFile;  // buffer owns the file
+   bool memory;   // operates on a memory block rather than a file
    
    void initBuffer(size_t pLen, int pEndian);
 
 public:
    BufferedFileBase() 
       : f(nullptr), buffer(nullptr), len(0), idx(0), endian(0), throwing(false),
-        ownFile(false)
+        ownFile(false), memory(false)
    {
    }
 
@@ -94,6 +95,7 @@ public:
 
    void setThrowing(bool val) { throwing = val;  }
    bool getThrowing() const   { return throwing; }
+   bool isMemory() const      { return memory;   }
 
    // endianness values
    enum
@@ -107,15 +109,25 @@ public:
 //
 // OutBuffer
 //
-// Buffered binary file output.
+// Buffered binary file output. May also target a growable block of memory,
+// in which case nothing is written anywhere until the owner takes the data.
 //
 class OutBuffer : public BufferedFileBase
 {
+protected:
+   bool makeRoom();
+
 public:
    bool createFile(const char *filename, size_t pLen, int pEndian);
+   bool createMemory(size_t pLen, int pEndian);
    bool flush();
    void close();
 
+   // Memory mode accessors
+   const byte *getMemory() const     { return buffer; }
+   size_t      getMemorySize() const { return idx;    }
+   void        resetMemory()         { if(memory) idx = 0; }
+
    bool write(const void *data, size_t size);
    bool writeSint64(int64_t  num);
    bool writeUint64(uint64_t num);
@@ -130,17 +142,23 @@ public:
 //
 // InBuffer
 //
-// Buffered binary file input.
+// Buffered binary file input. May also read from a block of memory owned by
+// the caller, which must remain valid until the buffer is closed.
 //
 class InBuffer : public BufferedFileBase
 {
+protected:
+   const byte *readmem; // source data in memory mode
+
 public:
-   InBuffer() : BufferedFileBase()
+   InBuffer() : BufferedFileBase(), readmem(nullptr)
    {
    }
 
    bool openFile(const char *filename, int pEndian);
    bool openExisting(FILE *f, int pEndian);
+   bool openMemory(const void *data, size_t size, int pEndian);
+   void close();
 
    int    seek(long offset, int origin);
    size_t read(void *dest, size_t size);
@@ -118,6 +118,16 @@ const int BANKS_MAX = (adl_getBanksCount() - 1);
 // haleyjd 10/09/07: wipe waiting
 extern int wipewait;
 
+extern int hub_memlimit;
+
+extern int rewind_interval;
+extern int rewind_slots;
+
+extern bool demo_compact;
+
+extern bool p_sightbatch;
+extern bool p_parallelclip;
+
 //jff 3/3/98 added min, max, and help string to all entries
 //jff 4/10/98 added isstr field to specify whether value is string or int
 //
@@ -843,6 +853,24 @@ default_t defaults[] =
    
    DEFAULT_INT("wipetype",&wipetype, NULL, 1, 0, 2, default_t::wad_yes,
                "0 = none, 1 = melt, 2 = fade"),
+
+   DEFAULT_INT("hub_memlimit", &hub_memlimit, NULL, 32, 0, 1024, default_t::wad_no,
+               "megabytes of saved hub levels kept in memory before spilling to disk"),
+
+   DEFAULT_INT("rewind_interval", &rewind_interval, NULL, 175, 35, 2100, default_t::wad_no,
+               "tics between snapshots kept for rewinding"),
+
+   DEFAULT_INT("rewind_slots", &rewind_slots, NULL, 0, 0, 128, default_t::wad_no,
+               "number of rewind snapshots kept (0 = only during demo playback)"),
+
+   DEFAULT_BOOL("demo_compact", &demo_compact, NULL, false, default_t::wad_no,
+                "1 to record demos in the compact, compressed format"),
+
+   DEFAULT_BOOL("p_sightbatch", &p_sightbatch, NULL, false, default_t::wad_no,
+                "1 to check monster sight ahead of time on worker threads"),
+
+   DEFAULT_BOOL("p_parallelclip", &p_parallelclip, NULL, false, default_t::wad_no,
+                "1 to clip things against lines on worker threads when sectors move"),
    
 #ifdef HAVE_SPCLIB
    DEFAULT_INT("snd_spcpreamp", &spc_preamp, NULL, 1, 1, 6, default_t::wad_yes,
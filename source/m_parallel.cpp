@@ -0,0 +1,161 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: worker threads for data-parallel jobs.
+//
+// M_ParallelFor runs a function over a range of indices, spread across a
+// pool of worker threads and the calling thread, and returns once all of
+// them are done. Only the main thread may start jobs. The jobs must not
+// change any game state besides their own outputs; the zone heap is made
+// safe for plain allocations while they run.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "z_zone.h"
+#include "m_argv.h"
+#include "m_parallel.h"
+
+#define MAXWORKERS 16
+
+static int  numworkers = -1; // not started yet
+
+static std::mutex              jobmutex;
+static std::condition_variable jobstart;
+static std::condition_variable jobdone;
+static unsigned int            jobserial;  // changes for every job
+static int                     jobbusy;    // workers still on the job
+
+static void           (*jobfunc)(int, void *);
+static void            *jobdata;
+static int              jobcount;
+static std::atomic<int> jobnext;
+
+//
+// Takes indices of the current job until there are none left
+//
+static void M_runJob()
+{
+   int index;
+
+   while((index = jobnext++) < jobcount)
+      jobfunc(index, jobdata);
+}
+
+//
+// Main loop of a worker thread
+//
+static void M_workerLoop()
+{
+   unsigned int serial = 0;
+
+   while(1)
+   {
+      {
+         std::unique_lock<std::mutex> lock(jobmutex);
+         jobstart.wait(lock, [&serial] { return jobserial != serial; });
+         serial = jobserial;
+      }
+
+      M_runJob();
+
+      std::lock_guard<std::mutex> lock(jobmutex);
+      if(!--jobbusy)
+         jobdone.notify_one();
+   }
+}
+
+//
+// M_ParallelWorkers
+//
+// Returns the number of worker threads, starting them on first use. There
+// is one less than the number of hardware threads, unless -workers says
+// otherwise; 0 means all jobs run on the calling thread.
+//
+int M_ParallelWorkers()
+{
+   if(numworkers >= 0)
+      return numworkers;
+
+   int p;
+
+   if((p = M_CheckParm("-workers")) && p < myargc - 1)
+      numworkers = atoi(myargv[p + 1]);
+   else
+      numworkers = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+
+   if(numworkers < 0)
+      numworkers = 0;
+   if(numworkers > MAXWORKERS)
+      numworkers = MAXWORKERS;
+
+   // the threads idle for the rest of the program, and die with it
+   for(int i = 0; i < numworkers; i++)
+      std::thread(M_workerLoop).detach();
+
+   return numworkers;
+}
+
+//
+// M_ParallelFor
+//
+// Calls func(index, data) for every index below count, in no particular
+// order and possibly at the same time.
+//
+void M_ParallelFor(int count, void (*func)(int index, void *data), void *data)
+{
+   if(count <= 0)
+      return;
+
+   if(count == 1 || !M_ParallelWorkers())
+   {
+      for(int i = 0; i < count; i++)
+         func(i, data);
+      return;
+   }
+
+   Z_SetThreaded(true);
+
+   {
+      std::lock_guard<std::mutex> lock(jobmutex);
+      jobfunc  = func;
+      jobdata  = data;
+      jobcount = count;
+      jobnext  = 0;
+      jobbusy  = numworkers;
+      ++jobserial;
+   }
+   jobstart.notify_all();
+
+   M_runJob();
+
+   {
+      std::unique_lock<std::mutex> lock(jobmutex);
+      jobdone.wait(lock, [] { return jobbusy == 0; });
+   }
+
+   Z_SetThreaded(false);
+}
+
+// EOF
+
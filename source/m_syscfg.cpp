@@ -241,6 +241,9 @@ static default_t sysdefaults[] =
    DEFAULT_BOOL("d_interpolate", &d_interpolate, NULL, true, default_t::wad_no,
                 "1 to activate frame interpolation (smooth rendering)"),
 
+   DEFAULT_BOOL("d_predict", &d_predict, NULL, false, default_t::wad_no,
+                "1 to predict your own movement in netgames"),
+
    DEFAULT_BOOL("i_forcefeedback", &i_forcefeedback, NULL, true, default_t::wad_no,
                 "1 to enable force feedback through gamepads where supported"),
 
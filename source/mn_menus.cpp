@@ -3560,6 +3560,7 @@ static menuitem_t mn_function_items[] =
    {it_binding, "End game",             "mn_endgame"},
    {it_binding, "Toggle messages",      "hu_messages /"},
    {it_binding, "Quick load",           "quickload"},
+   {it_binding, "Rewind",               "rewind"},
    {it_binding, "Quit",                 "mn_quit"},
    {it_binding, "Gamma correction",     "gamma /"},
    {it_gap},
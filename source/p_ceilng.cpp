@@ -360,6 +360,8 @@ bool CeilingThinker::reTriggerVerticalDoor(bool player)
 //
 int EV_DoCeiling(const line_t *line, ceiling_e type)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       secnum = -1;
    int       rtn = 0;
    int       noise = CNOISE_NORMAL; // haleyjd 09/28/06
@@ -380,8 +382,10 @@ int EV_DoCeiling(const line_t *line, ceiling_e type)
    }
   
    // affects all sectors with the same tag as the linedef
-   while((secnum = P_FindSectorFromLineArg0(line,secnum)) >= 0)
+   numtagged = P_SectorTagSpan(line->args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
       // if ceiling already moving, don't start a second function on it
@@ -818,6 +822,8 @@ void CeilingWaggleThinker::serialize(SaveArchive &arc)
 int EV_StartCeilingWaggle(const line_t *line, int tag, int height, int speed,
                          int offset, int timer)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       sectorIndex = -1;
    int       retCode = 0;
    bool      manual = false;
@@ -833,8 +839,10 @@ int EV_StartCeilingWaggle(const line_t *line, int tag, int height, int speed,
       goto manual_waggle;
    }
 
-   while((sectorIndex = P_FindSectorFromTag(tag, sectorIndex)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      sectorIndex = tagged[tagpos];
       sector = &sectors[sectorIndex];
 
 manual_waggle:
@@ -335,6 +335,12 @@ CONSOLE_VARIABLE(wipewait, wipewait, 0) {}
 VARIABLE_INT(wipetype, NULL, 0, 2, wipetype_strs);
 CONSOLE_VARIABLE(wipetype, wipetype, 0) {}
 
+// memory budget for hub levels before they spill to disk, in megabytes
+extern int hub_memlimit;
+
+VARIABLE_INT(hub_memlimit, NULL, 0, 1024, NULL);
+CONSOLE_VARIABLE(hub_memlimit, hub_memlimit, 0) {}
+
 void P_Chase_AddCommands(void);
 void P_Skin_AddCommands(void);
 
@@ -328,13 +328,17 @@ bool VerticalDoorThinker::reTriggerVerticalDoor(bool player)
 //
 int EV_DoDoor(const line_t *line, vldoor_e type)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int secnum = -1, rtn = 0;
    sector_t *sec;
    VerticalDoorThinker *door;
 
    // open all doors with the same tag as the activating line
-   while((secnum = P_FindSectorFromLineArg0(line, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(line->args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       // if the ceiling already moving, don't start the door action
       if(P_SectorActive(ceiling_special, sec)) //jff 2/22/98
@@ -51,12 +51,14 @@
 #include "metaapi.h"
 #include "p_anim.h"      // haleyjd
 #include "p_enemy.h"
+#include "p_flowpath.h"
 #include "p_info.h"
 #include "p_inter.h"
 #include "p_map.h"
 #include "p_map3d.h"
 #include "p_maputl.h"
 #include "p_mobjcol.h"
+#include "p_noise.h"
 #include "p_partcl.h"
 #include "p_setup.h"
 #include "p_spec.h"
@@ -82,99 +84,6 @@ static Mobj *current_actor;
 // but some can be made preaware
 //
 
-//
-// P_RecursiveSound
-//
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
-//
-// killough 5/5/98: reformatted, cleaned up
-//
-static void P_RecursiveSound(sector_t *sec, int soundblocks,
-                             Mobj *soundtarget)
-{
-   int i;
-   
-   // wake up all monsters in this sector
-   if(sec->validcount == validcount &&
-      sec->soundtraversed <= soundblocks+1)
-      return;             // already flooded
-
-   sec->validcount = validcount;
-   sec->soundtraversed = soundblocks+1;
-   P_SetTarget<Mobj>(&sec->soundtarget, soundtarget);    // killough 11/98
-
-#ifdef R_LINKEDPORTALS
-   if(sec->f_pflags & PS_PASSSOUND)
-   {
-      // Ok, because the same portal can be used on many sectors and even
-      // lines, the portal structure won't tell you what sector is on the
-      // other side of the portal. SO
-      sector_t *other;
-      line_t *check = sec->lines[0];
-
-      other = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) 
-                             + R_FPLink(sec)->deltax,
-                            ((check->v1->y + check->v2->y) / 2) 
-                             + R_FPLink(sec)->deltay)->sector;
-
-      P_RecursiveSound(other, soundblocks, soundtarget);
-   }
-   
-   if(sec->c_pflags & PS_PASSSOUND)
-   {
-      // Ok, because the same portal can be used on many sectors and even 
-      // lines, the portal structure won't tell you what sector is on the 
-      // other side of the portal. SO
-      sector_t *other;
-      line_t *check = sec->lines[0];
-
-      other = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) 
-                             + R_CPLink(sec)->deltax,
-                            ((check->v1->y + check->v2->y) / 2) 
-                             + R_CPLink(sec)->deltay)->sector;
-
-      P_RecursiveSound(other, soundblocks, soundtarget);
-   }
-#endif
-
-   for(i=0; i<sec->linecount; i++)
-   {
-      sector_t *other;
-      line_t *check = sec->lines[i];
-      
-#ifdef R_LINKEDPORTALS
-      if(check->pflags & PS_PASSSOUND)
-      {
-         sector_t *iother;
-
-         iother = 
-         R_PointInSubsector(((check->v1->x + check->v2->x) / 2) + check->portal->data.link.deltax,
-                            ((check->v1->y + check->v2->y) / 2) + check->portal->data.link.deltay)->sector;
-
-         P_RecursiveSound(iother, soundblocks, soundtarget);
-      }
-#endif
-      if(!(check->flags & ML_TWOSIDED))
-         continue;
-
-      P_LineOpening(check, NULL);
-      
-      if(clip.openrange <= 0)
-         continue;       // closed door
-
-      other=sides[check->sidenum[sides[check->sidenum[0]].sector==sec]].sector;
-      
-      if(!(check->flags & ML_SOUNDBLOCK))
-         P_RecursiveSound(other, soundblocks, soundtarget);
-      else if(!soundblocks)
-         P_RecursiveSound(other, 1, soundtarget);
-   }
-}
-
 //
 // P_NoiseAlert
 //
@@ -183,8 +92,7 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
 //
 void P_NoiseAlert(Mobj *target, Mobj *emitter)
 {
-   validcount++;
-   P_RecursiveSound(emitter->subsector->sector, 0, target);
+   P_PropagateNoise(emitter->subsector->sector, target);
 }
 
 //
@@ -363,7 +271,6 @@ bool P_CheckMissileRange(Mobj *actor)
 static bool P_IsOnLift(const Mobj *actor)
 {
    const sector_t *sec = actor->subsector->sector;
-   line_t line;
 
    // Short-circuit: it's on a lift which is active.
    if(thinker_cast<PlatThinker *>(sec->floordata) != NULL)
@@ -372,10 +279,15 @@ static bool P_IsOnLift(const Mobj *actor)
    // Check to see if it's in a sector which can be 
    // activated as a lift.
    // ioanch 20160303: use args[0]
-   if((line.args[0] = sec->tag))
+   if(sec->tag)
    {
-      for(int l = -1; (l = P_FindLineFromLineArg0(&line, l)) >= 0;)
+      const int *tagged;
+      int numtagged = P_LineTagSpan(sec->tag, tagged);
+
+      for(int i = 0; i < numtagged; i++)
       {
+         int l = tagged[i];
+
          // FIXME: I'm still keeping the old code because I don't know of any MBF
          // demos which can verify all of this. If you're confident you found one,
          // feel free to remove this block.
@@ -877,6 +789,8 @@ void P_NewChaseDir(Mobj *actor)
    // 1) Stay a certain distance away from a friend, to avoid being in their way
    // 2) Take advantage over an enemy without missiles, by keeping distance
 
+   bool towardtarget = true; // not moving away from it
+
    actor->strafecount = 0;
 
    if(demo_version >= 203)
@@ -909,6 +823,7 @@ void P_NewChaseDir(Mobj *actor)
          {
             deltax = -deltax;
             deltay = -deltay;
+            towardtarget = false;
          }
          else
          {
@@ -927,12 +842,17 @@ void P_NewChaseDir(Mobj *actor)
                   actor->strafecount = P_Random(pr_enemystrafe) & 15;
                   deltax = -deltax;
                   deltay = -deltay;
+                  towardtarget = false;
                }
             }
          }
       }
    }
 
+   // head for the next line on the way to a target elsewhere
+   if(towardtarget && actor->flags4 & MF4_FLOWPATH)
+      P_FlowPathDelta(actor, target, deltax, deltay);
+
    P_DoNewChaseDir(actor, deltax, deltay);
 
    // If strafing, set movecount to strafecount so that old Doom
@@ -431,6 +431,8 @@ int EV_FloorCrushStop(const line_t *line, int tag)
 //
 int EV_DoFloor(const line_t *line, floor_e floortype )
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int           secnum;
    int           rtn;
    int           i;
@@ -440,8 +442,10 @@ int EV_DoFloor(const line_t *line, floor_e floortype )
    secnum = -1;
    rtn = 0;
    // move all floors with the same tag as the linedef
-   while((secnum = P_FindSectorFromLineArg0(line,secnum)) >= 0)
+   numtagged = P_SectorTagSpan(line->args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
       // Don't start a second thinker on the same floor
@@ -673,11 +677,10 @@ int EV_DoFloorAndCeiling(const line_t *line, int tag, const floordata_t &fd,
    if(P_LevelIsVanillaHexen())
    {
       // Clear ceilingdata to emulate Hexen bug
-      int secnum = -1;
-      while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
-      {
-         sectors[secnum].ceilingdata = nullptr;
-      }
+      const int *tagged;
+      int numtagged = P_SectorTagSpan(tag, tagged);
+      for(int i = 0; i < numtagged; i++)
+         sectors[tagged[i]].ceilingdata = nullptr;
    }
    int ceiling = EV_DoParamCeiling(line, tag, &cd);
    return floor || ceiling ? 1 : 0;
@@ -696,6 +699,8 @@ int EV_DoFloorAndCeiling(const line_t *line, int tag, const floordata_t &fd,
 //
 int EV_DoChange(const line_t *line, int tag, change_e changetype, bool isParam)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int                   secnum;
    int                   rtn;
    sector_t*             sec;
@@ -717,8 +722,10 @@ int EV_DoChange(const line_t *line, int tag, change_e changetype, bool isParam)
 
    secnum = -1;
    // change all sectors with the same tag as the linedef
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
    manualChange:
       
@@ -1036,6 +1043,8 @@ static bool DonutOverflow(fixed_t *pfloorheight, int16_t *pfloorpic)
 int EV_DoParamDonut(const line_t *line, int tag, bool havespac,
                     fixed_t pspeed, fixed_t sspeed)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    sector_t    *s1, *s2, *s3;
    int          secnum;
    int          rtn;
@@ -1058,8 +1067,10 @@ int EV_DoParamDonut(const line_t *line, int tag, bool havespac,
       goto manual_donut;
    }
    // do function on all sectors with same tag as linedef
-   while(!manual && (secnum = P_FindSectorFromTag(tag,secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; !manual && tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       s1 = &sectors[secnum];                // s1 is pillar's sector
    manual_donut:  // ioanch
       // do not start the donut if the pillar is already moving
@@ -1163,6 +1174,8 @@ int EV_DoElevator
 ( const line_t* line, int tag,
   elevator_e    elevtype, fixed_t speed, fixed_t amount, bool isParam )
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int                   secnum;
    int                   rtn;
    sector_t*             sec;
@@ -1179,8 +1192,10 @@ int EV_DoElevator
       goto manualElevator;
    }
    // act on all sectors with the same tag as the triggering linedef
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
               
    manualElevator:
@@ -1256,6 +1271,8 @@ int EV_DoElevator
 //
 int EV_PillarBuild(const line_t *line, const pillardata_t *pd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    PillarThinker *pillar;
    sector_t *sector;
    int returnval = 0;
@@ -1273,8 +1290,10 @@ int EV_PillarBuild(const line_t *line, const pillardata_t *pd)
       goto manual_pillar;
    }
 
-   while((sectornum = P_FindSectorFromTag(pd->tag, sectornum)) >= 0)
+   numtagged = P_SectorTagSpan(pd->tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      sectornum = tagged[tagpos];
       sector = &sectors[sectornum];
 
 manual_pillar:
@@ -1346,6 +1365,8 @@ manual_pillar:
 //
 int EV_PillarOpen(const line_t *line, const pillardata_t *pd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    PillarThinker *pillar;
    sector_t *sector;
    int returnval = 0;
@@ -1362,8 +1383,10 @@ int EV_PillarOpen(const line_t *line, const pillardata_t *pd)
       goto manual_pillar;
    }
 
-   while((sectornum = P_FindSectorFromTag(pd->tag, sectornum)) >= 0)
+   numtagged = P_SectorTagSpan(pd->tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      sectornum = tagged[tagpos];
       sector = &sectors[sectornum];
 
 manual_pillar:
@@ -1521,6 +1544,8 @@ void FloorWaggleThinker::serialize(SaveArchive &arc)
 int EV_StartFloorWaggle(const line_t *line, int tag, int height, int speed,
                         int offset, int timer)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       sectorIndex = -1;
    int       retCode = 0;
    bool      manual = false;
@@ -1536,8 +1561,10 @@ int EV_StartFloorWaggle(const line_t *line, int tag, int height, int speed,
       goto manual_waggle;
    }
    
-   while((sectorIndex = P_FindSectorFromTag(tag, sectorIndex)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      sectorIndex = tagged[tagpos];
       sector = &sectors[sectorIndex];
 
 manual_waggle:
@@ -0,0 +1,649 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: flow fields over the sector graph, for FLOWPATH monsters.
+//
+// The sectors are the nodes of the graph, and the two-sided lines gathered
+// for them by P_GroupLines are its edges. A flow field is made for the
+// sector a target is in: a shortest path search outward from it gives every
+// sector the line to head for on the way there. Monsters with the FLOWPATH
+// flag chasing a target in another sector aim for that line, instead of
+// straight at the target, and the usual direction picking does the rest.
+//
+// Fields are kept for a few target sectors at a time and shared by all
+// monsters chasing something there. What a field holds is a function of the
+// map alone, never of when it was made: the costs of the lines are kept in a
+// table that is brought up to date before a field is looked at, and a field
+// made earlier is updated for the lines whose cost changed since. Only the
+// paths through those lines are searched again, so doors and lifts moving
+// don't have the whole graph searched over. Where several lines lead equally
+// well, the lowest numbered one is taken, so that an updated field is the
+// same as a new one, and a field thrown out of the cache or lost to a
+// savegame or rewind is made again exactly as it was.
+//
+
+#include "z_zone.h"
+
+#include "doomstat.h"
+#include "e_exdata.h"
+#include "m_collection.h"
+#include "m_compare.h"
+#include "p_map.h"
+#include "p_maputl.h"
+#include "p_mobj.h"
+#include "p_flowpath.h"
+#include "p_sightbatch.h"
+#include "r_defs.h"
+#include "r_portal.h"
+#include "r_state.h"
+
+#define MAXFLOWFIELDS   8
+#define MAXFLOWCHANGES  1024             // changed lines kept for updates
+#define FLOWMINOPENING  (56*FRACUNIT)    // room a walking monster needs
+#define FLOWDOORPENALTY 256              // for lines a monster may open
+
+struct flowfield_t
+{
+   const sector_t *root;     // sector the paths lead to
+   size_t          serial;   // line changes it has been updated for
+   int             lastuse;  // leveltime it was last looked at
+   int            *dist;     // cost of the path from each sector
+   int            *nextline; // line to head for from each sector, or -1
+};
+
+struct flowheapitem_t
+{
+   int dist;
+   int sector;
+};
+
+static flowfield_t flowfields[MAXFLOWFIELDS];
+static PODCollection<flowheapitem_t> flowheap;
+
+// Cost of each line in both directions: front to back, then back to front
+static int          *flowlinecost;
+static byte         *flowopenable;   // line had a special at level start
+static byte         *flowsectormark; // scratch, and sectors that moved
+static unsigned int  flowgeneration; // sightgeneration the costs are good for
+
+static PODCollection<int> flowchanges;  // lines whose cost changed
+static PODCollection<int> flowmoved;    // sectors moved since the last update
+static PODCollection<int> flowaffected; // scratch sector lists
+static PODCollection<int> flowtouched;
+
+enum
+{
+   FLOWMARK_MOVED    = 0x01,
+   FLOWMARK_AFFECTED = 0x02,
+   FLOWMARK_TOUCHED  = 0x04
+};
+
+//
+// P_InitFlowPaths
+//
+// Called at level setup. The arrays of the fields went away with the last
+// level. Whether a line can be opened is taken from the map as it starts out,
+// since specials are cleared by all kinds of things that don't tell us.
+//
+void P_InitFlowPaths()
+{
+   for(flowfield_t &field : flowfields)
+   {
+      field.root     = nullptr;
+      field.dist     = nullptr;
+      field.nextline = nullptr;
+   }
+
+   flowlinecost   = nullptr;
+   flowsectormark = nullptr;
+   flowchanges.makeEmpty();
+   flowmoved.makeEmpty();
+
+   flowopenable = (byte *)(Z_Malloc(numlines + 1, PU_LEVEL, NULL));
+   for(int i = 0; i < numlines; i++)
+      flowopenable[i] = (lines[i].special != 0);
+}
+
+//
+// Returns the cost of walking from sector from into sector to through a line,
+// or -1 if a monster can't get through.
+//
+static int P_flowCost(const line_t *line, const sector_t *from, const sector_t *to)
+{
+   if(!line->backsector || line->extflags & EX_ML_BLOCKALL ||
+      line->flags & (ML_BLOCKING | ML_BLOCKMONSTERS) || line->pflags & PS_PASSABLE)
+      return -1;
+
+   int cost = (P_AproxDistance(line->soundorg.x - from->soundorg.x,
+                               line->soundorg.y - from->soundorg.y) +
+               P_AproxDistance(to->soundorg.x - line->soundorg.x,
+                               to->soundorg.y - line->soundorg.y)) >> FRACBITS;
+   if(cost < 1)
+      cost = 1;
+
+   fixed_t top    = emin(from->ceilingheight, to->ceilingheight);
+   fixed_t bottom = emax(from->floorheight, to->floorheight);
+
+   if(to->floorheight - from->floorheight > STEPSIZE || top - bottom < FLOWMINOPENING)
+   {
+      // a closed door or a raised lift may still be opened by the monster
+      if(!flowopenable[line - lines])
+         return -1;
+      cost += FLOWDOORPENALTY;
+   }
+
+   return cost;
+}
+
+//
+// Cost of a line in the table, going from sector from to the other side
+//
+inline static int P_lineCost(int linenum, const sector_t *from)
+{
+   return flowlinecost[2 * linenum + (lines[linenum].frontsector != from)];
+}
+
+//
+// Works out the costs of a line again, noting it if they changed
+//
+static void P_refreshLineCost(int linenum)
+{
+   const line_t *line = &lines[linenum];
+   int front = -1, back = -1;
+
+   if(line->backsector && line->backsector != line->frontsector)
+   {
+      front = P_flowCost(line, line->frontsector, line->backsector);
+      back  = P_flowCost(line, line->backsector, line->frontsector);
+   }
+
+   if(flowlinecost[2 * linenum] != front || flowlinecost[2 * linenum + 1] != back)
+   {
+      flowlinecost[2 * linenum]     = front;
+      flowlinecost[2 * linenum + 1] = back;
+      flowchanges.add(linenum);
+   }
+}
+
+//
+// P_FlowPathSectorMoved
+//
+// Called when the floor or ceiling of a sector has moved, right after the
+// sight generation was bumped for it, so that only its lines need to be
+// looked at again. Anything else that bumps the generation has all of the
+// lines looked at.
+//
+void P_FlowPathSectorMoved(const sector_t *sec)
+{
+   if(!flowlinecost || flowgeneration != sightgeneration - 1)
+      return;
+
+   flowgeneration = sightgeneration;
+
+   int secnum = eindex(sec - sectors);
+   if(!(flowsectormark[secnum] & FLOWMARK_MOVED))
+   {
+      flowsectormark[secnum] |= FLOWMARK_MOVED;
+      flowmoved.add(secnum);
+   }
+}
+
+//
+// Brings the line cost table up to date with the map
+//
+static void P_updateFlowCosts()
+{
+   if(!flowlinecost)
+   {
+      // freed with the level, which leaves them null for P_FlowPathSectorMoved
+      flowlinecost   = (int *)(Z_Malloc(2 * (numlines + 1) * sizeof(int), PU_LEVEL,
+                                        (void **)&flowlinecost));
+      flowsectormark = (byte *)(Z_Calloc(numsectors + 1, 1, PU_LEVEL,
+                                         (void **)&flowsectormark));
+      for(int i = 0; i < 2 * numlines; i++)
+         flowlinecost[i] = -1;
+      flowgeneration = sightgeneration - 1; // look at everything
+   }
+
+   if(flowgeneration != sightgeneration)
+   {
+      for(int i = 0; i < numlines; i++)
+         P_refreshLineCost(i);
+   }
+   else
+   {
+      for(int secnum : flowmoved)
+      {
+         const sector_t *sec = &sectors[secnum];
+
+         for(int i = 0; i < sec->linecount; i++)
+            P_refreshLineCost(eindex(sec->lines[i] - lines));
+      }
+   }
+
+   for(int secnum : flowmoved)
+      flowsectormark[secnum] &= ~FLOWMARK_MOVED;
+   flowmoved.makeEmpty();
+   flowgeneration = sightgeneration;
+}
+
+//
+// Heap of sectors still to be reached, by path cost
+//
+static void P_flowHeapPush(int dist, int sector)
+{
+   size_t i = flowheap.getLength();
+
+   flowheap.add({ dist, sector });
+   while(i > 0)
+   {
+      size_t parent = (i - 1) / 2;
+
+      if(flowheap[parent].dist <= flowheap[i].dist)
+         break;
+      flowheapitem_t temp = flowheap[parent];
+      flowheap[parent] = flowheap[i];
+      flowheap[i] = temp;
+      i = parent;
+   }
+}
+
+static flowheapitem_t P_flowHeapPop()
+{
+   flowheapitem_t top  = flowheap[0];
+   flowheapitem_t last = flowheap.pop();
+   size_t length = flowheap.getLength();
+   size_t i = 0;
+
+   if(!length)
+      return top;
+   flowheap[0] = last;
+
+   while(1)
+   {
+      size_t child = 2 * i + 1;
+
+      if(child >= length)
+         break;
+      if(child + 1 < length && flowheap[child + 1].dist < flowheap[child].dist)
+         ++child;
+      if(flowheap[i].dist <= flowheap[child].dist)
+         break;
+      flowheapitem_t temp = flowheap[child];
+      flowheap[child] = flowheap[i];
+      flowheap[i] = temp;
+      i = child;
+   }
+
+   return top;
+}
+
+//
+// Returns the sector on the other side of a line
+//
+inline static const sector_t *P_flowOtherSide(const line_t *line, const sector_t *sec)
+{
+   return line->frontsector == sec ? line->backsector : line->frontsector;
+}
+
+//
+// Runs the search until the heap is empty, noting the sectors whose cost
+// went down in flowtouched. The paths are searched backward, from where they
+// lead.
+//
+static void P_runFlowSearch(flowfield_t &field)
+{
+   while(flowheap.getLength())
+   {
+      flowheapitem_t item = P_flowHeapPop();
+      const sector_t *to = &sectors[item.sector];
+
+      if(item.dist > field.dist[item.sector])
+         continue; // reached more cheaply already
+
+      for(int i = 0; i < to->linecount; i++)
+      {
+         const line_t   *line = to->lines[i];
+         const sector_t *from = P_flowOtherSide(line, to);
+         if(!from || from == to)
+            continue;
+
+         int cost = P_lineCost(eindex(line - lines), from);
+         if(cost < 0)
+            continue;
+
+         int fromnum = eindex(from - sectors);
+         if(item.dist + cost < field.dist[fromnum])
+         {
+            field.dist[fromnum] = item.dist + cost;
+            P_flowHeapPush(field.dist[fromnum], fromnum);
+            if(!(flowsectormark[fromnum] & FLOWMARK_TOUCHED))
+            {
+               flowsectormark[fromnum] |= FLOWMARK_TOUCHED;
+               flowtouched.add(fromnum);
+            }
+         }
+      }
+   }
+}
+
+//
+// Picks the line to head for from a sector: the lowest numbered one through
+// which the cost of the sector is met.
+//
+static void P_pickNextLine(flowfield_t &field, int secnum)
+{
+   const sector_t *sec = &sectors[secnum];
+   int best = -1;
+
+   if(field.dist[secnum] != D_MAXINT && sec != field.root)
+   {
+      for(int i = 0; i < sec->linecount; i++)
+      {
+         const line_t   *line = sec->lines[i];
+         const sector_t *to   = P_flowOtherSide(line, sec);
+         if(!to || to == sec)
+            continue;
+
+         int linenum = eindex(line - lines);
+         int cost    = P_lineCost(linenum, sec);
+         int todist  = field.dist[eindex(to - sectors)];
+
+         if(cost >= 0 && todist != D_MAXINT && todist + cost == field.dist[secnum] &&
+            (best < 0 || linenum < best))
+            best = linenum;
+      }
+   }
+
+   field.nextline[secnum] = best;
+}
+
+//
+// Picks the lines again for a sector and the sectors next to it
+//
+static void P_repickAround(flowfield_t &field, int secnum)
+{
+   const sector_t *sec = &sectors[secnum];
+
+   P_pickNextLine(field, secnum);
+   for(int i = 0; i < sec->linecount; i++)
+   {
+      const sector_t *other = P_flowOtherSide(sec->lines[i], sec);
+      if(other && other != sec)
+         P_pickNextLine(field, eindex(other - sectors));
+   }
+}
+
+//
+// Finds the paths from every sector to the root of a field
+//
+static void P_makeFlowField(flowfield_t &field)
+{
+   if(!field.dist)
+   {
+      field.dist     = (int *)(Z_Malloc(numsectors * sizeof(int), PU_LEVEL, NULL));
+      field.nextline = (int *)(Z_Malloc(numsectors * sizeof(int), PU_LEVEL, NULL));
+   }
+
+   for(int i = 0; i < numsectors; i++)
+      field.dist[i] = D_MAXINT;
+
+   int rootnum = eindex(field.root - sectors);
+   field.dist[rootnum] = 0;
+   flowheap.makeEmpty();
+   flowtouched.makeEmpty();
+   P_flowHeapPush(0, rootnum);
+   P_runFlowSearch(field);
+
+   for(int secnum : flowtouched)
+      flowsectormark[secnum] &= ~FLOWMARK_TOUCHED;
+   flowtouched.makeEmpty();
+
+   for(int i = 0; i < numsectors; i++)
+      P_pickNextLine(field, i);
+
+   field.serial = flowchanges.getLength();
+}
+
+//
+// Brings a field up to date with the lines whose cost changed since it was
+// last looked at. Sectors whose path led through such a line, and the ones
+// whose path led through those, are searched again from their neighbours;
+// sectors a cheaper line now helps are searched onward from it.
+//
+static void P_updateFlowField(flowfield_t &field)
+{
+   size_t numchanges = flowchanges.getLength();
+
+   flowaffected.makeEmpty();
+   flowtouched.makeEmpty();
+   flowheap.makeEmpty();
+
+   // sectors heading through a changed line
+   for(size_t c = field.serial; c < numchanges; c++)
+   {
+      const line_t *line = &lines[flowchanges[c]];
+      const sector_t *sides[2] = { line->frontsector, line->backsector };
+
+      for(const sector_t *side : sides)
+      {
+         if(!side)
+            continue;
+         int secnum = eindex(side - sectors);
+         if(field.nextline[secnum] == flowchanges[c] &&
+            !(flowsectormark[secnum] & FLOWMARK_AFFECTED))
+         {
+            flowsectormark[secnum] |= FLOWMARK_AFFECTED;
+            flowaffected.add(secnum);
+         }
+      }
+   }
+
+   // and those heading through them
+   for(size_t a = 0; a < flowaffected.getLength(); a++)
+   {
+      const sector_t *sec = &sectors[flowaffected[a]];
+
+      for(int i = 0; i < sec->linecount; i++)
+      {
+         const line_t   *line  = sec->lines[i];
+         const sector_t *other = P_flowOtherSide(line, sec);
+         if(!other || other == sec)
+            continue;
+
+         int othernum = eindex(other - sectors);
+         if(field.nextline[othernum] == eindex(line - lines) &&
+            !(flowsectormark[othernum] & FLOWMARK_AFFECTED))
+         {
+            flowsectormark[othernum] |= FLOWMARK_AFFECTED;
+            flowaffected.add(othernum);
+         }
+      }
+   }
+
+   for(int secnum : flowaffected)
+      field.dist[secnum] = D_MAXINT;
+
+   // start them off from the neighbours that kept their paths
+   for(int secnum : flowaffected)
+   {
+      const sector_t *sec = &sectors[secnum];
+
+      for(int i = 0; i < sec->linecount; i++)
+      {
+         const sector_t *to = P_flowOtherSide(sec->lines[i], sec);
+         if(!to || to == sec)
+            continue;
+
+         int cost   = P_lineCost(eindex(sec->lines[i] - lines), sec);
+         int todist = field.dist[eindex(to - sectors)];
+         if(cost >= 0 && todist != D_MAXINT && todist + cost < field.dist[secnum])
+            field.dist[secnum] = todist + cost;
+      }
+      if(field.dist[secnum] != D_MAXINT)
+         P_flowHeapPush(field.dist[secnum], secnum);
+   }
+
+   // lines which got cheaper may give shorter paths
+   for(size_t c = field.serial; c < numchanges; c++)
+   {
+      const line_t *line = &lines[flowchanges[c]];
+
+      for(int dir = 0; dir < 2; dir++)
+      {
+         const sector_t *from = dir ? line->backsector : line->frontsector;
+         const sector_t *to   = dir ? line->frontsector : line->backsector;
+         if(!from || !to || from == to)
+            continue;
+
+         int cost    = flowlinecost[2 * flowchanges[c] + dir];
+         int fromnum = eindex(from - sectors);
+         int todist  = field.dist[eindex(to - sectors)];
+         if(cost >= 0 && todist != D_MAXINT && todist + cost < field.dist[fromnum])
+         {
+            field.dist[fromnum] = todist + cost;
+            P_flowHeapPush(field.dist[fromnum], fromnum);
+            if(!(flowsectormark[fromnum] & FLOWMARK_TOUCHED))
+            {
+               flowsectormark[fromnum] |= FLOWMARK_TOUCHED;
+               flowtouched.add(fromnum);
+            }
+         }
+      }
+   }
+
+   P_runFlowSearch(field);
+
+   // the lines picked may differ wherever a cost changed
+   for(int secnum : flowaffected)
+      P_repickAround(field, secnum);
+   for(int secnum : flowtouched)
+      P_repickAround(field, secnum);
+   for(size_t c = field.serial; c < numchanges; c++)
+   {
+      const line_t *line = &lines[flowchanges[c]];
+
+      if(line->frontsector)
+         P_pickNextLine(field, eindex(line->frontsector - sectors));
+      if(line->backsector)
+         P_pickNextLine(field, eindex(line->backsector - sectors));
+   }
+
+   for(int secnum : flowaffected)
+      flowsectormark[secnum] &= ~FLOWMARK_AFFECTED;
+   for(int secnum : flowtouched)
+      flowsectormark[secnum] &= ~FLOWMARK_TOUCHED;
+
+   field.serial = numchanges;
+}
+
+//
+// Returns the flow field leading to a sector, making it if needed
+//
+static const flowfield_t &P_getFlowField(const sector_t *root)
+{
+   flowfield_t *field  = nullptr;
+   flowfield_t *oldest = &flowfields[0];
+
+   P_updateFlowCosts();
+
+   // once the changes kept grow too many, fields behind are made again
+   if(flowchanges.getLength() > MAXFLOWCHANGES)
+   {
+      for(flowfield_t &f : flowfields)
+      {
+         if(f.root && f.serial < flowchanges.getLength())
+            f.root = nullptr;
+         f.serial = 0; // the ones kept are up to date
+      }
+      flowchanges.makeEmpty();
+   }
+
+   for(flowfield_t &f : flowfields)
+   {
+      if(f.root == root)
+      {
+         field = &f;
+         break;
+      }
+      if(!f.root || (oldest->root && f.lastuse < oldest->lastuse))
+         oldest = &f;
+   }
+
+   if(!field)
+   {
+      field = oldest;
+      field->root = root;
+      P_makeFlowField(*field);
+   }
+   else if(field->serial != flowchanges.getLength())
+   {
+      // doors or lifts have moved since
+      P_updateFlowField(*field);
+   }
+
+   // forget the changes once every field has caught up with them
+   bool caughtup = true;
+   for(const flowfield_t &f : flowfields)
+   {
+      if(f.root && f.serial != flowchanges.getLength())
+         caughtup = false;
+   }
+   if(caughtup)
+   {
+      flowchanges.makeEmpty();
+      for(flowfield_t &f : flowfields)
+         f.serial = 0;
+   }
+
+   field->lastuse = leveltime;
+   return *field;
+}
+
+//
+// P_FlowPathDelta
+//
+// For a monster chasing a target in another sector, replaces the distance to
+// the target with the one to the next line on the way there. Returns false
+// and leaves them alone if there's no path, or no need for one.
+//
+bool P_FlowPathDelta(const Mobj *actor, const Mobj *target, 
+                     fixed_t &deltax, fixed_t &deltay)
+{
+   const sector_t *from = actor->subsector->sector;
+   const sector_t *to   = target->subsector->sector;
+
+   // sectors of different portal groups aren't linked by lines
+   if(from == to || actor->groupid != target->groupid)
+      return false;
+
+   const flowfield_t &field = P_getFlowField(to);
+   int linenum = field.nextline[eindex(from - sectors)];
+
+   if(linenum < 0)
+      return false;
+
+   deltax = lines[linenum].soundorg.x - actor->x;
+   deltay = lines[linenum].soundorg.y - actor->y;
+   return true;
+}
+
+// EOF
+
@@ -57,6 +57,8 @@
 
 int EV_DoParamFloor(const line_t *line, int tag, const floordata_t *fd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       secnum;
    int       rtn = 0;
    bool      manual = false;
@@ -79,8 +81,10 @@ int EV_DoParamFloor(const line_t *line, int tag, const floordata_t *fd)
 
    secnum = -1;
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
 manual_floor:                
@@ -363,6 +367,8 @@ int EV_DoGenFloor(const line_t *line)
 //
 int EV_DoParamCeiling(const line_t *line, int tag, const ceilingdata_t *cd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       secnum;
    int       rtn = 0;
    bool      manual = false;
@@ -385,8 +391,10 @@ int EV_DoParamCeiling(const line_t *line, int tag, const ceilingdata_t *cd)
 
    secnum = -1;
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
 
 manual_ceiling:                
@@ -740,6 +748,8 @@ int EV_DoGenLift(const line_t *line)
 int EV_DoGenLiftByParameters(bool manualtrig, const line_t &line, fixed_t speed, int delay,
                              int target, fixed_t height)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    PlatThinker *plat;
    sector_t    *sec;
    int  secnum;
@@ -768,8 +778,10 @@ int EV_DoGenLiftByParameters(bool manualtrig, const line_t &line, fixed_t speed,
    }
 
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromLineArg0(&line, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(line.args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
 
    manual_lift:
@@ -859,6 +871,8 @@ int EV_DoGenLiftByParameters(bool manualtrig, const line_t &line, fixed_t speed,
 //
 int EV_DoParamStairs(const line_t *line, int tag, const stairdata_t *sd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int  secnum;
    int  osecnum; //jff 3/4/98 preserve loop index
    int  height;
@@ -894,8 +908,10 @@ int EV_DoParamStairs(const line_t *line, int tag, const stairdata_t *sd)
 
    secnum = -1;
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
 manual_stair:          
@@ -1125,6 +1141,8 @@ int EV_DoGenStairs(line_t *line)
 //
 int EV_DoParamCrusher(const line_t *line, int tag, const crusherdata_t *cd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int       secnum;
    int       rtn;
    bool      manual;
@@ -1154,8 +1172,10 @@ int EV_DoParamCrusher(const line_t *line, int tag, const crusherdata_t *cd)
    
    secnum = -1;
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromTag(tag,secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
 manual_crusher:                
@@ -1339,6 +1359,8 @@ static int GenDoorRetrigger(Thinker *th, const doordata_t *dd, int tag)
 //
 int EV_DoParamDoor(const line_t *line, int tag, const doordata_t *dd)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int secnum, rtn = 0;
    sector_t *sec;
    VerticalDoorThinker *door;
@@ -1362,8 +1384,10 @@ int EV_DoParamDoor(const line_t *line, int tag, const doordata_t *dd)
    rtn = 0;
 
    // if not manual do all sectors tagged the same as the line
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
 manual_door:
       // Do not start another function if ceiling already moving
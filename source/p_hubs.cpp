@@ -43,6 +43,8 @@
 #include "doomstat.h"
 #include "d_io.h"       // SoM 3/14/2002: strncasecmp
 #include "g_game.h"
+#include "i_system.h"
+#include "m_utils.h"
 #include "p_maputl.h"
 #include "p_mobj.h"
 #include "p_saveg.h"
@@ -50,14 +52,22 @@
 #include "p_spec.h"
 #include "r_defs.h"
 #include "r_state.h"
+#include "v_misc.h"
 
 #define MAXHUBLEVELS 128
 
-typedef struct hublevel_s hublevel_t;
-struct hublevel_s
+//
+// Saved hub levels are kept in memory as compressed savegame images. Once
+// they take up more than hub_memlimit megabytes, the least recently used
+// ones are spilled out to temporary files.
+//
+struct hublevel_t
 {
-   char levelname[8];
-   char *tmpfile;        // temporary file holding the saved level
+   char   levelname[9];
+   byte  *data;          // compressed level archive, while held in memory
+   size_t size;          // size of data
+   char  *tmpfile;       // temporary file holding the level, once spilled
+   int    lastuse;       // LRU stamp
 };
 
 extern char gamemapname[9];
@@ -66,9 +76,14 @@ extern char gamemapname[9];
 //  another level in the hub
 bool hub_changelevel = false;  
 
+// memory budget for saved hub levels, in megabytes
+int hub_memlimit = 32;
+
 hublevel_t hub_levels[MAXHUBLEVELS];
 int num_hub_levels;
 
+static int hub_usestamp;
+
 // sf: my own tmpnam (djgpp one doesn't work as i want it)
 
 char *temp_hubfile(void)
@@ -76,7 +91,7 @@ char *temp_hubfile(void)
    static int tmpfilenum = 0;
    char *new_tmpfilename;
    
-   new_tmpfilename = emalloc(char *, 10);
+   new_tmpfilename = emalloc(char *, 16);
    
    sprintf(new_tmpfilename, "smmu%i.tmp", tmpfilenum++);
    
@@ -90,7 +105,16 @@ void P_ClearHubs(void)
    for(i=0; i<num_hub_levels; i++)
    {
       if(hub_levels[i].tmpfile)
+      {
          remove(hub_levels[i].tmpfile);
+         efree(hub_levels[i].tmpfile);
+         hub_levels[i].tmpfile = NULL;
+      }
+      if(hub_levels[i].data)
+      {
+         efree(hub_levels[i].data);
+         hub_levels[i].data = NULL;
+      }
    }
    
    num_hub_levels = 0;
@@ -136,10 +160,63 @@ static hublevel_t *HublevelForName(char *name)
 
 static hublevel_t *AddHublevel(char *levelname)
 {
-   strncpy(hub_levels[num_hub_levels].levelname, levelname, 8);
-   hub_levels[num_hub_levels].tmpfile = NULL;
-   
-   return &hub_levels[num_hub_levels++];
+   if(num_hub_levels == MAXHUBLEVELS)
+      I_Error("AddHublevel: too many levels in hub\n");
+
+   hublevel_t &hublevel = hub_levels[num_hub_levels++];
+
+   memset(hublevel.levelname, 0, sizeof(hublevel.levelname));
+   strncpy(hublevel.levelname, levelname, 8);
+   hublevel.data    = NULL;
+   hublevel.size    = 0;
+   hublevel.tmpfile = NULL;
+   hublevel.lastuse = 0;
+   
+   return &hublevel;
+}
+
+//
+// Spill least recently used levels to disk until the ones left in memory fit
+// within hub_memlimit. The level given by keep always stays in memory.
+//
+static void SpillHubLevels(const hublevel_t *keep)
+{
+   size_t limit = size_t(hub_memlimit) * 1024 * 1024;
+   size_t total = 0;
+   int i;
+
+   for(i=0; i<num_hub_levels; i++)
+      total += hub_levels[i].size;
+
+   while(total > limit)
+   {
+      hublevel_t *lru = NULL;
+
+      for(i=0; i<num_hub_levels; i++)
+      {
+         hublevel_t *hl = &hub_levels[i];
+         if(hl->data && hl != keep && (!lru || hl->lastuse < lru->lastuse))
+            lru = hl;
+      }
+
+      if(!lru)
+         break; // nothing left to spill
+
+      if(!lru->tmpfile)
+         lru->tmpfile = temp_hubfile();
+
+      if(!M_WriteFile(lru->tmpfile, lru->data, lru->size))
+      {
+         // keep it in memory instead
+         C_Printf(FC_ERROR "Warning: could not write hub file %s\n", lru->tmpfile);
+         break;
+      }
+
+      total -= lru->size;
+      efree(lru->data);
+      lru->data = NULL;
+      lru->size = 0;
+   }
 }
 
 // save the current level in the hub
@@ -154,12 +231,17 @@ static void SaveHubLevel(void)
    // create new hublevel if not been there yet
    if(!hublevel)
       hublevel = AddHublevel(levelmapname);
-   
-   // allocate a temp. filename for save
-   if(!hublevel->tmpfile)
-      hublevel->tmpfile = temp_hubfile();
-   
-   P_SaveCurrentLevel(hublevel->tmpfile, hubdesc);
+
+   // drop any older copy of the level
+   if(hublevel->data)
+      efree(hublevel->data);
+   if(hublevel->tmpfile)
+      remove(hublevel->tmpfile);
+
+   hublevel->data    = P_SaveGameToMemory(hubdesc, hublevel->size);
+   hublevel->lastuse = ++hub_usestamp;
+
+   SpillHubLevels(hublevel);
 }
 
 static void LoadHubLevel(char *levelname)
@@ -177,7 +259,11 @@ static void LoadHubLevel(char *levelname)
    else
    {
       // found saved level: reload
-      G_LoadGame(hublevel->tmpfile, 0, 0);
+      if(hublevel->data)
+         G_LoadGameFromMemory(hublevel->data, hublevel->size);
+      else
+         G_LoadGame(hublevel->tmpfile, 0, 0);
+      hublevel->lastuse = ++hub_usestamp;
       hub_changelevel = true;
    }
    
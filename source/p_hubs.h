@@ -39,6 +39,7 @@ void P_RestorePlayerPosition();
 void P_HubReborn();
 
 extern bool hub_changelevel;
+extern int  hub_memlimit;
 
 #endif
 
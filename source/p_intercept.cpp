@@ -0,0 +1,138 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: intercept storage and ordering for path traversals.
+//
+// Traversals used to pick the nearest remaining intercept by scanning the
+// whole list each time, taking the first one found among equally near ones.
+// That order is exactly a stable sort by frac, which is what is done here
+// once the intercepts are gathered.
+//
+
+#include "z_zone.h"
+#include "p_intercept.h"
+
+// lists up to this long are insertion sorted; they're usually close to being
+// in order already, as the blocks are gathered along the trace
+#define INSERTIONSORTMAX 48
+
+//
+// Doubles the storage
+//
+void InterceptArena::grow()
+{
+   size_t capacity = mCapacity ? mCapacity * 2 : 128;
+   intercept_t *items = new intercept_t[capacity];
+
+   if(mLength)
+      memcpy(items, mItems, mLength * sizeof(intercept_t));
+
+   delete [] mItems;
+   delete [] mScratch;
+   mItems    = items;
+   mScratch  = new intercept_t[capacity];
+   mCapacity = capacity;
+}
+
+//
+// Sorts the intercepts by frac, keeping the order of equal ones
+//
+void InterceptArena::sort()
+{
+   if(!mLength) // nothing may have been allocated yet
+      return;
+   P_SortIntercepts(mItems, mScratch, mLength);
+}
+
+//
+// Radix key of a frac: its bits with the sign flipped, so that unsigned
+// order is signed order
+//
+static inline uint32_t P_interceptKey(const intercept_t &in)
+{
+   return static_cast<uint32_t>(in.frac) ^ 0x80000000u;
+}
+
+//
+// P_SortIntercepts
+//
+// Stable sort of count intercepts by frac. Long lists get an LSD radix sort,
+// which needs scratch space for count intercepts.
+//
+void P_SortIntercepts(intercept_t *items, intercept_t *scratch, size_t count)
+{
+   if(count < 2)
+      return;
+
+   if(count <= INSERTIONSORTMAX)
+   {
+      for(size_t i = 1; i < count; i++)
+      {
+         if(items[i - 1].frac <= items[i].frac)
+            continue;
+
+         intercept_t in = items[i];
+         size_t j = i;
+         do
+         {
+            items[j] = items[j - 1];
+            --j;
+         }
+         while(j > 0 && items[j - 1].frac > in.frac);
+         items[j] = in;
+      }
+      return;
+   }
+
+   intercept_t *src = items, *dst = scratch;
+
+   for(int shift = 0; shift < 32; shift += 8)
+   {
+      size_t counts[256] = { 0 };
+
+      for(size_t i = 0; i < count; i++)
+         ++counts[(P_interceptKey(src[i]) >> shift) & 0xff];
+
+      // a byte all keys share doesn't need a pass
+      if(counts[(P_interceptKey(src[0]) >> shift) & 0xff] == count)
+         continue;
+
+      size_t total = 0;
+      for(size_t &c : counts)
+      {
+         size_t n = c;
+         c = total;
+         total += n;
+      }
+
+      for(size_t i = 0; i < count; i++)
+         dst[counts[(P_interceptKey(src[i]) >> shift) & 0xff]++] = src[i];
+
+      intercept_t *temp = src;
+      src = dst;
+      dst = temp;
+   }
+
+   if(src != items)
+      memcpy(items, src, count * sizeof(intercept_t));
+}
+
+// EOF
+
@@ -0,0 +1,81 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: intercept storage and ordering for path traversals.
+//
+
+#ifndef P_INTERCEPT_H__
+#define P_INTERCEPT_H__
+
+#include "p_maputl.h"
+
+//
+// Intercept arena
+//
+// Holds the intercepts gathered by a path traversal. The storage is kept
+// from one traversal to the next and only ever grows, so once warmed up a
+// trace allocates nothing. Like query contexts, arenas don't use the zone
+// heap, so traversals may run on any thread.
+//
+class InterceptArena
+{
+public:
+   InterceptArena() : mItems(nullptr), mScratch(nullptr), mLength(0), mCapacity(0)
+   {
+   }
+   ~InterceptArena()
+   {
+      delete [] mItems;
+      delete [] mScratch;
+   }
+
+   void clear() { mLength = 0; }
+
+   intercept_t &addNew()
+   {
+      if(mLength >= mCapacity)
+         grow();
+      return mItems[mLength++];
+   }
+
+   intercept_t *begin() const { return mItems; }
+   intercept_t *end()   const { return mItems + mLength; }
+   size_t getLength()   const { return mLength; }
+
+   void sort();
+
+private:
+   InterceptArena(const InterceptArena &) = delete;
+   InterceptArena &operator = (const InterceptArena &) = delete;
+
+   void grow();
+
+   intercept_t *mItems;
+   intercept_t *mScratch; // for sorting
+   size_t       mLength;
+   size_t       mCapacity;
+};
+
+void P_SortIntercepts(intercept_t *items, intercept_t *scratch, size_t count);
+
+#endif
+
+// EOF
+
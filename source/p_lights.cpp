@@ -703,6 +703,8 @@ void P_SpawnPSXGlowingLight(sector_t *sector, psxglow_e glowtype)
 int EV_StartLightStrobing(const line_t *line, int tag, int darkTime,
                           int brightTime, bool isParam)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int   secnum;
    sector_t* sec;
 
@@ -717,8 +719,10 @@ int EV_StartLightStrobing(const line_t *line, int tag, int darkTime,
    
    secnum = -1;
    // start lights strobing in all sectors tagged same as line
-   while(!manual && (secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; !manual && tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
    manualLight:
       // if already doing a lighting function, don't start a second
@@ -742,6 +746,8 @@ int EV_StartLightStrobing(const line_t *line, int tag, int darkTime,
 //
 int EV_TurnTagLightsOff(const line_t* line, int tag, bool isParam)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int j;
    // search sectors for those with same tag as activating line
    
@@ -757,8 +763,10 @@ int EV_TurnTagLightsOff(const line_t* line, int tag, bool isParam)
    }
 
    // killough 10/98: replaced inefficient search with fast search
-   for(j = -1; (j = P_FindSectorFromTag(tag, j)) >= 0; )
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      j = tagged[tagpos];
       sector = sectors + j;
 
    manualLight:
@@ -796,6 +804,8 @@ int EV_TurnTagLightsOff(const line_t* line, int tag, bool isParam)
 //
 int EV_LightTurnOn(const line_t *line, int tag, int bright, bool isParam)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int i;
    
    // search all sectors for ones with same tag as activating line
@@ -812,8 +822,10 @@ int EV_LightTurnOn(const line_t *line, int tag, int bright, bool isParam)
    }
 
    // killough 10/98: replace inefficient search with fast search
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
       sector = sectors+i;
 
    manualLight:
@@ -863,6 +875,8 @@ int EV_LightTurnOn(const line_t *line, int tag, int bright, bool isParam)
 //
 int EV_LightTurnOnPartway(int tag, fixed_t level)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int i;
    
    if(level < 0)          // clip at extremes 
@@ -871,8 +885,10 @@ int EV_LightTurnOnPartway(int tag, fixed_t level)
       level = FRACUNIT;
 
    // search all sectors for ones with same tag as activating line
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
       sector_t *temp, *sector = sectors + i;
       int j, bright = 0, min = sector->lightlevel;
 
@@ -906,6 +922,8 @@ int EV_LightTurnOnPartway(int tag, fixed_t level)
 //
 int EV_SetLight(const line_t *line, int tag, setlight_e type, int lvl)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int i, rtn = 0;
    sector_t *s;
    bool backside = false;
@@ -919,8 +937,10 @@ int EV_SetLight(const line_t *line, int tag, setlight_e type, int lvl)
       goto dobackside;
    }
 
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {      
+      i = tagged[tagpos];
 dobackside:
       s = &sectors[i];
 
@@ -961,6 +981,8 @@ dobackside:
 //
 int EV_FadeLight(const line_t *line, int tag, int destvalue, int speed)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int i, rtn = 0;
    LightFadeThinker *lf;
    bool backside = false;
@@ -979,8 +1001,10 @@ int EV_FadeLight(const line_t *line, int tag, int destvalue, int speed)
    }
    
    // search all sectors for ones with tag
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
 dobackside:
       rtn = 1;
 
@@ -1013,6 +1037,8 @@ dobackside:
 //
 int EV_GlowLight(const line_t *line, int tag, int maxval, int minval, int speed)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int i, rtn = 0;
    LightFadeThinker *lf;
    bool backside = false;
@@ -1039,8 +1065,10 @@ int EV_GlowLight(const line_t *line, int tag, int maxval, int minval, int speed)
    }
    
    // search all sectors for ones with tag
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
 dobackside:
       rtn = 1;
 
@@ -1078,6 +1106,8 @@ dobackside:
 int EV_StrobeLight(const line_t *line, int tag,
                    int maxval, int minval, int maxtime, int mintime)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    StrobeThinker *flash;
    int i, rtn = 0;
    bool backside = false;
@@ -1091,8 +1121,10 @@ int EV_StrobeLight(const line_t *line, int tag,
       goto dobackside;
    }
    
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
 dobackside:
       rtn = 1;
       flash = new StrobeThinker;
@@ -1124,6 +1156,8 @@ dobackside:
 //
 int EV_FlickerLight(const line_t *line, int tag, int maxval, int minval)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    LightFlashThinker *flash;
    int i, rtn = 0;
    bool backside = false;
@@ -1137,8 +1171,10 @@ int EV_FlickerLight(const line_t *line, int tag, int maxval, int minval)
       goto dobackside;
    }
    
-   for(i = -1; (i = P_FindSectorFromTag(tag, i)) >= 0;)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      i = tagged[tagpos];
 dobackside:
       rtn = 1;
       flash = new LightFlashThinker;
@@ -28,6 +28,7 @@
 #include "i_system.h"
 
 #include "c_io.h"
+#include "c_runcmd.h"
 #include "d_gi.h"
 #include "d_mod.h"
 #include "doomstat.h"
@@ -38,6 +39,7 @@
 #include "m_argv.h"
 #include "m_bbox.h"
 #include "m_compare.h"
+#include "m_parallel.h"
 #include "m_random.h"
 #include "p_info.h"
 #include "p_inter.h"
@@ -50,11 +52,14 @@
 #include "p_portal.h"
 #include "p_portalblockmap.h"
 #include "p_portalcross.h"
+#include "p_querycontext.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
 #include "p_skin.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_user.h"
+#include "polyobj.h"
 #include "r_defs.h"
 #include "r_main.h"
 #include "r_portal.h"
@@ -646,11 +651,10 @@ static void SpechitOverrun(line_t *ld)
 }
 
 //
-// P_CollectSpechits
-//
-// ioanch: moved this here so it may be called from elsewhere too
+// Adds a crossed line to the special lines of inter, if it counts as one
 //
-void P_CollectSpechits(line_t *ld, PODCollection<line_t *> *pushhit)
+static void P_collectSpechits(doom_mapinter_t &inter, line_t *ld,
+                              PODCollection<line_t *> *pushhit)
 {
    // if contacted a special line, add it to the list
    // ioanch 20160121: check for PS_PASSABLE, to restrict just for linked portals
@@ -661,19 +665,29 @@ void P_CollectSpechits(line_t *ld, PODCollection<line_t *> *pushhit)
       else if(pushhit)  // don't attempt adding passable lines to pushables.
          pushhit->add(ld);
       // 1/11/98 killough: remove limit on lines hit, by array doubling
-      if(clip.numspechit >= clip.spechit_max)
+      if(inter.numspechit >= inter.spechit_max)
       {
-         clip.spechit_max = clip.spechit_max ? clip.spechit_max * 2 : 8;
-         clip.spechit = erealloc(line_t **, clip.spechit, sizeof(*clip.spechit) * clip.spechit_max);
+         inter.spechit_max = inter.spechit_max ? inter.spechit_max * 2 : 8;
+         inter.spechit = erealloc(line_t **, inter.spechit, sizeof(*inter.spechit) * inter.spechit_max);
       }
-      clip.spechit[clip.numspechit++] = ld;
+      inter.spechit[inter.numspechit++] = ld;
 
       // haleyjd 09/20/06: spechit overflow emulation
-      if(clip.numspechit > MAXSPECHIT_OLD)
+      if(inter.numspechit > MAXSPECHIT_OLD && &inter == &clip)
          SpechitOverrun(ld);
    }
 }
 
+//
+// P_CollectSpechits
+//
+// ioanch: moved this here so it may be called from elsewhere too
+//
+void P_CollectSpechits(line_t *ld, PODCollection<line_t *> *pushhit)
+{
+   P_collectSpechits(clip, ld, pushhit);
+}
+
 //
 // Returns true if line should be blocked by ML_BLOCKMONSTERS lines.
 //
@@ -684,20 +698,19 @@ bool P_BlockedAsMonster(const Mobj &mo)
 }
 
 //
-// PIT_CheckLine
+// Adjusts the heights in inter for a line the thing may touch. Only the
+// global clip allows a player to get unstuck.
 //
-// Adjusts tmfloorz and tmceilingz as lines are contacted
-//
-bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
+static bool P_checkLine(doom_mapinter_t &inter, line_t *ld,
+                        PODCollection<line_t *> *pushhit)
 {
-   auto pushhit = static_cast<PODCollection<line_t *> *>(context);
-   if(clip.bbox[BOXRIGHT]  <= ld->bbox[BOXLEFT]   || 
-      clip.bbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  || 
-      clip.bbox[BOXTOP]    <= ld->bbox[BOXBOTTOM] || 
-      clip.bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+   if(inter.bbox[BOXRIGHT]  <= ld->bbox[BOXLEFT]   || 
+      inter.bbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  || 
+      inter.bbox[BOXTOP]    <= ld->bbox[BOXBOTTOM] || 
+      inter.bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
       return true; // didn't hit it
 
-   if(P_BoxOnLineSide(clip.bbox, ld) != -1)
+   if(P_BoxOnLineSide(inter.bbox, ld) != -1)
       return true; // didn't hit it
 
    // A line has been hit
@@ -714,9 +727,9 @@ bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
    // haleyjd 04/30/11: treat block-everything lines like they're 1S
    if(!ld->backsector || (ld->extflags & EX_ML_BLOCKALL)) // one sided line
    {
-      clip.blockline = ld;
-      bool result = clip.unstuck && !untouched(ld) &&
-         FixedMul(clip.x-clip.thing->x,ld->dy) > FixedMul(clip.y-clip.thing->y,ld->dx);
+      inter.blockline = ld;
+      bool result = inter.unstuck && !untouched(ld) &&
+         FixedMul(inter.x-inter.thing->x,ld->dy) > FixedMul(inter.y-inter.thing->y,ld->dx);
       if(!result && pushhit && ld->special &&
          full_demo_version >= make_full_version(401, 0))
       {
@@ -726,11 +739,11 @@ bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
    }
 
    // killough 8/10/98: allow bouncing objects to pass through as missiles
-   if(!(clip.thing->flags & (MF_MISSILE | MF_BOUNCES)))
+   if(!(inter.thing->flags & (MF_MISSILE | MF_BOUNCES)))
    {
       if(ld->flags & ML_BLOCKING)           // explicitly blocking everything
       {
-         bool result = clip.unstuck && !untouched(ld);  // killough 8/1/98: allow escape
+         bool result = inter.unstuck && !untouched(ld);  // killough 8/1/98: allow escape
 
          // When it's Hexen, keep side 0 even when hitting from backside
          if(!result && pushhit && ld->special &&
@@ -746,7 +759,7 @@ bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
       // killough 8/9/98: monster-blockers don't affect friends
       // SoM 9/7/02: block monsters standing on 3dmidtex only
       if(ld->flags & ML_BLOCKMONSTERS && !(ld->flags & ML_3DMIDTEX) &&
-         P_BlockedAsMonster(*clip.thing))
+         P_BlockedAsMonster(*inter.thing))
       {
          return false; // block monsters only
       }
@@ -755,50 +768,60 @@ bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
    // set openrange, opentop, openbottom
    // these define a 'window' from one sector to another across this line
    
-   P_LineOpening(ld, clip.thing);
+   P_LineOpening(inter, ld, inter.thing);
 
    // adjust floor & ceiling heights
    
-   if(clip.opentop < clip.zref.ceiling)
+   if(inter.opentop < inter.zref.ceiling)
    {
-      clip.zref.ceiling = clip.opentop;
-      clip.ceilingline = ld;
-      clip.blockline = ld;
+      inter.zref.ceiling = inter.opentop;
+      inter.ceilingline = ld;
+      inter.blockline = ld;
    }
 
-   if(clip.openbottom > clip.zref.floor)
+   if(inter.openbottom > inter.zref.floor)
    {
-      clip.zref.floor = clip.openbottom;
+      inter.zref.floor = inter.openbottom;
 
-      clip.floorline = ld;          // killough 8/1/98: remember floor linedef
-      clip.blockline = ld;
+      inter.floorline = ld;          // killough 8/1/98: remember floor linedef
+      inter.blockline = ld;
    }
 
-   if(clip.lowfloor < clip.zref.dropoff)
-      clip.zref.dropoff = clip.lowfloor;
+   if(inter.lowfloor < inter.zref.dropoff)
+      inter.zref.dropoff = inter.lowfloor;
 
    // haleyjd 11/10/04: 3DMidTex fix: never consider dropoffs when
    // touching 3DMidTex lines.
-   if(demo_version >= 331 && clip.touch3dside)
-      clip.zref.dropoff = clip.zref.floor;
+   if(demo_version >= 331 && inter.touch3dside)
+      inter.zref.dropoff = inter.zref.floor;
 
-   if(clip.opensecfloor > clip.zref.secfloor)
-      clip.zref.secfloor = clip.opensecfloor;
-   if(clip.opensecceil < clip.zref.secceil)
-      clip.zref.secceil = clip.opensecceil;
+   if(inter.opensecfloor > inter.zref.secfloor)
+      inter.zref.secfloor = inter.opensecfloor;
+   if(inter.opensecceil < inter.zref.secceil)
+      inter.zref.secceil = inter.opensecceil;
 
    // SoM 11/6/02: AGHAH
-   if(clip.zref.floor > clip.zref.passfloor)
-      clip.zref.passfloor = clip.zref.floor;
-   if(clip.zref.ceiling < clip.zref.passceil)
-      clip.zref.passceil = clip.zref.ceiling;
+   if(inter.zref.floor > inter.zref.passfloor)
+      inter.zref.passfloor = inter.zref.floor;
+   if(inter.zref.ceiling < inter.zref.passceil)
+      inter.zref.passceil = inter.zref.ceiling;
 
    // ioanch 20160113: moved to a special function
-   P_CollectSpechits(ld, pushhit);
+   P_collectSpechits(inter, ld, pushhit);
    
    return true;
 }
 
+//
+// PIT_CheckLine
+//
+// Adjusts tmfloorz and tmceilingz as lines are contacted
+//
+bool PIT_CheckLine(line_t *ld, polyobj_s *po, void *context)
+{
+   return P_checkLine(clip, ld, static_cast<PODCollection<line_t *> *>(context));
+}
+
 //
 // P_Touched
 //
@@ -1048,7 +1071,8 @@ ItemCheckResult P_CheckThingCommon(Mobj *thing)
    // haleyjd 1/16/00: Pushable objects -- at last!
    //   This is remarkably simpler than I had anticipated!
    
-   if(thing->flags2 & MF2_PUSHABLE && !(clip.thing->flags3 & MF3_CANNOTPUSH))
+   if(thing->flags2 & MF2_PUSHABLE && !(clip.thing->flags3 & MF3_CANNOTPUSH) &&
+      !(clip.thing->intflags & MIF_PREDICTED))
    {
       // transfer one-fourth momentum along the x and y axes
       thing->momx += clip.thing->momx / 4;
@@ -1096,7 +1120,7 @@ static bool PIT_CheckThing(Mobj *thing, void *context) // killough 3/26/98: make
    // surroundings such as walls, then the touchy thing dies immediately.
 
    // haleyjd: functionalized
-   if(P_Touched(thing))
+   if(!(clip.thing->intflags & MIF_PREDICTED) && P_Touched(thing))
       return true;
 
    ItemCheckResult result = P_CheckThingCommon(thing);
@@ -1177,6 +1201,116 @@ bool Check_Sides(Mobj *actor, int x, int y, mobjtype_t type)
 // MOVEMENT CLIPPING
 //
 
+//
+// Line clipping done ahead of time
+//
+// The heights a thing gets from the lines around it depend only on the map
+// and the thing, so when a moving sector has P_CheckSector clip many things
+// again, that part is done for all of them at once on worker threads. The
+// things are then gone through in order as before, and P_CheckPosition takes
+// the prepared result instead of going through the lines itself, provided it
+// starts from the very same state and neither the map nor the thing has
+// changed since.
+//
+
+bool p_parallelclip;
+
+struct heightclip_t
+{
+   Mobj         *thing;
+   fixed_t       z;          // what the lines were clipped with
+   fixed_t       radius;
+   unsigned int  flags;
+   unsigned int  flags4;
+   mobjinfo_t   *info;
+   unsigned int  generation; // sightgeneration by then
+   bool          usable;     // false if it must be done the usual way
+   bool          fits;       // no line blocked it
+   zrefs_t       start;      // heights before the lines
+   int           startpic;
+   doom_mapinter_t inter;    // clip state after the lines
+};
+
+static heightclip_t *heightclips;
+static int           numheightclips;
+static int           maxheightclips;
+static int           heightclipcursor;
+static heightclip_t *preparedclip; // for the next P_CheckPosition
+
+//
+// Finds the prepared clip of a thing, if there is one
+//
+static heightclip_t *P_findHeightClip(const Mobj *thing)
+{
+   // they are mostly asked for in the order they were prepared in
+   for(int i = 0; i < numheightclips; i++)
+   {
+      int index = (heightclipcursor + i) % numheightclips;
+
+      if(heightclips[index].thing == thing)
+      {
+         heightclipcursor = index + 1;
+         return &heightclips[index];
+      }
+   }
+   return nullptr;
+}
+
+//
+// Puts a prepared clip into the global clip, in place of going through the
+// lines. Returns false if it doesn't apply to the current state.
+//
+static bool P_usePreparedClip(const heightclip_t &hc)
+{
+   const Mobj            *thing = clip.thing;
+   const doom_mapinter_t &inter = hc.inter;
+
+   if(!hc.usable || hc.generation != sightgeneration || thing != hc.thing ||
+      thing->player || thing->z != hc.z || thing->radius != hc.radius ||
+      thing->flags != hc.flags || thing->flags4 != hc.flags4 ||
+      thing->info != hc.info)
+      return false;
+
+   // the things may have called P_CheckPosition on their own
+   if(clip.x != inter.x || clip.y != inter.y ||
+      memcmp(clip.bbox, inter.bbox, sizeof(clip.bbox)) ||
+      memcmp(&clip.zref, &hc.start, sizeof(clip.zref)) ||
+      clip.floorpic != hc.startpic || clip.unstuck || clip.touch3dside ||
+      clip.numspechit || clip.blockline || clip.floorline || clip.ceilingline)
+      return false;
+
+   clip.zref        = inter.zref;
+   clip.floorpic    = inter.floorpic;
+   clip.touch3dside = inter.touch3dside;
+   clip.blockline   = inter.blockline;
+   clip.floorline   = inter.floorline;
+   clip.ceilingline = inter.ceilingline;
+
+   // the opening is left as it was if no line had one
+   if(inter.openfrontsector)
+   {
+      clip.opentop         = inter.opentop;
+      clip.openbottom      = inter.openbottom;
+      clip.openrange       = inter.openrange;
+      clip.lowfloor        = inter.lowfloor;
+      clip.opensecfloor    = inter.opensecfloor;
+      clip.opensecceil     = inter.opensecceil;
+      clip.openfrontsector = inter.openfrontsector;
+      clip.openbacksector  = inter.openbacksector;
+   }
+
+   if(inter.numspechit > clip.spechit_max)
+   {
+      clip.spechit_max = inter.spechit_max;
+      clip.spechit = erealloc(line_t **, clip.spechit, sizeof(*clip.spechit) * clip.spechit_max);
+   }
+   for(int i = 0; i < inter.numspechit; i++)
+      clip.spechit[i] = inter.spechit[i];
+   clip.numspechit = inter.numspechit;
+
+   return true;
+}
+
 //
 // P_CheckPosition
 // This is purely informative, nothing is modified
@@ -1205,6 +1339,9 @@ bool P_CheckPosition(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *>
 {
    int xl, xh, yl, yh, bx, by;
    subsector_t *newsubsec;
+   const heightclip_t *prepared = preparedclip;
+
+   preparedclip = nullptr;
 
    // haleyjd: OVER_UNDER
    if(P_Use3DClipping())
@@ -1274,6 +1411,9 @@ bool P_CheckPosition(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *>
    // check lines
    
    clip.BlockingMobj = NULL; // haleyjd 1/17/00: global hit reference
+
+   if(prepared && P_usePreparedClip(*prepared))
+      return prepared->fits;
    
    xl = (clip.bbox[BOXLEFT]   - bmaporgx) >> MAPBLOCKSHIFT;
    xh = (clip.bbox[BOXRIGHT]  - bmaporgx) >> MAPBLOCKSHIFT;
@@ -1284,7 +1424,8 @@ bool P_CheckPosition(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *>
    {
       for(by = yl; by <= yh; by++)
       {
-         if(!P_BlockLinesIterator(bx, by, PIT_CheckLine, R_NOGROUP, pushhit))
+         if(!P_BlockLinesIterator(bx, by, PIT_CheckLine, R_NOGROUP, pushhit,
+                                  clip.bbox))
             return false; // doesn't fit
       }
    }
@@ -2056,6 +2197,7 @@ static bool P_ThingHeightClip(Mobj *thing)
    bool onfloor = thing->z == thing->zref.floor;
    fixed_t oldfloorz = thing->zref.floor; // haleyjd
 
+   preparedclip = P_findHeightClip(thing);
    P_CheckPosition(thing, thing->x, thing->y);
   
    // what about stranding a monster partially off an edge?
@@ -2451,18 +2593,16 @@ static bombdata_t bombs[MAXBOMBS]; // bombs away!
 static bombdata_t *theBomb;        // it's the bomb, man. (the current explosion)
 
 //
-// PIT_RadiusAttack
+// P_bombSpares
 //
-// "bombsource" is the creature that caused the explosion at "bombspot".
+// Returns true if the current explosion can't hurt a thing, regardless of
+// where the thing is.
 //
-static bool PIT_RadiusAttack(Mobj *thing, void *context)
+static bool P_bombSpares(const Mobj *thing)
 {
-   fixed_t dx, dy, dist;
-   Mobj *bombspot     = theBomb->bombspot;
-   Mobj *bombsource   = theBomb->bombsource;
-   int   bombdistance = theBomb->bombdistance;
-   int   bombdamage   = theBomb->bombdamage;
-   
+   const Mobj *bombspot   = theBomb->bombspot;
+   const Mobj *bombsource = theBomb->bombsource;
+
    // killough 8/20/98: allow bouncers to take damage 
    // (missile bouncers are already excluded with MF_NOBLOCKMAP)
    
@@ -2496,24 +2636,65 @@ static bool PIT_RadiusAttack(Mobj *thing, void *context)
       return true;
    }
 
+   return false;
+}
+
+//
+// P_bombOutOfHeight
+//
+// haleyjd: optional z check for Hexen-style explosions
+//
+static bool P_bombOutOfHeight(Mobj *thing)
+{
+   Mobj *bombspot = theBomb->bombspot;
+
+   return theBomb->bombflags & RAF_CLIPHEIGHT &&
+      (D_abs(getThingZ(bombspot, thing) - bombspot->z) / FRACUNIT) > 
+         2 * theBomb->bombdistance;
+}
+
+//
+// P_thingDistance
+//
+// Distance from a point to a thing as area damage measures it: along the
+// larger axis, to the edge of the thing, in map units. Never negative.
+//
+static int P_thingDistance(Mobj *origin, Mobj *thing)
+{
+   fixed_t dx, dy, dist;
+
    // ioanch 20151225: portal-aware behaviour
-   dx   = D_abs(getThingX(bombspot, thing) - bombspot->x);
-   dy   = D_abs(getThingY(bombspot, thing) - bombspot->y);
+   dx   = D_abs(getThingX(origin, thing) - origin->x);
+   dy   = D_abs(getThingY(origin, thing) - origin->y);
    dist = dx > dy ? dx : dy;
    dist = (dist - thing->radius) >> FRACBITS;
 
-   if(dist < 0)
-      dist = 0;
+   return dist < 0 ? 0 : dist;
+}
+
+//
+// PIT_RadiusAttack
+//
+// "bombsource" is the creature that caused the explosion at "bombspot".
+//
+static bool PIT_RadiusAttack(Mobj *thing, void *context)
+{
+   int   dist;
+   Mobj *bombspot     = theBomb->bombspot;
+   Mobj *bombsource   = theBomb->bombsource;
+   int   bombdistance = theBomb->bombdistance;
+   int   bombdamage   = theBomb->bombdamage;
+   
+   if(P_bombSpares(thing))
+      return true;
+
+   dist = P_thingDistance(bombspot, thing);
 
    if(dist >= bombdistance)
       return true;  // out of range
 
-   // haleyjd: optional z check for Hexen-style explosions
-   if(theBomb->bombflags & RAF_CLIPHEIGHT)
-   {
-      if((D_abs(getThingZ(bombspot, thing) - bombspot->z) / FRACUNIT) > 2 * bombdistance)
-         return true;
-   }
+   if(P_bombOutOfHeight(thing))
+      return true;
 
    if(P_CheckSight(thing, bombspot))      // must be in direct path
    {
@@ -2531,6 +2712,75 @@ static bool PIT_RadiusAttack(Mobj *thing, void *context)
    return true;
 }
 
+//
+// P_FindThingsInRange
+//
+// Finds the things within range map units of origin, measured the way area
+// damage does it. They come in the order P_BlockThingsIterator goes through
+// the blocks around origin, across linked portals.
+//
+void P_FindThingsInRange(Mobj *origin, int range, PODCollection<thingdist_t> &found)
+{
+   fixed_t dist = (range + MAXRADIUS) << FRACBITS;
+   fixed_t bbox[4];
+
+   bbox[BOXLEFT]   = origin->x - dist;
+   bbox[BOXTOP]    = origin->y + dist;
+   bbox[BOXRIGHT]  = origin->x + dist;
+   bbox[BOXBOTTOM] = origin->y - dist;
+
+   struct rangequery_t
+   {
+      Mobj *origin;
+      int   range;
+      PODCollection<thingdist_t> *found;
+   } query = { origin, range, &found };
+
+   P_TransPortalBlockWalker(bbox, origin->groupid, false, &query,
+      [](int x, int y, int groupid, void *data) -> bool
+   {
+      P_BlockThingsIterator(x, y, groupid, [](Mobj *thing, void *data) -> bool
+      {
+         auto query = static_cast<rangequery_t *>(data);
+         int  dist  = P_thingDistance(query->origin, thing);
+
+         if(dist < query->range)
+         {
+            thingdist_t &td = query->found->addNew();
+            td.thing = thing;
+            td.dist  = dist;
+         }
+         return true;
+      }, data);
+      return true;
+   });
+}
+
+//
+// P_prefetchBombSight
+//
+// Checks the sight of everything the current explosion may hurt all at
+// once, on worker threads, before the damage is dealt in the usual order.
+//
+static void P_prefetchBombSight()
+{
+   static PODCollection<thingdist_t> found;
+   static PODCollection<Mobj *>      lookers;
+
+   found.makeEmpty();
+   lookers.makeEmpty();
+
+   P_FindThingsInRange(theBomb->bombspot, theBomb->bombdistance, found);
+   for(const thingdist_t &td : found)
+   {
+      if(!P_bombSpares(td.thing) && !P_bombOutOfHeight(td.thing))
+         lookers.add(td.thing);
+   }
+
+   if(!lookers.isEmpty())
+      P_SightBatchPrefetch(&lookers[0], lookers.getLength(), theBomb->bombspot);
+}
+
 //
 // P_RadiusAttack
 //
@@ -2567,6 +2817,11 @@ void P_RadiusAttack(Mobj *spot, Mobj *source, int damage, int distance,
    theBomb->bombmod      = mod;
    theBomb->bombflags    = flags;
 
+   // sight checks are done first when they can run side by side, but the
+   // damage is still dealt as the blocks are walked, as ever
+   if(P_SightBatchActive())
+      P_prefetchBombSight();
+
    fixed_t bbox[4];
    bbox[BOXLEFT] = spot->x - dist;
    bbox[BOXTOP] = spot->y + dist;
@@ -2690,6 +2945,144 @@ bool P_ChangeSector(sector_t *sector, int crunch)
    return !!nofit;
 }
 
+//
+// Goes through a line for a prepared clip
+//
+static bool PIT_PrepareClipLine(line_t *ld, polyobj_s *po, void *context)
+{
+   heightclip_t &hc = *static_cast<heightclip_t *>(context);
+
+   // portal lines mark their groups as visited, and a back sector without a
+   // back side only gets part of the opening set; leave those to the usual
+   // way
+   if(ld->pflags & PS_PASSABLE || (ld->backsector && ld->sidenum[1] == -1))
+   {
+      hc.usable = false;
+      return false;
+   }
+
+   return P_checkLine(hc.inter, ld, nullptr);
+}
+
+//
+// Clips a thing against the lines around it, the way P_CheckPosition does,
+// into its own clip state. Runs on the worker threads.
+//
+static void P_prepareHeightClip(int index, void *data)
+{
+   heightclip_t    &hc    = heightclips[index];
+   Mobj            *thing = hc.thing;
+   doom_mapinter_t &inter = hc.inter;
+   subsector_t     *newsubsec;
+
+   hc.z          = thing->z;
+   hc.radius     = thing->radius;
+   hc.flags      = thing->flags;
+   hc.flags4     = thing->flags4;
+   hc.info       = thing->info;
+   hc.generation = sightgeneration;
+   hc.usable     = true;
+   hc.fits       = true;
+
+   inter.thing = thing;
+   inter.x     = thing->x;
+   inter.y     = thing->y;
+
+   inter.bbox[BOXTOP]    = inter.y + thing->radius;
+   inter.bbox[BOXBOTTOM] = inter.y - thing->radius;
+   inter.bbox[BOXRIGHT]  = inter.x + thing->radius;
+   inter.bbox[BOXLEFT]   = inter.x - thing->radius;
+
+   newsubsec = R_PointInSubsector(inter.x, inter.y);
+   inter.floorline = inter.blockline = inter.ceilingline = NULL;
+   inter.unstuck = 0;
+
+   inter.zref.floor = inter.zref.dropoff = newsubsec->sector->floorheight;
+   inter.zref.ceiling = newsubsec->sector->ceilingheight;
+   inter.zref.secfloor = inter.zref.passfloor = inter.zref.floor;
+   inter.zref.secceil = inter.zref.passceil = inter.zref.ceiling;
+
+   inter.floorpic        = newsubsec->sector->floorpic;
+   inter.touch3dside     = 0;
+   inter.numspechit      = 0;
+   inter.openfrontsector = NULL;
+
+   hc.start    = inter.zref;
+   hc.startpic = inter.floorpic;
+
+   int xl = (inter.bbox[BOXLEFT]   - bmaporgx) >> MAPBLOCKSHIFT;
+   int xh = (inter.bbox[BOXRIGHT]  - bmaporgx) >> MAPBLOCKSHIFT;
+   int yl = (inter.bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
+   int yh = (inter.bbox[BOXTOP]    - bmaporgy) >> MAPBLOCKSHIFT;
+
+   QueryContext *query = QueryContext::Acquire();
+   query->newQuery();
+
+   for(int bx = xl; bx <= xh && hc.fits; bx++)
+   {
+      for(int by = yl; by <= yh; by++)
+      {
+         if(!P_BlockLinesIterator(*query, bx, by, PIT_PrepareClipLine, R_NOGROUP,
+                                  &hc, inter.bbox))
+         {
+            hc.fits = false;
+            break;
+         }
+      }
+   }
+
+   QueryContext::Release(query);
+
+   // overflowing the old spechit array has effects of its own
+   if(inter.numspechit > MAXSPECHIT_OLD)
+      hc.usable = false;
+}
+
+#define MINHEIGHTCLIPS 8
+
+//
+// Prepares the line clipping of the things touching a moved sector. Returns
+// false if it wasn't done.
+//
+static bool P_prepareHeightClips(const sector_t *sector)
+{
+   if(!p_parallelclip || !M_ParallelWorkers())
+      return false;
+
+   numheightclips   = 0;
+   heightclipcursor = 0;
+
+   for(const msecnode_t *n = sector->touching_thinglist; n; n = n->m_snext)
+   {
+      Mobj *thing = n->m_thing;
+
+      // players may get unstuck, which depends on more than the lines
+      if(thing->flags & (MF_NOBLOCKMAP | MF_NOCLIP) || thing->player)
+         continue;
+
+      if(numheightclips == maxheightclips)
+      {
+         int oldmax = maxheightclips;
+
+         maxheightclips = maxheightclips ? maxheightclips * 2 : 64;
+         heightclips = erealloc(heightclip_t *, heightclips,
+                                maxheightclips * sizeof(heightclip_t));
+         memset(heightclips + oldmax, 0, 
+                (maxheightclips - oldmax) * sizeof(heightclip_t));
+      }
+      heightclips[numheightclips++].thing = thing;
+   }
+
+   if(numheightclips < MINHEIGHTCLIPS)
+   {
+      numheightclips = 0;
+      return false;
+   }
+
+   M_ParallelFor(numheightclips, P_prepareHeightClip, nullptr);
+   return true;
+}
+
 //
 // P_CheckSector
 //
@@ -2714,6 +3107,13 @@ bool P_CheckSector(sector_t *sector, int crunch, int amt, int floorOrCeil)
    
    nofit = 0;
    crushchange = crunch;
+
+   // Prepare the clipping of the things against the lines around them, unless
+   // this is called from within another P_CheckSector, whose prepared clips
+   // are still in use.
+   static int checkdepth;
+   bool prepared = !checkdepth && P_prepareHeightClips(sector);
+   ++checkdepth;
    
    // killough 4/4/98: scan list front-to-back until empty or exhausted,
    // restarting from beginning after each thing is processed. Avoids
@@ -2747,6 +3147,10 @@ bool P_CheckSector(sector_t *sector, int crunch, int amt, int floorOrCeil)
       }
    }
    while(n); // repeat from scratch until all things left are marked valid
+
+   --checkdepth;
+   if(prepared)
+      numheightclips = 0;
    
    return !!nofit;
 }
@@ -2794,13 +3198,28 @@ void P_FreeSecNodeList(void)
 //
 // killough 11/98: reformatted
 //
+// Nodes are allocated this many at a time, and never given back to the zone
+// before the level ends.
+#define SECNODESLAB 256
+
 static msecnode_t *P_GetSecnode(void)
 {
    msecnode_t *node;
 
-   return headsecnode ?
-   node = headsecnode, headsecnode = node->m_snext, node :
-      (msecnode_t *)(Z_Malloc(sizeof *node, PU_LEVEL, NULL)); 
+   if(!headsecnode)
+   {
+      msecnode_t *slab = 
+         (msecnode_t *)(Z_Malloc(SECNODESLAB * sizeof *node, PU_LEVEL, NULL));
+
+      for(int i = 0; i < SECNODESLAB - 1; i++)
+         slab[i].m_snext = &slab[i + 1];
+      slab[SECNODESLAB - 1].m_snext = NULL;
+      headsecnode = slab;
+   }
+
+   node = headsecnode;
+   headsecnode = node->m_snext;
+   return node;
 }
 
 //
@@ -3016,6 +3435,186 @@ static bool PIT_GetSectors(line_t *ld, polyobj_s *po, void *context)
    return true;
 }
 
+//
+// Sector list caching
+//
+// Most moves of a thing leave it touching the same sectors as before. The
+// lines of its blocks that come near it are remembered along with whether
+// each one crossed its box; while its box stays within the area they were
+// gathered for, its blocks and center sector are the same and no line
+// crosses it differently, the sector list it has is the one a rebuild would
+// make, so it is kept as it is. Only used without portal groups, and where
+// the clip stack keeps the rebuild from leaving anything behind.
+//
+
+// how far a thing may move before its lines are gathered again
+#define SECCACHEMARGIN (32*FRACUNIT)
+
+struct seccache_t
+{
+   fixed_t     area[4];        // lines overlapping this box were gathered
+   int         xl, xh, yl, yh; // blocks they came from
+   sector_t   *center;         // sector of the thing's center
+   msecnode_t *list;           // sector list made for the thing
+   int         numlines;
+   int         maxlines;
+   line_t    **lines;
+   bool       *crossing;       // whether each line crossed the thing's box
+};
+
+//
+// Tells whether a line crosses a box, the same way PIT_GetSectors does it
+// without portal groups.
+//
+static bool P_lineCrossesBox(const line_t *ld, const fixed_t *bbox)
+{
+   if(bbox[BOXRIGHT]  <= ld->bbox[BOXLEFT]   ||
+      bbox[BOXLEFT]   >= ld->bbox[BOXRIGHT]  ||
+      bbox[BOXTOP]    <= ld->bbox[BOXBOTTOM] ||
+      bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+      return false;
+
+   return P_BoxOnLineSide(bbox, ld) == -1;
+}
+
+//
+// Tells whether any of a range of blocks holds a polyobject, whose lines
+// move on their own.
+//
+static bool P_blocksHavePolyobjs(int xl, int xh, int yl, int yh)
+{
+   for(int bx = xl; bx <= xh; bx++)
+   {
+      for(int by = yl; by <= yh; by++)
+      {
+         if(bx >= 0 && by >= 0 && bx < bmapwidth && by < bmapheight &&
+            polyblocklinks[by * bmapwidth + bx])
+            return true;
+      }
+   }
+   return false;
+}
+
+//
+// Adds a line near the thing to its cache
+//
+static bool PIT_CacheSecLine(line_t *ld, polyobj_s *po, void *context)
+{
+   seccache_t *cache = static_cast<seccache_t *>(context);
+
+   if(cache->area[BOXRIGHT]  <= ld->bbox[BOXLEFT]   ||
+      cache->area[BOXLEFT]   >= ld->bbox[BOXRIGHT]  ||
+      cache->area[BOXTOP]    <= ld->bbox[BOXBOTTOM] ||
+      cache->area[BOXBOTTOM] >= ld->bbox[BOXTOP])
+      return true;
+
+   if(cache->numlines == cache->maxlines)
+   {
+      cache->maxlines = cache->maxlines ? cache->maxlines * 2 : 16;
+      cache->lines = (line_t **)(Z_Realloc(cache->lines, 
+         cache->maxlines * sizeof(line_t *), PU_LEVEL, NULL));
+      cache->crossing = (bool *)(Z_Realloc(cache->crossing,
+         cache->maxlines * sizeof(bool), PU_LEVEL, NULL));
+   }
+   cache->lines[cache->numlines]    = ld;
+   cache->crossing[cache->numlines] = P_lineCrossesBox(ld, pClip->bbox);
+   ++cache->numlines;
+
+   return true;
+}
+
+//
+// Gathers the lines near a thing after its sector list was rebuilt
+//
+static void P_cacheSecLines(Mobj *thing, int xl, int xh, int yl, int yh,
+                            msecnode_t *list)
+{
+   seccache_t *cache = thing->seccache;
+
+   if(P_blocksHavePolyobjs(xl, xh, yl, yh))
+   {
+      if(cache)
+         cache->list = NULL; // not usable
+      return;
+   }
+
+   if(!cache)
+   {
+      // no user: the thing may be freed without being removed first
+      cache = (seccache_t *)(Z_Calloc(1, sizeof(seccache_t), PU_LEVEL, NULL));
+      thing->seccache = cache;
+   }
+
+   cache->area[BOXTOP]    = pClip->bbox[BOXTOP]    + SECCACHEMARGIN;
+   cache->area[BOXBOTTOM] = pClip->bbox[BOXBOTTOM] - SECCACHEMARGIN;
+   cache->area[BOXRIGHT]  = pClip->bbox[BOXRIGHT]  + SECCACHEMARGIN;
+   cache->area[BOXLEFT]   = pClip->bbox[BOXLEFT]   - SECCACHEMARGIN;
+   cache->xl = xl;
+   cache->xh = xh;
+   cache->yl = yl;
+   cache->yh = yh;
+   cache->center   = thing->subsector->sector;
+   cache->list     = list;
+   cache->numlines = 0;
+
+   // a private context leaves validcount alone
+   QueryContext *query = QueryContext::Acquire();
+   for(int bx = xl; bx <= xh; bx++)
+   {
+      for(int by = yl; by <= yh; by++)
+         P_BlockLinesIterator(*query, bx, by, PIT_CacheSecLine, R_NOGROUP, cache);
+   }
+   QueryContext::Release(query);
+}
+
+//
+// Tells whether the sector list the thing has is still the one it would get
+// at the position in pClip.
+//
+static bool P_secListStillValid(const Mobj *thing, int xl, int xh, int yl, int yh)
+{
+   const seccache_t *cache = thing->seccache;
+
+   if(!cache || !cache->list || cache->list != thing->old_sectorlist ||
+      cache->center != thing->subsector->sector ||
+      cache->xl != xl || cache->xh != xh || cache->yl != yl || cache->yh != yh)
+      return false;
+
+   if(pClip->bbox[BOXTOP]    > cache->area[BOXTOP]    ||
+      pClip->bbox[BOXBOTTOM] < cache->area[BOXBOTTOM] ||
+      pClip->bbox[BOXRIGHT]  > cache->area[BOXRIGHT]  ||
+      pClip->bbox[BOXLEFT]   < cache->area[BOXLEFT])
+      return false;
+
+   // a polyobject may have moved in since
+   if(P_blocksHavePolyobjs(xl, xh, yl, yh))
+      return false;
+
+   for(int i = 0; i < cache->numlines; i++)
+   {
+      if(P_lineCrossesBox(cache->lines[i], pClip->bbox) != cache->crossing[i])
+         return false;
+   }
+
+   return true;
+}
+
+//
+// P_FreeSecCache
+//
+// Frees a thing's sector list cache, when it goes away.
+//
+void P_FreeSecCache(Mobj *thing)
+{
+   if(thing->seccache)
+   {
+      Z_Free(thing->seccache->lines);
+      Z_Free(thing->seccache->crossing);
+      Z_Free(thing->seccache);
+      thing->seccache = NULL;
+   }
+}
+
 //
 // P_CreateSecNodeList 
 //
@@ -3030,6 +3629,7 @@ static bool PIT_GetSectors(line_t *ld, polyobj_s *po, void *context)
 msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
 {
    msecnode_t *node, *list;
+   bool cacheable = !useportalgroups && (demo_version < 200 || demo_version >= 329);
 
    if(demo_version < 200 || demo_version >= 329)
       P_PushClipStack();
@@ -3096,7 +3696,21 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
                }
             }
          }
-         P_BlockLinesIterator(x, y, PIT_GetSectors, groupid);
+
+         // the box PIT_GetSectors tests the lines of this group against
+         fixed_t box[4];
+         const fixed_t *linebox = nullptr;
+         if(groupid != R_NOGROUP)
+         {
+            const linkoffset_t *link = P_GetLinkOffset(pClip->thing->groupid, groupid);
+            box[BOXRIGHT]  = pClip->bbox[BOXRIGHT]  + link->x;
+            box[BOXLEFT]   = pClip->bbox[BOXLEFT]   + link->x;
+            box[BOXTOP]    = pClip->bbox[BOXTOP]    + link->y;
+            box[BOXBOTTOM] = pClip->bbox[BOXBOTTOM] + link->y;
+            linebox = box;
+         }
+
+         P_BlockLinesIterator(x, y, PIT_GetSectors, groupid, nullptr, linebox);
          return true;
       });
       list = pClip->sector_list;
@@ -3109,10 +3723,23 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
       int yl = (pClip->bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
       int yh = (pClip->bbox[BOXTOP   ] - bmaporgy) >> MAPBLOCKSHIFT;
 
+      if(cacheable && P_secListStillValid(thing, xl, xh, yl, yh))
+      {
+         // nothing has changed; every node would just be kept
+         for(node = thing->old_sectorlist; node; node = node->m_tnext)
+            node->m_thing = thing;
+         P_PopClipStack();
+         return thing->old_sectorlist;
+      }
+
       for(int bx = xl; bx <= xh; bx++)
       {
          for(int by = yl; by <= yh; by++)
-            P_BlockLinesIterator(bx, by, PIT_GetSectors);
+         {
+            // with portal groups, PIT_GetSectors offsets its box per line
+            P_BlockLinesIterator(bx, by, PIT_GetSectors, R_NOGROUP, nullptr,
+                                 useportalgroups ? nullptr : pClip->bbox);
+         }
       }
 
       // Add the sector of the (x,y) point to sector_list.
@@ -3134,6 +3761,16 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
          node = node->m_tnext;
    }
 
+   if(cacheable)
+   {
+      P_cacheSecLines(thing, 
+                      (pClip->bbox[BOXLEFT  ] - bmaporgx) >> MAPBLOCKSHIFT,
+                      (pClip->bbox[BOXRIGHT ] - bmaporgx) >> MAPBLOCKSHIFT,
+                      (pClip->bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT,
+                      (pClip->bbox[BOXTOP   ] - bmaporgy) >> MAPBLOCKSHIFT,
+                      list);
+   }
+
   /* cph -
    * This is the strife we get into for using global variables. 
    *  clip.thing is being used by several different functions calling
@@ -3150,6 +3787,14 @@ msecnode_t *P_CreateSecNodeList(Mobj *thing, fixed_t x, fixed_t y)
    return list;
 }
 
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_TOGGLE(p_parallelclip, NULL, onoff);
+CONSOLE_VARIABLE(p_parallelclip, p_parallelclip, 0) {}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_map.c,v $
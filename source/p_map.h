@@ -132,6 +132,15 @@ enum
 void P_RadiusAttack(Mobj *spot, Mobj *source, int damage, int distance, 
                     int mod, unsigned int flags);
 
+// A thing found by P_FindThingsInRange
+struct thingdist_t
+{
+   Mobj *thing;
+   int   dist;  // map units from the origin to the edge of the thing
+};
+
+void P_FindThingsInRange(Mobj *origin, int range, PODCollection<thingdist_t> &found);
+
 //=============================================================================
 //
 // Sector Motion
@@ -158,6 +167,7 @@ void P_ApplyTorque(Mobj *mo);                       // killough 9/12/98
 void P_DelSeclist(msecnode_t *); // phares 3/16/98
 void P_FreeSecNodeList();        // sf
 msecnode_t *P_CreateSecNodeList(Mobj *, fixed_t, fixed_t);  // phares 3/14/98
+void P_FreeSecCache(Mobj *thing);
 
 //=============================================================================
 //
@@ -623,8 +623,25 @@ bool P_CheckPosition3D(Mobj *thing, fixed_t x, fixed_t y, PODCollection<line_t *
    if(!P_TransPortalBlockWalker(bbox, thing->groupid, true, pushhit, 
       [](int x, int y, int groupid, void *data) -> bool
    {
+      // the box PIT_CheckLine3D tests the lines of this group against
+      fixed_t box[4];
+      const fixed_t *linebox = clip.bbox;
+      if(useportalgroups && full_demo_version >= make_full_version(340, 48))
+      {
+         linebox = nullptr;
+         if(groupid != R_NOGROUP)
+         {
+            const linkoffset_t *link = P_GetLinkOffset(clip.thing->groupid, groupid);
+            box[BOXLEFT]   = clip.bbox[BOXLEFT]   + link->x;
+            box[BOXBOTTOM] = clip.bbox[BOXBOTTOM] + link->y;
+            box[BOXRIGHT]  = clip.bbox[BOXRIGHT]  + link->x;
+            box[BOXTOP]    = clip.bbox[BOXTOP]    + link->y;
+            linebox = box;
+         }
+      }
+
       // ioanch 20160112: try 3D portal check-line
-      if(!P_BlockLinesIterator(x, y, PIT_CheckLine3D, groupid, data))
+      if(!P_BlockLinesIterator(x, y, PIT_CheckLine3D, groupid, data, linebox))
          return false; // doesn't fit
       return true;
    }))
@@ -31,10 +31,12 @@
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "m_bbox.h"
+#include "m_compare.h"
 #include "p_map.h"
 #include "p_map3d.h"
 #include "p_maputl.h"
 #include "p_portalclip.h"
+#include "p_querycontext.h"
 #include "p_setup.h"
 #include "polyobj.h"
 #include "r_data.h"
@@ -278,8 +280,10 @@ fixed_t P_InterceptVector(const divline_t *v2, const divline_t *v1)
 // OPTIMIZE: keep this precalculated
 // ioanch 20160113: added portal detection (optional)
 //
-void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
-                   uint32_t *lineclipflags)
+// The results go into inter, which needn't be the global inter.
+//
+void P_LineOpening(doom_mapinter_t &inter, const line_t *linedef, const Mobj *mo,
+                   bool portaldetect, uint32_t *lineclipflags)
 {
    fixed_t frontceilz, frontfloorz, backceilz, backfloorz;
    // SoM: used for 3dmidtex
@@ -287,7 +291,7 @@ void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
 
    if(linedef->sidenum[1] == -1)      // single sided line
    {
-      clip.openrange = 0;
+      inter.openrange = 0;
       return;
    }
 
@@ -295,115 +299,115 @@ void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
    {
       *lineclipflags = 0;
    }
-   clip.openfrontsector = linedef->frontsector;
-   clip.openbacksector  = linedef->backsector;
+   inter.openfrontsector = linedef->frontsector;
+   inter.openbacksector  = linedef->backsector;
    sector_t *beyond = linedef->intflags & MLI_1SPORTALLINE &&
       linedef->beyondportalline ?
       linedef->beyondportalline->frontsector : nullptr;
    if(beyond)
-      clip.openbacksector = beyond;
+      inter.openbacksector = beyond;
 
    // SoM: ok, new plan. The only way a 2s line should give a lowered floor or hightened ceiling
    // z is if both sides of that line have the same portal.
    {
 #ifdef R_LINKEDPORTALS
       if(mo && demo_version >= 333 &&
-         ((clip.openfrontsector->c_pflags & PS_PASSABLE &&
-         clip.openbacksector->c_pflags & PS_PASSABLE && 
-         clip.openfrontsector->c_portal == clip.openbacksector->c_portal) ||
-         (clip.openfrontsector->c_pflags & PS_PASSABLE &&
+         ((inter.openfrontsector->c_pflags & PS_PASSABLE &&
+         inter.openbacksector->c_pflags & PS_PASSABLE && 
+         inter.openfrontsector->c_portal == inter.openbacksector->c_portal) ||
+         (inter.openfrontsector->c_pflags & PS_PASSABLE &&
           linedef->pflags & PS_PASSABLE &&
-          clip.openfrontsector->c_portal
+          inter.openfrontsector->c_portal
           ->data.link.deltaEquals(linedef->portal->data.link))))
       {
          // also handle line portal + ceiling portal, for edge portals
          if(!portaldetect) // ioanch
          {
-            frontceilz = backceilz = clip.openfrontsector->ceilingheight
+            frontceilz = backceilz = inter.openfrontsector->ceilingheight
             + (1024 * FRACUNIT);
          }
          else
          {
             *lineclipflags |= LINECLIP_UNDERPORTAL;
-            frontceilz = clip.openfrontsector->ceilingheight;
-            backceilz  = clip.openbacksector->ceilingheight;
+            frontceilz = inter.openfrontsector->ceilingheight;
+            backceilz  = inter.openbacksector->ceilingheight;
          }
       }
       else
 #endif
       {
-         frontceilz = clip.openfrontsector->ceilingheight;
-         backceilz  = clip.openbacksector->ceilingheight;
+         frontceilz = inter.openfrontsector->ceilingheight;
+         backceilz  = inter.openbacksector->ceilingheight;
       }
       
-      frontcz = clip.openfrontsector->ceilingheight;
-      backcz  = clip.openbacksector->ceilingheight;
+      frontcz = inter.openfrontsector->ceilingheight;
+      backcz  = inter.openbacksector->ceilingheight;
    }
 
 
    {
 #ifdef R_LINKEDPORTALS
       if(mo && demo_version >= 333 && 
-         ((clip.openfrontsector->f_pflags & PS_PASSABLE &&
-         clip.openbacksector->f_pflags & PS_PASSABLE && 
-         clip.openfrontsector->f_portal == clip.openbacksector->f_portal) ||
-          (clip.openfrontsector->f_pflags & PS_PASSABLE &&
+         ((inter.openfrontsector->f_pflags & PS_PASSABLE &&
+         inter.openbacksector->f_pflags & PS_PASSABLE && 
+         inter.openfrontsector->f_portal == inter.openbacksector->f_portal) ||
+          (inter.openfrontsector->f_pflags & PS_PASSABLE &&
            linedef->pflags & PS_PASSABLE &&
-           clip.openfrontsector->f_portal
+           inter.openfrontsector->f_portal
            ->data.link.deltaEquals(linedef->portal->data.link))))
       {
          if(!portaldetect)  // ioanch
          {
-            frontfloorz = backfloorz = clip.openfrontsector->floorheight - (1024 * FRACUNIT); //mo->height;
+            frontfloorz = backfloorz = inter.openfrontsector->floorheight - (1024 * FRACUNIT); //mo->height;
          }
          else
          {
             *lineclipflags |= LINECLIP_ABOVEPORTAL;
-            frontfloorz = clip.openfrontsector->floorheight;
-            backfloorz  = clip.openbacksector->floorheight;
+            frontfloorz = inter.openfrontsector->floorheight;
+            backfloorz  = inter.openbacksector->floorheight;
          }
       }
       else 
 #endif
       {
-         frontfloorz = clip.openfrontsector->floorheight;
-         backfloorz  = clip.openbacksector->floorheight;
+         frontfloorz = inter.openfrontsector->floorheight;
+         backfloorz  = inter.openbacksector->floorheight;
       }
 
-      frontfz = clip.openfrontsector->floorheight;
-      backfz = clip.openbacksector->floorheight;
+      frontfz = inter.openfrontsector->floorheight;
+      backfz = inter.openbacksector->floorheight;
    }
 
-   if(linedef->extflags & EX_ML_UPPERPORTAL && clip.openbacksector->c_pflags & PS_PASSABLE)
-      clip.opentop = frontceilz;
+   if(linedef->extflags & EX_ML_UPPERPORTAL && inter.openbacksector->c_pflags & PS_PASSABLE)
+      inter.opentop = frontceilz;
    else if(frontceilz < backceilz)
-      clip.opentop = frontceilz;
+      inter.opentop = frontceilz;
    else
-      clip.opentop = backceilz;
+      inter.opentop = backceilz;
 
    // ioanch 20160114: don't change floorpic if portaldetect is on
-   if(linedef->extflags & EX_ML_LOWERPORTAL && clip.openbacksector->f_pflags & PS_PASSABLE)
+   if(linedef->extflags & EX_ML_LOWERPORTAL && inter.openbacksector->f_pflags & PS_PASSABLE)
    {
-      clip.openbottom = frontfloorz;
-      clip.lowfloor = frontfloorz;
-      if(!portaldetect || !(clip.openfrontsector->f_pflags & PS_PASSABLE))
-         clip.floorpic = clip.openfrontsector->floorpic;
+      inter.openbottom = frontfloorz;
+      inter.lowfloor = frontfloorz;
+      if(!portaldetect || !(inter.openfrontsector->f_pflags & PS_PASSABLE))
+         inter.floorpic = inter.openfrontsector->floorpic;
    }
    else if(frontfloorz > backfloorz)
    {
-      clip.openbottom = frontfloorz;
-      clip.lowfloor = backfloorz;
+      inter.openbottom = frontfloorz;
+      inter.lowfloor = backfloorz;
       // haleyjd
-      if(!portaldetect || !(clip.openfrontsector->f_pflags & PS_PASSABLE))
-         clip.floorpic = clip.openfrontsector->floorpic;
+      if(!portaldetect || !(inter.openfrontsector->f_pflags & PS_PASSABLE))
+         inter.floorpic = inter.openfrontsector->floorpic;
    }
    else
    {
-      clip.openbottom = backfloorz;
-      clip.lowfloor = frontfloorz;
+      inter.openbottom = backfloorz;
+      inter.lowfloor = frontfloorz;
       // haleyjd
-      if(!portaldetect || !(clip.openbacksector->f_pflags & PS_PASSABLE))
-         clip.floorpic = clip.openbacksector->floorpic;
+      if(!portaldetect || !(inter.openbacksector->f_pflags & PS_PASSABLE))
+         inter.floorpic = inter.openbacksector->floorpic;
    }
 
    if(frontcz < backcz)
@@ -416,8 +420,8 @@ void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
    else
       obot = backfz;
 
-   clip.opensecfloor = clip.openbottom;
-   clip.opensecceil  = clip.opentop;
+   inter.opensecfloor = inter.openbottom;
+   inter.opensecceil  = inter.opentop;
 
    // SoM 9/02/02: Um... I know I told Quasar` I would do this after 
    // I got SDL_Mixer support and all, but I WANT THIS NOW hehe
@@ -449,31 +453,31 @@ void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
          !(mo->flags & (MF_FLOAT | MF_DROPOFF)) &&
          D_abs(mo->z - textop) <= STEPSIZE)
       {
-         clip.opentop = clip.openbottom;
-         clip.openrange = 0;
+         inter.opentop = inter.openbottom;
+         inter.openrange = 0;
          return;
       }
       
       if(mo->z + (P_ThingInfoHeight(mo->info) / 2) < texmid)
       {
-         if(texbot < clip.opentop)
-            clip.opentop = texbot;
+         if(texbot < inter.opentop)
+            inter.opentop = texbot;
          // ioanch 20160318: mark if 3dmidtex affects clipping
          // Also don't flag lines that are offset into the floor/ceiling
-         if(portaldetect && (texbot < clip.openfrontsector->ceilingheight ||
-                             texbot < clip.openbacksector->ceilingheight))
+         if(portaldetect && (texbot < inter.openfrontsector->ceilingheight ||
+                             texbot < inter.openbacksector->ceilingheight))
          {
             *lineclipflags |= LINECLIP_UNDER3DMIDTEX;
          }
       }
       else
       {
-         if(textop > clip.openbottom)
-            clip.openbottom = textop;
+         if(textop > inter.openbottom)
+            inter.openbottom = textop;
          // ioanch 20160318: mark if 3dmidtex affects clipping
          // Also don't flag lines that are offset into the floor/ceiling
-         if(portaldetect && (textop > clip.openfrontsector->floorheight ||
-                             textop > clip.openbacksector->floorheight))
+         if(portaldetect && (textop > inter.openfrontsector->floorheight ||
+                             textop > inter.openbacksector->floorheight))
          {
             *lineclipflags |= LINECLIP_OVER3DMIDTEX;
          }
@@ -481,11 +485,17 @@ void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
          // The mobj is above the 3DMidTex, so check to see if it's ON the 3DMidTex
          // SoM 01/12/06: let monsters walk over dropoffs
          if(abs(mo->z - textop) <= STEPSIZE)
-            clip.touch3dside = 1;
+            inter.touch3dside = 1;
       }
    }
 
-   clip.openrange = clip.opentop - clip.openbottom;
+   inter.openrange = inter.opentop - inter.openbottom;
+}
+
+void P_LineOpening(const line_t *linedef, const Mobj *mo, bool portaldetect,
+                   uint32_t *lineclipflags)
+{
+   P_LineOpening(clip, linedef, mo, portaldetect, lineclipflags);
 }
 
 //
@@ -710,6 +720,169 @@ bool ThingIsOnLine(const Mobj *t, const line_t *l)
 // exit with false without checking anything else.
 //
 
+//
+// Collision blockmap
+//
+// A copy of the line lists of the blockmap, laid out as parallel arrays
+// holding each entry's line number, bounding box and portal group, so that
+// P_BlockLinesIterator can reject the lines of a block which a box doesn't
+// touch without reading their line_t. The entries keep their blockmap order,
+// and every list still starts with its delimiter, so the same lines are
+// visited in the same order as through blockmaplump.
+//
+struct blocklineboxes_t
+{
+   int     *cellstart; // first entry of each block, plus one past the end
+   int     *lineno;    // line number, or -1 for an invalid entry
+   fixed_t *box[4];    // line bounding boxes, indexed by BOXTOP etc.
+   int     *groupid;   // portal group of the line's front sector
+};
+
+static blocklineboxes_t blockboxes;
+
+//
+// P_BuildBlockLineBoxes
+//
+// Builds the collision blockmap from blockmaplump. Must be called once level
+// setup is done, since it needs the portal groups and polyobject lines. If
+// lumpcount is not negative, no list may go past that many ints of
+// blockmaplump (which is the case of a blockmap that wasn't verified).
+//
+void P_BuildBlockLineBoxes(int lumpcount)
+{
+   int numcells = bmapwidth * bmapheight;
+   int total = 0;
+
+   // count the entries, and make sure every list ends where expected
+   for(int i = 0; i < numcells; i++)
+   {
+      int offset = blockmap[i];
+      int count  = 0;
+
+      for(;; count++)
+      {
+         if(lumpcount >= 0 && (offset < 0 || offset + count >= lumpcount))
+            return; // malformed; blocks get walked as they are
+         if(blockmaplump[offset + count] == -1)
+            break;
+      }
+      total += count;
+   }
+
+   size_t size = sizeof(int) * (numcells + 1) + 
+                 (sizeof(int) * 2 + sizeof(fixed_t) * 4) * total;
+   byte *data = emalloctag(byte *, size, PU_LEVEL, (void **)&blockboxes.cellstart);
+
+   // the cell starts come first, since their pointer is the one the zone
+   // clears when the level is freed
+   blockboxes.cellstart = reinterpret_cast<int *>(data);
+   blockboxes.lineno    = blockboxes.cellstart + numcells + 1;
+   blockboxes.groupid   = blockboxes.lineno + total;
+   for(int j = 0; j < 4; j++)
+      blockboxes.box[j] = reinterpret_cast<fixed_t *>(blockboxes.groupid + total) + j * total;
+
+   // polyobject lines move, so they get a box that is always hit, and the
+   // callback checks them against their current one
+   byte *polyline = ecalloc(byte *, numlines, 1);
+   for(int i = 0; i < numPolyObjects; i++)
+   {
+      for(int j = 0; j < PolyObjects[i].numLines; j++)
+         polyline[PolyObjects[i].lines[j] - lines] = 1;
+   }
+
+   int n = 0;
+   for(int i = 0; i < numcells; i++)
+   {
+      blockboxes.cellstart[i] = n;
+      for(const int *list = blockmaplump + blockmap[i]; *list != -1; list++, n++)
+      {
+         if(*list >= numlines)
+         {
+            // an empty box, so it's never hit
+            blockboxes.lineno[n] = -1;
+            blockboxes.groupid[n] = R_NOGROUP;
+            blockboxes.box[BOXLEFT][n] = blockboxes.box[BOXBOTTOM][n] = D_MAXINT;
+            blockboxes.box[BOXRIGHT][n] = blockboxes.box[BOXTOP][n] = D_MININT;
+            continue;
+         }
+
+         const line_t *ld = &lines[*list];
+         blockboxes.lineno[n]  = *list;
+         blockboxes.groupid[n] = ld->frontsector ? ld->frontsector->groupid : R_NOGROUP;
+         if(polyline[*list])
+         {
+            blockboxes.box[BOXLEFT][n] = blockboxes.box[BOXBOTTOM][n] = D_MININT;
+            blockboxes.box[BOXRIGHT][n] = blockboxes.box[BOXTOP][n] = D_MAXINT;
+            continue;
+         }
+         for(int j = 0; j < 4; j++)
+            blockboxes.box[j][n] = ld->bbox[j];
+      }
+   }
+   blockboxes.cellstart[numcells] = n;
+
+   efree(polyline);
+}
+
+//
+// Walks the line list of a block through the collision blockmap, skipping the
+// lines whose bounding box doesn't strictly overlap bbox. Returns -1 if the
+// block has to be walked through blockmaplump instead.
+//
+static int P_blockLinesBoxed(QueryContext &query, int offset, bool skipfirst,
+                             const fixed_t *bbox,
+                             bool func(line_t *, polyobj_t *, void *),
+                             int groupid, void *context)
+{
+   enum { CHUNK = 64 };
+
+   int start = blockboxes.cellstart[offset];
+   int end   = blockboxes.cellstart[offset + 1];
+
+   if(skipfirst)
+   {
+      // an empty list without the delimiter would make it skip into the
+      // next list, which only blockmaplump can reproduce
+      if(start == end)
+         return -1;
+      start++;
+   }
+
+   const fixed_t *left   = blockboxes.box[BOXLEFT];
+   const fixed_t *right  = blockboxes.box[BOXRIGHT];
+   const fixed_t *bottom = blockboxes.box[BOXBOTTOM];
+   const fixed_t *top    = blockboxes.box[BOXTOP];
+   byte hit[CHUNK];
+
+   for(int base = start; base < end; base += CHUNK)
+   {
+      int count = emin(end - base, static_cast<int>(CHUNK));
+
+      // no branches here, so the compiler can vectorize it
+      for(int i = 0; i < count; i++)
+      {
+         hit[i] = (left[base + i]   < bbox[BOXRIGHT]) & (right[base + i] > bbox[BOXLEFT]) &
+                  (bottom[base + i] < bbox[BOXTOP])   & (top[base + i]   > bbox[BOXBOTTOM]);
+      }
+
+      for(int i = 0; i < count; i++)
+      {
+         if(!hit[i])
+            continue;
+         if(groupid != R_NOGROUP && groupid != blockboxes.groupid[base + i])
+            continue;
+
+         line_t *ld = &lines[blockboxes.lineno[base + i]];
+         if(!query.markLine(*ld))
+            continue;       // line has already been checked
+         if(!func(ld, nullptr, context))
+            return 0;
+      }
+   }
+
+   return 1;
+}
+
 //
 // P_BlockLinesIterator
 // The validcount flags are used to avoid checking lines
@@ -722,8 +895,17 @@ bool ThingIsOnLine(const Mobj *t, const line_t *l)
 // ioanch 20160111: added groupid
 // ioanch 20160114: enhanced the callback
 //
-bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *), int groupid,
-   void *context)
+// If bbox is given, lines whose bounding box doesn't strictly overlap it may
+// be left out without calling func. Only pass it if func does nothing but
+// return true for such lines.
+//
+// Lines and polyobjects are marked as visited in the given query context;
+// call its newQuery instead of incrementing validcount. The overload without
+// one uses the global context.
+//
+bool P_BlockLinesIterator(QueryContext &query, int x, int y,
+                          bool func(line_t*, polyobj_t*, void *), int groupid,
+                          void *context, const fixed_t *bbox)
 {
    int        offset;
    const int  *list;     // killough 3/1/98: for removal of blockmap limit
@@ -740,16 +922,14 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
    {
       polyobj_t *po = (*plink)->po;
 
-      if(po->validcount != validcount) // if polyobj hasn't been checked
+      if(query.markPolyobj(*po)) // if polyobj hasn't been checked
       {
          int i;
-         po->validcount = validcount;
          
          for(i = 0; i < po->numLines; ++i)
          {
-            if(po->lines[i]->validcount == validcount) // line has been checked
+            if(!query.markLine(*po->lines[i])) // line has been checked
                continue;
-            po->lines[i]->validcount = validcount;
             if(!func(po->lines[i], po, context))
                return false;
          }
@@ -757,10 +937,6 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
       plink = plink->dllNext;
    }
 
-   // original was reading delimiting 0 as linedef 0 -- phares
-   offset = *(blockmap + offset);
-   list = blockmaplump + offset;
-
    // MaxW: 2016/02/02: This skip isn't feasible to do for recent play,
    // as it has been found that the starting delimiter can have a use.
 
@@ -771,7 +947,22 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
    // MaxW: 2016/02/02: if before 3.42 always skip, skip if all blocklists start w/ 0
    // killough 2/22/98: demo_compatibility check
    // skip 0 starting delimiter -- phares
-   if((!demo_compatibility && demo_version < 342) || (demo_version >= 342 && skipblstart))
+   bool skipfirst = (!demo_compatibility && demo_version < 342) || 
+                    (demo_version >= 342 && skipblstart);
+
+   if(bbox && blockboxes.cellstart)
+   {
+      int result = P_blockLinesBoxed(query, offset, skipfirst, bbox, func, groupid,
+                                     context);
+      if(result >= 0)
+         return !!result;
+   }
+
+   // original was reading delimiting 0 as linedef 0 -- phares
+   offset = *(blockmap + offset);
+   list = blockmaplump + offset;
+
+   if(skipfirst)
       list++;     
    for( ; *list != -1; list++)
    {
@@ -786,15 +977,20 @@ bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *),
       // ioanch 20160111: check groupid
       if(groupid != R_NOGROUP && groupid != ld->frontsector->groupid)
          continue;
-      if(ld->validcount == validcount)
+      if(!query.markLine(*ld))
          continue;       // line has already been checked
-      ld->validcount = validcount;
       if(!func(ld, nullptr, context))
          return false;
    }
    return true;  // everything was checked
 }
 
+bool P_BlockLinesIterator(int x, int y, bool func(line_t*, polyobj_t*, void *), int groupid,
+   void *context, const fixed_t *bbox)
+{
+   return P_BlockLinesIterator(QueryContext::Global(), x, y, func, groupid, context, bbox);
+}
+
 //
 // P_BlockThingsIterator
 //
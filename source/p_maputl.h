@@ -30,10 +30,12 @@
 #include "m_vector.h"
 #include "tables.h" // for angle_t
 
+struct doom_mapinter_t;
 struct line_t;
 class  Mobj;
 struct mobjinfo_t;
 struct polyobj_s; // ioanch 20160114
+class  QueryContext;
 struct subsector_t;
 
 // mapblocks are used to check movement against lines and things
@@ -119,11 +121,20 @@ int P_BoxOnDivlineSide(const fixed_t *tmbox, const divline_t &dl);
 // ioanch 20150113: added optional portal detection
 void    P_LineOpening (const line_t *linedef, const Mobj *mo,
                        bool portaldetect = false, uint32_t *lineclipflags = nullptr);
+void    P_LineOpening (doom_mapinter_t &inter, const line_t *linedef,
+                       const Mobj *mo, bool portaldetect = false,
+                       uint32_t *lineclipflags = nullptr);
 
 void P_UnsetThingPosition(Mobj *thing);
 void P_SetThingPosition(Mobj *thing);
+void P_BuildBlockLineBoxes(int lumpcount);
 bool P_BlockLinesIterator (int x, int y, bool func(line_t *, polyobj_s *, void *),
-                           int groupid = R_NOGROUP, void *context = nullptr);
+                           int groupid = R_NOGROUP, void *context = nullptr,
+                           const fixed_t *bbox = nullptr);
+bool P_BlockLinesIterator (QueryContext &query, int x, int y,
+                           bool func(line_t *, polyobj_s *, void *),
+                           int groupid = R_NOGROUP, void *context = nullptr,
+                           const fixed_t *bbox = nullptr);
 bool P_BlockThingsIterator(int x, int y, int groupid, bool (*func)(Mobj *, void *),
                            void *context = nullptr);
 inline static bool P_BlockThingsIterator(int x, int y, bool func(Mobj *, void *),
@@ -135,6 +146,8 @@ inline static bool P_BlockThingsIterator(int x, int y, bool func(Mobj *, void *)
 bool ThingIsOnLine(const Mobj *t, const line_t *l);  // killough 3/15/98
 bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
                     int flags, traverser_t trav, void *context = nullptr);
+bool P_PathTraverse(QueryContext &query, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                    int flags, traverser_t trav, void *context = nullptr);
 
 angle_t P_PointToAngle(fixed_t xo, fixed_t yo, fixed_t x, fixed_t y);
 angle_t P_DoubleToAngle(double a);
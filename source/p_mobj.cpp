@@ -46,6 +46,7 @@
 #include "in_lude.h"
 #include "m_bbox.h"
 #include "m_collection.h"
+#include "m_compare.h"
 #include "m_random.h"
 #include "p_chase.h"
 #include "p_enemy.h"
@@ -59,6 +60,7 @@
 #include "p_portalcross.h"
 #include "p_saveg.h"
 #include "p_sector.h"
+#include "p_sightbatch.h"
 #include "p_skin.h"
 #include "p_tick.h"
 #include "p_spec.h"    // haleyjd 04/05/99: TerrainTypes
@@ -1752,6 +1754,18 @@ void Mobj::deSwizzle()
    dsInfo = NULL;
 }
 
+//
+// Mobj::stateHash
+//
+// Overrides Thinker::stateHash. Covers what a desync changes first: where
+// the thing is, and how much health it has left.
+//
+uint32_t Mobj::stateHash() const
+{
+   return uint32_t(x) ^ (uint32_t(y) * 0x9e3779b9u) ^ (uint32_t(z) * 0x85ebca6bu) ^
+          (uint32_t(health) * 0xc2b2ae35u) ^ (uint32_t(type) << 24);
+}
+
 //
 // Mobj::updateThinker
 //
@@ -2027,6 +2041,9 @@ void Mobj::remove()
    // haleyjd 02/02/04: remove from tid hash
    P_RemoveThingTID(this);
 
+   // no sight checks batched ahead of time may refer to it anymore
+   P_SightBatchForget(this);
+
    // unlink from sector and block lists
    P_UnsetThingPosition(this);
 
@@ -2036,6 +2053,7 @@ void Mobj::remove()
    // Delete all nodes on the current sector_list -- phares 3/16/98
    if(this->old_sectorlist)
       P_DelSeclist(this->old_sectorlist);
+   P_FreeSecCache(this);
 
    // haleyjd 08/13/10: ensure that the object cannot be relinked, and
    // nullify old_sectorlist to avoid multiple release of msecnodes.
@@ -2138,6 +2156,20 @@ void P_RespawnSpecials()
    iquetail = (iquetail+1)&(ITEMQUESIZE-1);
 }
 
+//
+// P_ArchiveItemRespawnQueue
+//
+// Saves or restores the item respawn queue. Savegames have never kept it, but
+// rewind snapshots need it to put a deathmatch level back exactly.
+//
+void P_ArchiveItemRespawnQueue(SaveArchive &arc)
+{
+   arc << iquehead << iquetail;
+
+   for(int i = iquetail; i != iquehead; i = (i + 1) & (ITEMQUESIZE-1))
+      arc << itemrespawnque[i] << itemrespawntime[i];
+}
+
 //
 // P_SpawnPlayer
 //
@@ -3423,10 +3455,75 @@ void P_ChangeThingHeights(void)
 // haleyjd 02/02/04: Thing IDs (aka TIDs)
 //
 
-#define TIDCHAINS 131
+// The things of each tid are kept together in one array, in the order they
+// were given it. The arrays are found through an open addressing table keyed
+// by tid, which doubles whenever it gets three quarters full. A thing losing
+// its tid leaves a null behind, so nothing moves; the holes are closed up
+// when an array runs out of room while at least half of it is holes, unless
+// a span is being walked.
+struct tidentry_t
+{
+   int    tid;    // 0 if the slot is free
+   Mobj **things;
+   int    numthings;
+   int    maxthings;
+   int    numholes;
+};
+
+#define MINTIDSLOTS 256
+
+static tidentry_t *tidtable;
+static int         numtidslots;
+static int         numtidsused;
+static int         numtidwalks; // spans being walked by position
+
+//
+// Returns the table slot for tid: the one holding it if there is one, or else
+// the free slot it would go into.
+//
+static tidentry_t *P_tidSlot(tidentry_t *table, int numslots, int tid)
+{
+   unsigned int mask = unsigned(numslots - 1);
+   unsigned int i    = (unsigned(tid) * 2654435761u) & mask;
+
+   while(table[i].tid && table[i].tid != tid)
+      i = (i + 1) & mask;
+
+   return &table[i];
+}
+
+//
+// Doubles the tid table, moving all entries into it.
+//
+static void P_growTIDTable()
+{
+   int newslots = numtidslots ? numtidslots * 2 : MINTIDSLOTS;
+   tidentry_t *newtable = ecalloc(tidentry_t *, newslots, sizeof(tidentry_t));
+
+   for(int i = 0; i < numtidslots; i++)
+   {
+      if(tidtable[i].tid)
+         *P_tidSlot(newtable, newslots, tidtable[i].tid) = tidtable[i];
+   }
 
-// TID hash chains
-static Mobj *tidhash[TIDCHAINS];
+   efree(tidtable);
+   tidtable    = newtable;
+   numtidslots = newslots;
+}
+
+//
+// Returns the entry for tid, or NULL if no thing was ever given it
+//
+static tidentry_t *P_findTIDEntry(int tid)
+{
+   tidentry_t *entry;
+
+   if(!numtidslots)
+      return NULL;
+
+   entry = P_tidSlot(tidtable, numtidslots, tid);
+   return entry->tid ? entry : NULL;
+}
 
 //
 // P_InitTIDHash
@@ -3435,7 +3532,13 @@ static Mobj *tidhash[TIDCHAINS];
 //
 void P_InitTIDHash(void)
 {
-   memset(tidhash, 0, TIDCHAINS*sizeof(Mobj *));
+   for(int i = 0; i < numtidslots; i++)
+      efree(tidtable[i].things);
+
+   efree(tidtable);
+   tidtable    = NULL;
+   numtidslots = 0;
+   numtidsused = 0;
 }
 
 //
@@ -3450,23 +3553,52 @@ void P_AddThingTID(Mobj *mo, int tid)
    if(tid <= 0)
    {
       mo->tid = 0;
-      mo->tid_next = NULL;
-      mo->tid_prevn = NULL;
+      mo->tid_index = 0;
    }
    else
    {
-      int key = tid % TIDCHAINS;
+      tidentry_t *entry;
 
       mo->tid = (uint16_t)tid;
 
-      // insert at head of chain
-      mo->tid_next  = tidhash[key];
-      mo->tid_prevn = &tidhash[key];
-      tidhash[key]  = mo;
+      if((numtidsused + 1) * 4 > numtidslots * 3)
+         P_growTIDTable();
 
-      // connect to any existing things in chain
-      if(mo->tid_next)
-         mo->tid_next->tid_prevn = &(mo->tid_next);
+      entry = P_tidSlot(tidtable, numtidslots, mo->tid);
+      if(!entry->tid)
+      {
+         entry->tid = mo->tid;
+         ++numtidsused;
+      }
+
+      // don't renumber the things under a walk; grow instead
+      if(entry->numthings == entry->maxthings && entry->numholes * 2 >= entry->numthings &&
+         !numtidwalks)
+      {
+         int count = 0;
+
+         for(int i = 0; i < entry->numthings; i++)
+         {
+            if(entry->things[i])
+            {
+               entry->things[count] = entry->things[i];
+               entry->things[count]->tid_index = count;
+               ++count;
+            }
+         }
+         entry->numthings = count;
+         entry->numholes  = 0;
+      }
+
+      if(entry->numthings == entry->maxthings)
+      {
+         entry->maxthings = entry->maxthings ? entry->maxthings * 2 : 8;
+         entry->things = erealloc(Mobj **, entry->things, 
+                                  entry->maxthings * sizeof(Mobj *));
+      }
+
+      mo->tid_index = entry->numthings;
+      entry->things[entry->numthings++] = mo;
    }
 }
 
@@ -3478,20 +3610,79 @@ void P_AddThingTID(Mobj *mo, int tid)
 //
 void P_RemoveThingTID(Mobj *mo)
 {
-   if(mo->tid > 0 && mo->tid_prevn)
+   tidentry_t *entry;
+
+   if(mo->tid > 0 && (entry = P_findTIDEntry(mo->tid)))
    {
-      // set previous thing's next field to this thing's next thing
-      *(mo->tid_prevn) = mo->tid_next;
+      int i = mo->tid_index;
 
-      // set next thing's prev field to this thing's prev field
-      if(mo->tid_next)
-         mo->tid_next->tid_prevn = mo->tid_prevn;
+      if(i >= entry->numthings || entry->things[i] != mo)
+      {
+         for(i = 0; i < entry->numthings && entry->things[i] != mo; i++)
+            ;
+      }
+
+      if(i < entry->numthings)
+      {
+         entry->things[i] = NULL;
+         ++entry->numholes;
+         mo->tid_index = i;
+
+         // holes at the end need no closing up
+         while(entry->numthings && !entry->things[entry->numthings - 1])
+         {
+            --entry->numthings;
+            --entry->numholes;
+         }
+      }
    }
 
    // clear tid
    mo->tid = 0;
 }
 
+//
+// P_GetTIDSpan
+//
+// Points things at all the things with the given tid, oldest first, and
+// returns the length of the span. Things which have lost the tid since leave
+// nulls in it. The span stays good while tids are removed, but not once one
+// is next added; inside P_BeginTIDWalk, the positions in it do.
+//
+int P_GetTIDSpan(int tid, Mobj *const *&things)
+{
+   tidentry_t *entry;
+
+   if(tid <= 0 || !(entry = P_findTIDEntry(tid)))
+   {
+      things = NULL;
+      return 0;
+   }
+
+   things = entry->things;
+   return entry->numthings;
+}
+
+//
+// P_BeginTIDWalk
+//
+// Called before walking a span by position while things may be given tids.
+// The things keep their places in their spans until the matching call to
+// P_EndTIDWalk.
+//
+void P_BeginTIDWalk()
+{
+   ++numtidwalks;
+}
+
+//
+// P_EndTIDWalk
+//
+void P_EndTIDWalk()
+{
+   --numtidwalks;
+}
+
 //
 // P_FindMobjFromTID
 //
@@ -3501,6 +3692,10 @@ void P_RemoveThingTID(Mobj *mo)
 // once the end of the chain is hit. Calling it again at that point
 // would restart the search from the base of the chain.
 //
+// Things are returned newest first, the same order as the old hash
+// chains gave them in. If the previous thing lost its tid since it was
+// returned, the search carries on from where it was.
+//
 // The last parameter only applies when this is called from a
 // Small native function, and can be left null otherwise.
 //
@@ -3511,12 +3706,21 @@ Mobj *P_FindMobjFromTID(int tid, Mobj *rover, Mobj *trigger)
    // Normal TIDs
    if(tid > 0)
    {
-      rover = rover ? rover->tid_next : tidhash[tid % TIDCHAINS];
+      Mobj *const *things;
+      int count = P_GetTIDSpan(tid, things);
+      int i     = count;
+
+      if(rover)
+      {
+         if(rover->tid && rover->tid != tid)
+            return NULL;
+         i = emin(rover->tid_index, count);
+      }
 
-      while(rover && rover->tid != tid)
-         rover = rover->tid_next;
+      while(i > 0 && !things[i - 1])
+         --i;
 
-      return rover;
+      return i > 0 ? things[i - 1] : NULL;
    }
 
    // Reserved TIDs
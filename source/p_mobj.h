@@ -224,6 +224,7 @@ public:
    virtual void remove() override;
    virtual void serialize(SaveArchive &arc) override;
    virtual void deSwizzle() override;
+   virtual uint32_t stateHash() const override;
 
    // Methods
    void backupPosition();
@@ -336,6 +337,7 @@ public:
    // a linked list of sectors where this object appears
    msecnode_t *touching_sectorlist;                 // phares 3/14/98
    msecnode_t *old_sectorlist;                      // haleyjd 04/16/10
+   struct seccache_t *seccache; // lines near it, see P_CreateSecNodeList
 
    // SEE WARNING ABOVE ABOUT POINTER FIELDS!!!
 
@@ -365,11 +367,11 @@ public:
    int args[NUMMTARGS]; // arguments
    uint16_t tid;        // thing id used by scripts
 
-   // Note: tid chain pointers are NOT serialized in save games,
-   // but are restored on load by rehashing the things as they are
-   // spawned.
-   Mobj  *tid_next;  // ptr to next thing in tid chain
-   Mobj **tid_prevn; // ptr to last thing's next pointer
+   // Note: the tid index position is NOT serialized in save games,
+   // but is restored on load by indexing the things as they are
+   // spawned. It is left alone when the tid is removed, so that a
+   // P_FindMobjFromTID search can carry on past a thing taken out of it.
+   int tid_index; // position among the things with the same tid
 };
 
 //
@@ -410,6 +412,8 @@ void P_StartMobjFade(Mobj *mo, int alphavelocity);
 extern int iquehead;
 extern int iquetail;
 
+void P_ArchiveItemRespawnQueue(SaveArchive &arc);
+
 enum bloodaction_e : int
 {
    BLOOD_SHOT,   // bullet
@@ -537,6 +541,9 @@ void P_ThrustMobj(Mobj *mo, angle_t angle, fixed_t move);
 void  P_InitTIDHash(void);
 void  P_AddThingTID(Mobj *mo, int tid);
 void  P_RemoveThingTID(Mobj *mo);
+int   P_GetTIDSpan(int tid, Mobj *const *&things);
+void  P_BeginTIDWalk();
+void  P_EndTIDWalk();
 Mobj *P_FindMobjFromTID(int tid, Mobj *rover, Mobj *trigger);
 
 void P_AdjustFloorClip(Mobj *thing);
@@ -723,7 +730,8 @@ enum mobjflags4_e : unsigned int
    MF4_LOWAIMPRIO         = 0x04000000, // can't be autoaimed.
    MF4_STICKYCARRY        = 0x08000000, // can carry other things on top of it.
    MF4_SETTARGETONDEATH   = 0x10000000, // target is updated even when one-shot
-   MF4_SLIDEOVERTHINGS    = 0x20000000  // thing will keep sliding when on top of things
+   MF4_SLIDEOVERTHINGS    = 0x20000000, // thing will keep sliding when on top of things
+   MF4_FLOWPATH           = 0x40000000  // chases along flow fields (p_flowpath.cpp)
 };
 
 // killough 9/15/98: Same, but internal flags, not intended for .deh
@@ -757,6 +765,9 @@ enum
    // A substitute for calling E_SafeThingName every tic for every Mobj
    MIF_MUSICCHANGER = 0x00020000,
 
+   // Player movement is being predicted, and must not affect anything else
+   MIF_PREDICTED = 0x00040000,
+
    // these should be cleared when a thing is being raised
    MIF_CLEARRAISED = (MIF_DIEDFALLING|MIF_SCREAMED|MIF_CRASHED|MIF_WIMPYDEATH),
 };
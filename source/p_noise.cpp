@@ -0,0 +1,348 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: sector graph for propagating noise to monsters.
+//
+// Noise used to be flooded through the map by recursing over every line of
+// every sector reached, checking the opening of each two-sided line and
+// looking up the sector behind each sound-passing portal. Now the lines that
+// can carry noise are gathered per sector when the level is set up, and
+// whether a line is open is remembered until one of its sectors moves. The
+// flood is a breadth-first walk over those arrays: first through the lines
+// without ML_SOUNDBLOCK, then once more from the sectors behind the blocking
+// ones. Every sector ends up with the same soundtraversed value (one more
+// than the fewest blocking lines crossed) and soundtarget as before.
+//
+
+#include "z_zone.h"
+
+#include "doomstat.h"
+#include "m_collection.h"
+#include "m_compare.h"
+#include "p_maputl.h"
+#include "p_mobj.h"
+#include "p_noise.h"
+#include "p_querycontext.h"
+#include "r_main.h"
+#include "r_pcheck.h"
+#include "r_portal.h"
+#include "r_state.h"
+
+// edge flags
+enum
+{
+   NE_TWOSIDED   = 0x01, // noise can go through the line opening
+   NE_SOUNDBLOCK = 0x02, // ML_SOUNDBLOCK
+   NE_PORTAL     = 0x04, // the line has a portal
+};
+
+// line opening states
+enum
+{
+   NO_DIRTY,  // one of its sectors has moved since it was last checked
+   NO_CLOSED,
+   NO_OPEN
+};
+
+struct noiseedge_t
+{
+   int line;  // line number
+   int other; // sector on the other side, -1 if there is none
+   int flags; // NE_ flags
+};
+
+//
+// Sector behind a portal, and the point it was looked up from; the portal or
+// the line it was found from may change.
+//
+struct noisetarget_t
+{
+   fixed_t x, y;
+   int     sector;
+};
+
+struct noisegraph_t
+{
+   int           *edgestart;  // first edge of each sector, numsectors + 1
+   noiseedge_t   *edges;
+   byte          *lineopen;   // NO_ state of each line
+   noisetarget_t *linetarget; // per line
+   noisetarget_t *floortarget, *ceilingtarget; // per sector
+};
+
+static noisegraph_t noisegraph;
+
+static PODCollection<int> noisequeue;   // sectors to expand
+static PODCollection<int> noiseblocked; // sectors behind blocking lines
+
+//
+// P_BuildNoiseGraph
+//
+// Gathers the lines of each sector that noise can travel through. Called at
+// level setup, once all the portals have been made.
+//
+void P_BuildNoiseGraph()
+{
+   int numedges = 0;
+
+   P_NoiseGraphInvalidate();
+
+   for(int i = 0; i < numsectors; i++)
+   {
+      const sector_t &sec = sectors[i];
+      for(int j = 0; j < sec.linecount; j++)
+      {
+         if(sec.lines[j]->flags & ML_TWOSIDED || sec.lines[j]->portal)
+            ++numedges;
+      }
+   }
+
+   noisegraph.edgestart = emalloctag(int *, (numsectors + 1) * sizeof(int),
+                                     PU_LEVEL, (void **)&noisegraph.edgestart);
+   noisegraph.edges = emalloctag(noiseedge_t *, emax(numedges, 1) * sizeof(noiseedge_t),
+                                 PU_LEVEL, (void **)&noisegraph.edges);
+   noisegraph.lineopen = ecalloctag(byte *, emax(numlines, 1), 1, PU_LEVEL,
+                                    (void **)&noisegraph.lineopen);
+   noisegraph.linetarget = emalloctag(noisetarget_t *, 
+                                      emax(numlines, 1) * sizeof(noisetarget_t),
+                                      PU_LEVEL, (void **)&noisegraph.linetarget);
+   noisegraph.floortarget = emalloctag(noisetarget_t *,
+                                       numsectors * 2 * sizeof(noisetarget_t),
+                                       PU_LEVEL, (void **)&noisegraph.floortarget);
+   noisegraph.ceilingtarget = noisegraph.floortarget + numsectors;
+
+   // no portal target is known yet
+   for(int i = 0; i < numlines; i++)
+      noisegraph.linetarget[i].sector = -1;
+   for(int i = 0; i < numsectors * 2; i++)
+      noisegraph.floortarget[i].sector = -1;
+
+   numedges = 0;
+   for(int i = 0; i < numsectors; i++)
+   {
+      const sector_t &sec = sectors[i];
+
+      noisegraph.edgestart[i] = numedges;
+      for(int j = 0; j < sec.linecount; j++)
+      {
+         const line_t *line = sec.lines[j];
+
+         if(!(line->flags & ML_TWOSIDED) && !line->portal)
+            continue;
+
+         noiseedge_t &edge = noisegraph.edges[numedges++];
+         edge.line  = eindex(line - lines);
+         // one-sided portal lines have nothing behind them but the portal
+         if(line->sidenum[1] != -1)
+         {
+            edge.other = 
+               eindex(sides[line->sidenum[sides[line->sidenum[0]].sector == &sec]].sector - 
+                      sectors);
+         }
+         else
+            edge.other = -1;
+         edge.flags = 0;
+         if(line->flags & ML_TWOSIDED)
+            edge.flags |= NE_TWOSIDED;
+         if(line->flags & ML_SOUNDBLOCK)
+            edge.flags |= NE_SOUNDBLOCK;
+         if(line->portal)
+            edge.flags |= NE_PORTAL;
+      }
+   }
+   noisegraph.edgestart[numsectors] = numedges;
+}
+
+//
+// P_NoiseGraphInvalidate
+//
+// Called when lines gain portals after setup; the graph is built again the
+// next time noise is made.
+//
+void P_NoiseGraphInvalidate()
+{
+   if(!noisegraph.edgestart)
+      return;
+
+   Z_Free(noisegraph.edgestart);
+   Z_Free(noisegraph.edges);
+   Z_Free(noisegraph.lineopen);
+   Z_Free(noisegraph.linetarget);
+   Z_Free(noisegraph.floortarget);
+   noisegraph.ceilingtarget = nullptr;
+}
+
+//
+// P_NoiseGraphSectorChanged
+//
+// Called when a sector's floor or ceiling moves, or its portals change state.
+// The openings of its lines have to be checked again.
+//
+void P_NoiseGraphSectorChanged(const sector_t *sec)
+{
+   if(!noisegraph.lineopen)
+      return;
+
+   for(int i = 0; i < sec->linecount; i++)
+      noisegraph.lineopen[sec->lines[i] - lines] = NO_DIRTY;
+}
+
+//
+// Returns true if noise can go through a two-sided line
+//
+static bool P_noiseLineOpen(const line_t *line)
+{
+   byte &state = noisegraph.lineopen[line - lines];
+
+   // the other side of a one-sided portal line is not among its sectors
+   if(state == NO_DIRTY || line->intflags & MLI_1SPORTALLINE)
+   {
+      P_LineOpening(line, nullptr);
+      state = clip.openrange > 0 ? NO_OPEN : NO_CLOSED;
+   }
+
+   return state == NO_OPEN;
+}
+
+#ifdef R_LINKEDPORTALS
+//
+// Returns the sector behind a portal, as found from the middle of a line
+//
+static int P_noisePortalTarget(noisetarget_t &target, const line_t *line,
+                               const linkdata_t &link)
+{
+   fixed_t x = ((line->v1->x + line->v2->x) / 2) + link.deltax;
+   fixed_t y = ((line->v1->y + line->v2->y) / 2) + link.deltay;
+
+   if(target.sector < 0 || target.x != x || target.y != y)
+   {
+      target.x      = x;
+      target.y      = y;
+      target.sector = eindex(R_PointInSubsector(x, y)->sector - sectors);
+   }
+
+   return target.sector;
+}
+#endif
+
+//
+// Lets noise into a sector, queueing it if it hasn't been reached with as
+// few blocking lines crossed yet
+//
+static void P_noiseVisit(QueryContext &query, int secnum, int soundblocks,
+                         Mobj *soundtarget)
+{
+   sector_t &sec = sectors[secnum];
+
+   if(query.sectorMarked(sec) && sec.soundtraversed <= soundblocks + 1)
+      return; // already flooded
+
+   query.markSector(sec);
+   sec.soundtraversed = soundblocks + 1;
+   P_SetTarget<Mobj>(&sec.soundtarget, soundtarget); // killough 11/98
+
+   noisequeue.add(secnum);
+}
+
+//
+// Floods noise from the queued sectors
+//
+static void P_noiseFlood(QueryContext &query, int soundblocks, Mobj *soundtarget)
+{
+   for(size_t head = 0; head < noisequeue.getLength(); head++)
+   {
+      int secnum = noisequeue[head];
+      const sector_t &sec = sectors[secnum];
+
+#ifdef R_LINKEDPORTALS
+      // Because the same portal can be used on many sectors and even lines,
+      // the portal structure won't tell you what sector is on the other side
+      // of the portal. The first line of the sector is used to find it.
+      if(sec.f_pflags & PS_PASSSOUND && sec.linecount)
+      {
+         P_noiseVisit(query, P_noisePortalTarget(noisegraph.floortarget[secnum],
+                                                 sec.lines[0], *R_FPLink(&sec)),
+                      soundblocks, soundtarget);
+      }
+      if(sec.c_pflags & PS_PASSSOUND && sec.linecount)
+      {
+         P_noiseVisit(query, P_noisePortalTarget(noisegraph.ceilingtarget[secnum],
+                                                 sec.lines[0], *R_CPLink(&sec)),
+                      soundblocks, soundtarget);
+      }
+#endif
+
+      const noiseedge_t *edge = noisegraph.edges + noisegraph.edgestart[secnum];
+      const noiseedge_t *end  = noisegraph.edges + noisegraph.edgestart[secnum + 1];
+      for(; edge != end; ++edge)
+      {
+         const line_t *line = lines + edge->line;
+
+#ifdef R_LINKEDPORTALS
+         if(edge->flags & NE_PORTAL && line->pflags & PS_PASSSOUND)
+         {
+            P_noiseVisit(query, P_noisePortalTarget(noisegraph.linetarget[edge->line],
+                                                    line, line->portal->data.link),
+                         soundblocks, soundtarget);
+         }
+#endif
+         if(edge->other == -1)
+            continue;
+         if(!(edge->flags & NE_TWOSIDED) || !P_noiseLineOpen(line))
+            continue; // closed door
+
+         if(!(edge->flags & NE_SOUNDBLOCK))
+            P_noiseVisit(query, edge->other, soundblocks, soundtarget);
+         else if(!soundblocks)
+            noiseblocked.add(edge->other);
+      }
+   }
+}
+
+//
+// P_PropagateNoise
+//
+// Alerts the monsters of every sector that noise made in sec reaches: those
+// reachable through open lines, crossing at most one ML_SOUNDBLOCK line.
+//
+void P_PropagateNoise(sector_t *sec, Mobj *soundtarget)
+{
+   QueryContext &query = QueryContext::Global();
+
+   if(!noisegraph.edgestart)
+      P_BuildNoiseGraph();
+
+   query.newQuery();
+   noisequeue.makeEmpty();
+   noiseblocked.makeEmpty();
+
+   P_noiseVisit(query, eindex(sec - sectors), 0, soundtarget);
+   P_noiseFlood(query, 0, soundtarget);
+
+   // then on from behind the blocking lines, where it gets no further than
+   // the next one
+   noisequeue.makeEmpty();
+   for(int secnum : noiseblocked)
+      P_noiseVisit(query, secnum, 1, soundtarget);
+   P_noiseFlood(query, 1, soundtarget);
+}
+
+// EOF
+
@@ -316,102 +316,142 @@ void P_InitParticleEffects(void)
 }
 
 //
-// P_UnsetParticlePosition
+// P_SetParticlePosition
 //
 // haleyjd 02/20/04: maintenance of particle sector links,
-// necessitated by portals.
+// necessitated by portals. The subsector is all that is kept now; the
+// renderer sorts the particles by sector from it.
 //
-static void P_UnsetParticlePosition(particle_t *ptcl)
+static void P_SetParticlePosition(particle_t *ptcl)
 {
-   ptcl->seclinks.remove();
-   ptcl->subsector = NULL;
+   ptcl->subsector = R_PointInSubsector(ptcl->x, ptcl->y);
 }
 
 //
-// P_SetParticlePosition
+// P_killParticle
 //
-// haleyjd 02/20/04: maintenance of particle sector links,
-// necessitated by portals. Maintaining a subsector_t
-// field in the particle_t will be useful in the future,
-// I am sure.
+// Moves the last live particle into slot n.
 //
-static void P_SetParticlePosition(particle_t *ptcl)
+static void P_killParticle(particlepool_t &pool, int n)
 {
-   subsector_t *ss = R_PointInSubsector(ptcl->x, ptcl->y);
-
-   ptcl->seclinks.insert(ptcl, &(ss->sector->ptcllist));
-   ptcl->subsector = ss;
+   int last = --pool.count;
+
+   pool.x[n]          = pool.x[last];
+   pool.y[n]          = pool.y[last];
+   pool.z[n]          = pool.z[last];
+   pool.velx[n]       = pool.velx[last];
+   pool.vely[n]       = pool.vely[last];
+   pool.velz[n]       = pool.velz[last];
+   pool.accx[n]       = pool.accx[last];
+   pool.accy[n]       = pool.accy[last];
+   pool.accz[n]       = pool.accz[last];
+   pool.trans[n]      = pool.trans[last];
+   pool.fade[n]       = pool.fade[last];
+   pool.ttl[n]        = pool.ttl[last];
+   pool.size[n]       = pool.size[last];
+   pool.color[n]      = pool.color[last];
+   pool.styleflags[n] = pool.styleflags[last];
+   pool.subsector[n]  = pool.subsector[last];
+   pool.flags[n]      = pool.flags[last];
 }
 
+//
+// P_ParticleThinker
+//
+// Runs all particles for one tic. The fading, the killing off and the moving
+// are each done for the whole pool in one pass over plain arrays, which the
+// compiler can turn into vector code; what needs the map is done after that,
+// one particle at a time.
+//
 void P_ParticleThinker(void)
 {
-   int i;
-   particle_t *particle, *prev;
-   const sector_t *psec;
-   fixed_t floorheight;
+   particlepool_t &pool = particlepool;
+   int count;
    
-   i = activeParticles;
-   prev = NULL;
-   while(i != -1) 
+   R_CommitParticles();
+
+   if(!(count = pool.count))
+      return;
+
+   pool.binsdirty = true;
+
+   // haleyjd: particles with fall to ground style don't start
+   // fading or counting down their TTL until they hit the floor
+   for(int i = 0; i < count; i++)
    {
-      particle = Particles + i;
-      i = particle->next;
+      unsigned int oldtrans = pool.trans[i];
+      unsigned int trans    = oldtrans - pool.fade[i];
+      byte         ttl      = byte(pool.ttl[i] - 1);
+      bool         ticking  = !(pool.styleflags[i] & PS_FALLTOGROUND);
+
+      // is it time to kill this particle?
+      pool.flags[i] = ticking & ((oldtrans < trans) | (ttl == 0));
+      pool.trans[i] = ticking ? trans : oldtrans;
+      pool.ttl[i]   = ticking ? ttl : pool.ttl[i];
+   }
 
-      // haleyjd: unlink the particle from the world
-      P_UnsetParticlePosition(particle);
+   for(int i = 0; i < pool.count; )
+   {
+      if(pool.flags[i])
+         P_killParticle(pool, i); // look at what was moved here next
+      else
+         ++i;
+   }
 
-      // haleyjd: particles with fall to ground style don't start
-      // fading or counting down their TTL until they hit the floor
-      if(!(particle->styleflags & PS_FALLTOGROUND))
-      {
-         // perform fading
-         unsigned oldtrans = particle->trans;
-         particle->trans -= particle->fade;
-         
-         // is it time to kill this particle?
-         if(oldtrans < particle->trans || --particle->ttl == 0)
-         {
-            memset(particle, 0, sizeof(particle_t));
-            if(prev)
-               prev->next = i;
-            else
-               activeParticles = i;
-            particle->next = inactiveParticles;
-            inactiveParticles = eindex(particle - Particles);
-            continue;
-         }
-      }
+   count = pool.count;
 
+   // update to the new position; only particles that moved sideways need
+   // their subsector looked up again
+   if(gMapHasLinePortals)
+   {
       // Check for wall portals
-      if(gMapHasLinePortals && particle->velx | particle->vely)
+      for(int i = 0; i < count; i++)
       {
-         v2fixed_t destination = P_LinePortalCrossing(particle->x, particle->y, 
-            particle->velx, particle->vely);
-         particle->x = destination.x;
-         particle->y = destination.y;
-      }
-      else
-      {
-         // update and link to new position
-         particle->x += particle->velx;
-         particle->y += particle->vely;
+         if(pool.velx[i] | pool.vely[i])
+         {
+            v2fixed_t destination = P_LinePortalCrossing(pool.x[i], pool.y[i], 
+               pool.velx[i], pool.vely[i]);
+            pool.x[i] = destination.x;
+            pool.y[i] = destination.y;
+         }
       }
-      particle->z += particle->velz;
-      P_SetParticlePosition(particle);
-      if(P_IsInVoid(particle->x, particle->y, *particle->subsector))
+   }
+   else
+   {
+      for(int i = 0; i < count; i++)
       {
-         particle->ttl = 1;
-         particle->trans = 0;
+         pool.x[i] += pool.velx[i];
+         pool.y[i] += pool.vely[i];
       }
+   }
+
+   for(int i = 0; i < count; i++)
+   {
+      pool.flags[i] = (pool.velx[i] | pool.vely[i]) != 0;
+      pool.z[i] += pool.velz[i];
 
       // apply accelerations
-      particle->velx += particle->accx;
-      particle->vely += particle->accy;
-      particle->velz += particle->accz;
+      pool.velx[i] += pool.accx[i];
+      pool.vely[i] += pool.accy[i];
+      pool.velz[i] += pool.accz[i];
+   }
+
+   // handle special movement flags (post-position-set)
+   for(int i = 0; i < count; i++)
+   {
+      const sector_t *psec;
+      fixed_t floorheight;
 
-      // handle special movement flags (post-position-set)
+      if(pool.flags[i])
+         pool.subsector[i] = R_PointInSubsector(pool.x[i], pool.y[i]);
+
+      if(P_IsInVoid(pool.x[i], pool.y[i], *pool.subsector[i]))
+      {
+         pool.ttl[i] = 1;
+         pool.trans[i] = 0;
+      }
 
-      psec = particle->subsector->sector;
+      psec = pool.subsector[i]->sector;
 
       // haleyjd 09/04/05: use deep water floor if it is higher
       // than the real floor.
@@ -422,56 +462,66 @@ void P_ParticleThinker(void)
           psec->floorheight; 
 
       // did particle hit ground, but is now no longer on it?
-      if(particle->styleflags & PS_HITGROUND && particle->z != floorheight)
-         particle->z = floorheight;
+      if(pool.styleflags[i] & PS_HITGROUND && pool.z[i] != floorheight)
+         pool.z[i] = floorheight;
 
       // floor clipping
-      if(particle->z < floorheight && psec->f_pflags & PS_PASSABLE)
+      if(pool.z[i] < floorheight && psec->f_pflags & PS_PASSABLE)
       {
          const linkdata_t *ldata = R_FPLink(psec);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
+         pool.x[i] += ldata->deltax;
+         pool.y[i] += ldata->deltay;
+         pool.z[i] += ldata->deltaz;
+         pool.subsector[i] = R_PointInSubsector(pool.x[i], pool.y[i]);
       }
-      else if(particle->z < floorheight)
+      else if(pool.z[i] < floorheight)
       {
          // particles with fall to ground style start ticking now
-         if(particle->styleflags & PS_FALLTOGROUND)
-            particle->styleflags &= ~PS_FALLTOGROUND;
+         if(pool.styleflags[i] & PS_FALLTOGROUND)
+            pool.styleflags[i] &= ~PS_FALLTOGROUND;
 
          // particles with floor clipping may need to stop
-         if(particle->styleflags & PS_FLOORCLIP)
+         if(pool.styleflags[i] & PS_FLOORCLIP)
          {
-            particle->z = floorheight;
-            particle->accz = particle->velz = 0;
-            particle->styleflags |= PS_HITGROUND;
+            pool.z[i] = floorheight;
+            pool.accz[i] = pool.velz[i] = 0;
+            pool.styleflags[i] |= PS_HITGROUND;
             
             // some particles make splashes
-            if(particle->styleflags & PS_SPLASH)
-               E_PtclTerrainHit(particle);
+            if(pool.styleflags[i] & PS_SPLASH)
+            {
+               particle_t hit;
+
+               memset(&hit, 0, sizeof(hit));
+               hit.subsector = pool.subsector[i];
+               hit.x = pool.x[i];
+               hit.y = pool.y[i];
+               hit.z = pool.z[i];
+               E_PtclTerrainHit(&hit);
+            }
          }
       }
-      else if(particle->z > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
+      else if(pool.z[i] > psec->ceilingheight && psec->c_pflags & PS_PASSABLE)
       {
          const linkdata_t *ldata = R_CPLink(psec);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->deltax;
-         particle->y += ldata->deltay;
-         particle->z += ldata->deltaz;
-         P_SetParticlePosition(particle);
+         pool.x[i] += ldata->deltax;
+         pool.y[i] += ldata->deltay;
+         pool.z[i] += ldata->deltaz;
+         pool.subsector[i] = R_PointInSubsector(pool.x[i], pool.y[i]);
       }
-      
-      prev = particle;
    }
 }
 
 void P_RunEffects(void)
 {
    int snum = 0;
+
+   // nothing to see from a dedicated server
+   if(!camera && !players[displayplayer].mo)
+      return;
+
    Thinker *th = &thinkercap;
 
    if(camera)
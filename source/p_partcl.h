@@ -24,8 +24,7 @@
 #ifndef P_PARTCL_H__
 #define P_PARTCL_H__
 
-// Required for: DLListItem, fixed_t, angle_t
-#include "m_dllist.h"
+// Required for: fixed_t, angle_t
 #include "m_fixed.h"
 #include "tables.h"
 
@@ -41,11 +40,15 @@ struct subsector_t;
 #define PS_HITGROUND    0x0008
 #define PS_SPLASH       0x0010 
 
+//
+// particle_t
+//
+// A particle as made by the spawners. newParticle hands these out, and they
+// are moved into the particle pool by R_CommitParticles before they are next
+// run or drawn.
+//
 struct particle_t
 {
-   // haleyjd 02/20/04: particles now need sector links
-   // haleyjd 08/05/05: use generalized dbl-linked list code
-   DLListItem<particle_t> seclinks;         // sector links
    subsector_t *subsector;
 
    fixed_t x, y, z;
@@ -56,13 +59,41 @@ struct particle_t
    byte	ttl;
    byte	size;
    byte color;
-   int  next;
    int  styleflags; // haleyjd 07/03/03
 };
 
-extern int activeParticles;
-extern int inactiveParticles;
-extern particle_t *Particles;
+//
+// particlepool_t
+//
+// The live particles, one array per field, so that the thinker runs through
+// each field in a straight line. Particles 0 to count - 1 are live; when one
+// dies the last one is moved into its place.
+//
+struct particlepool_t
+{
+   int count;
+   int max;
+
+   fixed_t *x, *y, *z;
+   fixed_t *velx, *vely, *velz;
+   fixed_t *accx, *accy, *accz;
+   unsigned int *trans;
+   unsigned int *fade;
+   byte *ttl;
+   byte *size;
+   byte *color;
+   int  *styleflags;
+   subsector_t **subsector;
+   byte *flags; // scratch space for the thinker
+
+   // particles listed by sector, for the renderer
+   int  *binstart;  // first entry of each sector in bins, numsectors + 1 long
+   int  *bins;      // particle indices
+   int   binsectors; // number of sectors binstart was made for
+   bool  binsdirty;  // particles were added, removed or moved since binning
+};
+
+extern particlepool_t particlepool;
 extern int particle_trans;
 
 #define FX_ROCKET		0x00000001
@@ -271,6 +271,8 @@ bool PlatThinker::reTriggerVerticalDoor(bool player)
 //
 bool EV_DoPlat(const line_t *line, plattype_e type, int amount )
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    PlatThinker *plat;
    int          secnum;
    bool         rtn;
@@ -296,8 +298,10 @@ bool EV_DoPlat(const line_t *line, plattype_e type, int amount )
    }
       
    // act on all sectors tagged the same as the activating linedef
-   while((secnum = P_FindSectorFromLineArg0(line, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(line->args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
       
       // don't start a second floor function if already moving
@@ -419,6 +423,8 @@ bool EV_DoPlat(const line_t *line, plattype_e type, int amount )
 //
 bool EV_DoParamPlat(const line_t *line, const int *args, paramplattype_e type)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    sector_t *sec    = NULL;
    int       secnum = -1;
    bool      manual = false;
@@ -448,8 +454,10 @@ bool EV_DoParamPlat(const line_t *line, const int *args, paramplattype_e type)
       goto manual_plat;
    }
 
-   while((secnum = P_FindSectorFromTag(args[0], secnum)) >= 0)
+   numtagged = P_SectorTagSpan(args[0], tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sec = &sectors[secnum];
 
 manual_plat:
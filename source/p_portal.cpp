@@ -31,10 +31,14 @@
 #include "e_exdata.h"
 #include "ev_specials.h"
 #include "p_chase.h"
+#include "p_flowpath.h"
 #include "polyobj.h"
 #include "p_portal.h"
 #include "p_portalblockmap.h"
+#include "p_noise.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
+#include "p_statehash.h"
 #include "p_user.h"
 #include "r_main.h"
 #include "r_portal.h"
@@ -997,6 +1001,9 @@ static int P_GetPortalState(const portal_t *portal, int sflags, bool obscured)
 void P_CheckCPortalState(sector_t *sec)
 {
    bool     obscured;
+
+   // the openings of its lines may have changed too
+   P_NoiseGraphSectorChanged(sec);
    
    if(!sec->c_portal)
    {
@@ -1014,6 +1021,9 @@ void P_CheckCPortalState(sector_t *sec)
 void P_CheckFPortalState(sector_t *sec)
 {
    bool     obscured;
+
+   // the openings of its lines may have changed too
+   P_NoiseGraphSectorChanged(sec);
    
    if(!sec->f_portal)
    {
@@ -1048,8 +1058,12 @@ void P_CheckLPortalState(line_t *line)
 void P_SetFloorHeight(sector_t *sec, fixed_t h)
 {
    // set new value
+   P_StateHashRemoveSector(sec);
    sec->floorheight = h;
    sec->floorheightf = M_FixedToFloat(sec->floorheight);
+   P_StateHashAddSector(sec);
+   P_SightBatchInvalidate();
+   P_FlowPathSectorMoved(sec);
 
    // check floor portal state
    P_CheckFPortalState(sec);
@@ -1064,8 +1078,12 @@ void P_SetFloorHeight(sector_t *sec, fixed_t h)
 void P_SetCeilingHeight(sector_t *sec, fixed_t h)
 {
    // set new value
+   P_StateHashRemoveSector(sec);
    sec->ceilingheight = h;
    sec->ceilingheightf = M_FixedToFloat(sec->ceilingheight);
+   P_StateHashAddSector(sec);
+   P_SightBatchInvalidate();
+   P_FlowPathSectorMoved(sec);
 
    // check ceiling portal state
    P_CheckCPortalState(sec);
@@ -1076,6 +1094,7 @@ void P_SetPortalBehavior(portal_t *portal, int newbehavior)
    int   i;
    
    portal->flags = newbehavior & PF_FLAGMASK;
+   P_SightBatchInvalidate();
    for(i = 0; i < numsectors; i++)
    {
       sector_t *sec = sectors + i;
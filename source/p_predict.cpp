@@ -0,0 +1,451 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Client-side movement prediction for netgames.
+//
+// In a netgame the world can only be run as far as the last tic for which
+// every node's commands have arrived, so the console player's own input is
+// seen with a delay of the full round trip. To hide it, before a frame is
+// drawn the console player is moved ahead through the commands already built
+// locally but not yet run, starting from the last confirmed tic. After the
+// frame the player is rolled back to the snapshot taken before, so that the
+// authoritative commands are always run against the confirmed state: a
+// misprediction only ever lasts for one frame.
+//
+// Only the player's own movement is predicted. The predicted moves never
+// relink the player's mobj, cross special lines, pick up or touch anything,
+// change states or make noise, and everything they do change is in the
+// snapshot, so the synced game state is left exactly as it was found.
+//
+//----------------------------------------------------------------------------
+
+#include "z_zone.h"
+
+#include "d_event.h"
+#include "d_player.h"
+#include "d_ticcmd.h"
+#include "doomstat.h"
+#include "e_player.h"
+#include "m_compare.h"
+#include "p_info.h"
+#include "p_map.h"
+#include "p_map3d.h"
+#include "p_maputl.h"
+#include "p_mobj.h"
+#include "p_portal.h"
+#include "p_predict.h"
+#include "p_user.h"
+#include "r_defs.h"
+#include "r_main.h"
+#include "r_state.h"
+
+extern bool onground;
+
+//
+// Everything a predicted tic can change
+//
+struct predictsnap_t
+{
+   player_t *player;
+
+   // player
+   fixed_t  viewz;
+   fixed_t  prevviewz;
+   fixed_t  viewheight;
+   fixed_t  deltaviewheight;
+   fixed_t  bob;
+   fixed_t  pmomx;
+   fixed_t  pmomy;
+   fixed_t  pitch;
+   fixed_t  prevpitch;
+   int      jumptime;
+   ticcmd_t cmd;
+
+   // player's mobj
+   fixed_t   x, y, z;
+   angle_t   angle;
+   fixed_t   momx, momy, momz;
+   zrefs_t   zref;
+   prevpos_t prevpos;
+   unsigned int flags;
+   unsigned int intflags;
+   int       reactiontime;
+   int       movefactor;
+
+   // globals
+   bool onground;
+   int  leveltime;
+   doom_mapinter_t clip;
+};
+
+static predictsnap_t snap;
+
+//
+// Takes the snapshot the prediction is rolled back to.
+//
+static void P_savePrediction(player_t *player)
+{
+   Mobj *mo = player->mo;
+
+   snap.player          = player;
+   snap.viewz           = player->viewz;
+   snap.prevviewz       = player->prevviewz;
+   snap.viewheight      = player->viewheight;
+   snap.deltaviewheight = player->deltaviewheight;
+   snap.bob             = player->bob;
+   snap.pmomx           = player->momx;
+   snap.pmomy           = player->momy;
+   snap.pitch           = player->pitch;
+   snap.prevpitch       = player->prevpitch;
+   snap.jumptime        = player->jumptime;
+   snap.cmd             = player->cmd;
+
+   snap.x            = mo->x;
+   snap.y            = mo->y;
+   snap.z            = mo->z;
+   snap.angle        = mo->angle;
+   snap.momx         = mo->momx;
+   snap.momy         = mo->momy;
+   snap.momz         = mo->momz;
+   snap.zref         = mo->zref;
+   snap.prevpos      = mo->prevpos;
+   snap.flags        = mo->flags;
+   snap.intflags     = mo->intflags;
+   snap.reactiontime = mo->reactiontime;
+   snap.movefactor   = mo->movefactor;
+
+   snap.onground  = onground;
+   snap.leveltime = leveltime;
+   snap.clip      = clip;
+}
+
+//
+// Predicted version of P_TryMove. Checks that the player fits at x, y and
+// moves them there, without linking them into the blockmap or sectors.
+//
+static bool P_predictTryMove(Mobj *mo, fixed_t x, fixed_t y)
+{
+   if(!P_CheckPosition(mo, x, y))
+      return false;
+
+   if(!(mo->flags & MF_NOCLIP))
+   {
+      if(clip.zref.ceiling - clip.zref.floor < mo->height)
+         return false; // doesn't fit
+      if(!(mo->flags4 & MF4_FLY) && clip.zref.ceiling - mo->z < mo->height)
+         return false; // mobj must lower to fit
+      if(!(mo->flags4 & MF4_FLY) && clip.zref.floor - mo->z > STEPSIZE)
+         return false; // too big a step up
+   }
+
+   mo->x    = x;
+   mo->y    = y;
+   mo->zref = clip.zref;
+
+   return true;
+}
+
+//
+// Predicted version of P_XYMovement for the player. Where the real one
+// slides along walls, this one falls back to moving along either axis.
+//
+static void P_predictXYMovement(player_t *player)
+{
+   Mobj *mo = player->mo;
+   fixed_t xmove, ymove;
+
+   if(mo->momx | mo->momy)
+   {
+      mo->momx = eclamp(mo->momx, -MAXMOVE, MAXMOVE);
+      mo->momy = eclamp(mo->momy, -MAXMOVE, MAXMOVE);
+
+      xmove = mo->momx;
+      ymove = mo->momy;
+
+      do
+      {
+         fixed_t ptryx, ptryy;
+
+         if(xmove > MAXMOVE/2 || ymove > MAXMOVE/2 ||
+            xmove < -MAXMOVE/2 || ymove < -MAXMOVE/2)
+         {
+            ptryx = mo->x + xmove/2;
+            ptryy = mo->y + ymove/2;
+            xmove >>= 1;
+            ymove >>= 1;
+         }
+         else
+         {
+            ptryx = mo->x + xmove;
+            ptryy = mo->y + ymove;
+            xmove = ymove = 0;
+         }
+
+         if(!P_predictTryMove(mo, ptryx, ptryy))
+         {
+            if(P_predictTryMove(mo, ptryx, mo->y))
+               mo->momy = 0;
+            else if(P_predictTryMove(mo, mo->x, ptryy))
+               mo->momx = 0;
+            else
+               mo->momx = mo->momy = 0;
+         }
+      }
+      while(xmove | ymove);
+   }
+
+   // no friction when airborne
+   if(mo->z > mo->zref.floor && !(mo->flags4 & MF4_FLY) &&
+      (!P_Use3DClipping() || !(mo->intflags & MIF_ONMOBJ)) &&
+      LevelInfo.airFriction == 0)
+      return;
+
+   if(mo->momx > -STOPSPEED && mo->momx < STOPSPEED &&
+      mo->momy > -STOPSPEED && mo->momy < STOPSPEED &&
+      !(player->cmd.forwardmove | player->cmd.sidemove))
+   {
+      mo->momx = mo->momy = 0;
+      player->momx = player->momy = 0;
+   }
+   else
+   {
+      fixed_t friction = P_GetFriction(mo, NULL);
+
+      mo->momx = FixedMul(mo->momx, friction);
+      mo->momy = FixedMul(mo->momy, friction);
+
+      player->momx = FixedMul(player->momx, ORIG_FRICTION);
+      player->momy = FixedMul(player->momy, ORIG_FRICTION);
+   }
+}
+
+//
+// Predicted version of P_ZMovement for the player: gravity, and landing on
+// the floor or hitting the ceiling.
+//
+static void P_predictZMovement(player_t *player)
+{
+   Mobj *mo = player->mo;
+
+   // check for smooth step up
+   if(mo->z < mo->zref.floor)
+   {
+      player->viewheight -= mo->zref.floor - mo->z;
+      player->deltaviewheight =
+         (player->pclass->viewheight - player->viewheight) >> 3;
+   }
+
+   mo->z += mo->momz;
+
+   if(mo->z <= mo->zref.floor)
+   {
+      if(mo->momz < 0)
+      {
+         if(mo->momz < -LevelInfo.gravity*8)
+            player->deltaviewheight = mo->momz >> 3;
+         mo->momz = 0;
+      }
+      mo->z = mo->zref.floor;
+   }
+   else if(!(mo->flags & MF_NOGRAVITY))
+   {
+      if(!mo->momz)
+         mo->momz = -LevelInfo.gravity;
+      mo->momz -= LevelInfo.gravity;
+   }
+
+   if(mo->z + mo->height > mo->zref.ceiling)
+   {
+      if(mo->momz > 0)
+         mo->momz = 0;
+      mo->z = mo->zref.ceiling - mo->height;
+   }
+}
+
+//
+// Runs one predicted tic of the player, following P_PlayerThink and the
+// movement of the player's mobj.
+//
+static void P_predictTic(player_t *player, const ticcmd_t &cmd)
+{
+   Mobj *mo = player->mo;
+
+   player->prevviewz = player->viewz;
+   mo->backupPosition();
+   player->cmd = cmd;
+
+   if(allowmlook)
+   {
+      player->prevpitch = player->pitch;
+
+      if(cmd.look && !mo->reactiontime)
+      {
+         if(cmd.look == -32768)
+            player->pitch = 0;
+         else
+         {
+            player->pitch -= cmd.look << 16;
+            player->pitch = eclamp(player->pitch, -ANGLE_1*MAXPITCHUP,
+                                   ANGLE_1*MAXPITCHDOWN);
+         }
+      }
+   }
+
+   if(player->jumptime)
+      player->jumptime--;
+
+   if(mo->reactiontime)
+      mo->reactiontime--;
+   else
+   {
+      mo->angle += cmd.angleturn << 16;
+
+      onground = mo->z <= mo->zref.floor ||
+         (P_Use3DClipping() && mo->intflags & MIF_ONMOBJ);
+
+      if((cmd.forwardmove | cmd.sidemove) && onground)
+      {
+         int friction, movefactor = P_GetMoveFactor(mo, &friction);
+         int bobfactor =
+            friction < ORIG_FRICTION ? movefactor : ORIG_FRICTION_FACTOR;
+
+         if(cmd.forwardmove)
+         {
+            P_Bob(player, mo->angle, 0, cmd.forwardmove*bobfactor);
+            P_Thrust(player, mo->angle, 0, cmd.forwardmove*movefactor);
+         }
+         if(cmd.sidemove)
+         {
+            P_Bob(player, mo->angle-ANG90, 0, cmd.sidemove*bobfactor);
+            P_Thrust(player, mo->angle-ANG90, 0, cmd.sidemove*movefactor);
+         }
+      }
+
+      if(cmd.actions & AC_JUMP && E_CanJump(*player->pclass) &&
+         (mo->z == mo->zref.floor || mo->intflags & MIF_ONMOBJ) &&
+         !player->jumptime)
+      {
+         mo->momz += player->pclass->jumpspeed;
+         mo->intflags &= ~MIF_ONMOBJ;
+         player->jumptime = 18;
+      }
+   }
+
+   P_CalcHeight(player);
+
+   P_predictXYMovement(player);
+   P_predictZMovement(player);
+
+   ++leveltime;
+}
+
+//
+// P_PredictPlayer
+//
+// Moves the player ahead through the given commands, which have been built
+// locally but not yet run. Returns false, leaving the player alone, if they
+// cannot be predicted. Otherwise P_UnpredictPlayer must be called before the
+// next tic is run.
+//
+bool P_PredictPlayer(player_t *player, const ticcmd_t *cmds, int numcmds)
+{
+   Mobj *mo = player->mo;
+
+   if(!mo || numcmds <= 0 || player->playerstate != PST_LIVE ||
+      mo->flags4 & MF4_FLY || gMapHasLinePortals)
+      return false;
+
+   P_savePrediction(player);
+
+   // test moves only; see P_CheckPositionExt
+   mo->flags    &= ~MF_PICKUP;
+   mo->intflags |= MIF_NOTOUCH | MIF_PREDICTED;
+
+   for(int i = 0; i < numcmds; i++)
+      P_predictTic(player, cmds[i]);
+
+   // leveltime only phases the view bobbing; the HUD and the renderer keep
+   // the confirmed time
+   leveltime = snap.leveltime;
+
+   return true;
+}
+
+//
+// P_UnpredictPlayer
+//
+// Rolls the predicted player back to the confirmed state.
+//
+void P_UnpredictPlayer()
+{
+   player_t *player = snap.player;
+   Mobj     *mo;
+
+   if(!player)
+      return;
+
+   mo = player->mo;
+
+   player->viewz           = snap.viewz;
+   player->prevviewz       = snap.prevviewz;
+   player->viewheight      = snap.viewheight;
+   player->deltaviewheight = snap.deltaviewheight;
+   player->bob             = snap.bob;
+   player->momx            = snap.pmomx;
+   player->momy            = snap.pmomy;
+   player->pitch           = snap.pitch;
+   player->prevpitch       = snap.prevpitch;
+   player->jumptime        = snap.jumptime;
+   player->cmd             = snap.cmd;
+
+   mo->x            = snap.x;
+   mo->y            = snap.y;
+   mo->z            = snap.z;
+   mo->angle        = snap.angle;
+   mo->momx         = snap.momx;
+   mo->momy         = snap.momy;
+   mo->momz         = snap.momz;
+   mo->zref         = snap.zref;
+   mo->prevpos      = snap.prevpos;
+   mo->flags        = snap.flags;
+   mo->intflags     = snap.intflags;
+   mo->reactiontime = snap.reactiontime;
+   mo->movefactor   = snap.movefactor;
+
+   onground  = snap.onground;
+   leveltime = snap.leveltime;
+
+   // the clipping buffers may have grown meanwhile; keep the current ones
+   line_t **spechit     = clip.spechit;
+   int      spechit_max = clip.spechit_max;
+   doom_mapinter_t::linepoly_t *portalhit = clip.portalhit;
+   int      portalhit_max = clip.portalhit_max;
+
+   clip = snap.clip;
+   clip.spechit       = spechit;
+   clip.spechit_max   = spechit_max;
+   clip.portalhit     = portalhit;
+   clip.portalhit_max = portalhit_max;
+
+   snap.player = nullptr;
+}
+
+// EOF
+
@@ -0,0 +1,37 @@
+// Emacs style mode select -*- C++ -*-
+//----------------------------------------------------------------------------
+//
+// Copyright(C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//----------------------------------------------------------------------------
+//
+// Client-side movement prediction for netgames.
+//
+//----------------------------------------------------------------------------
+
+#ifndef P_PREDICT_H__
+#define P_PREDICT_H__
+
+struct player_t;
+struct ticcmd_t;
+
+bool P_PredictPlayer(player_t *player, const ticcmd_t *cmds, int numcmds);
+void P_UnpredictPlayer();
+
+#endif
+
+// EOF
+
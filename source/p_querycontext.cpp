@@ -0,0 +1,125 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: visited sets for spatial queries.
+//
+
+#include "z_zone.h"
+#include "p_querycontext.h"
+
+QueryContext QueryContext::global(true);
+
+//
+// Pool of private contexts, one per thread. Queries may nest (a traversal
+// callback can start another one), so there may be several in use at once.
+//
+struct querypool_t
+{
+   QueryContext *free = nullptr;
+
+   ~querypool_t()
+   {
+      QueryContext *next;
+      for(QueryContext *query = free; query; query = next)
+      {
+         next = query->mNextFree;
+         delete query;
+      }
+   }
+};
+
+static thread_local querypool_t querypool;
+
+//
+// Gets a private context from the calling thread's pool, making a new one if
+// all are in use. Call newQuery on it before use.
+//
+QueryContext *QueryContext::Acquire()
+{
+   QueryContext *query = querypool.free;
+
+   if(!query)
+      return new QueryContext;
+
+   querypool.free = query->mNextFree;
+   query->mNextFree = nullptr;
+   return query;
+}
+
+//
+// Gives a context back to the pool of the calling thread
+//
+void QueryContext::Release(QueryContext *query)
+{
+   query->mNextFree = querypool.free;
+   querypool.free = query;
+}
+
+//
+// Frees the sets. They aren't zone-allocated, so that contexts can be
+// created and used by other threads.
+//
+QueryContext::~QueryContext()
+{
+   for(visitset_t *set : { &mLines, &mSectors, &mPolyobjs })
+   {
+      delete [] set->bits;
+      delete [] set->stamps;
+   }
+}
+
+//
+// Starts a new generation of all sets, resizing them first if the level has
+// changed size since the last query.
+//
+void QueryContext::newGeneration()
+{
+   const int counts[] = { numlines, numsectors, numPolyObjects };
+   visitset_t *sets[] = { &mLines, &mSectors, &mPolyobjs };
+   bool cleared = false;
+
+   for(size_t i = 0; i < earrlen(sets); i++)
+   {
+      int numwords = (counts[i] + 31) / 32;
+      if(numwords == sets[i]->numwords)
+         continue;
+
+      delete [] sets[i]->bits;
+      delete [] sets[i]->stamps;
+      sets[i]->bits     = new uint32_t[numwords ? numwords : 1];
+      sets[i]->stamps   = new uint32_t[numwords ? numwords : 1]();
+      sets[i]->numwords = numwords;
+      cleared = true;
+   }
+
+   // stamps from before a wraparound could be mistaken for current ones
+   if(cleared || ++mGeneration == 0)
+   {
+      for(visitset_t *set : sets)
+      {
+         for(int i = 0; i < set->numwords; i++)
+            set->stamps[i] = 0;
+      }
+      mGeneration = 1;
+   }
+}
+
+// EOF
+
@@ -0,0 +1,189 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: visited sets for spatial queries.
+//
+
+#ifndef P_QUERYCONTEXT_H_
+#define P_QUERYCONTEXT_H_
+
+#include "p_intercept.h"
+#include "polyobj.h"
+#include "r_defs.h"
+#include "r_main.h"
+#include "r_state.h"
+
+//
+// Query context
+//
+// Keeps track of the lines, sectors and polyobjects a spatial query has
+// already visited, and holds the intercepts of path traversals. The global
+// context is the classic one: it bumps validcount and stamps the validcount
+// fields of the map structures. Any other context owns its own sets, so
+// queries using different contexts may run at the same time, even on
+// different threads.
+//
+class QueryContext
+{
+public:
+   QueryContext() : mGlobal(false), mNextFree(nullptr), mGeneration(0)
+   {
+   }
+   ~QueryContext();
+
+   static QueryContext &Global()
+   {
+      return global;
+   }
+
+   // Private contexts kept for reuse by the calling thread
+   static QueryContext *Acquire();
+   static void Release(QueryContext *query);
+
+   //
+   // Starts a new query; everything counts as unvisited again
+   //
+   void newQuery()
+   {
+      if(mGlobal)
+         ++validcount;
+      else
+         newGeneration();
+   }
+
+   //
+   // Each mark function returns false if the object was already visited by
+   // this query, otherwise marks it and returns true.
+   //
+   bool markLine(line_t &line)
+   {
+      if(!mGlobal)
+         return mark(mLines, eindex(&line - lines));
+      if(line.validcount == validcount)
+         return false;
+      line.validcount = validcount;
+      return true;
+   }
+
+   bool markSector(sector_t &sector)
+   {
+      if(!mGlobal)
+         return mark(mSectors, eindex(&sector - sectors));
+      if(sector.validcount == validcount)
+         return false;
+      sector.validcount = validcount;
+      return true;
+   }
+
+   bool markPolyobj(polyobj_t &po)
+   {
+      if(!mGlobal)
+         return mark(mPolyobjs, eindex(&po - PolyObjects));
+      if(po.validcount == validcount)
+         return false;
+      po.validcount = validcount;
+      return true;
+   }
+
+   //
+   // These return true if the object was visited by this query, without
+   // marking it
+   //
+   bool lineMarked(const line_t &line) const
+   {
+      if(!mGlobal)
+         return isMarked(mLines, eindex(&line - lines));
+      return line.validcount == validcount;
+   }
+
+   bool sectorMarked(const sector_t &sector) const
+   {
+      if(!mGlobal)
+         return isMarked(mSectors, eindex(&sector - sectors));
+      return sector.validcount == validcount;
+   }
+
+   //
+   // Storage for the intercepts of a path traversal. Starting a new query
+   // doesn't clear it, as callbacks may run other queries in this context
+   // while the intercepts are being gone through.
+   //
+   InterceptArena &getIntercepts() { return mIntercepts; }
+
+private:
+   //
+   // Generation-stamped bitset: a word only counts if it was written during
+   // the current generation, so starting a new query doesn't clear anything.
+   //
+   struct visitset_t
+   {
+      uint32_t *bits;
+      uint32_t *stamps;
+      int       numwords;
+   };
+
+   explicit QueryContext(bool isglobal)
+      : mGlobal(isglobal), mNextFree(nullptr), mGeneration(0)
+   {
+   }
+
+   bool mark(visitset_t &set, int index)
+   {
+      int      word = index >> 5;
+      uint32_t bit  = 1u << (index & 31);
+
+      if(set.stamps[word] != mGeneration)
+      {
+         set.stamps[word] = mGeneration;
+         set.bits[word]   = bit;
+         return true;
+      }
+      if(set.bits[word] & bit)
+         return false;
+      set.bits[word] |= bit;
+      return true;
+   }
+
+   bool isMarked(const visitset_t &set, int index) const
+   {
+      int word = index >> 5;
+      return set.stamps[word] == mGeneration &&
+             (set.bits[word] & (1u << (index & 31)));
+   }
+
+   void newGeneration();
+
+   friend struct querypool_t;
+   static QueryContext global;
+
+   bool          mGlobal;
+   QueryContext *mNextFree; // in the pool of its thread
+   uint32_t      mGeneration;
+   visitset_t    mLines    = {};
+   visitset_t    mSectors  = {};
+   visitset_t    mPolyobjs = {};
+
+   InterceptArena mIntercepts;
+};
+
+#endif
+
+// EOF
+
@@ -23,6 +23,9 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <atomic>
+#include <thread>
+
 #include "z_zone.h"
 #include "i_system.h"
 
@@ -45,9 +48,11 @@
 #include "m_argv.h"
 #include "m_buffer.h"
 #include "m_random.h"
+#include "m_utils.h"
 #include "p_info.h"
 #include "p_maputl.h"
 #include "p_spec.h"
+#include "p_statehash.h"
 #include "p_tick.h"
 #include "p_saveg.h"
 #include "p_enemy.h"
@@ -56,6 +61,7 @@
 #include "p_hubs.h"
 #include "p_skin.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
 #include "r_draw.h"
 #include "r_main.h"
 #include "r_state.h"
@@ -67,6 +73,7 @@
 #include "version.h"
 #include "w_levels.h"
 #include "w_wad.h"
+#include "../zlib/zlib.h"
 
 // Pads save_p to a 4-byte boundary
 //  so that the load/save works on SGI&Gecko.
@@ -85,7 +92,7 @@
 // Constructs a SaveArchive object in saving mode.
 //
 SaveArchive::SaveArchive(OutBuffer *pSaveFile) 
-   : savefile(pSaveFile), loadfile(nullptr)
+   : savefile(pSaveFile), loadfile(nullptr), deltaWorld(false)
 {
    if(!pSaveFile)
       I_Error("SaveArchive: created a save file without a valid OutBuffer\n");
@@ -95,7 +102,7 @@ SaveArchive::SaveArchive(OutBuffer *pSaveFile)
 // Constructs a SaveArchive object in loading mode.
 //
 SaveArchive::SaveArchive(InBuffer *pLoadFile)
-   : savefile(nullptr), loadfile(pLoadFile)
+   : savefile(nullptr), loadfile(pLoadFile), deltaWorld(false)
 {
    if(!pLoadFile)
       I_Error("SaveArchive: created a load file without a valid InBuffer\n");
@@ -645,73 +652,187 @@ extern int LevelSky;
 extern int LevelTempSky;
 
 //
-// P_ArchiveWorld
+// Archives the dynamic properties of a single sector.
 //
-// Saves dynamic properties of sectors, lines, and sides.
+static void P_archiveSector(SaveArchive &arc, sector_t *sec)
+{
+   // killough 10/98: save full floor & ceiling heights, including fraction
+   // haleyjd: save the friction information too
+   // haleyjd 03/04/07: save colormap indices
+   // haleyjd 12/28/08: save sector flags
+   // haleyjd 08/30/09: intflags
+   // haleyjd 03/02/09: save sector damage properties
+   // haleyjd 08/30/09: save floorpic/ceilingpic as ints
+
+   arc << sec->floorheight << sec->ceilingheight 
+       << sec->friction << sec->movefactor  
+       << sec->topmap << sec->midmap << sec->bottommap
+       << sec->flags << sec->intflags 
+       << sec->damage << sec->damageflags << sec->leakiness << sec->damagemask
+       << sec->damagemod
+       << sec->floorpic << sec->ceilingpic
+       << sec->lightlevel << sec->oldlightlevel
+       << sec->floorlightdelta << sec->ceilinglightdelta
+       << sec->special << sec->tag; // needed?   yes -- transfer types -- killough
+
+   if(arc.isLoading())
+   {
+      // SoM: update the heights
+      P_SetFloorHeight(sec, sec->floorheight);
+      P_SetCeilingHeight(sec, sec->ceilingheight);
+   }
+}
+
 //
-static void P_ArchiveWorld(SaveArchive &arc)
+// Archives the dynamic properties of a single line and its sides.
+//
+static void P_archiveLine(SaveArchive &arc, line_t *li)
 {
-   int       i;
-   sector_t *sec;
-   line_t   *li;
-   side_t   *si;
-  
-   // do sectors
-   for(i = 0, sec = sectors; i < numsectors; ++i, ++sec)
+   arc << li->flags << li->special << li->tag
+       << li->args[0] << li->args[1] << li->args[2] << li->args[3] << li->args[4];
+
+   for(int j = 0; j < 2; j++)
    {
-      // killough 10/98: save full floor & ceiling heights, including fraction
-      // haleyjd: save the friction information too
-      // haleyjd 03/04/07: save colormap indices
-      // haleyjd 12/28/08: save sector flags
-      // haleyjd 08/30/09: intflags
-      // haleyjd 03/02/09: save sector damage properties
-      // haleyjd 08/30/09: save floorpic/ceilingpic as ints
-
-      arc << sec->floorheight << sec->ceilingheight 
-          << sec->friction << sec->movefactor  
-          << sec->topmap << sec->midmap << sec->bottommap
-          << sec->flags << sec->intflags 
-          << sec->damage << sec->damageflags << sec->leakiness << sec->damagemask
-          << sec->damagemod
-          << sec->floorpic << sec->ceilingpic
-          << sec->lightlevel << sec->oldlightlevel
-          << sec->floorlightdelta << sec->ceilinglightdelta
-          << sec->special << sec->tag; // needed?   yes -- transfer types -- killough
-
-      if(arc.isLoading())
+      if(li->sidenum[j] != -1)
       {
-         // jff 2/22/98 now three thinker fields, not two
-         sec->ceilingdata  = nullptr;
-         sec->floordata    = nullptr;
-         sec->lightingdata = nullptr;
-         sec->soundtarget  = nullptr;
-
-         // SoM: update the heights
-         P_SetFloorHeight(sec, sec->floorheight);
-         P_SetCeilingHeight(sec, sec->ceilingheight);
+         side_t *si = &sides[li->sidenum[j]];
+
+         // killough 10/98: save full sidedef offsets,
+         // preserving fractional scroll offsets
+
+         arc << si->textureoffset << si->rowoffset
+             << si->toptexture << si->bottomtexture << si->midtexture;
+      }
+   }
+}
+
+//
+// World Baseline
+//
+// The serialized state of every sector and line as it stands right after
+// level setup. Delta archives only store the entries which differ from it;
+// everything else is restored from here.
+//
+static byte   *worldbaseline;    // serialized sectors, then lines
+static size_t *worldbaseoffsets; // numsectors + numlines + 1 offsets into it
+
+//
+// P_SaveWorldBaseline
+//
+// Called at the end of level setup to snapshot the initial world state.
+//
+void P_SaveWorldBaseline()
+{
+   OutBuffer   basefile;
+   SaveArchive arc(&basefile);
+   int         i, numitems = numsectors + numlines;
+
+   basefile.createMemory(64*1024, OutBuffer::NENDIAN);
+
+   worldbaseoffsets = static_cast<size_t *>
+      (Z_Malloc((numitems + 1) * sizeof(size_t), PU_LEVEL,
+                reinterpret_cast<void **>(&worldbaseoffsets)));
+
+   for(i = 0; i < numsectors; i++)
+   {
+      worldbaseoffsets[i] = basefile.getMemorySize();
+      P_archiveSector(arc, &sectors[i]);
+   }
+   for(i = 0; i < numlines; i++)
+   {
+      worldbaseoffsets[numsectors + i] = basefile.getMemorySize();
+      P_archiveLine(arc, &lines[i]);
+   }
+   worldbaseoffsets[numitems] = basefile.getMemorySize();
+
+   worldbaseline = static_cast<byte *>
+      (Z_Malloc(basefile.getMemorySize() + 1, PU_LEVEL,
+                reinterpret_cast<void **>(&worldbaseline)));
+   memcpy(worldbaseline, basefile.getMemory(), basefile.getMemorySize());
+}
+
+//
+// Archives one sector or line of a delta archive. When saving, a change flag
+// is written, followed by the entry only if it differs from the baseline.
+// When loading, unchanged entries are restored from the baseline.
+//
+template<typename T>
+static void P_archiveDeltaItem(SaveArchive &arc, OutBuffer &scratch, int baseidx,
+                               T *item, void (*archiver)(SaveArchive &, T *))
+{
+   const byte *base     = worldbaseline + worldbaseoffsets[baseidx];
+   size_t      basesize = worldbaseoffsets[baseidx + 1] - worldbaseoffsets[baseidx];
+   uint8_t     changed;
+
+   if(arc.isSaving())
+   {
+      SaveArchive scratcharc(&scratch);
+
+      scratch.resetMemory();
+      archiver(scratcharc, item);
+
+      changed = (scratch.getMemorySize() != basesize ||
+                 memcmp(scratch.getMemory(), base, basesize));
+      arc << changed;
+      if(changed)
+         arc.getSaveFile()->write(scratch.getMemory(), scratch.getMemorySize());
+   }
+   else
+   {
+      arc << changed;
+      if(changed)
+         archiver(arc, item);
+      else
+      {
+         InBuffer    basefile;
+         SaveArchive basearc(&basefile);
+
+         basefile.openMemory(base, basesize, InBuffer::NENDIAN);
+         archiver(basearc, item);
       }
    }
+}
 
-   // do lines
-   for(i = 0, li = lines; i < numlines; ++i, ++li)
+//
+// P_ArchiveWorld
+//
+// Saves dynamic properties of sectors, lines, and sides.
+//
+static void P_ArchiveWorld(SaveArchive &arc)
+{
+   int i;
+
+   if(arc.isDeltaWorld())
    {
-      int j;
+      OutBuffer scratch;
 
-      arc << li->flags << li->special << li->tag
-          << li->args[0] << li->args[1] << li->args[2] << li->args[3] << li->args[4];
+      if(!worldbaseline)
+         I_Error("P_ArchiveWorld: no world baseline for delta archive\n");
 
-      for(j = 0; j < 2; j++)
+      scratch.createMemory(256, OutBuffer::NENDIAN);
+
+      for(i = 0; i < numsectors; i++)
+         P_archiveDeltaItem(arc, scratch, i, &sectors[i], P_archiveSector);
+      for(i = 0; i < numlines; i++)
+         P_archiveDeltaItem(arc, scratch, numsectors + i, &lines[i], P_archiveLine);
+   }
+   else
+   {
+      for(i = 0; i < numsectors; i++)
+         P_archiveSector(arc, &sectors[i]);
+      for(i = 0; i < numlines; i++)
+         P_archiveLine(arc, &lines[i]);
+   }
+
+   if(arc.isLoading())
+   {
+      for(i = 0; i < numsectors; i++)
       {
-         if(li->sidenum[j] != -1)
-         {
-            si = &sides[li->sidenum[j]];
-            
-            // killough 10/98: save full sidedef offsets,
-            // preserving fractional scroll offsets
-            
-            arc << si->textureoffset << si->rowoffset
-                << si->toptexture << si->bottomtexture << si->midtexture;
-         }
+         // jff 2/22/98 now three thinker fields, not two
+         sectors[i].ceilingdata  = nullptr;
+         sectors[i].floordata    = nullptr;
+         sectors[i].lightingdata = nullptr;
+         sectors[i].soundtarget  = nullptr;
       }
    }
 
@@ -1002,8 +1123,9 @@ static void P_ArchivePolyObj(SaveArchive &arc, polyobj_t *po)
       if((po->flags & POF_ISBAD) || po != Polyobj_GetForNum(po->id))
          return;
 
-      // rotate and translate polyobject
-      Polyobj_MoveOnLoad(po, angle, pt.x, pt.y);
+      // rotate and translate polyobject; the angle is passed relative to the
+      // current one, so that this also works on a level that is already set up
+      Polyobj_MoveOnLoad(po, angle - po->angle, pt.x, pt.y);
    }
 }
 
@@ -1255,155 +1377,538 @@ static void P_ArchiveACS(SaveArchive &arc)
 
 //============================================================================
 //
-// Saving - Main Routine
+// Compressed Save Format
+//
+// Savegames begin with the uncompressed description string so that the menus
+// can read it directly. It is followed by a small header and then by the
+// archive itself, deflated with zlib. Older savegames have the archive stored
+// raw right after the description, and are recognized by the absence of the
+// header magic.
 //
 
 #define SAVESTRINGSIZE 24
 
-void P_SaveCurrentLevel(char *filename, char *description)
+static const char saveMagic[4] = { 'E', 'E', 'S', 'Z' };
+
+// description, magic, flags, uncompressed archive size
+#define SAVEHEADERSIZE (SAVESTRINGSIZE + sizeof(saveMagic) + 2 * sizeof(uint32_t))
+
+// largest uncompressed archive a savegame may claim to hold; deflate can't
+// expand data by more than SAVEMAXRATIO to one either
+#define SAVEMAXRAWSIZE (256u * 1024u * 1024u)
+#define SAVEMAXRATIO   1032u
+
+enum
+{
+   SAVEF_DELTAWORLD = 0x00000001, // world is archived relative to baseline
+
+   SAVEF_KNOWN = SAVEF_DELTAWORLD
+};
+
+//
+// Fills in the uncompressed header which precedes the deflated archive.
+//
+static void P_writeSaveHeader(byte *dest, const char *description, uint32_t flags,
+                              size_t rawsize)
+{
+   OutBuffer header;
+   char      desc[SAVESTRINGSIZE];
+
+   memset(desc, 0, sizeof(desc));
+   strncpy(desc, description, SAVESTRINGSIZE);
+
+   header.createMemory(SAVEHEADERSIZE, OutBuffer::NENDIAN);
+   header.write(desc, SAVESTRINGSIZE);
+   header.write(saveMagic, sizeof(saveMagic));
+   header.writeUint32(flags);
+   header.writeUint32(static_cast<uint32_t>(rawsize));
+   memcpy(dest, header.getMemory(), SAVEHEADERSIZE);
+}
+
+//============================================================================
+//
+// Background Writing
+//
+// The archive is built into memory on the game thread, which is fast. The
+// slow parts, compressing the data and writing it out to disk, happen on a
+// worker thread. Only the system heap may be used from there, as the zone
+// allocator is not thread-safe.
+//
+
+struct savejob_t
+{
+   char   *filename;                  // destination file
+   byte    header[SAVEHEADERSIZE];    // description + format header
+   byte   *data;                      // raw archive
+   size_t  size;                      // raw archive size
+   bool    message;                   // print "game saved" when done
+   int     error;                     // errno, or -1 for unknown failure
+};
+
+static std::thread       saveWriterThread;
+static std::atomic<bool> saveWriterDone;
+static savejob_t        *saveWriterJob;
+
+//
+// Worker thread routine: compress the archive and write the file. A temporary
+// file is renamed over the destination at the end, so that an interrupted
+// save never destroys the previous one in that slot.
+//
+static void P_saveWriterThread(savejob_t *job)
+{
+   uLongf  complen = compressBound(static_cast<uLong>(job->size));
+   byte   *comp    = static_cast<byte *>(malloc(complen));
+   size_t  fnlen   = strlen(job->filename) + 5;
+   char   *tmpname = static_cast<char *>(malloc(fnlen));
+   FILE   *f       = nullptr;
+
+   job->error = 0;
+
+   if(!comp || !tmpname)
+      job->error = ENOMEM;
+   else if(compress2(comp, &complen, job->data, static_cast<uLong>(job->size),
+                     Z_DEFAULT_COMPRESSION) != Z_OK)
+      job->error = -1;
+   else
+   {
+      snprintf(tmpname, fnlen, "%s.tmp", job->filename);
+
+      errno = 0;
+      if(!(f = fopen(tmpname, "wb")) ||
+         fwrite(job->header, sizeof(job->header), 1, f) < 1 ||
+         fwrite(comp, complen, 1, f) < 1)
+      {
+         job->error = errno ? errno : -1;
+      }
+      if(f && fclose(f) && !job->error)
+         job->error = errno ? errno : -1;
+
+      if(job->error)
+         remove(tmpname);
+      else
+      {
+#ifdef _WIN32
+         // rename will not replace an existing file here
+         remove(job->filename);
+#endif
+         if(rename(tmpname, job->filename))
+            job->error = errno ? errno : -1;
+      }
+   }
+
+   free(tmpname);
+   free(comp);
+   free(job->data);
+   job->data = nullptr;
+
+   saveWriterDone = true;
+}
+
+//
+// Joins the worker thread and reports the outcome of the save.
+//
+static void P_reapSaveWriter()
+{
+   savejob_t *job = saveWriterJob;
+
+   saveWriterThread.join();
+   saveWriterJob = nullptr;
+
+   if(job->error)
+   {
+      const char *str = job->error > 0 ? strerror(job->error) :
+         FC_ERROR "Could not save game: Error unknown";
+      doom_printf("%s", str);
+   }
+   else if(job->message)
+      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+
+   free(job->filename);
+   free(job);
+}
+
+//
+// P_CheckSaveWriter
+//
+// Called every gametic to report on a background save once it finishes.
+//
+void P_CheckSaveWriter()
+{
+   if(saveWriterJob && saveWriterDone)
+      P_reapSaveWriter();
+}
+
+//
+// P_FinishSaveWriter
+//
+// Blocks until any pending background save has been written out.
+//
+void P_FinishSaveWriter()
+{
+   if(saveWriterJob)
+      P_reapSaveWriter();
+}
+
+//
+// Hands a finished in-memory archive off to the worker thread.
+//
+static void P_startSaveWriter(const char *filename, const char *description,
+                              uint32_t flags, const OutBuffer &savefile)
+{
+   static bool atexit_set = false;
+   savejob_t  *job;
+
+   if(!atexit_set)
+   {
+      atexit(P_FinishSaveWriter);
+      atexit_set = true;
+   }
+
+   job = static_cast<savejob_t *>(calloc(1, sizeof(savejob_t)));
+   job->filename = static_cast<char *>(malloc(strlen(filename) + 1));
+   job->size     = savefile.getMemorySize();
+   job->data     = static_cast<byte *>(malloc(job->size));
+   if(!job->filename || !job->data)
+      I_Error("P_SaveCurrentLevel: failed to allocate %u bytes\n", unsigned(job->size));
+
+   strcpy(job->filename, filename);
+   memcpy(job->data, savefile.getMemory(), job->size);
+   job->message = !hub_changelevel; // sf: no 'game saved' message for hubs
+
+   P_writeSaveHeader(job->header, description, flags, job->size);
+
+   saveWriterDone = false;
+   saveWriterJob  = job;
+   saveWriterThread = std::thread(P_saveWriterThread, job);
+}
+
+//============================================================================
+//
+// Saving - Main Routine
+//
+
+//
+// Archives the complete game state into a memory buffer. Returns the format
+// flags describing the archive.
+//
+static uint32_t P_archiveGame(OutBuffer &savefile)
 {
    int i;
    char name2[VERSIONSIZE];
    const char *fn;
-   OutBuffer savefile;
    SaveArchive arc(&savefile);
+   uint32_t flags = 0;
 
-   if(!savefile.createFile(filename, 512*1024, OutBuffer::NENDIAN))
+   if(worldbaseline)
    {
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-      return;
+      arc.setDeltaWorld(true);
+      flags |= SAVEF_DELTAWORLD;
    }
 
-   // Enable buffered IO exceptions
-   savefile.setThrowing(true);
+   // killough 2/22/98: "proprietary" version string :-)
+   memset(name2, 0, sizeof(name2));
+   sprintf(name2, VERSIONID, version);
 
-   try
-   {
-      arc.archiveCString(description, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      memset(name2, 0, sizeof(name2));
-      sprintf(name2, VERSIONID, version);
-   
-      arc.archiveCString(name2, VERSIONSIZE);
-   
-      // killough 2/14/98: save old compatibility flag:
-      // haleyjd 06/16/10: save "inmasterlevels" state
-      int tempskill = (int)gameskill;
+   arc.archiveCString(name2, VERSIONSIZE);
+
+   // killough 2/14/98: save old compatibility flag:
+   // haleyjd 06/16/10: save "inmasterlevels" state
+   int tempskill = (int)gameskill;
       
-      arc << compatibility << tempskill << inmanageddir;
-      arc << vanilla_mode;
+   arc << compatibility << tempskill << inmanageddir;
+   arc << vanilla_mode;
    
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc = levelmapname[i];
-         arc << lvc;
-      }
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc = levelmapname[i];
+      arc << lvc;
+   }
 
-      // haleyjd 06/16/10: support for saving/loading levels in managed wad
-      // directories.
+   // haleyjd 06/16/10: support for saving/loading levels in managed wad
+   // directories.
 
-      if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
-      {
-         // save length of managed directory filename string and
-         // managed directory filename string
-         arc.writeLString(fn);
-      }
-      else
-      {
-         // just save 0; there is no name to save
-         size_t len = 0;
-         arc.archiveSize(len);
-      }
+   if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
+   {
+      // save length of managed directory filename string and
+      // managed directory filename string
+      arc.writeLString(fn);
+   }
+   else
+   {
+      // just save 0; there is no name to save
+      size_t len = 0;
+      arc.archiveSize(len);
+   }
   
-      // killough 3/16/98, 12/98: store lump name checksum
-      // FIXME/TODO: Will be simple with future save format
-      /*
-      uint64_t checksum = G_Signature(g_dir);
-      savefile.Write(&checksum, sizeof(checksum));
-
-      // killough 3/16/98: store pwad filenames in savegame  
-      for(wfileadd_t *file = wadfiles; file->filename; ++file)
-      {
-         const char *fn = file->filename;
-         savefile.Write(fn, strlen(fn));
-         savefile.WriteUint8((uint8_t)'\n');
-      }
-      savefile.WriteUint8(0);
-      */
+   // killough 3/16/98, 12/98: store lump name checksum
+   // FIXME/TODO: Will be simple with future save format
+   /*
+   uint64_t checksum = G_Signature(g_dir);
+   savefile.Write(&checksum, sizeof(checksum));
+
+   // killough 3/16/98: store pwad filenames in savegame  
+   for(wfileadd_t *file = wadfiles; file->filename; ++file)
+   {
+      const char *fn = file->filename;
+      savefile.Write(fn, strlen(fn));
+      savefile.WriteUint8((uint8_t)'\n');
+   }
+   savefile.WriteUint8(0);
+   */
   
-      for(i = 0; i < MAXPLAYERS; i++)
-         arc << playeringame[i];
+   for(i = 0; i < MAXPLAYERS; i++)
+      arc << playeringame[i];
 
-      for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
-      {
-         bool dummy = 0;
-         arc << dummy;
-      }
+   for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
 
-      // jff 3/17/98 save idmus state
-      int tempGameType = (int)GameType;
-      arc << idmusnum << tempGameType;
+   // jff 3/17/98 save idmus state
+   int tempGameType = (int)GameType;
+   arc << idmusnum << tempGameType;
 
-      byte options[GAME_OPTION_SIZE];
-      G_WriteOptions(options);    // killough 3/1/98: save game options
-      savefile.write(options, sizeof(options));
+   byte options[GAME_OPTION_SIZE];
+   G_WriteOptions(options);    // killough 3/1/98: save game options
+   savefile.write(options, sizeof(options));
    
-      //killough 11/98: save entire word
-      arc << leveltime;
+   //killough 11/98: save entire word
+   arc << leveltime;
    
-      // killough 11/98: save revenant tracer state
-      uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
-      arc << tracerState;
+   // killough 11/98: save revenant tracer state
+   uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
+   arc << tracerState;
 
-      arc << dmflags;
+   arc << dmflags;
    
-      // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
-      // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
+   // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
+   // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
    
-      P_NumberThinkers();    // turn ptrs to numbers
+   P_NumberThinkers();    // turn ptrs to numbers
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
+   P_ArchiveMap(arc);    // killough 1/22/98: save automap information
+   P_ArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+
+   P_DeNumberThinkers();
+
+   uint8_t cmarker = 0xE6; // consistency marker
+   arc << cmarker; 
+
+   return flags;
+}
+
+//
+// P_SaveCurrentLevel
+//
+// Saves the game to a file. The file is written out in the background.
+//
+void P_SaveCurrentLevel(char *filename, char *description)
+{
+   OutBuffer savefile;
+   uint32_t  flags;
+
+   // only one save may be in flight at a time
+   P_FinishSaveWriter();
+
+   savefile.createMemory(512*1024, OutBuffer::NENDIAN);
+   flags = P_archiveGame(savefile);
+
+   // Compress and write it out in the background
+   P_startSaveWriter(filename, description, flags, savefile);
+
+   // Check the heap.
+   Z_CheckHeap();
+}
+
+//
+// P_SaveGameToMemory
+//
+// Saves the game to a compressed image in memory, laid out exactly like a
+// savegame file. Compression favors speed here. The returned buffer belongs
+// to the caller, and its size is returned in the size parameter.
+//
+byte *P_SaveGameToMemory(const char *description, size_t &size)
+{
+   OutBuffer savefile;
+   uint32_t  flags;
+   byte     *image;
+
+   savefile.createMemory(512*1024, OutBuffer::NENDIAN);
+   flags = P_archiveGame(savefile);
+
+   uLong  rawsize = static_cast<uLong>(savefile.getMemorySize());
+   uLongf complen = compressBound(rawsize);
+
+   image = emalloc(byte *, SAVEHEADERSIZE + complen);
+   P_writeSaveHeader(image, description, flags, rawsize);
+
+   if(compress2(image + SAVEHEADERSIZE, &complen, savefile.getMemory(), rawsize,
+                Z_BEST_SPEED) != Z_OK)
+   {
+      I_Error("P_SaveGameToMemory: compression failed\n");
+   }
+
+   size = SAVEHEADERSIZE + complen;
+   return erealloc(byte *, image, size);
+}
+
+//============================================================================
+//
+// Snapshots
+//
+// A snapshot holds the state of the level in play, without the game setup
+// that a savegame carries along. Restoring one puts the level back where it
+// was without going through level setup, so a snapshot is only good for the
+// level it was taken on. These back the rewind buffer.
+//
+
+// Mobjs replaced by a snapshot which something still points to
+static PODCollection<Mobj *> replacedmobjs;
+
+//
+// Frees the mobjs which a snapshot replaced, once nothing refers to them.
+// Those still referred to are tried again at the next restore.
+//
+static void P_freeReplacedMobjs()
+{
+   size_t kept = 0;
+
+   // the old mobjs may still point at one another
+   for(Mobj *mo : replacedmobjs)
+   {
+      P_SetTarget<Mobj>(&mo->target,    nullptr);
+      P_SetTarget<Mobj>(&mo->tracer,    nullptr);
+      P_SetTarget<Mobj>(&mo->lastenemy, nullptr);
+   }
+
+   for(size_t i = 0; i < replacedmobjs.getLength(); i++)
+   {
+      Mobj *mo = replacedmobjs[i];
+
+      if(mo->getReferences())
+         replacedmobjs[kept++] = mo;
+      else
+         delete mo;
+   }
+   replacedmobjs.resize(kept);
+}
+
+//
+// P_ForgetReplacedMobjs
+//
+// Called at level setup, when the replaced mobjs have gone with the level.
+//
+void P_ForgetReplacedMobjs()
+{
+   replacedmobjs.clear();
+}
+
+//
+// P_SaveSnapshot
+//
+void P_SaveSnapshot(OutBuffer &buf)
+{
+   SaveArchive arc(&buf);
+   bool deltaworld = (worldbaseline != nullptr);
+   int  tracerState = gametic - basetic;
+
+   arc << deltaworld;
+   arc.setDeltaWorld(deltaworld);
+
+   arc << leveltime << tracerState << dmflags;
+
+   P_NumberThinkers();
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc);
+   P_ArchiveThinkers(arc);
+   P_ArchiveItemRespawnQueue(arc);
+   P_ArchiveRNG(arc);
+   P_ArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);
+
+   P_DeNumberThinkers();
+
+   uint8_t cmarker = 0xE6;
+   arc << cmarker;
+}
+
+//
+// P_LoadSnapshot
+//
+// Restores a snapshot taken with P_SaveSnapshot on the current level.
+//
+void P_LoadSnapshot(InBuffer &buf)
+{
+   SaveArchive arc(&buf);
+
+   buf.setThrowing(true);
+
+   try
+   {
+      bool deltaworld;
+      int  tracerState;
+
+      arc << deltaworld;
+      if(deltaworld && !worldbaseline)
+         I_Error("P_LoadSnapshot: snapshot does not belong to this level\n");
+      arc.setDeltaWorld(deltaworld);
+
+      arc << leveltime << tracerState << dmflags;
+      basetic = gametic - tracerState;
+
+      // sounds still playing belong to objects which are about to go away
+      S_StopSounds(false);
+
+      // the mobjs in play are about to be replaced
+      for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+      {
+         if(th->isInstanceOf(RTTI(Mobj)))
+            replacedmobjs.add(static_cast<Mobj *>(th));
+      }
 
       P_ArchivePlayers(arc);
       P_ArchiveWorld(arc);
       P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+      P_ArchivePolyObjects(arc);
       P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
-      P_ArchiveMap(arc);    // killough 1/22/98: save automap information
-      P_ArchiveSoundSequences(arc);
+      P_ArchiveItemRespawnQueue(arc); // after thinkers; removal refills it
+      P_ArchiveRNG(arc);
+      P_UnArchiveSoundSequences(arc);
       P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
+      P_ArchiveACS(arc);
+
+      P_FreeThinkerTable();
+
+      uint8_t cmarker;
+      arc << cmarker;
+      if(cmarker != 0xE6)
+         I_Error("Bad snapshot: last byte is 0x%x\n", cmarker);
 
-      P_DeNumberThinkers();
+      P_StateHashRebuild();
 
-      uint8_t cmarker = 0xE6; // consistency marker
-      arc << cmarker; 
+      // anything may have changed, not just sector heights
+      P_SightBatchInvalidate();
    }
-   catch(BufferedIOException)
+   catch(...)
    {
-      // An IO error occurred while trying to save.
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-
-      // Close the file and remove it
-      savefile.setThrowing(false);
-      savefile.close();
-      remove(filename);
-      return;
+      I_Error("P_LoadSnapshot: snapshot read error\n");
    }
 
-   // Close the save file
-   savefile.close();
-
-   // Check the heap.
-   Z_CheckHeap();
-
-   if(!hub_changelevel) // sf: no 'game saved' message for hubs
-      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+   P_freeReplacedMobjs();
 }
 
 //============================================================================
@@ -1411,31 +1916,77 @@ void P_SaveCurrentLevel(char *filename, char *description)
 // Loading -- Main Routine
 //
 
-void P_LoadGame(const char *filename)
+//
+// P_LoadGameFromMemory
+//
+// Loads a game from a savegame image held in memory, in either the compressed
+// or the old raw format.
+//
+void P_LoadGameFromMemory(const byte *data, size_t size)
 {
    int i;
    char vcheck[VERSIONSIZE], vread[VERSIONSIZE];
    //uint64_t checksum, rchecksum;
+   InBuffer savefile;
    InBuffer loadfile;
-   SaveArchive arc(&loadfile);
+   InBuffer *src = &savefile;
+   bool deltaworld = false;
+   byte *rawdata = nullptr;
 
-   if(!loadfile.openFile(filename, InBuffer::NENDIAN))
-   {
-      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
-      C_SetConsole();
-      return;
-   }
+   savefile.openMemory(data, size, InBuffer::NENDIAN);
 
    // Enable buffered IO exceptions
+   savefile.setThrowing(true);
    loadfile.setThrowing(true);
 
    try
    {
       // skip description
       char throwaway[SAVESTRINGSIZE];
+      char magic[sizeof(saveMagic)];
+
+      savefile.read(throwaway, SAVESTRINGSIZE);
+
+      if(size >= SAVEHEADERSIZE &&
+         savefile.read(magic, sizeof(magic)) == sizeof(magic) &&
+         !memcmp(magic, saveMagic, sizeof(magic)))
+      {
+         uint32_t flags = 0, rawsize = 0;
+
+         savefile.readUint32(flags);
+         savefile.readUint32(rawsize);
+         if(flags & ~SAVEF_KNOWN)
+            I_Error("P_LoadGame: unsupported savegame format 0x%x\n", flags);
+
+         // don't trust the stored size with an allocation before checking it
+         if(!rawsize || rawsize > SAVEMAXRAWSIZE ||
+            rawsize / SAVEMAXRATIO > size - SAVEHEADERSIZE)
+         {
+            I_Error("P_LoadGame: savegame claims a bad size of %u bytes\n",
+                    static_cast<unsigned int>(rawsize));
+         }
+
+         // inflate the rest of the image
+         uLongf rawlen = rawsize;
+         rawdata = emalloc(byte *, rawlen + 1);
+
+         if(uncompress(rawdata, &rawlen, data + SAVEHEADERSIZE,
+                       static_cast<uLong>(size - SAVEHEADERSIZE)) != Z_OK ||
+            rawlen != rawsize)
+         {
+            I_Error("P_LoadGame: compressed savegame is corrupt\n");
+         }
+
+         loadfile.openMemory(rawdata, rawlen, InBuffer::NENDIAN);
+         src = &loadfile;
+         deltaworld = !!(flags & SAVEF_DELTAWORLD);
+      }
+      else // old format: archive is stored raw after the description
+         savefile.seek(SAVESTRINGSIZE, SEEK_SET);
+
+      SaveArchive arc(src);
+      arc.setDeltaWorld(deltaworld);
 
-      arc.archiveCString(throwaway, SAVESTRINGSIZE);
-      
       // killough 2/22/98: "proprietary" version string :-)
       sprintf(vcheck, VERSIONID, version);
 
@@ -1553,7 +2104,7 @@ void P_LoadGame(const char *filename)
 
       /* cph 2001/05/23 - Must read options before we set up the level */
       byte options[GAME_OPTION_SIZE];
-      loadfile.read(options, sizeof(options));
+      src->read(options, sizeof(options));
 
       G_ReadOptions(options);
  
@@ -1602,6 +2153,9 @@ void P_LoadGame(const char *filename)
       if(cmarker != 0xE6)
          I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
 
+      // sector heights were restored directly
+      P_StateHashRebuild();
+
       // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
       Z_CheckHeap(); 
    }
@@ -1612,6 +2166,10 @@ void P_LoadGame(const char *filename)
    }
 
    loadfile.close();
+   savefile.close();
+
+   if(rawdata)
+      efree(rawdata);
 
    if (setsizeneeded)
       R_ExecuteSetViewSize();
@@ -1640,6 +2198,31 @@ void P_LoadGame(const char *filename)
       P_RestorePlayerPosition();
 }
 
+//
+// P_LoadGame
+//
+// Loads a savegame file.
+//
+void P_LoadGame(const char *filename)
+{
+   byte *data = nullptr;
+   int   size;
+
+   // make sure the file isn't still being written
+   P_FinishSaveWriter();
+
+   if((size = M_ReadFile(filename, &data)) < 0)
+   {
+      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
+      C_SetConsole();
+      return;
+   }
+
+   P_LoadGameFromMemory(data, static_cast<size_t>(size));
+
+   efree(data);
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_saveg.c,v $
@@ -46,6 +46,7 @@ class SaveArchive
 protected:
    OutBuffer *savefile;        // valid when saving
    InBuffer  *loadfile;        // valid when loading
+   bool       deltaWorld;      // world is archived relative to level baseline
 
 public:
    explicit SaveArchive(OutBuffer *pSaveFile);
@@ -57,6 +58,9 @@ public:
    OutBuffer *getSaveFile() { return savefile; }
    InBuffer  *getLoadFile() { return loadfile; }
 
+   bool isDeltaWorld() const     { return deltaWorld; }
+   void setDeltaWorld(bool val)  { deltaWorld = val;  }
+
    // Methods
    void archiveCString(char *str,  size_t maxLen);
    void archiveLString(char *&str, size_t &len);
@@ -114,9 +118,24 @@ unsigned int P_NumForThinker(Thinker *th);
 Thinker *P_ThinkerForNum(unsigned int n);
 void P_SetNewTarget(Mobj **mop, Mobj *targ);
 
+void P_SaveWorldBaseline();
+
 void P_SaveCurrentLevel(char *filename, char *description);
 void P_LoadGame(const char *filename);
 
+// In-memory savegame images, laid out like savegame files
+byte *P_SaveGameToMemory(const char *description, size_t &size);
+void  P_LoadGameFromMemory(const byte *data, size_t size);
+
+// Background savegame writing
+void P_CheckSaveWriter();
+void P_FinishSaveWriter();
+
+// Snapshots of the level in play, for the rewind buffer
+void P_SaveSnapshot(OutBuffer &buf);
+void P_LoadSnapshot(InBuffer &buf);
+void P_ForgetReplacedMobjs();
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -111,6 +111,8 @@ void P_NewSectorActionFromMobj(Mobj *actor)
 int EV_SectorSetRotation(const line_t *line, int tag, int floorangle,
                          int ceilingangle)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int secnum = -1;
 
    bool manual = false;
@@ -124,8 +126,10 @@ int EV_SectorSetRotation(const line_t *line, int tag, int floorangle,
    }
 
    // TODO: Once UDMF, let this work for line arg0 when in UDMF config.
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sector = sectors + secnum;
    manualtrig:
       sector->floorangle = static_cast<float>
@@ -147,6 +151,8 @@ int EV_SectorSetRotation(const line_t *line, int tag, int floorangle,
 int EV_SectorSetCeilingPanning(const line_t *line, int tag, fixed_t xoffs,
                                fixed_t yoffs)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int secnum = -1;
 
    bool manual = false;
@@ -160,8 +166,10 @@ int EV_SectorSetCeilingPanning(const line_t *line, int tag, fixed_t xoffs,
    }
 
    // TODO: Once UDMF, let this work for line arg0 when in UDMF config.
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sector = sectors + secnum;
    manualtrig:
       sector->ceiling_xoffs = xoffs;
@@ -181,6 +189,8 @@ int EV_SectorSetCeilingPanning(const line_t *line, int tag, fixed_t xoffs,
 int EV_SectorSetFloorPanning(const line_t *line, int tag, fixed_t xoffs,
                              fixed_t yoffs)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    int secnum = -1;
 
    bool manual = false;
@@ -194,8 +204,10 @@ int EV_SectorSetFloorPanning(const line_t *line, int tag, fixed_t xoffs,
    }
 
    // TODO: Once UDMF, let this work for line arg0 when in UDMF config.
-   while((secnum = P_FindSectorFromTag(tag, secnum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secnum = tagged[tagpos];
       sector = sectors + secnum;
    manualtrig:
       sector->floor_xoffs = xoffs;
@@ -212,12 +224,16 @@ int EV_SectorSetFloorPanning(const line_t *line, int tag, fixed_t xoffs,
 //
 int EV_SectorSoundChange(int tag, int sndSeqID)
 {
+   const int *tagged    = NULL; // sectors with the tag
+   int        numtagged = 0, tagpos = 0;
    if(!tag)
       return 0;
    int secNum = -1;
    bool rtn = false;
-   while((secNum = P_FindSectorFromTag(tag, secNum)) >= 0)
+   numtagged = P_SectorTagSpan(tag, tagged);
+   for(tagpos = 0; tagpos < numtagged; tagpos++)
    {
+      secNum = tagged[tagpos];
       sectors[secNum].sndSeqID = sndSeqID;
       rtn = true;
    }
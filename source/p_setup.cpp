@@ -44,6 +44,7 @@
 #include "ev_specials.h"
 #include "g_demolog.h"
 #include "g_game.h"
+#include "g_rewind.h"
 #include "hu_frags.h"
 #include "hu_stuff.h"
 #include "in_lude.h"
@@ -53,18 +54,22 @@
 #include "p_anim.h"  // haleyjd: lightning
 #include "p_chase.h"
 #include "p_enemy.h"
+#include "p_flowpath.h"
 #include "p_hubs.h"
 #include "p_info.h"
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_mobjcol.h"
+#include "p_noise.h"
 #include "p_partcl.h"
 #include "p_portal.h"
+#include "p_saveg.h"
 #include "p_scroll.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "p_slopes.h"
 #include "p_spec.h"
+#include "p_statehash.h"
 #include "p_tick.h"
 #include "polyobj.h"
 #include "r_data.h"
@@ -178,6 +183,9 @@ byte     *portalmap;              // haleyjd: for portals
 
 bool      skipblstart;            // MaxW: Skip initial blocklist short
 
+// ints in a blockmap lump that wasn't verified, or -1 if it's known good
+static int blockmapcount;
+
 //
 // REJECT
 // For fast sight rejection.
@@ -2698,6 +2706,8 @@ static void P_LoadBlockMap(int lump)
    // sf: -blockmap checkparm made into variable
    // also checking for levels without blockmaps (0 length)
    // haleyjd 03/04/10: blockmaps of less than 8 bytes cannot be valid
+   blockmapcount = -1;
+
    if(r_blockmap || len < 8 || count >= 0x10000)
    {
       P_CreateBlockMap();
@@ -2732,6 +2742,9 @@ static void P_LoadBlockMap(int lump)
       bmapwidth  = blockmaplump[2];
       bmapheight = blockmaplump[3];
 
+      if(demo_compatibility)
+         blockmapcount = count;
+
       // haleyjd 03/04/10: check for blockmap problems
       if(!(demo_compatibility || P_VerifyBlockMap(count)))
       {
@@ -3794,6 +3807,21 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    // haleyjd
    P_InitLightning();
 
+   // portal groups and polyobjects are known now
+   P_BuildBlockLineBoxes(blockmapcount);
+   P_BuildNoiseGraph();
+   P_InitFlowPaths();
+
+   // snapshot initial sector and line state for delta archives
+   P_SaveWorldBaseline();
+
+   // rewind snapshots of the previous level are no good anymore
+   G_ClearRewind();
+   P_ForgetReplacedMobjs();
+
+   // start the world state hash for desync checks
+   P_StateHashRebuild();
+
    // preload graphics
    if(precache)
       R_PrecacheLevel();
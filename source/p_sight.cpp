@@ -31,7 +31,9 @@
 #include "e_exdata.h"
 #include "m_bbox.h"
 #include "p_maputl.h"
+#include "p_querycontext.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
 #include "r_dynseg.h"
 #include "r_main.h"
 #include "r_state.h"
@@ -48,6 +50,7 @@ typedef struct los_s
    divline_t strace;                // from t1 to t2
    fixed_t topslope, bottomslope;   // slopes to top and bottom of target
    fixed_t bbox[4];
+   QueryContext *query;             // lines and polyobjects already checked
 } los_t;
 
 //
@@ -135,10 +138,8 @@ static bool P_CrossSubsecPolyObj(polyobj_t *po, los_t *los)
       const vertex_t *v1,*v2;
       
       // already checked other side?
-      if(line->validcount == validcount)
+      if(!los->query->markLine(*line))
          continue;
-
-      line->validcount = validcount;
       
       // OPTIMIZE: killough 4/20/98: Added quick bounding-box rejection test
       if(line->bbox[BOXLEFT  ] > los->bbox[BOXRIGHT ] ||
@@ -198,9 +199,8 @@ static bool P_CrossSubsector(int num, los_t *los)
       {
          polyobj_t *po = (*link)->polyobj;
 
-         if(po->validcount != validcount)
+         if(los->query->markPolyobj(*po))
          {
-            po->validcount = validcount;
             if(!P_CrossSubsecPolyObj(po, los))
                return false;
          }
@@ -218,10 +218,8 @@ static bool P_CrossSubsector(int num, los_t *los)
       fixed_t frac;
       
       // already checked other side?
-      if(line->validcount == validcount)
+      if(!los->query->markLine(*line))
          continue;
-
-      line->validcount = validcount;
       
       // OPTIMIZE: killough 4/20/98: Added quick bounding-box rejection test
       // haleyjd: another demo compatibility fix by cph -- who knows
@@ -346,6 +344,10 @@ bool P_CheckSight(Mobj *t1, Mobj *t2)
       camparams.prev = nullptr;
       camparams.setLookerMobj(t1);
       camparams.setTargetMobj(t2);
+
+      bool result;
+      if(P_SightBatchLookup(t1, t2, camparams, result))
+         return result;
       return CAM_CheckSight(camparams);
    }
 
@@ -389,7 +391,8 @@ bool P_CheckSight(Mobj *t1, Mobj *t2)
    // An unobstructed LOS is possible.
    // Now look from eyes of t1 to any part of t2.
    
-   validcount++;
+   los.query = &QueryContext::Global();
+   los.query->newQuery();
 
    los.topslope = 
       (los.bottomslope = t2->z - (los.sightzstart =
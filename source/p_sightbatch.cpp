@@ -0,0 +1,368 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: per-tic batches of monster sight checks.
+//
+// Before the thinkers run, the monsters that are about to call A_Look this
+// tic are found, and their sight checks against the players (and against the
+// soundtarget of their sector, for ambushers) are done ahead of time, in
+// parallel. The map doesn't change while that happens. P_CheckSight then
+// takes a result from the batch when its looker, target and their positions
+// are the same, and nothing that can block sight has changed since; anything
+// else is checked as usual. Since the results are what the check would have
+// returned at that point anyway, thinkers still see them in their own order
+// and demo sync is unaffected.
+//
+// Explosions do the same for everything in their blast before dealing any
+// damage, through P_SightBatchPrefetch.
+//
+// When a batched result turns out to be stale (typically because a player
+// has moved, or a door has), the checks still pending are done again with
+// the current state, a few times per tic at most.
+//
+
+#include "z_zone.h"
+
+#include "a_common.h"
+#include "c_runcmd.h"
+#include "cam_sight.h"
+#include "d_player.h"
+#include "doomstat.h"
+#include "info.h"
+#include "m_collection.h"
+#include "m_compare.h"
+#include "m_parallel.h"
+#include "p_mobj.h"
+#include "p_sightbatch.h"
+#include "r_defs.h"
+#include "r_state.h"
+
+#define MINBATCH    16 // fewer checks than this aren't worth the threads
+#define MAXREBATCH  4  // times the pending checks may be redone per tic
+
+bool p_sightbatch;
+
+unsigned int sightgeneration;
+
+struct sightquery_t
+{
+   const Mobj      *looker;
+   const Mobj      *target;
+   camsightparams_t params;
+   unsigned int     generation; // sightgeneration the result holds for
+   bool             result;
+   bool             asked;      // already taken by P_CheckSight
+   bool             ready;      // result has been checked
+   bool             dead;       // the looker or target was removed
+};
+
+static PODCollection<sightquery_t> queries;
+static PODCollection<int>          pending;   // indices of queries to evaluate
+static PODCollection<int>          hashtable; // query index + 1, or 0
+static bool batchenabled;
+static int  rebatches;
+
+//
+// Hashes a looker/target pair into the table
+//
+static unsigned int P_pairHash(const Mobj *looker, const Mobj *target)
+{
+   uintptr_t key = reinterpret_cast<uintptr_t>(looker) * 31 +
+                   reinterpret_cast<uintptr_t>(target);
+   key ^= key >> 17;
+   key *= 0xed5ad4bbu;
+   key ^= key >> 11;
+   return static_cast<unsigned int>(key) & (hashtable.getLength() - 1);
+}
+
+//
+// Returns the index of a pair's query, or -1
+//
+static int P_findQuery(const Mobj *looker, const Mobj *target)
+{
+   if(hashtable.isEmpty())
+      return -1;
+
+   unsigned int mask = static_cast<unsigned int>(hashtable.getLength() - 1);
+   for(unsigned int h = P_pairHash(looker, target); hashtable[h]; h = (h + 1) & mask)
+   {
+      const sightquery_t &q = queries[hashtable[h] - 1];
+      if(q.looker == looker && q.target == target)
+         return hashtable[h] - 1;
+   }
+   return -1;
+}
+
+//
+// Puts a query into the pair hash table
+//
+static void P_hashQuery(int index)
+{
+   unsigned int mask = static_cast<unsigned int>(hashtable.getLength() - 1);
+   unsigned int h = P_pairHash(queries[index].looker, queries[index].target);
+
+   while(hashtable[h])
+      h = (h + 1) & mask;
+   hashtable[h] = index + 1;
+}
+
+//
+// Queues a pair, unless it already is. Returns the index of the new query,
+// or -1.
+//
+static int P_addQuery(const Mobj *looker, const Mobj *target)
+{
+   if(looker == target || P_findQuery(looker, target) >= 0)
+      return -1;
+
+   // keep the table at most half full
+   if(queries.getLength() * 2 + 2 > hashtable.getLength())
+   {
+      size_t size = emax(hashtable.getLength() * 2, size_t(64));
+
+      hashtable.makeEmpty();
+      for(size_t i = 0; i < size; i++)
+         hashtable.add(0);
+      for(size_t i = 0; i < queries.getLength(); i++)
+         P_hashQuery(static_cast<int>(i));
+   }
+
+   int index = static_cast<int>(queries.getLength());
+   sightquery_t &q = queries.addNew();
+   q.looker = looker;
+   q.target = target;
+   q.asked  = false;
+   q.dead   = false;
+   q.ready  = false;
+   P_hashQuery(index);
+
+   return index;
+}
+
+//
+// Runs one pending sight check; called on worker threads
+//
+static void P_evalQuery(int index, void *data)
+{
+   sightquery_t &q = queries[pending[index]];
+   q.result = CAM_CheckSight(q.params);
+}
+
+//
+// Checks the sight of the pending queries with the current positions.
+// Returns false, leaving them alone, if there are too few to bother.
+//
+static bool P_evalPending()
+{
+   if(pending.getLength() < MINBATCH)
+      return false;
+
+   for(int index : pending)
+   {
+      sightquery_t &q = queries[index];
+
+      q.params.setLookerMobj(q.looker);
+      q.params.setTargetMobj(q.target);
+      q.params.prev = nullptr;
+      q.generation  = sightgeneration;
+      q.ready       = true;
+   }
+
+   M_ParallelFor(static_cast<int>(pending.getLength()), P_evalQuery, nullptr);
+   return true;
+}
+
+//
+// Checks again the sight of all the queries not yet asked for
+//
+static bool P_rerunBatch()
+{
+   pending.makeEmpty();
+   for(size_t i = 0; i < queries.getLength(); i++)
+   {
+      if(!queries[i].asked && !queries[i].dead)
+         pending.add(static_cast<int>(i));
+   }
+
+   return P_evalPending();
+}
+
+//
+// P_SightBatchStart
+//
+// Called before the thinkers run. Finds the monsters that will call A_Look
+// this tic and checks their sight ahead of time.
+//
+void P_SightBatchStart()
+{
+   batchenabled = false;
+   rebatches    = 0;
+   queries.makeEmpty();
+   hashtable.makeEmpty();
+
+   // only the current sight code can run off the main thread
+   if(!p_sightbatch || full_demo_version < make_full_version(340, 24) ||
+      gamestate != GS_LEVEL || !M_ParallelWorkers())
+      return;
+
+   batchenabled = true;
+   pending.makeEmpty();
+
+   for(Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
+   {
+      Mobj *mo = thinker_cast<Mobj *>(th);
+      int   index;
+
+      // looking happens when the state changes
+      if(!mo || mo->tics != 1 || mo->health <= 0 || mo->flags & MF_FRIEND ||
+         states[mo->state->nextstate]->action != A_Look)
+         continue;
+
+      for(int i = 0; i < MAXPLAYERS; i++)
+      {
+         if(playeringame[i] && players[i].mo && players[i].health > 0 &&
+            (index = P_addQuery(mo, players[i].mo)) >= 0)
+            pending.add(index);
+      }
+
+      Mobj *sndtarget = mo->subsector->sector->soundtarget;
+      if(sndtarget && mo->flags & MF_AMBUSH && 
+         (index = P_addQuery(mo, sndtarget)) >= 0)
+         pending.add(index);
+   }
+
+   P_evalPending();
+}
+
+//
+// P_SightBatchPrefetch
+//
+// Checks ahead of time the sight of a set of lookers to one target, for
+// the P_CheckSight calls that are about to follow; the area damage code uses
+// it for everything in the blast. Does nothing if there are too few.
+//
+void P_SightBatchPrefetch(Mobj *const *lookers, size_t count, const Mobj *target)
+{
+   if(!batchenabled || count < MINBATCH)
+      return;
+
+   pending.makeEmpty();
+   for(size_t i = 0; i < count; i++)
+   {
+      int index = P_addQuery(lookers[i], target);
+      if(index >= 0)
+         pending.add(index);
+   }
+
+   P_evalPending();
+}
+
+//
+// P_SightBatchActive
+//
+// Returns true while sight checks can be batched.
+//
+bool P_SightBatchActive()
+{
+   return batchenabled;
+}
+
+//
+// P_SightBatchEnd
+//
+// Called once the thinkers have run; the batch is of no use after that.
+//
+void P_SightBatchEnd()
+{
+   batchenabled = false;
+}
+
+//
+// P_SightBatchForget
+//
+// Called when a Mobj is removed, so that it is never looked at again.
+//
+void P_SightBatchForget(const Mobj *mo)
+{
+   if(!batchenabled)
+      return;
+
+   for(sightquery_t &q : queries)
+   {
+      if(q.looker == mo || q.target == mo)
+         q.dead = true;
+   }
+}
+
+//
+// Returns true if two sets of sight parameters are the same
+//
+static bool P_sameParams(const camsightparams_t &a, const camsightparams_t &b)
+{
+   return a.cx == b.cx && a.cy == b.cy && a.cz == b.cz && a.cheight == b.cheight &&
+          a.tx == b.tx && a.ty == b.ty && a.tz == b.tz && a.theight == b.theight &&
+          a.cgroupid == b.cgroupid && a.tgroupid == b.tgroupid;
+}
+
+//
+// P_SightBatchLookup
+//
+// Called by P_CheckSight. If the batch holds an up to date result for this
+// check, puts it in result and returns true.
+//
+bool P_SightBatchLookup(const Mobj *looker, const Mobj *target,
+                        const camsightparams_t &params, bool &result)
+{
+   if(!batchenabled)
+      return false;
+
+   int index = P_findQuery(looker, target);
+   if(index < 0)
+      return false;
+
+   sightquery_t &q = queries[index];
+   if(q.dead)
+      return false;
+
+   if(!q.ready || q.generation != sightgeneration || !P_sameParams(q.params, params))
+   {
+      // the result is stale; so are probably the others still pending
+      if(q.asked || rebatches >= MAXREBATCH)
+         return false;
+      ++rebatches;
+      if(!P_rerunBatch() || !P_sameParams(q.params, params))
+         return false;
+   }
+
+   q.asked = true;
+   result  = q.result;
+   return true;
+}
+
+//=============================================================================
+//
+// Console Variables
+//
+
+VARIABLE_TOGGLE(p_sightbatch, NULL, onoff);
+CONSOLE_VARIABLE(p_sightbatch, p_sightbatch, 0) {}
+
+// EOF
+
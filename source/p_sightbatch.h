@@ -0,0 +1,56 @@
+//
+// The Eternity Engine
+// Copyright(C) 2018 James Haley, Ioan Chera, et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+// Purpose: per-tic batches of monster sight checks.
+//
+
+#ifndef P_SIGHTBATCH_H__
+#define P_SIGHTBATCH_H__
+
+class  Mobj;
+struct camsightparams_t;
+
+extern bool p_sightbatch;
+
+extern unsigned int sightgeneration;
+
+//
+// P_SightBatchInvalidate
+//
+// Must be called whenever something that may block sight changes: sector
+// heights, polyobjects, line flags, portals.
+//
+inline static void P_SightBatchInvalidate()
+{
+   ++sightgeneration;
+}
+
+void P_SightBatchStart();
+void P_SightBatchEnd();
+bool P_SightBatchActive();
+void P_SightBatchForget(const Mobj *mo);
+void P_SightBatchPrefetch(Mobj *const *lookers, size_t count, const Mobj *target);
+bool P_SightBatchLookup(const Mobj *looker, const Mobj *target,
+                        const camsightparams_t &params, bool &result);
+
+#endif
+
+// EOF
+
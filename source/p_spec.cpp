@@ -58,6 +58,7 @@
 #include "p_inter.h"
 #include "p_map.h"
 #include "p_maputl.h"
+#include "p_noise.h"
 #include "p_portal.h"
 #include "p_portalcross.h"
 #include "p_pushers.h"
@@ -883,6 +884,200 @@ sector_t *P_FindModelCeilingSector(fixed_t ceildestheight, int secnum)
    return NULL;
 }
 
+//=============================================================================
+//
+// Tag Index
+//
+// killough 1/30/98 hashed the tags into chains threaded through the sectors
+// and lines themselves, so that every step of a search was a hop through one
+// of those big structures. Now each tag has a dense array of the numbers of
+// the sectors or lines carrying it, lowest first, found through an open
+// addressing table that doubles when it gets three quarters full. The place
+// of each sector or line in its array is kept on the side, so the
+// P_Find*FromTag functions can step along the array from the last result.
+//
+
+struct tagspan_t
+{
+   bool used;    // tag 0 is a real tag, so this marks the free slots
+   int  tag;
+   int *indices; // sectors or lines with the tag
+   int  count;
+   int  max;
+};
+
+struct tagindex_t
+{
+   tagspan_t *slots;
+   int numslots;
+   int numused;
+   int *pos;     // place of each sector or line within its span
+};
+
+#define MINTAGSLOTS 64
+
+static tagindex_t sectortags;
+static tagindex_t linetags;
+
+//
+// Returns the slot of tag, or the free slot it would go into.
+//
+static tagspan_t *P_tagSlot(tagspan_t *slots, int numslots, int tag)
+{
+   unsigned int mask = unsigned(numslots - 1);
+   unsigned int i    = (unsigned(tag) * 2654435761u) & mask;
+
+   while(slots[i].used && slots[i].tag != tag)
+      i = (i + 1) & mask;
+
+   return &slots[i];
+}
+
+//
+// Empties a tag index, making room for the positions of num items.
+//
+static void P_clearTagIndex(tagindex_t &index, int num)
+{
+   for(int i = 0; i < index.numslots; i++)
+      efree(index.slots[i].indices);
+   efree(index.slots);
+
+   index.slots    = NULL;
+   index.numslots = 0;
+   index.numused  = 0;
+   index.pos      = (int *)(Z_Malloc((num + 1) * sizeof(int), PU_LEVEL, NULL));
+}
+
+//
+// Returns the span of a tag, or NULL if nothing was ever given the tag.
+//
+static tagspan_t *P_findTagSpan(const tagindex_t &index, int tag)
+{
+   tagspan_t *span;
+
+   if(!index.numslots)
+      return NULL;
+
+   span = P_tagSlot(index.slots, index.numslots, tag);
+   return span->used ? span : NULL;
+}
+
+//
+// Puts item into the span of tag, either after all others or before them.
+//
+static void P_addToTagIndex(tagindex_t &index, int tag, int item, bool first)
+{
+   tagspan_t *span;
+
+   if((index.numused + 1) * 4 > index.numslots * 3)
+   {
+      int newslots = index.numslots ? index.numslots * 2 : MINTAGSLOTS;
+      tagspan_t *newtable = ecalloc(tagspan_t *, newslots, sizeof(tagspan_t));
+
+      for(int i = 0; i < index.numslots; i++)
+      {
+         if(index.slots[i].used)
+            *P_tagSlot(newtable, newslots, index.slots[i].tag) = index.slots[i];
+      }
+
+      efree(index.slots);
+      index.slots    = newtable;
+      index.numslots = newslots;
+   }
+
+   span = P_tagSlot(index.slots, index.numslots, tag);
+   if(!span->used)
+   {
+      span->used = true;
+      span->tag  = tag;
+      ++index.numused;
+   }
+
+   if(span->count == span->max)
+   {
+      span->max = span->max ? span->max * 2 : 4;
+      span->indices = erealloc(int *, span->indices, span->max * sizeof(int));
+   }
+
+   if(first)
+   {
+      for(int i = span->count; i > 0; i--)
+      {
+         span->indices[i] = span->indices[i - 1];
+         index.pos[span->indices[i]] = i;
+      }
+      span->indices[0] = item;
+      index.pos[item]  = 0;
+   }
+   else
+   {
+      span->indices[span->count] = item;
+      index.pos[item] = span->count;
+   }
+   ++span->count;
+}
+
+//
+// Takes item out of the span of tag, keeping the others in order.
+//
+static void P_removeFromTagIndex(tagindex_t &index, int tag, int item)
+{
+   tagspan_t *span = P_findTagSpan(index, tag);
+   int i;
+
+   if(!span || (i = index.pos[item]) >= span->count || span->indices[i] != item)
+      return;
+
+   --span->count;
+   for(; i < span->count; i++)
+   {
+      span->indices[i] = span->indices[i + 1];
+      index.pos[span->indices[i]] = i;
+   }
+}
+
+//
+// Returns the item following start in the span of tag, or the first one if
+// start is negative; -1 once there are no more.
+//
+static int P_nextInTagIndex(const tagindex_t &index, int tag, int start)
+{
+   const tagspan_t *span = P_findTagSpan(index, tag);
+   int i = start >= 0 ? index.pos[start] + 1 : 0;
+
+   return span && i < span->count ? span->indices[i] : -1;
+}
+
+//
+// P_SectorTagSpan
+//
+// Points indices at the numbers of all sectors with the given tag, lowest
+// first, and returns how many there are. The EV_ functions walk it to act on
+// every tagged sector. The span is only good until a sector tag changes.
+//
+int P_SectorTagSpan(int tag, const int *&indices)
+{
+   const tagspan_t *span = P_findTagSpan(sectortags, tag);
+
+   indices = span ? span->indices : NULL;
+   return span ? span->count : 0;
+}
+
+//
+// P_LineTagSpan
+//
+// Points indices at the numbers of all lines with the given tag or line id,
+// and returns how many there are. The span is only good until P_SetLineID
+// is next called.
+//
+int P_LineTagSpan(int tag, const int *&indices)
+{
+   const tagspan_t *span = P_findTagSpan(linetags, tag);
+
+   indices = span ? span->indices : NULL;
+   return span ? span->count : 0;
+}
+
 //
 // RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
 //
@@ -894,28 +1089,17 @@ sector_t *P_FindModelCeilingSector(fixed_t ceildestheight, int secnum)
 
 int P_FindSectorFromLineArg0(const line_t *line, int start)
 {
-   start = 
-      (start >= 0 ? sectors[start].nexttag :
-       sectors[(unsigned int)line->args[0] % (unsigned int)numsectors].firsttag);
-  
-   while(start >= 0 && sectors[start].tag != line->args[0])
-      start = sectors[start].nexttag;
-   
-   return start;
+   return P_FindSectorFromTag(line->args[0], start);
 }
 
 // killough 4/16/98: Same thing, only for linedefs
 // ioanch 20160424: convenience to only use tag
 int P_FindLineFromTag(int tag, int start)
 {
-   start =
-   (start >= 0 ? lines[start].nexttag :
-    lines[(unsigned int)tag % (unsigned int)numlines].firsttag);
+   if(start >= 0 && lines[start].tag != tag)
+      return -1;
 
-   while(start >= 0 && lines[start].tag != tag)
-      start = lines[start].nexttag;
-   
-   return start;
+   return P_nextInTagIndex(linetags, tag, start);
 }
 int P_FindLineFromLineArg0(const line_t *line, int start)
 {
@@ -926,51 +1110,39 @@ int P_FindLineFromLineArg0(const line_t *line, int start)
 
 int P_FindSectorFromTag(const int tag, int start)
 {
-   start = 
-      (start >= 0 ? sectors[start].nexttag :
-       sectors[(unsigned int)tag % (unsigned int)numsectors].firsttag);
-  
-   while(start >= 0 && sectors[start].tag != tag)
-      start = sectors[start].nexttag;
-  
-   return start;
+   if(start >= 0 && sectors[start].tag != tag)
+      return -1;
+
+   return P_nextInTagIndex(sectortags, tag, start);
 }
 
 //
 // P_InitTagLists
 //
-// Hash the sector tags across the sectors and linedefs.
+// Index the sectors and linedefs by tag.
 //
 static void P_InitTagLists()
 {
    int i;
+
+   P_clearTagIndex(sectortags, numsectors);
    
-   for(i = numsectors; --i >= 0; )   // Initially make all slots empty.
-      sectors[i].firsttag = -1;
-   
-   for(i = numsectors; --i >= 0; )   // Proceed from last to first sector
-   {                                 // so that lower sectors appear first
-      int j = (unsigned int)sectors[i].tag % (unsigned int)numsectors; // Hash func
-      sectors[i].nexttag = sectors[j].firsttag;   // Prepend sector to chain
-      sectors[j].firsttag = i;
-   }
+   for(i = 0; i < numsectors; i++) // lower sectors appear first
+      P_addToTagIndex(sectortags, sectors[i].tag, i, false);
    
    // killough 4/17/98: same thing, only for linedefs
+
+   P_clearTagIndex(linetags, numlines);
    
-   for(i = numlines; --i >= 0; )   // Initially make all slots empty.
-      lines[i].firsttag = -1;
-   
-   for(i = numlines; --i >= 0; )   // Proceed from last to first linedef
-   {                               // so that lower linedefs appear first
+   for(i = 0; i < numlines; i++)   // lower linedefs appear first
+   {
       // haleyjd 05/16/09: unified id into tag;
       // added mapformat parameter to test here:
       if(LevelInfo.mapFormat == LEVEL_FORMAT_DOOM || 
          LevelInfo.mapFormat == LEVEL_FORMAT_PSX  ||
          lines[i].tag != -1)
       {
-         int j = (unsigned int)lines[i].tag % (unsigned int)numlines; // Hash func
-         lines[i].nexttag = lines[j].firsttag;   // Prepend linedef to chain
-         lines[j].firsttag = i;
+         P_addToTagIndex(linetags, lines[i].tag, i, false);
       }
    }
 }
@@ -1891,21 +2063,11 @@ static void P_SpawnFriction()
 //
 line_t *P_FindLine(int tag, int *searchPosition)
 {
-   line_t *line = NULL;
-   
-   int start = 
-      (*searchPosition >= 0 ? lines[*searchPosition].nexttag :
-       lines[(unsigned int)tag % (unsigned int)numlines].firsttag);
-  
-   while(start >= 0 && lines[start].tag != tag)
-      start = lines[start].nexttag;
-
-   if(start >= 0)
-      line = &lines[start];
+   int start = P_FindLineFromTag(tag, *searchPosition);
 
    *searchPosition = start;
    
-   return line;
+   return start >= 0 ? &lines[start] : NULL;
 }
 
 //
@@ -1915,42 +2077,19 @@ line_t *P_FindLine(int tag, int *searchPosition)
 //
 void P_SetLineID(line_t *line, int id)
 {
-   // remove from any chain it's already in
-   if(line->tag >= 0)
-   {
-      int chain = (unsigned int)line->tag % (unsigned int)numlines;
-      int i;
-      line_t *prevline = NULL;
-
-      // walk the chain
-      for(i = lines[chain].firsttag; i != -1; i = lines[i].nexttag)
-      {
-         if(line == &lines[i])
-         {
-            // remove this line
-            if(prevline)
-               prevline->nexttag = line->nexttag; // prev->next = this->next
-            else
-               lines[chain].firsttag = line->nexttag; // list = this->next
-         }
+   int linenum = eindex(line - lines);
 
-         // not a match, keep looking
-         // record this line in case it's the one before the one we're looking for
-         prevline = &lines[i]; 
-      }
-   }
+   // remove from any span it's already in
+   if(line->tag >= 0)
+      P_removeFromTagIndex(linetags, line->tag, linenum);
 
    // set the new id
    line->tag = id;
-   line->nexttag = -1;
 
+   // the line goes first among those with its id, as it did when the chains
+   // were prepended to
    if(line->tag >= 0)
-   {
-      int chain = (unsigned int)line->tag % (unsigned int)numlines; // Hash func
-   
-      line->nexttag = lines[chain].firsttag;   // Prepend linedef to chain
-      lines[chain].firsttag = eindex(line - lines);
-   }
+      P_addToTagIndex(linetags, line->tag, linenum, true);
 }
 
 //=============================================================================
@@ -2806,6 +2945,7 @@ void P_SetPortal(sector_t *sec, line_t *line, portal_t *portal, portal_effect ef
    case portal_lineonly:
       line->portal = portal;
       P_CheckLPortalState(line);
+      P_NoiseGraphInvalidate();
       break;
    default:
       I_Error("P_SetPortal: unknown portal effect\n");
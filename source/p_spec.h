@@ -1383,6 +1383,9 @@ int P_FindLineFromLineArg0(const line_t *line, int start);
 
 int P_FindSectorFromTag(const int tag, int start);        // sf
 
+int P_SectorTagSpan(int tag, const int *&indices);
+int P_LineTagSpan(int tag, const int *&indices);
+
 int P_FindMinSurroundingLight(const sector_t *sector, int max);
 
 sector_t *getNextSector(const line_t *line, const sector_t *sec);
@@ -0,0 +1,203 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      World state hashing, for desync detection.
+//
+//      The hash is kept in separate parts per class of state, and none of
+//      them needs a pass of its own over the level:
+//      * Things are hashed right after they think, in the thinker loop.
+//      * Sectors are summed once at level setup, then kept up to date by
+//        P_SetFloorHeight and P_SetCeilingHeight as they move.
+//      * The RNG state is small, and is hashed when the hash is read.
+//
+//      Parts are sums of per-object hashes, so that an object's contribution
+//      can be taken out again when it changes.
+//
+//-----------------------------------------------------------------------------
+
+#include "z_zone.h"
+
+#include "m_random.h"
+#include "p_statehash.h"
+#include "p_tick.h"
+#include "r_defs.h"
+#include "r_state.h"
+
+statehash_t statehash;
+
+const char *const statehashnames[NUMSTATEHASHES] =
+{
+   "things", "sectors", "rng", "thinkers"
+};
+
+//
+// Mixes the bits of a value (the MurmurHash3 finalizer)
+//
+static uint32_t P_mixHash(uint32_t h)
+{
+   h ^= h >> 16;
+   h *= 0x85ebca6bu;
+   h ^= h >> 13;
+   h *= 0xc2b2ae35u;
+   h ^= h >> 16;
+   return h;
+}
+
+//
+// Hash of one sector's heights, tied to its number
+//
+static uint32_t P_sectorHash(const sector_t *sec)
+{
+   uint32_t h = P_mixHash(uint32_t(sec - sectors) * 0x9e3779b9u);
+
+   h = P_mixHash(h ^ uint32_t(sec->floorheight));
+   return P_mixHash(h ^ uint32_t(sec->ceilingheight));
+}
+
+//
+// P_StateHashRebuild
+//
+// Computes the sector part from scratch. Needed whenever sector heights were
+// set without going through P_SetFloorHeight or P_SetCeilingHeight, that is,
+// at level setup and after loading a game.
+//
+void P_StateHashRebuild()
+{
+   uint32_t sum = 0;
+
+   for(int i = 0; i < numsectors; i++)
+      sum += P_sectorHash(&sectors[i]);
+
+   statehash.parts[SH_SECTORS]  = sum;
+   statehash.parts[SH_THINGS]   = 0;
+   statehash.parts[SH_THINKERS] = 0;
+}
+
+//
+// P_StateHashStartTic
+//
+// Starts over the parts collected by the thinker loop.
+//
+void P_StateHashStartTic()
+{
+   statehash.parts[SH_THINGS]   = 0;
+   statehash.parts[SH_THINKERS] = 0;
+}
+
+//
+// P_StateHashThinker
+//
+// Adds a thinker which has just thought.
+//
+void P_StateHashThinker(const Thinker *th)
+{
+   ++statehash.parts[SH_THINKERS];
+   if(!th->isRemoved())
+      statehash.parts[SH_THINGS] += P_mixHash(th->stateHash());
+}
+
+//
+// P_StateHashRemoveSector
+//
+// Takes a sector out of the hash before its heights change.
+//
+void P_StateHashRemoveSector(const sector_t *sec)
+{
+   statehash.parts[SH_SECTORS] -= P_sectorHash(sec);
+}
+
+//
+// P_StateHashAddSector
+//
+// Puts a sector back into the hash after its heights changed.
+//
+void P_StateHashAddSector(const sector_t *sec)
+{
+   statehash.parts[SH_SECTORS] += P_sectorHash(sec);
+}
+
+//
+// P_StateHashGet
+//
+// Returns all parts of the hash for the current state.
+//
+void P_StateHashGet(statehash_t &hash)
+{
+   uint32_t h = P_mixHash(uint32_t(rng.rndindex) ^ (uint32_t(rng.prndindex) << 8));
+
+   for(unsigned int seed : rng.seed)
+      h = P_mixHash(h ^ seed);
+
+   hash = statehash;
+   hash.parts[SH_RNG] = h;
+}
+
+//
+// P_StateHashFold
+//
+// Folds each part down to the given number of bits and packs them together,
+// first part lowest. Comparing two folded values with P_StateHashDiff tells
+// which classes of state differ.
+//
+uint32_t P_StateHashFold(const statehash_t &hash, int bits)
+{
+   uint32_t result = 0;
+   uint32_t mask = (1u << bits) - 1;
+
+   for(int i = 0; i < NUMSTATEHASHES; i++)
+   {
+      uint32_t h = hash.parts[i];
+      uint32_t f = 0;
+
+      for(int shift = 0; shift < 32; shift += bits)
+         f ^= (h >> shift) & mask;
+      result |= f << (i * bits);
+   }
+
+   return result;
+}
+
+//
+// P_StateHashDiff
+//
+// Writes the names of the classes whose parts differ between two folded
+// hashes into buf.
+//
+void P_StateHashDiff(uint32_t a, uint32_t b, int bits, char *buf, size_t len)
+{
+   uint32_t mask = (1u << bits) - 1;
+   size_t   used = 0;
+
+   *buf = '\0';
+   for(int i = 0; i < NUMSTATEHASHES && used < len; i++)
+   {
+      if(((a >> (i * bits)) & mask) != ((b >> (i * bits)) & mask))
+      {
+         int n = snprintf(buf + used, len - used, "%s%s", used ? " " : "",
+                          statehashnames[i]);
+         if(n > 0)
+            used += size_t(n);
+      }
+   }
+}
+
+// EOF
+
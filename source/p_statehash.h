@@ -0,0 +1,64 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2013 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      World state hashing, for desync detection.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef P_STATEHASH_H__
+#define P_STATEHASH_H__
+
+class  Thinker;
+struct sector_t;
+
+// Classes of state hashed separately, so that a desync can be traced to one.
+enum
+{
+   SH_THINGS,   // positions and health of things, as they think
+   SH_SECTORS,  // floor and ceiling heights, kept up as they move
+   SH_RNG,      // random number generator state
+   SH_THINKERS, // number of thinkers run
+   NUMSTATEHASHES
+};
+
+struct statehash_t
+{
+   uint32_t parts[NUMSTATEHASHES];
+};
+
+extern statehash_t statehash;
+
+void P_StateHashRebuild();
+void P_StateHashStartTic();
+void P_StateHashThinker(const Thinker *th);
+void P_StateHashRemoveSector(const sector_t *sec);
+void P_StateHashAddSector(const sector_t *sec);
+
+void     P_StateHashGet(statehash_t &hash);
+uint32_t P_StateHashFold(const statehash_t &hash, int bits);
+void     P_StateHashDiff(uint32_t a, uint32_t b, int bits, char *buf, size_t len);
+
+extern const char *const statehashnames[NUMSTATEHASHES];
+
+#endif
+
+// EOF
+
@@ -444,16 +444,18 @@ int EV_ParamSilentTeleport(int tid, const line_t *line, int tag, int side,
 int EV_SilentLineTeleport(const line_t *line, int lineid, int side, Mobj *thing,
                           bool reverse)
 {
-   int i;
+   const int *tagged;
+   int numtagged;
    line_t *l;
 
    // ioanch 20160424: protect against null line or thing pointer
    if(side || !thing || thing->flags & MF_MISSILE || !line)
       return 0;
 
-   for (i = -1; (i = P_FindLineFromTag(lineid, i)) >= 0;)
+   numtagged = P_LineTagSpan(lineid, tagged);
+   for(int i = 0; i < numtagged; i++)
    {
-      if ((l=lines+i) != line && l->backsector)
+      if ((l=lines+tagged[i]) != line && l->backsector)
       {
          // Get the thing's position along the source linedef
          fixed_t pos = D_abs(line->dx) > D_abs(line->dy) ?
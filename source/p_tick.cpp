@@ -37,7 +37,9 @@
 #include "p_saveg.h"
 #include "p_scroll.h"
 #include "p_sector.h"
+#include "p_sightbatch.h"
 #include "p_spec.h"
+#include "p_statehash.h"
 #include "p_tick.h"
 #include "p_user.h"
 #include "p_partcl.h"
@@ -234,7 +236,12 @@ void Thinker::RunThinkers(void)
       if(currentthinker->removed)
          currentthinker->removeDelayed();
       else
-         currentthinker->Think();
+      {
+         Thinker *th = currentthinker;
+
+         th->Think();
+         P_StateHashThinker(th);
+      }
    }
    S_MusInfoUpdate();
 }
@@ -277,6 +284,9 @@ void P_Ticker()
    if(!leveltime)
       P_SpawnUnknownThings();
 
+   // the thinkers add themselves to the world state hash as they run
+   P_StateHashStartTic();
+
    // interpolation: save current sector heights
    P_SaveSectorPositions();
    // save dynaseg positions (or reset them to avoid shaking)
@@ -299,7 +309,9 @@ void P_Ticker()
       }
    }
 
+   P_SightBatchStart();
    Thinker::RunThinkers();
+   P_SightBatchEnd();
    ACS_Exec();
    P_UpdateSpecials();
    P_RespawnSpecials();
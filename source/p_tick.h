@@ -85,6 +85,7 @@ public:
    // Reference counting
    void addReference() { ++references; }
    void delReference() { --references; }
+   unsigned int getReferences() const { return references; }
 
    // Enumeration 
    // For thinkers needing savegame enumeration.
@@ -101,6 +102,9 @@ public:
    // De-swizzling should restore pointers to other thinkers.
    virtual void deSwizzle() {}
    virtual bool shouldSerialize() const { return !removed;  }
+
+   // Contribution to the world state hash, taken after each think
+   virtual uint32_t stateHash() const { return 0; }
    
    // Data Members
 
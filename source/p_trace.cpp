@@ -25,18 +25,23 @@
 //-----------------------------------------------------------------------------
 
 #include "z_zone.h"
+#include "hal/i_timer.h"
 
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "cam_sight.h"
 #include "d_gi.h"
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "e_puff.h"
+#include "m_compare.h"
 #include "metaapi.h"
 #include "p_map.h"
 #include "p_maputl.h"
 #include "p_mobj.h"
 #include "p_inter.h"
 #include "p_portal.h"   // ioanch 20160113
+#include "p_querycontext.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "p_spec.h"
@@ -46,6 +51,7 @@
 #include "r_state.h"
 #include "r_pcheck.h"
 #include "s_sound.h"
+#include "v_misc.h"
 
 // Globals
 linetracer_t trace;
@@ -779,22 +785,6 @@ void P_UseLines(player_t *player)
 // Intercept Routines
 //
 
-// 1/11/98 killough: Intercept limit removed
-static intercept_t *intercepts, *intercept_p;
-
-// Check for limit and double size if necessary -- killough
-static void check_intercept()
-{
-   static size_t num_intercepts;
-   size_t offset = intercept_p - intercepts;
-   if(offset >= num_intercepts)
-   {
-      num_intercepts = num_intercepts ? num_intercepts*2 : 128;
-      intercepts = erealloc(intercept_t *, intercepts, sizeof(*intercepts)*num_intercepts);
-      intercept_p = intercepts + offset;
-   }
-}
-
 //
 // PIT_AddLineIntercepts
 //
@@ -809,6 +799,7 @@ static void check_intercept()
 //
 static bool PIT_AddLineIntercepts(line_t *ld, polyobj_s *po, void *context)
 {
+   InterceptArena &intercepts = *static_cast<InterceptArena *>(context);
    int       s1;
    int       s2;
    fixed_t   frac;
@@ -837,12 +828,10 @@ static bool PIT_AddLineIntercepts(line_t *ld, polyobj_s *po, void *context)
    if(frac < 0)
       return true;        // behind source
 
-   check_intercept();    // killough
-   
-   intercept_p->frac = frac;
-   intercept_p->isaline = true;
-   intercept_p->d.line = ld;
-   intercept_p++;
+   intercept_t &in = intercepts.addNew();
+   in.frac    = frac;
+   in.isaline = true;
+   in.d.line  = ld;
    
    return true;  // continue
 }
@@ -854,6 +843,7 @@ static bool PIT_AddLineIntercepts(line_t *ld, polyobj_s *po, void *context)
 //
 static bool PIT_AddThingIntercepts(Mobj *thing, void *context)
 {
+   InterceptArena &intercepts = *static_cast<InterceptArena *>(context);
    fixed_t   x1, y1;
    fixed_t   x2, y2;
    int       s1, s2;
@@ -892,12 +882,10 @@ static bool PIT_AddThingIntercepts(Mobj *thing, void *context)
    if(frac < 0)
       return true;                // behind source
    
-   check_intercept();            // killough
-   
-   intercept_p->frac    = frac;
-   intercept_p->isaline = false;
-   intercept_p->d.thing = thing;
-   intercept_p++;
+   intercept_t &in = intercepts.addNew();
+   in.frac    = frac;
+   in.isaline = false;
+   in.d.thing = thing;
    
    return true;          // keep going
 }
@@ -910,42 +898,38 @@ static bool PIT_AddThingIntercepts(Mobj *thing, void *context)
 //
 // killough 5/3/98: reformatted, cleaned up
 //
-static bool P_TraverseIntercepts(traverser_t func, fixed_t maxfrac, void *context)
+// The intercepts are sorted once, instead of searching them all for the
+// nearest one each time; the order is the same.
+//
+static bool P_TraverseIntercepts(InterceptArena &intercepts, traverser_t func,
+                                 fixed_t maxfrac, void *context)
 {
-   intercept_t *in = nullptr;
-   int count = static_cast<int>(intercept_p - intercepts);
-   while(count--)
+   if(!intercepts.getLength())
+      return true; // the trace crossed nothing
+
+   intercepts.sort();
+
+   for(intercept_t *in = intercepts.begin(); in < intercepts.end(); in++)
    {
-      fixed_t dist = D_MAXINT;
-      intercept_t *scan;
-      for(scan = intercepts; scan < intercept_p; scan++)
-         if(scan->frac < dist)
-            dist = (in=scan)->frac;
-      if(dist > maxfrac)
+      if(in->frac > maxfrac)
          return true;    // checked everything in range
 
-      if(in) // haleyjd: for safety
-      {
-         if(!func(in, context))
-            return false;           // don't bother going farther
-         in->frac = D_MAXINT;
-      }
+      if(!func(in, context))
+         return false;           // don't bother going farther
    }
    return true;                  // everything was traversed
 }
 
 //
-// P_PathTraverse
+// P_gatherIntercepts
 //
-// Traces a line from x1,y1 to x2,y2,
-// calling the traverser function for each.
-// Returns true if the traverser function returns true
-// for all lines.
+// Gathers the intercepts of a trace from x1,y1 to x2,y2 into the arena of the
+// query context, unsorted. Returns false if an iterator quit early.
 //
 // killough 5/3/98: reformatted, cleaned up
 //
-bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
-                    int flags, traverser_t trav, void *context)
+static bool P_gatherIntercepts(QueryContext &query, fixed_t x1, fixed_t y1,
+                               fixed_t x2, fixed_t y2, int flags)
 {
    fixed_t xt1, yt1;
    fixed_t xt2, yt2;
@@ -956,8 +940,10 @@ bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
    int     mapxstep, mapystep;
    int     count;
 
-   validcount++;
-   intercept_p = intercepts;
+   InterceptArena &intercepts = query.getIntercepts();
+
+   query.newQuery();
+   intercepts.clear();
    
    if(!((x1-bmaporgx)&(MAPBLOCKSIZE-1)))
       x1 += FRACUNIT;     // don't side exactly on a line
@@ -1033,13 +1019,14 @@ bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
    {
       if(flags & PT_ADDLINES)
       {
-         if(!P_BlockLinesIterator(mapx, mapy, PIT_AddLineIntercepts))
+         if(!P_BlockLinesIterator(query, mapx, mapy, PIT_AddLineIntercepts, 
+                                  R_NOGROUP, &intercepts))
             return false; // early out
       }
       
       if(flags & PT_ADDTHINGS)
       {
-         if(!P_BlockThingsIterator(mapx, mapy, PIT_AddThingIntercepts))
+         if(!P_BlockThingsIterator(mapx, mapy, PIT_AddThingIntercepts, &intercepts))
             return false; // early out
       }
       
@@ -1058,8 +1045,168 @@ bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
       }
    }
 
+   return true;
+}
+
+//
+// P_PathTraverse
+//
+// Traces a line from x1,y1 to x2,y2,
+// calling the traverser function for each.
+// Returns true if the traverser function returns true
+// for all lines.
+//
+// killough 5/3/98: reformatted, cleaned up
+//
+// The lines are visited, and the intercepts kept, in the given query context.
+// The trace is still global, so only one path traversal can run at a time.
+//
+bool P_PathTraverse(QueryContext &query, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                    int flags, traverser_t trav, void *context)
+{
+   if(!P_gatherIntercepts(query, x1, y1, x2, y2, flags))
+      return false; // early out
+
    // go through the sorted list
-   return P_TraverseIntercepts(trav, FRACUNIT, context);
+   return P_TraverseIntercepts(query.getIntercepts(), trav, FRACUNIT, context);
+}
+
+bool P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                    int flags, traverser_t trav, void *context)
+{
+   return P_PathTraverse(QueryContext::Global(), x1, y1, x2, y2, flags, trav, context);
+}
+
+//=============================================================================
+//
+// Intercept Ordering Benchmark
+//
+// p_interceptbench fires traces all around the console player and times
+// ordering their intercepts with the old nearest-first scan against sorting
+// them, checking that both give the same order.
+//
+
+//
+// The old ordering: repeatedly scans for the nearest remaining intercept
+//
+static void P_benchSelectionOrder(intercept_t *items, size_t count, 
+                                  const intercept_t **order)
+{
+   for(size_t n = 0; n < count; n++)
+   {
+      fixed_t      dist = D_MAXINT;
+      intercept_t *in   = nullptr;
+      for(intercept_t *scan = items; scan < items + count; scan++)
+      {
+         if(scan->frac < dist)
+            dist = (in = scan)->frac;
+      }
+      if(!in)
+         break;
+      order[n] = in;
+      in->frac = D_MAXINT;
+   }
+}
+
+CONSOLE_COMMAND(p_interceptbench, cf_notnet|cf_level|cf_hidden)
+{
+   const Mobj *mo = players[consoleplayer].mo;
+   int numtraces = Console.argc ? Console.argv[0]->toInt() : 1024;
+
+   if(!mo)
+      return;
+   if(numtraces < 1)
+      numtraces = 1;
+
+   // gather the intercepts of all traces, unsorted
+   QueryContext *query = QueryContext::Acquire();
+   PODCollection<intercept_t> gathered;
+   PODCollection<size_t>      starts;
+   size_t maxcount = 0;
+
+   for(int i = 0; i < numtraces; i++)
+   {
+      angle_t an = static_cast<angle_t>((static_cast<uint64_t>(i) << 32) / numtraces);
+      fixed_t x2 = mo->x + FixedMul(MISSILERANGE, finecosine[an >> ANGLETOFINESHIFT]);
+      fixed_t y2 = mo->y + FixedMul(MISSILERANGE, finesine[an >> ANGLETOFINESHIFT]);
+
+      P_gatherIntercepts(*query, mo->x, mo->y, x2, y2, PT_ADDLINES | PT_ADDTHINGS);
+
+      starts.add(gathered.getLength());
+      for(const intercept_t &in : query->getIntercepts())
+         gathered.add(in);
+      maxcount = emax(maxcount, query->getIntercepts().getLength());
+   }
+   starts.add(gathered.getLength());
+   QueryContext::Release(query);
+
+   if(!gathered.getLength())
+   {
+      C_Printf("No intercepts were found\n");
+      return;
+   }
+
+   intercept_t        *work    = new intercept_t[maxcount + 1];
+   intercept_t        *scratch = new intercept_t[maxcount + 1];
+   const intercept_t **order   = new const intercept_t *[maxcount + 1];
+   unsigned int selectms = 0, sortms = 0;
+   int reps = 0, mismatches = 0;
+
+   // compare the orders once
+   for(int i = 0; i < numtraces; i++)
+   {
+      size_t count = starts[i + 1] - starts[i];
+      const intercept_t *src = &gathered[0] + starts[i];
+
+      memcpy(work, src, count * sizeof(intercept_t));
+      P_benchSelectionOrder(work, count, order);
+      for(size_t j = 0; j < count; j++)
+         order[j] = src + (order[j] - work);
+
+      memcpy(work, src, count * sizeof(intercept_t));
+      P_SortIntercepts(work, scratch, count);
+      for(size_t j = 0; j < count; j++)
+      {
+         if(work[j].frac != order[j]->frac || work[j].d.thing != order[j]->d.thing)
+         {
+            ++mismatches;
+            break;
+         }
+      }
+   }
+
+   // then time them, repeating until it takes long enough to measure
+   while(selectms < 500 && reps < 1000)
+   {
+      unsigned int start = i_haltimer.GetTicks();
+      for(int i = 0; i < numtraces; i++)
+      {
+         size_t count = starts[i + 1] - starts[i];
+         memcpy(work, &gathered[0] + starts[i], count * sizeof(intercept_t));
+         P_benchSelectionOrder(work, count, order);
+      }
+      unsigned int mid = i_haltimer.GetTicks();
+      for(int i = 0; i < numtraces; i++)
+      {
+         size_t count = starts[i + 1] - starts[i];
+         memcpy(work, &gathered[0] + starts[i], count * sizeof(intercept_t));
+         P_SortIntercepts(work, scratch, count);
+      }
+      sortms   += i_haltimer.GetTicks() - mid;
+      selectms += mid - start;
+      ++reps;
+   }
+
+   delete [] work;
+   delete [] scratch;
+   delete [] order;
+
+   C_Printf("%d traces, %d intercepts on average, %d at most\n", numtraces,
+            static_cast<int>(gathered.getLength() / numtraces), static_cast<int>(maxcount));
+   C_Printf("nearest-first scan: %.3f ms per pass\n", double(selectms) / reps);
+   C_Printf("sort:               %.3f ms per pass\n", double(sortms) / reps);
+   if(mismatches)
+      C_Printf(FC_ERROR "%d traces were ordered differently\n", mismatches);
 }
 
 // EOF
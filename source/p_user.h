@@ -41,6 +41,7 @@ void P_CalcHeight(player_t *player);
 void P_DeathThink(player_t *player);
 void P_MovePlayer(player_t *player);
 void P_Thrust(player_t *player, angle_t angle, angle_t pitch, fixed_t move);
+void P_Bob(player_t *player, angle_t angle, angle_t pitch, fixed_t move);
 void P_SetPlayerAttacker(player_t *player, Mobj *attacker);
 void P_SetDisplayPlayer(int new_displayplayer);
 void P_PlayerStartFlight(player_t *player, bool thrustup);
@@ -48,6 +48,7 @@
 #include "p_portalblockmap.h"
 #include "p_saveg.h"
 #include "p_setup.h"
+#include "p_sightbatch.h"
 #include "p_slopes.h"
 #include "p_spec.h"
 #include "p_tick.h"
@@ -1112,6 +1113,8 @@ static bool Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, bool onload = fa
    if(po->flags & POF_ISBAD)
       return false;
 
+   P_SightBatchInvalidate();
+
    PODCollection<portalthing_t> pts;
    if(po->numPortals)
       for(i = 0; i < po->numLines; ++i)
@@ -1306,6 +1309,8 @@ static bool Polyobj_rotate(polyobj_t *po, angle_t delta, bool onload = false)
 
    angle = (po->angle + delta) >> ANGLETOFINESHIFT;
 
+   P_SightBatchInvalidate();
+
    // point about which to rotate is the spawn spot
    origin.x = po->spawnSpot.x;
    origin.y = po->spawnSpot.y;
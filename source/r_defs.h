@@ -36,7 +36,6 @@
 #include "p_mobj.h"
 
 struct line_t;
-struct particle_t;
 struct planehash_t;
 struct portal_t;
 struct sector_t;
@@ -242,7 +241,6 @@ struct sector_t
    int16_t special;
    int16_t tag;
    int16_t leakiness;       // ioanch (UDMF): probability / 256 that the suit will leak
-   int nexttag, firsttag;   // killough 1/30/98: improves searches for tags.
    int soundtraversed;      // 0 = untraversed, 1,2 = sndlines-1
    Mobj *soundtarget;       // thing that made a sound (or null)
    fixed_t blockbox[4];     // mapblock bounding box for height changes
@@ -338,7 +336,6 @@ struct sector_t
    // haleyjd 09/24/06: sound sequence id
    int sndSeqID;
 
-   DLListItem<particle_t> *ptcllist; // haleyjd 02/20/04: list of particles in sector
 
    // haleyjd 07/04/07: Happy July 4th :P
    // Angles for flat rotation!
@@ -428,7 +425,6 @@ struct line_t
    sector_t *backsector; 
    int validcount;         // if == validcount, already checked
    int tranlump;           // killough 4/11/98: translucency filter, -1 == none
-   int firsttag, nexttag;  // killough 4/17/98: improves searches for tags.
    PointThinker soundorg;  // haleyjd 04/19/09: line sound origin
    int intflags;           // haleyjd 01/22/11: internal flags
 
@@ -1230,6 +1230,10 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
    R_ClearPortals();
    R_ClearSprites();
 
+   // list the particles by sector for R_AddSprites
+   if(drawparticles)
+      R_BinParticles();
+
    if(autodetect_hom)
       R_HOMdrawer();
    
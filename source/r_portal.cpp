@@ -612,6 +612,10 @@ portal_t *R_GetSkyBoxPortal(Mobj *camera)
    ret = R_CreatePortal();
    ret->type = R_SKYBOX;
    ret->data.camera = camera;
+
+   // the portal keeps the camera alive, even once it is removed or replaced
+   // by a rewind
+   camera->addReference();
    return ret;
 }
 
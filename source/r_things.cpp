@@ -111,9 +111,7 @@ int numsprites;
 
 // haleyjd: global particle system state
 
-int        activeParticles;
-int        inactiveParticles;
-particle_t *Particles;
+particlepool_t particlepool;
 int        particle_trans;
 
 float *mfloorclip, *mceilingclip;
@@ -174,10 +172,26 @@ struct vissprite_t
 // haleyjd 04/25/10: drawsegs optimization
 struct drawsegs_xrange_t
 {
-   int x1, x2;
+   int x1, x2;       // clipped to the tile
+   float dist;       // nearest end of the seg
+   float fardist;    // farthest end
    drawseg_t *user;
 };
 
+// Drawsegs are binned into tiles of screen columns, so that a sprite only
+// looks at the segs over the columns it covers. Each tile keeps the depth
+// range of its segs, which lets a sprite pass over a tile entirely behind it.
+#define DSTILESHIFT 5
+
+struct drawsegs_tile_t
+{
+   int   first;      // first entry in drawsegs_xrange
+   int   count;      // number of entries
+   float maxdist;    // nearest point of any seg
+   float minfardist; // farthest point of any seg
+   bool  masked;     // some seg has a masked mid texture
+};
+
 //=============================================================================
 //
 // Statics
@@ -205,6 +219,10 @@ static drawsegs_xrange_t *drawsegs_xrange;
 static unsigned int drawsegs_xrange_size = 0;
 static int drawsegs_xrange_count = 0;
 
+static drawsegs_tile_t *drawsegs_tiles;
+static int drawsegs_tiles_size = 0;
+static int drawsegs_numtiles = 0;
+
 static float *pscreenheightarray; // for psprites
 
 VALLOCATION(pscreenheightarray)
@@ -220,6 +238,10 @@ static int maxframe;
 // Max number of particles
 static int numParticles;
 
+// particles spawned since the last R_CommitParticles
+static particle_t *spawnedParticles;
+static int         numSpawnedParticles;
+
 static vissprite_t *vissprites, **vissprite_ptrs;  // killough
 static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
 
@@ -284,7 +306,7 @@ VALLOCATION(clipbot)
 
 // Forward declarations:
 static void R_DrawParticle(vissprite_t *vis);
-static void R_ProjectParticle(particle_t *particle);
+static void R_ProjectParticles(sector_t *sector);
 
 //
 // R_SetMaskedSilhouette
@@ -1207,12 +1229,7 @@ void R_AddSprites(sector_t* sec, int lightlevel)
    // haleyjd 02/20/04: Handle all particles in sector.
 
    if(drawparticles)
-   {
-      DLListItem<particle_t> *link;
-
-      for(link = sec->ptcllist; link; link = link->dllNext)
-         R_ProjectParticle(*link);
-   }
+      R_ProjectParticles(sec);
 }
 
 //
@@ -1538,6 +1555,98 @@ static void R_SortVisSpriteRange(int first, int last)
    }
 }
 
+//
+// R_BinDrawSegs
+//
+// Sorts the drawsegs of a range which can clip sprites into column tiles,
+// nearest first, the order in which R_DrawSpriteInDSRange must see them.
+//
+static void R_BinDrawSegs(int firstds, int lastds)
+{
+   drawseg_t *ds;
+   int numtiles = 0, total = 0;
+
+   drawsegs_xrange_count = 0;
+   drawsegs_numtiles     = 0;
+
+   for(ds = drawsegs + firstds; ds < drawsegs + lastds; ds++)
+   {
+      if(ds->silhouette || ds->maskedtexturecol)
+         numtiles = emax(numtiles, (ds->x2 >> DSTILESHIFT) + 1);
+   }
+   if(!numtiles)
+      return;
+
+   if(drawsegs_tiles_size < numtiles)
+   {
+      drawsegs_tiles_size = numtiles;
+      drawsegs_tiles = erealloc(drawsegs_tile_t *, drawsegs_tiles,
+                                drawsegs_tiles_size * sizeof(*drawsegs_tiles));
+   }
+   memset(drawsegs_tiles, 0, numtiles * sizeof(*drawsegs_tiles));
+
+   // count the segs over each tile and sum up their depths
+   for(ds = drawsegs + firstds; ds < drawsegs + lastds; ds++)
+   {
+      if(!ds->silhouette && !ds->maskedtexturecol)
+         continue;
+
+      float dist    = emax(ds->dist1, ds->dist2);
+      float fardist = emin(ds->dist1, ds->dist2);
+
+      for(int t = ds->x1 >> DSTILESHIFT; t <= ds->x2 >> DSTILESHIFT; t++)
+      {
+         drawsegs_tile_t &tile = drawsegs_tiles[t];
+
+         if(!tile.count || dist > tile.maxdist)
+            tile.maxdist = dist;
+         if(!tile.count || fardist < tile.minfardist)
+            tile.minfardist = fardist;
+         if(ds->maskedtexturecol)
+            tile.masked = true;
+         tile.count++;
+         total++;
+      }
+   }
+
+   if(drawsegs_xrange_size < unsigned(total))
+   {
+      // haleyjd: fix reallocation to track 2x size
+      drawsegs_xrange_size = 2 * total;
+      drawsegs_xrange = 
+         erealloc(drawsegs_xrange_t *, drawsegs_xrange, 
+                  drawsegs_xrange_size * sizeof(*drawsegs_xrange));
+   }
+
+   for(int t = 0; t < numtiles; t++)
+   {
+      drawsegs_tiles[t].first = drawsegs_xrange_count;
+      drawsegs_xrange_count  += drawsegs_tiles[t].count;
+      drawsegs_tiles[t].count = 0;
+   }
+
+   // fill the tiles from the last drawn seg back, so the nearest come first
+   for(ds = drawsegs + lastds; ds-- > drawsegs + firstds; )
+   {
+      if(!ds->silhouette && !ds->maskedtexturecol)
+         continue;
+
+      for(int t = ds->x1 >> DSTILESHIFT; t <= ds->x2 >> DSTILESHIFT; t++)
+      {
+         drawsegs_tile_t   &tile = drawsegs_tiles[t];
+         drawsegs_xrange_t &dsx  = drawsegs_xrange[tile.first + tile.count++];
+
+         dsx.x1      = emax(ds->x1, t << DSTILESHIFT);
+         dsx.x2      = emin(ds->x2, ((t + 1) << DSTILESHIFT) - 1);
+         dsx.dist    = emax(ds->dist1, ds->dist2);
+         dsx.fardist = emin(ds->dist1, ds->dist2);
+         dsx.user    = ds;
+      }
+   }
+
+   drawsegs_numtiles = numtiles;
+}
+
 //
 // R_DrawSpriteInDSRange
 //
@@ -1559,66 +1668,63 @@ static void R_DrawSpriteInDSRange(vissprite_t *spr, int firstds, int lastds)
    // e6y: optimization
    if(drawsegs_xrange_count)
    {
-      drawsegs_xrange_t *dsx = drawsegs_xrange;
+      int lasttile = emin(spr->x2 >> DSTILESHIFT, drawsegs_numtiles - 1);
 
-      // drawsegs_xrange is sorted by ::x1
-      // haleyjd: way faster to use a pointer here
-      while((ds = dsx->user))
+      for(int t = spr->x1 >> DSTILESHIFT; t <= lasttile; t++)
       {
-         // determine if the drawseg obscures the sprite
-         if(dsx->x1 > spr->x2 || dsx->x2 < spr->x1)
-         {
-            ++dsx;
-            continue;      // does not cover sprite
-         }
-         ++dsx;
+         const drawsegs_tile_t &tile = drawsegs_tiles[t];
 
-         if(ds->dist1 > ds->dist2)
-         {
-            fardist = ds->dist2;
-            dist = ds->dist1;
-         }
-         else
-         {
-            fardist = ds->dist1;
-            dist = ds->dist2;
-         }
+         // Nothing to do in a tile whose segs are all behind the sprite,
+         // unless they have masked textures to draw first.
+         if(!tile.count || (tile.maxdist < spr->dist && !tile.masked))
+            continue;
 
-         if(dist < spr->dist || (fardist < spr->dist &&
-            !R_PointOnSegSide(spr->gx, spr->gy, ds->curline)))
+         // When all of them are in front, none needs the side test.
+         bool infront = (tile.minfardist >= spr->dist);
+         int  tx1     = emax(spr->x1, t << DSTILESHIFT);
+         int  tx2     = emin(spr->x2, ((t + 1) << DSTILESHIFT) - 1);
+
+         // the entries are in drawing order, nearest first
+         const drawsegs_xrange_t *dsx = drawsegs_xrange + tile.first;
+         for(int i = tile.count; i--; dsx++)
          {
-            if(ds->maskedtexturecol) // masked mid texture?
+            // determine if the drawseg obscures the sprite
+            if(dsx->x1 > tx2 || dsx->x2 < tx1)
+               continue;      // does not cover sprite
+
+            ds = dsx->user;
+            r1 = dsx->x1 < tx1 ? tx1 : dsx->x1;
+            r2 = dsx->x2 > tx2 ? tx2 : dsx->x2;
+
+            if(!infront && (dsx->dist < spr->dist || (dsx->fardist < spr->dist &&
+               !R_PointOnSegSide(spr->gx, spr->gy, ds->curline))))
             {
-               r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-               r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
-               R_RenderMaskedSegRange(ds, r1, r2);
+               if(ds->maskedtexturecol) // masked mid texture?
+                  R_RenderMaskedSegRange(ds, r1, r2);
+               continue;                // seg is behind sprite
             }
-            continue;                // seg is behind sprite
-         }
 
-         r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-         r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
-
-         // clip this piece of the sprite
-         // killough 3/27/98: optimized and made much shorter
+            // clip this piece of the sprite
+            // killough 3/27/98: optimized and made much shorter
 
-         // bottom sil
-         if(ds->silhouette & SIL_BOTTOM && spr->gz < ds->bsilheight)
-         {
-            for(x = r1; x <= r2; x++)
+            // bottom sil
+            if(ds->silhouette & SIL_BOTTOM && spr->gz < ds->bsilheight)
             {
-               if(clipbot[x] == CLIP_UNDEF)
-                  clipbot[x] = ds->sprbottomclip[x];
+               for(x = r1; x <= r2; x++)
+               {
+                  if(clipbot[x] == CLIP_UNDEF)
+                     clipbot[x] = ds->sprbottomclip[x];
+               }
             }
-         }
 
-         // top sil
-         if(ds->silhouette & SIL_TOP && spr->gzt > ds->tsilheight)
-         {
-            for(x = r1; x <= r2; x++)
+            // top sil
+            if(ds->silhouette & SIL_TOP && spr->gzt > ds->tsilheight)
             {
-               if(cliptop[x] == CLIP_UNDEF)
-                  cliptop[x] = ds->sprtopclip[x];
+               for(x = r1; x <= r2; x++)
+               {
+                  if(cliptop[x] == CLIP_UNDEF)
+                     cliptop[x] = ds->sprtopclip[x];
+               }
             }
          }
       }
@@ -1823,30 +1929,7 @@ void R_DrawPostBSP()
             // Reducing of cache misses in the following R_DrawSprite()
             // Makes sense for scenes with huge amount of drawsegs.
             // ~12% of speed improvement on epic.wad map05
-            drawsegs_xrange_count = 0;
-            if(num_vissprite > 0)
-            {
-               if(drawsegs_xrange_size <= maxdrawsegs+1)
-               {
-                  // haleyjd: fix reallocation to track 2x size
-                  drawsegs_xrange_size =  2 * (maxdrawsegs+1);
-                  drawsegs_xrange = 
-                     erealloc(drawsegs_xrange_t *, drawsegs_xrange, 
-                              drawsegs_xrange_size * sizeof(*drawsegs_xrange));
-               }
-               for(ds = drawsegs + lastds; ds-- > drawsegs + firstds; )
-               {
-                  if (ds->silhouette || ds->maskedtexturecol)
-                  {
-                     drawsegs_xrange[drawsegs_xrange_count].x1   = ds->x1;
-                     drawsegs_xrange[drawsegs_xrange_count].x2   = ds->x2;
-                     drawsegs_xrange[drawsegs_xrange_count].user = ds;
-                     drawsegs_xrange_count++;
-                  }
-               }
-               // haleyjd: terminate with a NULL user for faster loop - adds ~3 FPS
-               drawsegs_xrange[drawsegs_xrange_count].user = NULL;
-            }
+            R_BinDrawSegs(firstds, lastds);
 
             ptop    = masked->ceilingclip;
             pbottom = masked->floorclip;
@@ -2167,20 +2250,19 @@ void R_CheckMobjProjections(Mobj *mobj, bool checklines)
 //
 // newParticle
 //
-// Tries to find an inactive particle in the Particles list
+// Returns a cleared particle to be set up by the caller, which joins the
+// particle pool at the next R_CommitParticles.
 // Returns NULL on failure
 //
 particle_t *newParticle()
 {
-   particle_t *result = NULL;
-   if(inactiveParticles != -1)
-   {
-      result = Particles + inactiveParticles;
-      inactiveParticles = result->next;
-      result->next = activeParticles;
-      activeParticles = int(result - Particles);
-   }
+   particle_t *result;
+
+   if(particlepool.count + numSpawnedParticles >= numParticles)
+      return NULL;
 
+   result = &spawnedParticles[numSpawnedParticles++];
+   memset(result, 0, sizeof(particle_t));
    return result;
 }
 
@@ -2191,6 +2273,7 @@ particle_t *newParticle()
 //
 void R_InitParticles()
 {
+   particlepool_t &pool = particlepool;
    int i;
 
    numParticles = 0;
@@ -2203,172 +2286,274 @@ void R_InitParticles()
    else if(numParticles < 100)
       numParticles = 100;
    
-   Particles = (particle_t *)(Z_Malloc(numParticles*sizeof(particle_t), PU_STATIC, NULL));
+   spawnedParticles = estructalloc(particle_t, numParticles);
+
+   pool.max        = numParticles;
+   pool.x          = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.y          = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.z          = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.velx       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.vely       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.velz       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.accx       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.accy       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.accz       = ecalloc(fixed_t *, numParticles, sizeof(fixed_t));
+   pool.trans      = ecalloc(unsigned int *, numParticles, sizeof(unsigned int));
+   pool.fade       = ecalloc(unsigned int *, numParticles, sizeof(unsigned int));
+   pool.ttl        = ecalloc(byte *, numParticles, sizeof(byte));
+   pool.size       = ecalloc(byte *, numParticles, sizeof(byte));
+   pool.color      = ecalloc(byte *, numParticles, sizeof(byte));
+   pool.styleflags = ecalloc(int *, numParticles, sizeof(int));
+   pool.subsector  = ecalloc(subsector_t **, numParticles, sizeof(subsector_t *));
+   pool.flags      = ecalloc(byte *, numParticles, sizeof(byte));
+   pool.bins       = ecalloc(int *, numParticles, sizeof(int));
+
    R_ClearParticles();
 }
 
 //
 // R_ClearParticles
 //
-// set up the particle list
+// Removes all particles
 //
 void R_ClearParticles()
 {
-   int i;
-   
-   memset(Particles, 0, numParticles*sizeof(particle_t));
-   activeParticles = -1;
-   inactiveParticles = 0;
-   for(i = 0; i < numParticles - 1; i++)
-      Particles[i].next = i + 1;
-   Particles[i].next = -1;
+   particlepool.count     = 0;
+   particlepool.binsdirty = true;
+   numSpawnedParticles    = 0;
 }
 
 //
-// R_ProjectParticle
+// R_CommitParticles
 //
-static void R_ProjectParticle(particle_t *particle)
+// Moves the newly spawned particles into the pool.
+//
+void R_CommitParticles()
 {
-   fixed_t gzt;
-   int x1, x2;
-   vissprite_t *vis;
-   sector_t    *sector = NULL;
-   int heightsec = -1;
-   
-   float tempx, tempy, ty1, tx1, tx2, tz;
-   float idist, xscale, yscale;
-   float y1, y2;
+   particlepool_t &pool = particlepool;
 
-   // SoM: Cardboard translate the mobj coords and just project the sprite.
-   tempx = M_FixedToFloat(particle->x) - view.x;
-   tempy = M_FixedToFloat(particle->y) - view.y;
-   ty1   = (tempy * view.cos) + (tempx * view.sin);
+   for(int i = 0; i < numSpawnedParticles; i++)
+   {
+      const particle_t &p = spawnedParticles[i];
+      int n = pool.count++;
 
-   // lies in front of the front view plane
-   if(ty1 < 1.0f)
-      return;
+      pool.x[n]          = p.x;
+      pool.y[n]          = p.y;
+      pool.z[n]          = p.z;
+      pool.velx[n]       = p.velx;
+      pool.vely[n]       = p.vely;
+      pool.velz[n]       = p.velz;
+      pool.accx[n]       = p.accx;
+      pool.accy[n]       = p.accy;
+      pool.accz[n]       = p.accz;
+      pool.trans[n]      = p.trans;
+      pool.fade[n]       = p.fade;
+      pool.ttl[n]        = p.ttl;
+      pool.size[n]       = p.size;
+      pool.color[n]      = p.color;
+      pool.styleflags[n] = p.styleflags;
+      pool.subsector[n]  = p.subsector ? p.subsector : R_PointInSubsector(p.x, p.y);
+   }
 
-   // invisible?
-   if(!particle->trans)
-      return;
+   if(numSpawnedParticles)
+   {
+      pool.binsdirty = true;
+      numSpawnedParticles = 0;
+   }
+}
 
-   tx1 = (tempx * view.cos) - (tempy * view.sin);
+//
+// R_BinParticles
+//
+// Commits any new particles, then sorts the particles by sector into the
+// bins of the pool, unless nothing changed since the last time.
+//
+void R_BinParticles()
+{
+   particlepool_t &pool = particlepool;
 
-   tx2 = tx1 + 1.0f;
+   R_CommitParticles();
 
-   idist = 1.0f / ty1;
-   xscale = idist * view.xfoc;
-   yscale = idist * view.yfoc;
-   
-   // calculate edges of the shape
-   x1 = (int)(view.xcenter + (tx1 * xscale));
-   x2 = (int)(view.xcenter + (tx2 * xscale));
+   if(pool.binsectors != numsectors)
+   {
+      pool.binstart   = erealloc(int *, pool.binstart, (numsectors + 1) * sizeof(int));
+      pool.binsectors = numsectors;
+      pool.binsdirty  = true;
+   }
 
-   if(x2 < x1) x2 = x1;
-   
-   // off either side?
-   if(x1 >= viewwindow.width || x2 < 0)
+   if(!pool.binsdirty)
       return;
 
-   tz = M_FixedToFloat(particle->z) - view.z;
+   // count the particles of each sector, then turn the counts into starts
+   memset(pool.binstart, 0, (numsectors + 1) * sizeof(int));
+   for(int i = 0; i < pool.count; i++)
+      ++pool.binstart[pool.subsector[i]->sector - sectors + 1];
+   for(int s = 0; s < numsectors; s++)
+      pool.binstart[s + 1] += pool.binstart[s];
 
-   y1 = (view.ycenter - (tz * yscale));
-   y2 = (view.ycenter - ((tz - 1.0f) * yscale));
-   
-   if(y2 < 0.0f || y1 >= view.height)
+   // filling a sector moves its start up to the start of the next one...
+   for(int i = 0; i < pool.count; i++)
+      pool.bins[pool.binstart[pool.subsector[i]->sector - sectors]++] = i;
+
+   // ...so move them all back down by one
+   for(int s = numsectors; s > 0; s--)
+      pool.binstart[s] = pool.binstart[s - 1];
+   pool.binstart[0] = 0;
+
+   pool.binsdirty = false;
+}
+
+//
+// R_ProjectParticles
+//
+// Projects the particles of one sector. The colormap and light table depend
+// only on the sector, so they are worked out once for all of them.
+//
+static void R_ProjectParticles(sector_t *sector)
+{
+   const particlepool_t &pool = particlepool;
+   int  secnum    = int(sector - sectors);
+   int  heightsec = sector->heightsec;
+   int  phs       = view.sector->heightsec;
+   bool inverse;
+   lighttable_t  *brightmap = NULL;
+   lighttable_t **ltable    = NULL;
+
+   if(pool.binsdirty || pool.binsectors != numsectors ||
+      pool.binstart[secnum] == pool.binstart[secnum + 1])
       return;
-   
-   gzt = particle->z + 1;
-   
-   // killough 3/27/98: exclude things totally separated
-   // from the viewer, by either water or fake ceilings
-   // killough 4/11/98: improve sprite clipping for underwater/fake ceilings
-   
+
+   inverse = 
+      (fixedcolormap == fullcolormap + INVERSECOLORMAP*256*sizeof(lighttable_t));
+
+   if(!inverse)
    {
-      // haleyjd 02/20/04: use subsector now stored in particle
-      subsector_t *subsector = particle->subsector;
-      sector = subsector->sector;
-      heightsec = sector->heightsec;
+      sector_t tmpsec;
+      int floorlightlevel, ceilinglightlevel, lightnum;
 
-      if(particle->z < sector->floorheight || 
-	 particle->z > sector->ceilingheight)
-	 return;
+      R_SectorColormap(sector);
+      brightmap = fullcolormap;
+
+      R_FakeFlat(sector, &tmpsec, &floorlightlevel, 
+                 &ceilinglightlevel, false);
+
+      lightnum = (floorlightlevel + ceilinglightlevel) / 2;
+      lightnum = (lightnum >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
+         
+      if(lightnum >= LIGHTLEVELS || fixedcolormap)
+         ltable = scalelight[LIGHTLEVELS - 1];      
+      else if(lightnum < 0)
+         ltable = scalelight[0];
+      else
+         ltable = scalelight[lightnum];
    }
-   
-   // only clip particles which are in special sectors
-   if(heightsec != -1)
+
+   for(int i = pool.binstart[secnum]; i < pool.binstart[secnum + 1]; i++)
    {
-      int phs = view.sector->heightsec;
-      
-      if(phs != -1 && 
-	 viewz < sectors[phs].floorheight ?
-	 particle->z >= sectors[heightsec].floorheight :
-         gzt < sectors[heightsec].floorheight)
-         return;
+      int n = pool.bins[i];
+      fixed_t px = pool.x[n], py = pool.y[n], pz = pool.z[n];
+      fixed_t gzt;
+      int x1, x2;
+      vissprite_t *vis;
+   
+      float tempx, tempy, ty1, tx1, tx2, tz;
+      float idist, xscale, yscale;
+      float y1, y2;
 
-      if(phs != -1 && 
-	 viewz > sectors[phs].ceilingheight ?
-	 gzt < sectors[heightsec].ceilingheight &&
-	 viewz >= sectors[heightsec].ceilingheight :
-         particle->z >= sectors[heightsec].ceilingheight)
-         return;
-   }
+      // SoM: Cardboard translate the mobj coords and just project the sprite.
+      tempx = M_FixedToFloat(px) - view.x;
+      tempy = M_FixedToFloat(py) - view.y;
+      ty1   = (tempy * view.cos) + (tempx * view.sin);
+
+      // lies in front of the front view plane
+      if(ty1 < 1.0f)
+         continue;
+
+      // invisible?
+      if(!pool.trans[n])
+         continue;
+
+      tx1 = (tempx * view.cos) - (tempy * view.sin);
+
+      tx2 = tx1 + 1.0f;
+
+      idist = 1.0f / ty1;
+      xscale = idist * view.xfoc;
+      yscale = idist * view.yfoc;
    
-   // store information in a vissprite
-   vis = R_NewVisSprite();
-   vis->heightsec = heightsec;
-   vis->gx = particle->x;
-   vis->gy = particle->y;
-   vis->gz = particle->z;
-   vis->gzt = gzt;
-   vis->texturemid = vis->gzt - viewz;
-   vis->x1 = x1 < 0 ? 0 : x1;
-   vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
-   vis->colour = particle->color;
-   vis->patch = -1;
-   vis->translucency = static_cast<uint16_t>(particle->trans - 1);
-   vis->tranmaplump = -1;
-   // Cardboard
-   vis->dist = idist;
-   vis->xstep = 1.0f / xscale;
-   vis->ytop = y1;
-   vis->ybottom = y2;
-   vis->scale = yscale;
-   vis->sector = int(sector - sectors);
+      // calculate edges of the shape
+      x1 = (int)(view.xcenter + (tx1 * xscale));
+      x2 = (int)(view.xcenter + (tx2 * xscale));
+
+      if(x2 < x1) x2 = x1;
    
-   if(fixedcolormap ==
-      fullcolormap + INVERSECOLORMAP*256*sizeof(lighttable_t))
-   {
-      vis->colormap = fixedcolormap;
-   } 
-   else
-   {
-      R_SectorColormap(sector);
+      // off either side?
+      if(x1 >= viewwindow.width || x2 < 0)
+         continue;
+
+      tz = M_FixedToFloat(pz) - view.z;
 
-      if(LevelInfo.useFullBright && (particle->styleflags & PS_FULLBRIGHT))
+      y1 = (view.ycenter - (tz * yscale));
+      y2 = (view.ycenter - ((tz - 1.0f) * yscale));
+   
+      if(y2 < 0.0f || y1 >= view.height)
+         continue;
+   
+      gzt = pz + 1;
+   
+      // killough 3/27/98: exclude things totally separated
+      // from the viewer, by either water or fake ceilings
+      // killough 4/11/98: improve sprite clipping for underwater/fake ceilings
+
+      if(pz < sector->floorheight || pz > sector->ceilingheight)
+         continue;
+   
+      // only clip particles which are in special sectors
+      if(heightsec != -1)
       {
-         vis->colormap = fullcolormap;
+         if(phs != -1 && 
+            viewz < sectors[phs].floorheight ?
+            pz >= sectors[heightsec].floorheight :
+            gzt < sectors[heightsec].floorheight)
+            continue;
+
+         if(phs != -1 && 
+            viewz > sectors[phs].ceilingheight ?
+            gzt < sectors[heightsec].ceilingheight &&
+            viewz >= sectors[heightsec].ceilingheight :
+            pz >= sectors[heightsec].ceilingheight)
+            continue;
       }
+   
+      // store information in a vissprite
+      vis = R_NewVisSprite();
+      vis->heightsec = heightsec;
+      vis->gx = px;
+      vis->gy = py;
+      vis->gz = pz;
+      vis->gzt = gzt;
+      vis->texturemid = vis->gzt - viewz;
+      vis->x1 = x1 < 0 ? 0 : x1;
+      vis->x2 = x2 >= viewwindow.width ? viewwindow.width-1 : x2;
+      vis->colour = pool.color[n];
+      vis->patch = -1;
+      vis->translucency = static_cast<uint16_t>(pool.trans[n] - 1);
+      vis->tranmaplump = -1;
+      // Cardboard
+      vis->dist = idist;
+      vis->xstep = 1.0f / xscale;
+      vis->ytop = y1;
+      vis->ybottom = y2;
+      vis->scale = yscale;
+      vis->sector = secnum;
+   
+      if(inverse)
+         vis->colormap = fixedcolormap;
+      else if(LevelInfo.useFullBright && (pool.styleflags[n] & PS_FULLBRIGHT))
+         vis->colormap = brightmap;
       else
       {
-         lighttable_t **ltable;
-         sector_t tmpsec;
-         int floorlightlevel, ceilinglightlevel, lightnum, index;
-
-         R_FakeFlat(sector, &tmpsec, &floorlightlevel, 
-                    &ceilinglightlevel, false);
-
-         lightnum = (floorlightlevel + ceilinglightlevel) / 2;
-         lightnum = (lightnum >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
-         
-         if(lightnum >= LIGHTLEVELS || fixedcolormap)
-            ltable = scalelight[LIGHTLEVELS - 1];      
-         else if(lightnum < 0)
-            ltable = scalelight[0];
-         else
-            ltable = scalelight[lightnum];
-         
-         index = (int)(idist * 2560.0f);
+         int index = (int)(idist * 2560.0f);
          if(index >= MAXLIGHTSCALE)
             index = MAXLIGHTSCALE - 1;
          
@@ -79,6 +79,8 @@ void R_DrawPostBSP(void);
 void R_ClearParticles(void);
 void R_InitParticles(void);
 particle_t *newParticle(void);
+void R_CommitParticles();
+void R_BinParticles();
 
 typedef struct cb_maskedcolumn_s
 {
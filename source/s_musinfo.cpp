@@ -65,8 +65,14 @@ void S_MusInfoClear()
 //
 void S_MusInfoThink(Mobj &thing)
 {
+   const Mobj *mo = players[consoleplayer].mo;
+
+   // a dedicated server has no player of its own
+   if(!mo)
+      return;
+
    if(musinfo.mapthing != &thing &&
-      thing.subsector->sector == players[consoleplayer].mo->subsector->sector)
+      thing.subsector->sector == mo->subsector->sector)
    {
       P_SetTarget(&musinfo.lastmapthing, musinfo.mapthing);
       P_SetTarget(&musinfo.mapthing, &thing);
@@ -79,20 +79,6 @@ static bool I_NetSendError()
 static bool (*netget )() = I_NetGetError;
 static bool (*netsend)() = I_NetSendError;
 
-inline static void HostToNet16(Sint16 value, byte *area)
-{
-   // input is host endianness, output is big endian
-
-   area[0] = (byte)((value >> 8) & 0xff);
-   area[1] = (byte)( value       & 0xff);
-}
-
-inline static Sint16 NetToHost16(const byte *area)
-{
-   // input is big endian, output is host endianness
-   return ((Sint16)area[0] << 8) | area[1];
-}
-
 inline static void HostToNet32(Uint32 value, byte *area)
 {
    // input is host endianness, output is big endian
@@ -120,82 +106,21 @@ inline static Uint32 NetToHost32(const byte *area)
 //
 // NetChecksum 
 //
-static uint32_t NetChecksum(byte *packetdata, int len)
+// Summed bytewise, so that every byte counts and both ends agree whatever
+// their endianness.
+//
+static uint32_t NetChecksum(const byte *packetdata, int len)
 {
    uint32_t c = 0x1234567;
    int i;
-   
-   len /= sizeof(uint32_t);
 
    for(i = 0; i < len; ++i)
-      c += ((uint32_t *)packetdata)[i] * (i + 1);
+      c += packetdata[i] * (i + 1);
    
    return c & NCMD_CHECKSUM;
 }
 
 
-#define NETWRITEBYTE(b) \
-   *rover++ = (b); \
-   packetsize += 1
-
-#define NETWRITEBYTEIF(b, flag) \
-   do \
-   { \
-      if((b)) \
-      { \
-         NETWRITEBYTE((b)); \
-         ticcmdflags |= (flag); \
-      } \
-   } \
-   while(0)
-
-#define NETWRITESHORT(s) \
-   HostToNet16((s), rover); \
-   rover += 2; \
-   packetsize += 2
-
-#define NETWRITESHORTIF(s, flag) \
-   do \
-   { \
-      if((s)) \
-      { \
-         NETWRITESHORT((s)); \
-         ticcmdflags |= (flag); \
-      } \
-   } \
-   while(0)
-
-#define NETWRITELONG(dw) \
-   HostToNet32((dw), rover); \
-   rover += 4; \
-   packetsize += 4
-
-#define NETWRITELONGIF(dw, flag) \
-   do \
-   { \
-      if((dw)) \
-      { \
-         NETWRITELONG((dw)); \
-         ticcmdflags |= (flag); \
-      } \
-   } \
-   while(0)
-
-enum
-{
-   TCF_FORWARDMOVE = 0x00000001,
-   TCF_SIDEMOVE    = 0x00000002,
-   TCF_ANGLETURN   = 0x00000004,
-   TCF_CHATCHAR    = 0x00000008,
-   TCF_BUTTONS     = 0x00000010,
-   TCF_ACTIONS     = 0x00000020,
-   TCF_LOOK        = 0x00000040,
-   TCF_FLY         = 0x00000080,
-   TCF_ITEMID      = 0x00000100,
-   TCF_WEAPONID    = 0x00000200,
-   TCF_SLOTINDEX   = 0x00000400,
-};
-
 // DEBUG
 
 void writesendpacket(void *data, int len)
@@ -224,68 +149,17 @@ void writegetpacket(void *data, int len)
 //
 // PacketSend
 //
+// The packet goes out as encoded by d_net, behind its checksum.
+//
 bool PacketSend(void)
 {
-   int c;
-   int packetsize = 0;   
-
    byte *rover = (byte *)packet->data;
+   int packetsize = doomcom->datalength;
 
-   // reserve 4 bytes for the checksum
-   rover += 4;
-
-   NETWRITEBYTE(netbuffer->player);
-   NETWRITEBYTE(netbuffer->retransmitfrom);
-   NETWRITEBYTE(netbuffer->starttic);
-   NETWRITEBYTE(netbuffer->numtics);
-
-   if(!(netbuffer->checksum & NCMD_SETUP))
-   {
-      for(c = 0; c < netbuffer->numtics; ++c)
-      {
-         byte *ticstart = rover, *ticend;
-         Sint16 ticcmdflags = 0;         
-         
-         // reserve 2 bytes for the flags
-         rover += 2;
-
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].forwardmove, TCF_FORWARDMOVE);
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].sidemove,    TCF_SIDEMOVE);
-         NETWRITESHORTIF(netbuffer->d.cmds[c].angleturn,  TCF_ANGLETURN);         
-         
-         NETWRITESHORT(netbuffer->d.cmds[c].consistency);         
-
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].chatchar,  TCF_CHATCHAR);
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].buttons,   TCF_BUTTONS);
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].actions,   TCF_ACTIONS);
-         NETWRITESHORTIF(netbuffer->d.cmds[c].look,     TCF_LOOK);
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].fly,       TCF_FLY);
-         NETWRITESHORTIF(netbuffer->d.cmds[c].itemID,   TCF_ITEMID);
-         NETWRITESHORTIF(netbuffer->d.cmds[c].weaponID, TCF_WEAPONID);
-         NETWRITEBYTEIF(netbuffer->d.cmds[c].chatchar,  TCF_CHATCHAR);
-
-         // go back to ticstart and write in the flags
-         ticend = rover;
-         rover  = ticstart;
-         NETWRITESHORT(ticcmdflags);
-
-         rover = ticend;
-      }
-   }
-   else
-   {
-      for(c = 0; c < GAME_OPTION_SIZE; ++c)
-         *rover++ = netbuffer->d.data[c];
-      
-      packetsize += GAME_OPTION_SIZE;
-   }
-
-   // Go back and write the checksum at the beginning
-   rover = (byte *)packet->data;
-   netbuffer->checksum |= NetChecksum((byte *)packet->data + 4, packetsize);
-   NETWRITELONG(netbuffer->checksum);
+   HostToNet32(NetChecksum(doomcom->packet, packetsize), rover);
+   memcpy(rover + 4, doomcom->packet, packetsize);
    
-   packet->len     = packetsize;
+   packet->len     = packetsize + 4;
    packet->address = sendaddress[doomcom->remotenode];
 
    // DEBUG
@@ -306,7 +180,7 @@ bool PacketSend(void)
 bool PacketGet(void)
 {
    uint32_t checksum;
-   int i, c, packets_read;
+   int i, packets_read;
    byte *rover;
    
    packets_read = SDLNet_UDP_Recv(udpsocket, packet);
@@ -337,83 +211,21 @@ bool PacketGet(void)
    
    doomcom->remotenode = i;
 
-   if(packet->len < 4)
+   if(packet->len < 4 || packet->len - 4 > int(NETMAXPACKETSIZE))
       return false;
    
    rover = (byte *)packet->data;
 
    checksum = NetToHost32(rover);
+   rover += 4;
    
    // haleyjd: verify checksum first; if fails, don't even read the rest
-   if((checksum & NCMD_CHECKSUM) != NetChecksum((byte *)packet->data + 4, packet->len - 4))
+   if((checksum & NCMD_CHECKSUM) != NetChecksum(rover, packet->len - 4))
       return false;
-   
-   netbuffer->checksum = checksum;
-   rover += 4;
-   
-   netbuffer->player         = *rover++;
-   netbuffer->retransmitfrom = *rover++;
-   netbuffer->starttic       = *rover++;
-   netbuffer->numtics        = *rover++;
-   
-   if(!(netbuffer->checksum & NCMD_SETUP))
-   {
-      for(c = 0; c < netbuffer->numtics; ++c)
-      {
-         Sint16 ticcmdflags;
-
-         ticcmdflags = NetToHost16(rover);
-         rover += 2;
-
-         memset(&(netbuffer->d.cmds[c]), 0, sizeof(ticcmd_t));
-
-         if(ticcmdflags & TCF_FORWARDMOVE)
-            netbuffer->d.cmds[c].forwardmove = *rover++;
-         if(ticcmdflags & TCF_SIDEMOVE)
-            netbuffer->d.cmds[c].sidemove = *rover++;
-         if(ticcmdflags & TCF_ANGLETURN)
-         {
-            netbuffer->d.cmds[c].angleturn = NetToHost16(rover);
-            rover += 2;
-         }
-         
-         netbuffer->d.cmds[c].consistency = NetToHost16(rover);
-         rover += 2;
-         
-         if(ticcmdflags & TCF_CHATCHAR)
-            netbuffer->d.cmds[c].chatchar = *rover++;
-         if(ticcmdflags & TCF_BUTTONS)
-            netbuffer->d.cmds[c].buttons = *rover++;
-         if(ticcmdflags & TCF_ACTIONS)
-            netbuffer->d.cmds[c].actions = *rover++;
-         if(ticcmdflags & TCF_LOOK)
-         {
-            netbuffer->d.cmds[c].look = NetToHost16(rover);
-            rover += 2;
-         }
-         if(ticcmdflags & TCF_FLY)
-            netbuffer->d.cmds[c].fly = *rover++;
-         if(ticcmdflags & TCF_ITEMID)
-         {
-            netbuffer->d.cmds[c].itemID = NetToHost16(rover);
-            rover += 2;
-         }
-         if(ticcmdflags & TCF_WEAPONID)
-         {
-            netbuffer->d.cmds[c].weaponID = NetToHost16(rover);
-            rover += 2;
-         }
-         if(ticcmdflags & TCF_SLOTINDEX)
-         {
-            netbuffer->d.cmds[c].slotIndex = *rover++;
-         }
-      }
-   }
-   else
-   {
-      for(c = 0; c < GAME_OPTION_SIZE; ++c)
-         netbuffer->d.data[c] = *rover++;
-   }
+
+   // d_net decodes the rest
+   doomcom->datalength = packet->len - 4;
+   memcpy(doomcom->packet, rover, doomcom->datalength);
 
    return true;
 }
@@ -509,6 +321,9 @@ void I_InitNetwork(void)
    i++;
    while(++i < myargc && myargv[i][0] != '-')
    {
+      if(doomcom->numnodes == MAXNETNODES)
+         I_Error("I_InitNetwork: too many nodes (max %d)\n", MAXNETNODES);
+
       if(SDLNet_ResolveHost(&sendaddress[doomcom->numnodes], myargv[i], DOOMPORT))
          I_Error("Unable to resolve %s\n", myargv[i]);
       
@@ -520,7 +335,7 @@ void I_InitNetwork(void)
    
    udpsocket = SDLNet_UDP_Open(DOOMPORT);
 
-   packet = SDLNet_AllocPacket((int)((sizeof(doomdata_t) + 31) & ~31));
+   packet = SDLNet_AllocPacket((int)((NETMAXPACKETSIZE + 4 + 31) & ~31));
 }
 
 bool I_NetCmd(void)
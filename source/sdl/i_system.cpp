@@ -156,15 +156,20 @@ void I_Quit(void)
    //         06/06/10: check each call, as an I_FatalError called from any of this
    //                   code could escalate the error status.
 
-   IFNOTFATAL(M_SaveDefaults());
-   IFNOTFATAL(M_SaveSysConfig());
-   IFNOTFATAL(G_SaveDefaults()); // haleyjd
+   // -demoverify runs many instances at once, which must leave the
+   // configuration files alone
+   if(!G_DemoHashEnabled())
+   {
+      IFNOTFATAL(M_SaveDefaults());
+      IFNOTFATAL(M_SaveSysConfig());
+      IFNOTFATAL(G_SaveDefaults()); // haleyjd
+   }
    
 #ifdef _MSC_VER
    // Under Visual C++, the console window likes to rudely slam
    // shut -- this can stop it, but is now optional except when an error occurs
    // ioanch 20160313: do not pause if demo logging is enabled
-   if(!G_DemoLogEnabled() && 
+   if(!G_DemoLogEnabled() && !G_DemoHashEnabled() &&
       (error_exitcode >= I_ERRORLEVEL_NORMAL || waitAtExit))
    {
       puts("Press any key to continue\n");
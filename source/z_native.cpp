@@ -36,6 +36,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <mutex>
+
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomstat.h"
@@ -298,6 +300,34 @@ void Z_Init(void)
    Z_LogPrintf("Initialized zone heap (using native implementation)\n");
 }
 
+//=============================================================================
+//
+// Thread Safety
+//
+// The zone heap belongs to the main thread. While it is set as threaded, the
+// core routines below take a lock, so that code running on worker threads
+// (see m_parallel.cpp) may still allocate and free plain blocks. Allocating
+// ZoneObjects off the main thread is never safe.
+//
+
+static bool zonethreaded;
+static std::recursive_mutex zonemutex;
+
+#define ZONE_LOCK() \
+   std::unique_lock<std::recursive_mutex> zonelock(zonemutex, std::defer_lock); \
+   if(zonethreaded) \
+      zonelock.lock()
+
+//
+// Z_SetThreaded
+//
+// Must only be called by the main thread while no workers are running.
+//
+void Z_SetThreaded(bool threaded)
+{
+   zonethreaded = threaded;
+}
+
 //=============================================================================
 //
 // Core Memory Management Routines
@@ -310,6 +340,7 @@ void Z_Init(void)
 //
 void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 {
+   ZONE_LOCK();
    memblock_t *block;
    byte *ret;
 
@@ -371,6 +402,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 //
 void (Z_Free)(void *p, const char *file, int line)
 {
+   ZONE_LOCK();
    DEBUG_CHECKHEAP();
 
    if(p)
@@ -424,6 +456,7 @@ void (Z_Free)(void *p, const char *file, int line)
 //
 void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 {
+   ZONE_LOCK();
    memblock_t *block;
 
    // haleyjd 03/30/2011: delete ZoneObjects of the same tags as well
@@ -459,6 +492,7 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 //
 void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 {
+   ZONE_LOCK();
    memblock_t *block;
    
    DEBUG_CHECKHEAP();
@@ -508,6 +542,7 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
                   const char *file, int line)
 {
+   ZONE_LOCK();
    void *p;
    memblock_t *block, *newblock, *origblock;
 
@@ -102,6 +102,7 @@ void  (Z_Free)(void *ptr, const char *, int);
 void  (Z_FreeTags)(int lowtag, int hightag, const char *, int);
 void  (Z_ChangeTag)(void *ptr, int tag, const char *, int);
 void   Z_Init();
+void   Z_SetThreaded(bool threaded);
 void *(Z_Calloc)(size_t n, size_t n2, int tag, void **user, const char *, int);
 void *(Z_Realloc)(void *p, size_t n, int tag, void **user, const char *, int);
 char *(Z_Strdup)(const char *s, int tag, void **user, const char *, int);